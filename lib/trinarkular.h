@@ -91,8 +91,11 @@
 
 /** @} */
 
+#include "trinarkular_belief.h"
+#include "trinarkular_journal.h"
 #include "trinarkular_probe.h"
 #include "trinarkular_probelist.h"
 #include "trinarkular_prober.h"
+#include "trinarkular_state_table.h"
 
 #endif /* __TRINARKULAR_H */
@@ -0,0 +1,220 @@
+/*
+ * This file is part of trinarkular
+ *
+ * Copyright (C) 2015 The Regents of the University of California.
+ * Authors: Alistair King
+ *
+ * This software is Copyright (c) 2015 The Regents of the University of
+ * California. All Rights Reserved. Permission to copy, modify, and distribute this
+ * software and its documentation for academic research and education purposes,
+ * without fee, and without a written agreement is hereby granted, provided that
+ * the above copyright notice, this paragraph and the following three paragraphs
+ * appear in all copies. Permission to make use of this software for other than
+ * academic research and education purposes may be obtained by contacting:
+ *
+ * Office of Innovation and Commercialization
+ * 9500 Gilman Drive, Mail Code 0910
+ * University of California
+ * La Jolla, CA 92093-0910
+ * (858) 534-5815
+ * invent@ucsd.edu
+ *
+ * This software program and documentation are copyrighted by The Regents of the
+ * University of California. The software program and documentation are supplied
+ * "as is", without any accompanying services from The Regents. The Regents does
+ * not warrant that the operation of the program will be uninterrupted or
+ * error-free. The end-user understands that the program was developed for research
+ * purposes and is advised not to rely exclusively on the program for any reason.
+ *
+ * IN NO EVENT SHALL THE UNIVERSITY OF CALIFORNIA BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+ * PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF
+ * THE UNIVERSITY OF CALIFORNIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE. THE UNIVERSITY OF CALIFORNIA SPECIFICALLY DISCLAIMS ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS
+ * IS" BASIS, AND THE UNIVERSITY OF CALIFORNIA HAS NO OBLIGATIONS TO PROVIDE
+ * MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ * Report any bugs, questions or comments to alistair@caida.org
+ *
+ */
+
+#include "trinarkular_arena.h"
+#include "config.h"
+#include "utils.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** All allocations are aligned to this many bytes */
+#define ALIGN sizeof(void *)
+
+#define ALIGN_UP(x) (((x) + ALIGN - 1) & ~(ALIGN - 1))
+
+/** Allocations larger than this fraction of the chunk size get their own
+    chunk so that they do not waste the remainder of the current one */
+#define LARGE_ALLOC_DIV 4
+
+typedef struct chunk {
+
+  /** Next (older) chunk in the list */
+  struct chunk *next;
+
+  /** Number of bytes available in data */
+  size_t size;
+
+  /** Number of bytes of data that have been handed out */
+  size_t used;
+
+  /** Start of the chunk memory (aligned) */
+  uint64_t data[];
+
+} chunk_t;
+
+struct trinarkular_arena {
+
+  /** Chunk currently being allocated from (head of the chunk list) */
+  chunk_t *head;
+
+  /** Size of a regular chunk */
+  size_t chunk_size;
+
+  /** Total bytes held in chunks */
+  size_t total_size;
+};
+
+/* ---------- PRIVATE FUNCTIONS ---------- */
+
+static chunk_t *chunk_create(size_t size)
+{
+  chunk_t *chunk;
+
+  if ((chunk = malloc(sizeof(chunk_t) + size)) == NULL) {
+    return NULL;
+  }
+  chunk->next = NULL;
+  chunk->size = size;
+  chunk->used = 0;
+
+  return chunk;
+}
+
+/* ---------- PUBLIC FUNCTIONS ---------- */
+
+trinarkular_arena_t *trinarkular_arena_create(size_t chunk_size)
+{
+  trinarkular_arena_t *arena;
+
+  if ((arena = malloc_zero(sizeof(trinarkular_arena_t))) == NULL) {
+    return NULL;
+  }
+
+  arena->chunk_size = ALIGN_UP(
+    (chunk_size == 0) ? TRINARKULAR_ARENA_CHUNK_SIZE_DEFAULT : chunk_size);
+
+  return arena;
+}
+
+void trinarkular_arena_destroy(trinarkular_arena_t *arena)
+{
+  chunk_t *chunk;
+  chunk_t *next;
+
+  if (arena == NULL) {
+    return;
+  }
+
+  for (chunk = arena->head; chunk != NULL; chunk = next) {
+    next = chunk->next;
+    free(chunk);
+  }
+
+  free(arena);
+}
+
+void *trinarkular_arena_alloc(trinarkular_arena_t *arena, size_t len)
+{
+  chunk_t *chunk = arena->head;
+  void *ptr;
+
+  len = ALIGN_UP(len);
+
+  if (chunk != NULL && chunk->size - chunk->used >= len) {
+    ptr = (char *)chunk->data + chunk->used;
+    chunk->used += len;
+    return ptr;
+  }
+
+  if (len > arena->chunk_size / LARGE_ALLOC_DIV) {
+    // give this its own chunk, but keep allocating from the current one
+    if ((chunk = chunk_create(len)) == NULL) {
+      return NULL;
+    }
+    chunk->used = len;
+    if (arena->head != NULL) {
+      chunk->next = arena->head->next;
+      arena->head->next = chunk;
+    } else {
+      arena->head = chunk;
+    }
+    arena->total_size += len;
+    return chunk->data;
+  }
+
+  // start a new chunk (the remainder of the current one is wasted)
+  if ((chunk = chunk_create(arena->chunk_size)) == NULL) {
+    return NULL;
+  }
+  chunk->next = arena->head;
+  arena->head = chunk;
+  arena->total_size += chunk->size;
+
+  chunk->used = len;
+  return chunk->data;
+}
+
+char *trinarkular_arena_strndup(trinarkular_arena_t *arena, const char *str,
+                                size_t len)
+{
+  char *cpy;
+
+  if ((cpy = trinarkular_arena_alloc(arena, len + 1)) == NULL) {
+    return NULL;
+  }
+  memcpy(cpy, str, len);
+  cpy[len] = '\0';
+
+  return cpy;
+}
+
+void trinarkular_arena_merge(trinarkular_arena_t *dst,
+                             trinarkular_arena_t *src)
+{
+  chunk_t *tail;
+
+  if (src->head == NULL) {
+    return;
+  }
+
+  if (dst->head == NULL) {
+    dst->head = src->head;
+  } else {
+    // splice the src chunks in behind the dst head so that dst keeps
+    // allocating from its current chunk
+    for (tail = src->head; tail->next != NULL; tail = tail->next)
+      ;
+    tail->next = dst->head->next;
+    dst->head->next = src->head;
+  }
+  dst->total_size += src->total_size;
+
+  src->head = NULL;
+  src->total_size = 0;
+}
+
+size_t trinarkular_arena_get_size(trinarkular_arena_t *arena)
+{
+  return arena->total_size;
+}
@@ -0,0 +1,115 @@
+/*
+ * This file is part of trinarkular
+ *
+ * Copyright (C) 2015 The Regents of the University of California.
+ * Authors: Alistair King
+ *
+ * This software is Copyright (c) 2015 The Regents of the University of
+ * California. All Rights Reserved. Permission to copy, modify, and distribute this
+ * software and its documentation for academic research and education purposes,
+ * without fee, and without a written agreement is hereby granted, provided that
+ * the above copyright notice, this paragraph and the following three paragraphs
+ * appear in all copies. Permission to make use of this software for other than
+ * academic research and education purposes may be obtained by contacting:
+ *
+ * Office of Innovation and Commercialization
+ * 9500 Gilman Drive, Mail Code 0910
+ * University of California
+ * La Jolla, CA 92093-0910
+ * (858) 534-5815
+ * invent@ucsd.edu
+ *
+ * This software program and documentation are copyrighted by The Regents of the
+ * University of California. The software program and documentation are supplied
+ * "as is", without any accompanying services from The Regents. The Regents does
+ * not warrant that the operation of the program will be uninterrupted or
+ * error-free. The end-user understands that the program was developed for research
+ * purposes and is advised not to rely exclusively on the program for any reason.
+ *
+ * IN NO EVENT SHALL THE UNIVERSITY OF CALIFORNIA BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+ * PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF
+ * THE UNIVERSITY OF CALIFORNIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE. THE UNIVERSITY OF CALIFORNIA SPECIFICALLY DISCLAIMS ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS
+ * IS" BASIS, AND THE UNIVERSITY OF CALIFORNIA HAS NO OBLIGATIONS TO PROVIDE
+ * MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ * Report any bugs, questions or comments to alistair@caida.org
+ *
+ */
+
+#ifndef __TRINARKULAR_ARENA_H
+#define __TRINARKULAR_ARENA_H
+
+#include <stddef.h>
+
+/** @file
+ *
+ * @brief Header file that exposes a simple chunked bump allocator
+ *
+ * @author Alistair King
+ *
+ * Allocations are carved sequentially out of large chunks and cannot be freed
+ * individually. Destroying the arena frees everything at once.
+ *
+ */
+
+/** Default size of each arena chunk */
+#define TRINARKULAR_ARENA_CHUNK_SIZE_DEFAULT (4 * 1024 * 1024)
+
+/** Opaque struct holding arena state */
+typedef struct trinarkular_arena trinarkular_arena_t;
+
+/** Create a new arena
+ *
+ * @param chunk_size    size of each chunk to allocate (0 for the default)
+ * @return pointer to the arena if successful, NULL otherwise
+ */
+trinarkular_arena_t *trinarkular_arena_create(size_t chunk_size);
+
+/** Destroy the given arena, freeing all memory allocated from it
+ *
+ * @param arena         pointer to the arena to destroy
+ */
+void trinarkular_arena_destroy(trinarkular_arena_t *arena);
+
+/** Allocate memory from the given arena
+ *
+ * @param arena         pointer to the arena to allocate from
+ * @param len           number of bytes to allocate
+ * @return pointer to the (uninitialized, pointer-aligned) memory if
+ * successful, NULL otherwise
+ */
+void *trinarkular_arena_alloc(trinarkular_arena_t *arena, size_t len);
+
+/** Copy a (not necessarily nul-terminated) string into the given arena
+ *
+ * @param arena         pointer to the arena to allocate from
+ * @param str           pointer to the string to copy
+ * @param len           number of characters to copy
+ * @return pointer to the nul-terminated copy if successful, NULL otherwise
+ */
+char *trinarkular_arena_strndup(trinarkular_arena_t *arena, const char *str,
+                                size_t len);
+
+/** Move all memory owned by one arena into another
+ *
+ * @param dst           pointer to the arena to take ownership of the memory
+ * @param src           pointer to the arena to move memory out of
+ *
+ * Pointers allocated from src remain valid and are freed when dst is
+ * destroyed. src is left empty (but usable).
+ */
+void trinarkular_arena_merge(trinarkular_arena_t *dst,
+                             trinarkular_arena_t *src);
+
+/** Get the total number of bytes held by the given arena
+ *
+ * @param arena         pointer to the arena
+ * @return number of bytes allocated for chunks (including unused space)
+ */
+size_t trinarkular_arena_get_size(trinarkular_arena_t *arena);
+
+#endif /* __TRINARKULAR_ARENA_H */
@@ -0,0 +1,176 @@
+/*
+ * This file is part of trinarkular
+ *
+ * Copyright (C) 2015 The Regents of the University of California.
+ * Authors: Alistair King
+ *
+ * This software is Copyright (c) 2015 The Regents of the University of
+ * California. All Rights Reserved. Permission to copy, modify, and distribute this
+ * software and its documentation for academic research and education purposes,
+ * without fee, and without a written agreement is hereby granted, provided that
+ * the above copyright notice, this paragraph and the following three paragraphs
+ * appear in all copies. Permission to make use of this software for other than
+ * academic research and education purposes may be obtained by contacting:
+ *
+ * Office of Innovation and Commercialization
+ * 9500 Gilman Drive, Mail Code 0910
+ * University of California
+ * La Jolla, CA 92093-0910
+ * (858) 534-5815
+ * invent@ucsd.edu
+ *
+ * This software program and documentation are copyrighted by The Regents of the
+ * University of California. The software program and documentation are supplied
+ * "as is", without any accompanying services from The Regents. The Regents does
+ * not warrant that the operation of the program will be uninterrupted or
+ * error-free. The end-user understands that the program was developed for research
+ * purposes and is advised not to rely exclusively on the program for any reason.
+ *
+ * IN NO EVENT SHALL THE UNIVERSITY OF CALIFORNIA BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+ * PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF
+ * THE UNIVERSITY OF CALIFORNIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE. THE UNIVERSITY OF CALIFORNIA SPECIFICALLY DISCLAIMS ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS
+ * IS" BASIS, AND THE UNIVERSITY OF CALIFORNIA HAS NO OBLIGATIONS TO PROVIDE
+ * MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ * Report any bugs, questions or comments to alistair@caida.org
+ *
+ */
+
+#include "trinarkular_belief.h"
+#include "config.h"
+#include "trinarkular.h"
+#include <math.h>
+#include <stdint.h>
+
+/** Largest magnitude of an increment (enough to move a belief from one bound
+    to the other) */
+#define INCR_MAX (TRINARKULAR_BELIEF_MAX - TRINARKULAR_BELIEF_MIN)
+
+/* ---------- PRIVATE FUNCTIONS ---------- */
+
+/** Convert a likelihood ratio to a (clamped) fixed-point increment */
+static trinarkular_belief_t ratio_to_incr(double ratio)
+{
+  double incr;
+
+  // a likelihood of 0 always moves the belief to the bound
+  if (ratio <= 0) {
+    return -INCR_MAX;
+  }
+
+  incr = round(log(ratio) * TRINARKULAR_BELIEF_SCALE);
+  if (incr < -INCR_MAX) {
+    return -INCR_MAX;
+  }
+  if (incr > INCR_MAX) {
+    return INCR_MAX;
+  }
+  return incr;
+}
+
+/* ---------- PUBLIC FUNCTIONS ---------- */
+
+void trinarkular_belief_compute_incrs(float aeb, trinarkular_belief_t *incrs)
+{
+  // P(p|~U)
+  double PpD = (1.0 - TRINARKULAR_BELIEF_PACKET_LOSS_FREQUENCY) /
+               TRINARKULAR_SLASH24_HOST_CNT;
+
+  // P(p|U)
+  double PpU = aeb;
+
+  // P(n|U)
+  double PnU = 1.0 - PpU;
+
+  // P(n|~U)
+  double PnD = 1.0 - PpD;
+
+  // log(B'(U)/B'(~U)) = log(B(U)/B(~U)) + log(P(r|U)/P(r|~U))
+  incrs[0] = ratio_to_incr(PnU / PnD);
+  incrs[1] = ratio_to_incr(PpU / PpD);
+}
+
+void trinarkular_belief_update_batch(
+  trinarkular_belief_t *restrict beliefs,
+  const trinarkular_belief_t *restrict neg_incrs,
+  const trinarkular_belief_t *restrict pos_incrs,
+  const uint8_t *restrict responses, size_t cnt)
+{
+  size_t i;
+  int32_t mask;
+  int32_t belief;
+
+  for (i = 0; i < cnt; i++) {
+    // select the increment without branching
+    mask = -(int32_t)(responses[i] != 0);
+    belief = beliefs[i] + neg_incrs[i] + ((pos_incrs[i] - neg_incrs[i]) & mask);
+    belief = (belief < TRINARKULAR_BELIEF_MIN) ? TRINARKULAR_BELIEF_MIN : belief;
+    belief = (belief > TRINARKULAR_BELIEF_MAX) ? TRINARKULAR_BELIEF_MAX : belief;
+    beliefs[i] = belief;
+  }
+}
+
+float trinarkular_belief_to_prob(trinarkular_belief_t belief)
+{
+  return 1.0 / (1.0 + exp(-(double)belief / TRINARKULAR_BELIEF_SCALE));
+}
+
+trinarkular_belief_t trinarkular_belief_from_prob(float prob)
+{
+  double belief;
+
+  if (prob <= 0) {
+    return TRINARKULAR_BELIEF_MIN;
+  }
+  if (prob >= 1) {
+    return TRINARKULAR_BELIEF_MAX;
+  }
+
+  belief = round(log(prob / (1.0 - prob)) * TRINARKULAR_BELIEF_SCALE);
+  return TRINARKULAR_BELIEF_UPDATE(0, (int32_t)belief);
+}
+
+float trinarkular_belief_update_ref(float belief, float aeb, int response)
+{
+  // B(U)
+  float BU = belief;
+
+  // B(~U)
+  float BD = 1.0 - BU;
+
+  // P(p|~U)
+  float PpD = (1.0 - TRINARKULAR_BELIEF_PACKET_LOSS_FREQUENCY) /
+              TRINARKULAR_SLASH24_HOST_CNT;
+
+  // P(p|U)
+  float PpU = aeb;
+
+  // P(n|U)
+  float PnU = 1.0 - PpU;
+
+  // P(n|~U)
+  float PnD = 1.0 - PpD;
+
+  float new_belief_down;
+
+  // Positive response
+  if (response != 0) {
+    new_belief_down = (PpD * BD) / ((PpD*BD) + (PpU*BU));
+  } else { // Negative, or no response
+    new_belief_down = (PnD*BD) / ((PnD*BD) + (PnU*BU));
+  }
+
+  // capping as per sec 4.2 of paper
+  if (new_belief_down > 0.99) {
+    new_belief_down = 0.99;
+  } else if (new_belief_down < 0.01) {
+    new_belief_down = 0.01;
+  }
+
+  // convert B(~U) to B(U) and return
+  return 1 - new_belief_down;
+}
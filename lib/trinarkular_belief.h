@@ -0,0 +1,168 @@
+/*
+ * This file is part of trinarkular
+ *
+ * Copyright (C) 2015 The Regents of the University of California.
+ * Authors: Alistair King
+ *
+ * This software is Copyright (c) 2015 The Regents of the University of
+ * California. All Rights Reserved. Permission to copy, modify, and distribute this
+ * software and its documentation for academic research and education purposes,
+ * without fee, and without a written agreement is hereby granted, provided that
+ * the above copyright notice, this paragraph and the following three paragraphs
+ * appear in all copies. Permission to make use of this software for other than
+ * academic research and education purposes may be obtained by contacting:
+ *
+ * Office of Innovation and Commercialization
+ * 9500 Gilman Drive, Mail Code 0910
+ * University of California
+ * La Jolla, CA 92093-0910
+ * (858) 534-5815
+ * invent@ucsd.edu
+ *
+ * This software program and documentation are copyrighted by The Regents of the
+ * University of California. The software program and documentation are supplied
+ * "as is", without any accompanying services from The Regents. The Regents does
+ * not warrant that the operation of the program will be uninterrupted or
+ * error-free. The end-user understands that the program was developed for research
+ * purposes and is advised not to rely exclusively on the program for any reason.
+ *
+ * IN NO EVENT SHALL THE UNIVERSITY OF CALIFORNIA BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+ * PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF
+ * THE UNIVERSITY OF CALIFORNIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE. THE UNIVERSITY OF CALIFORNIA SPECIFICALLY DISCLAIMS ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS
+ * IS" BASIS, AND THE UNIVERSITY OF CALIFORNIA HAS NO OBLIGATIONS TO PROVIDE
+ * MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ * Report any bugs, questions or comments to alistair@caida.org
+ *
+ */
+
+#ifndef __TRINARKULAR_BELIEF_H
+#define __TRINARKULAR_BELIEF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** @file
+ *
+ * @brief Header file that exposes the fixed-point Bayesian belief engine
+ *
+ * @author Alistair King
+ *
+ * The belief that a /24 is up is kept as log-odds (log(B(U)/B(~U))) in fixed
+ * point. A probe response then simply adds a per-/24 increment (precomputed
+ * from A(E(b))) to the belief, and the belief states are integer comparisons.
+ *
+ * Compared with the float implementation (trinarkular_belief_update_ref), each
+ * increment is rounded to 1/TRINARKULAR_BELIEF_SCALE, so after n updates the
+ * log-odds differ by at most n/(2*TRINARKULAR_BELIEF_SCALE) (plus float
+ * rounding). For the <= TRINARKULAR_BELIEF_REF_UPDATES updates that a /24
+ * receives per round, the belief (as a probability) differs by less than
+ * TRINARKULAR_BELIEF_REF_TOLERANCE. The belief state only differs if the float
+ * belief is within that distance of a state threshold. `make check` runs
+ * trinarkular-check-belief to verify this.
+ *
+ */
+
+/** Fixed-point log-odds belief */
+typedef int16_t trinarkular_belief_t;
+
+/** Number of fixed-point units per nat of log-odds */
+#define TRINARKULAR_BELIEF_SCALE 2048
+
+/** Largest belief (B(U) = 0.99, as per sec 4.2 of the paper) */
+#define TRINARKULAR_BELIEF_MAX 9411
+
+/** Smallest belief (B(U) = 0.01) */
+#define TRINARKULAR_BELIEF_MIN (-TRINARKULAR_BELIEF_MAX)
+
+/** Belief that is neither up nor down (B(U) = 0.5) */
+#define TRINARKULAR_BELIEF_UNCERTAIN 0
+
+/** A /24 is up if its belief is greater than this (B(U) > 0.9, i.e. log-odds
+    > 4499.92 units) */
+#define TRINARKULAR_BELIEF_UP_THRESHOLD 4499
+
+/** A /24 is down if its belief is less than this (B(U) < 0.1) */
+#define TRINARKULAR_BELIEF_DOWN_THRESHOLD (-TRINARKULAR_BELIEF_UP_THRESHOLD)
+
+/** Number of consecutive updates that the fixed-point belief is guaranteed
+    to track the float implementation over (at least the periodic probe plus
+    the adaptive probe budget of a round) */
+#define TRINARKULAR_BELIEF_REF_UPDATES 16
+
+/** Largest difference (in B(U)) between the fixed-point and float beliefs
+    after TRINARKULAR_BELIEF_REF_UPDATES updates */
+#define TRINARKULAR_BELIEF_REF_TOLERANCE 0.001
+
+/** How often do we expect packet loss? (Taken from the paper) */
+#define TRINARKULAR_BELIEF_PACKET_LOSS_FREQUENCY 0.01
+
+/** Apply the given increment to the given belief (arguments are evaluated
+    more than once) */
+#define TRINARKULAR_BELIEF_UPDATE(belief, incr)                                \
+  ((trinarkular_belief_t)(                                                     \
+    ((int32_t)(belief) + (incr)) < TRINARKULAR_BELIEF_MIN                      \
+      ? TRINARKULAR_BELIEF_MIN                                                 \
+      : ((int32_t)(belief) + (incr)) > TRINARKULAR_BELIEF_MAX                  \
+          ? TRINARKULAR_BELIEF_MAX                                             \
+          : ((int32_t)(belief) + (incr))))
+
+/** Compute the belief increments for a /24
+ *
+ * @param aeb           A(E(b)) of the /24
+ * @param incrs         array of two increments to fill, for a negative (0) and
+ *                      positive (1) probe response
+ *
+ * Increments are clamped so that a single response can always move the belief
+ * from one bound to the other.
+ */
+void trinarkular_belief_compute_incrs(float aeb, trinarkular_belief_t *incrs);
+
+/** Apply a vector of probe responses to a vector of beliefs
+ *
+ * @param beliefs       array of beliefs to update
+ * @param neg_incrs     array of increments for a negative response
+ * @param pos_incrs     array of increments for a positive response
+ * @param responses     array of responses (non-zero if positive)
+ * @param cnt           number of items in each array
+ *
+ * The arrays must not overlap. The loop is branch-free so that the compiler
+ * can vectorize it (e.g. for offline replay of recorded responses).
+ */
+void trinarkular_belief_update_batch(
+  trinarkular_belief_t *restrict beliefs,
+  const trinarkular_belief_t *restrict neg_incrs,
+  const trinarkular_belief_t *restrict pos_incrs,
+  const uint8_t *restrict responses, size_t cnt);
+
+/** Convert a belief to the probability that the /24 is up
+ *
+ * @param belief        belief to convert
+ * @return B(U)
+ */
+float trinarkular_belief_to_prob(trinarkular_belief_t belief);
+
+/** Convert the probability that a /24 is up to a belief
+ *
+ * @param prob          B(U) to convert
+ * @return the (clamped) belief
+ */
+trinarkular_belief_t trinarkular_belief_from_prob(float prob);
+
+/** Update a belief using the (reference) float implementation
+ *
+ * @param belief        B(U) before the response
+ * @param aeb           A(E(b)) of the /24
+ * @param response      non-zero if the response was positive
+ * @return B(U) after the response
+ *
+ * This is the original implementation of the update. It is kept as a
+ * reference for the fixed-point engine.
+ */
+float trinarkular_belief_update_ref(float belief, float aeb, int response);
+
+#endif /* __TRINARKULAR_BELIEF_H */
@@ -43,6 +43,7 @@
 #include "config.h"
 
 #include <assert.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -105,6 +106,9 @@ static int handle_req(zloop_t *loop, zsock_t *reader, void *arg)
   char *command = NULL;
 
   trinarkular_probe_req_t req;
+  trinarkular_probe_req_t reqs[TRINARKULAR_PROBE_IO_REQS_MAX];
+  int reqs_cnt;
+  int i;
 
   if ((command = trinarkular_probe_recv_str(TRINARKULAR_DRIVER_DRIVER_PIPE(drv),
                                             0)) == NULL) {
@@ -123,6 +127,18 @@ static int handle_req(zloop_t *loop, zsock_t *reader, void *arg)
     if (drv->handle_req(drv, &req) == -1) {
       goto shutdown;
     }
+  } else if (strcmp("REQS", command) == 0) {
+    if ((reqs_cnt = trinarkular_probe_reqs_recv(
+           TRINARKULAR_DRIVER_DRIVER_PIPE(drv), reqs,
+           TRINARKULAR_PROBE_IO_REQS_MAX)) < 0) {
+      goto shutdown;
+    }
+
+    for (i = 0; i < reqs_cnt; i++) {
+      if (drv->handle_req(drv, &reqs[i]) == -1) {
+        goto shutdown;
+      }
+    }
   } else {
     trinarkular_log("WARN: Unknown command received (%s)", command);
   }
@@ -294,37 +310,88 @@ int trinarkular_driver_queue_req(trinarkular_driver_t *drv,
   return trinarkular_probe_req_send(TRINARKULAR_DRIVER_USER_PIPE(drv), req);
 }
 
+int trinarkular_driver_queue_reqs(trinarkular_driver_t *drv,
+                                  trinarkular_probe_req_t *reqs, int reqs_cnt)
+{
+  int cnt;
+
+  while (reqs_cnt > 0) {
+    cnt = (reqs_cnt < TRINARKULAR_PROBE_IO_REQS_MAX)
+            ? reqs_cnt
+            : TRINARKULAR_PROBE_IO_REQS_MAX;
+    if (trinarkular_probe_reqs_send(TRINARKULAR_DRIVER_USER_PIPE(drv), reqs,
+                                    cnt) != 0) {
+      return -1;
+    }
+    reqs += cnt;
+    reqs_cnt -= cnt;
+  }
+
+  return 0;
+}
+
+/** Receive the command that precedes a response. Returns 1 if a response is
+    ready to be received, 0 if non-blocking and no response was ready, and -1 if
+    an error occurred */
+static int recv_resp_command(trinarkular_driver_t *drv, int flags)
+{
+  // (received into a small buffer to avoid an allocation per response)
+  char command[8];
+  int len;
+
+  if ((len = zmq_recv(TRINARKULAR_DRIVER_USER_PIPE(drv), command,
+                      sizeof(command), flags)) == -1) {
+    return (errno == EAGAIN) ? 0 : -1;
+  }
+  CHECK_SHUTDOWN(return -1);
+  if (len != strlen("RESP") || memcmp("RESP", command, len) != 0) {
+    trinarkular_log("ERROR: Invalid command (%.*s) received",
+                    (len < sizeof(command)) ? len : (int)sizeof(command),
+                    command);
+    return -1;
+  }
+
+  return 1;
+}
+
 int trinarkular_driver_recv_resp(trinarkular_driver_t *drv,
                                  trinarkular_probe_resp_t *resp, int blocking)
 {
-  char *command;
+  int ret;
 
   // check for a RESP command
-  if ((command = trinarkular_probe_recv_str(TRINARKULAR_DRIVER_USER_PIPE(drv),
-                                            blocking ? 0 : ZMQ_DONTWAIT)) ==
-      NULL) {
-    goto err;
-  }
-  if (blocking == 0 && command == NULL) {
-    return 0;
-  }
-  CHECK_SHUTDOWN(goto err);
-  if (strcmp("RESP", command) != 0) {
-    trinarkular_log("ERROR: Invalid command (%s) received", command);
-    goto err;
+  if ((ret = recv_resp_command(drv, blocking ? 0 : ZMQ_DONTWAIT)) != 1) {
+    return ret;
   }
 
   if (trinarkular_probe_resp_recv(TRINARKULAR_DRIVER_USER_PIPE(drv), resp) !=
       0) {
-    goto err;
+    return -1;
   }
 
-  free(command);
   return 1;
+}
 
-err:
-  free(command);
-  return -1;
+int trinarkular_driver_recv_resps(trinarkular_driver_t *drv,
+                                  trinarkular_probe_resp_t *resps,
+                                  int resps_len)
+{
+  int cnt = 0;
+  int ret;
+
+  while (cnt < resps_len) {
+    if ((ret = recv_resp_command(drv, ZMQ_DONTWAIT)) == 0) {
+      // drained
+      break;
+    }
+    if (ret < 0 || trinarkular_probe_resp_recv(
+                     TRINARKULAR_DRIVER_USER_PIPE(drv), &resps[cnt]) != 0) {
+      return -1;
+    }
+    cnt++;
+  }
+
+  return cnt;
 }
 
 // defined in trinarkular_driver_interface.h
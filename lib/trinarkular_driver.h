@@ -124,6 +124,19 @@ void trinarkular_driver_destroy(trinarkular_driver_t *drv);
 int trinarkular_driver_queue_req(trinarkular_driver_t *drv,
                                  trinarkular_probe_req_t *req);
 
+/** Queue the given batch of probe requests
+ *
+ * @param drv         The driver object
+ * @param reqs        Array of probe requests
+ * @param reqs_cnt    Number of requests in the array
+ * @return 0 if successful, -1 if an error occurred
+ *
+ * The requests are sent to the driver thread in as few messages as possible,
+ * which is much cheaper than queueing each request individually.
+ */
+int trinarkular_driver_queue_reqs(trinarkular_driver_t *drv,
+                                  trinarkular_probe_req_t *reqs, int reqs_cnt);
+
 /** Get an opaque socket to use when using zmq_poll or zloop in an event loop
  *
  * @param drv         The driver object to get socket from
@@ -146,4 +159,20 @@ void *trinarkular_driver_get_recv_socket(trinarkular_driver_t *drv);
 int trinarkular_driver_recv_resp(trinarkular_driver_t *drv,
                                  trinarkular_probe_resp_t *resp, int blocking);
 
+/** Receive all probe responses that are ready, without blocking
+ *
+ * @param drv         The driver object
+ * @param resps       Array of response objects to fill
+ * @param resps_len   Maximum number of responses to receive
+ * @return the number of responses received (0 if none were ready), -1 if an
+ * error occurred
+ *
+ * Intended to be called when the socket returned by
+ * trinarkular_driver_get_recv_socket is readable, to handle a batch of
+ * responses per event loop wakeup.
+ */
+int trinarkular_driver_recv_resps(trinarkular_driver_t *drv,
+                                  trinarkular_probe_resp_t *resps,
+                                  int resps_len);
+
 #endif /* __TRINARKULAR_DRIVER_H */
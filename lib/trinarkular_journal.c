@@ -0,0 +1,530 @@
+/*
+ * This file is part of trinarkular
+ *
+ * Copyright (C) 2015 The Regents of the University of California.
+ * Authors: Alistair King
+ *
+ * This software is Copyright (c) 2015 The Regents of the University of
+ * California. All Rights Reserved. Permission to copy, modify, and distribute this
+ * software and its documentation for academic research and education purposes,
+ * without fee, and without a written agreement is hereby granted, provided that
+ * the above copyright notice, this paragraph and the following three paragraphs
+ * appear in all copies. Permission to make use of this software for other than
+ * academic research and education purposes may be obtained by contacting:
+ *
+ * Office of Innovation and Commercialization
+ * 9500 Gilman Drive, Mail Code 0910
+ * University of California
+ * La Jolla, CA 92093-0910
+ * (858) 534-5815
+ * invent@ucsd.edu
+ *
+ * This software program and documentation are copyrighted by The Regents of the
+ * University of California. The software program and documentation are supplied
+ * "as is", without any accompanying services from The Regents. The Regents does
+ * not warrant that the operation of the program will be uninterrupted or
+ * error-free. The end-user understands that the program was developed for research
+ * purposes and is advised not to rely exclusively on the program for any reason.
+ *
+ * IN NO EVENT SHALL THE UNIVERSITY OF CALIFORNIA BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+ * PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF
+ * THE UNIVERSITY OF CALIFORNIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE. THE UNIVERSITY OF CALIFORNIA SPECIFICALLY DISCLAIMS ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS
+ * IS" BASIS, AND THE UNIVERSITY OF CALIFORNIA HAS NO OBLIGATIONS TO PROVIDE
+ * MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ * Report any bugs, questions or comments to alistair@caida.org
+ *
+ */
+
+#include "trinarkular_journal.h"
+#include "trinarkular_log.h"
+#include "config.h"
+#include "utils.h"
+#include <assert.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/* Each journal file is laid out as:
+ *
+ *   header | record 0 | record 1 | ... | record capacity-1
+ *
+ * The file is sized for its full capacity when it is created, and the number
+ * of complete records is kept in the header. The writer stores each record
+ * before publishing the new count (with release semantics), so a reader that
+ * loads the count (with acquire semantics) only sees complete records. When
+ * the writer is destroyed, the file is truncated to the complete records.
+ */
+
+/** Magic string at the start of every journal file */
+#define JOURNAL_MAGIC "TRNKJNL"
+
+/** Current version of the journal format */
+#define JOURNAL_VERSION 1
+
+/** Written in native byte order so that files from hosts with a different
+    byte order can be rejected */
+#define JOURNAL_BYTE_ORDER 0x01020304
+
+typedef struct journal_hdr {
+
+  /** JOURNAL_MAGIC (NUL padded) */
+  char magic[8];
+
+  /** JOURNAL_VERSION */
+  uint32_t format_version;
+
+  /** JOURNAL_BYTE_ORDER */
+  uint32_t byte_order;
+
+  /** Size of each record */
+  uint32_t record_size;
+
+  /** Unused (keeps the records 8-byte aligned) */
+  uint32_t pad;
+
+  /** Number of records the file was created with room for */
+  uint64_t capacity;
+
+  /** Number of complete records (updated atomically) */
+  uint64_t cnt;
+
+  /** Time the file was created (ms since the epoch) */
+  uint64_t create_time;
+
+  /** Unused (reserved for later versions) */
+  uint64_t reserved[2];
+
+} journal_hdr_t;
+
+struct trinarkular_journal {
+
+  /** Path prefix of the journal files */
+  char *prefix;
+
+  /** Number of records in each file */
+  uint64_t file_records;
+
+  /** Number of files to keep (0 to keep all) */
+  uint32_t files_max;
+
+  /** Sequence number of the current file */
+  uint64_t seq;
+
+  /** Sequence number of the first file written by this writer */
+  uint64_t first_seq;
+
+  /** Mapping of the current file (NULL if there is no current file) */
+  uint8_t *base;
+
+  /** Length of the mapping */
+  size_t map_len;
+
+  /** File descriptor of the current file */
+  int fd;
+
+  /** Header of the current file (points into the mapping) */
+  journal_hdr_t *hdr;
+
+  /** Records of the current file (points into the mapping) */
+  trinarkular_journal_rec_t *recs;
+
+  /** Number of records written to the current file */
+  uint64_t cnt;
+};
+
+struct trinarkular_journal_reader {
+
+  /** Mapping of the file */
+  uint8_t *base;
+
+  /** Length of the mapping */
+  size_t map_len;
+
+  /** Header of the file (points into the mapping) */
+  journal_hdr_t *hdr;
+
+  /** Records of the file (points into the mapping) */
+  const trinarkular_journal_rec_t *recs;
+
+  /** Number of records that fit in the mapping */
+  uint64_t capacity;
+};
+
+static int journal_filename(trinarkular_journal_t *journal, uint64_t seq,
+                            char *buf)
+{
+  if (snprintf(buf, TRINARKULAR_JOURNAL_PATH_LEN, "%s.%" PRIu64,
+               journal->prefix, seq) >= TRINARKULAR_JOURNAL_PATH_LEN) {
+    trinarkular_log("ERROR: Journal path too long (%s)", journal->prefix);
+    return -1;
+  }
+  return 0;
+}
+
+/** Unmap the current file, truncating it to the records written */
+static void journal_finish(trinarkular_journal_t *journal)
+{
+  if (journal->base == NULL) {
+    return;
+  }
+
+  munmap(journal->base, journal->map_len);
+  if (journal->cnt != journal->file_records &&
+      ftruncate(journal->fd, sizeof(journal_hdr_t) +
+                               journal->cnt *
+                                 sizeof(trinarkular_journal_rec_t)) != 0) {
+    trinarkular_log("WARN: Could not truncate journal (%s)", strerror(errno));
+  }
+  close(journal->fd);
+
+  journal->base = NULL;
+  journal->hdr = NULL;
+  journal->recs = NULL;
+  journal->fd = -1;
+  journal->cnt = 0;
+}
+
+/** Create and map the file with the current sequence number */
+static int journal_start(trinarkular_journal_t *journal)
+{
+  char filename[TRINARKULAR_JOURNAL_PATH_LEN];
+  struct timeval tv;
+
+  assert(journal->base == NULL);
+
+  if (journal_filename(journal, journal->seq, filename) != 0) {
+    goto err;
+  }
+
+  journal->map_len = sizeof(journal_hdr_t) +
+                     journal->file_records * sizeof(trinarkular_journal_rec_t);
+  if ((journal->fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644)) == -1 ||
+      ftruncate(journal->fd, journal->map_len) != 0) {
+    trinarkular_log("ERROR: Could not create journal %s (%s)", filename,
+                    strerror(errno));
+    goto err;
+  }
+
+  if ((journal->base = mmap(NULL, journal->map_len, PROT_READ | PROT_WRITE,
+                            MAP_SHARED, journal->fd, 0)) == MAP_FAILED) {
+    journal->base = NULL;
+    trinarkular_log("ERROR: Could not map journal %s (%s)", filename,
+                    strerror(errno));
+    goto err;
+  }
+
+  journal->hdr = (journal_hdr_t *)journal->base;
+  journal->recs =
+    (trinarkular_journal_rec_t *)(journal->base + sizeof(journal_hdr_t));
+  journal->cnt = 0;
+
+  // the file is zero-filled by ftruncate, so only the set fields are written
+  memcpy(journal->hdr->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+  journal->hdr->format_version = JOURNAL_VERSION;
+  journal->hdr->byte_order = JOURNAL_BYTE_ORDER;
+  journal->hdr->record_size = sizeof(trinarkular_journal_rec_t);
+  journal->hdr->capacity = journal->file_records;
+  gettimeofday(&tv, NULL);
+  journal->hdr->create_time =
+    (uint64_t)tv.tv_sec * 1000 + (uint64_t)tv.tv_usec / 1000;
+
+  return 0;
+
+err:
+  if (journal->fd != -1) {
+    close(journal->fd);
+    journal->fd = -1;
+  }
+  return -1;
+}
+
+/** Move on to the next file, removing the oldest file if needed */
+static int journal_rotate(trinarkular_journal_t *journal)
+{
+  char filename[TRINARKULAR_JOURNAL_PATH_LEN];
+
+  journal_finish(journal);
+  journal->seq++;
+
+  // only remove files that this writer created
+  if (journal->files_max != 0 &&
+      journal->seq - journal->first_seq >= journal->files_max) {
+    if (journal_filename(journal, journal->seq - journal->files_max,
+                         filename) != 0) {
+      return -1;
+    }
+    if (unlink(filename) != 0 && errno != ENOENT) {
+      trinarkular_log("WARN: Could not remove journal %s (%s)", filename,
+                      strerror(errno));
+    }
+  }
+
+  return journal_start(journal);
+}
+
+/** Set the sequence number to follow the last existing file (the oldest
+    files may already have been removed, so the directory is searched) */
+static int journal_find_seq(trinarkular_journal_t *journal)
+{
+  char dirname[TRINARKULAR_JOURNAL_PATH_LEN];
+  const char *basename;
+  size_t basename_len;
+  DIR *dir;
+  struct dirent *ent;
+  char *end;
+  uint64_t seq;
+
+  if ((basename = strrchr(journal->prefix, '/')) != NULL) {
+    basename++;
+    if ((size_t)(basename - journal->prefix) >= sizeof(dirname)) {
+      trinarkular_log("ERROR: Journal path too long (%s)", journal->prefix);
+      return -1;
+    }
+    memcpy(dirname, journal->prefix, basename - journal->prefix);
+    dirname[basename - journal->prefix] = '\0';
+  } else {
+    basename = journal->prefix;
+    strcpy(dirname, ".");
+  }
+  basename_len = strlen(basename);
+
+  if ((dir = opendir(dirname)) == NULL) {
+    trinarkular_log("ERROR: Could not open journal directory %s (%s)", dirname,
+                    strerror(errno));
+    return -1;
+  }
+  journal->seq = 0;
+  while ((ent = readdir(dir)) != NULL) {
+    if (strncmp(ent->d_name, basename, basename_len) != 0 ||
+        ent->d_name[basename_len] != '.' ||
+        ent->d_name[basename_len + 1] < '0' ||
+        ent->d_name[basename_len + 1] > '9') {
+      continue;
+    }
+    seq = strtoull(ent->d_name + basename_len + 1, &end, 10);
+    if (*end == '\0' && seq >= journal->seq) {
+      journal->seq = seq + 1;
+    }
+  }
+  closedir(dir);
+
+  return 0;
+}
+
+/* ---------- WRITING ---------- */
+
+trinarkular_journal_t *trinarkular_journal_create(const char *prefix,
+                                                  uint64_t file_records,
+                                                  uint32_t files_max)
+{
+  trinarkular_journal_t *journal = NULL;
+  char filename[TRINARKULAR_JOURNAL_PATH_LEN];
+
+  assert(prefix != NULL);
+  assert(file_records > 0);
+
+  if ((journal = malloc_zero(sizeof(trinarkular_journal_t))) == NULL) {
+    trinarkular_log("ERROR: Could not allocate journal");
+    return NULL;
+  }
+  journal->fd = -1;
+  journal->file_records = file_records;
+  journal->files_max = files_max;
+
+  if ((journal->prefix = strdup(prefix)) == NULL) {
+    goto err;
+  }
+
+  // continue after any files from a previous run so that they are not
+  // overwritten
+  if (journal_find_seq(journal) != 0) {
+    goto err;
+  }
+  journal->first_seq = journal->seq;
+
+  if (journal_start(journal) != 0 ||
+      journal_filename(journal, journal->seq, filename) != 0) {
+    goto err;
+  }
+
+  trinarkular_log("journaling to %s", filename);
+
+  return journal;
+
+err:
+  trinarkular_journal_destroy(journal);
+  return NULL;
+}
+
+void trinarkular_journal_destroy(trinarkular_journal_t *journal)
+{
+  if (journal == NULL) {
+    return;
+  }
+
+  journal_finish(journal);
+  free(journal->prefix);
+  free(journal);
+}
+
+int trinarkular_journal_append(trinarkular_journal_t *journal,
+                               const trinarkular_journal_rec_t *rec)
+{
+  // (a failed rotation leaves no current file, so it is retried)
+  if ((journal->base == NULL || journal->cnt == journal->file_records) &&
+      journal_rotate(journal) != 0) {
+    return -1;
+  }
+
+  journal->recs[journal->cnt++] = *rec;
+  __atomic_store_n(&journal->hdr->cnt, journal->cnt, __ATOMIC_RELEASE);
+
+  return 0;
+}
+
+/* ---------- READING ---------- */
+
+trinarkular_journal_reader_t *trinarkular_journal_open(const char *filename)
+{
+  trinarkular_journal_reader_t *reader = NULL;
+  int fd = -1;
+  struct stat st;
+
+  if ((reader = malloc_zero(sizeof(trinarkular_journal_reader_t))) == NULL) {
+    trinarkular_log("ERROR: Could not allocate journal reader");
+    return NULL;
+  }
+
+  if ((fd = open(filename, O_RDONLY)) == -1 || fstat(fd, &st) != 0) {
+    trinarkular_log("ERROR: Could not open %s (%s)", filename,
+                    strerror(errno));
+    goto err;
+  }
+  reader->map_len = st.st_size;
+  if (reader->map_len < sizeof(journal_hdr_t)) {
+    trinarkular_log("ERROR: Truncated journal %s", filename);
+    goto err;
+  }
+
+  // the mapping must be shared to see records appended after it was made
+  if ((reader->base = mmap(NULL, reader->map_len, PROT_READ, MAP_SHARED, fd,
+                           0)) == MAP_FAILED) {
+    reader->base = NULL;
+    trinarkular_log("ERROR: Could not map %s (%s)", filename, strerror(errno));
+    goto err;
+  }
+  close(fd);
+  fd = -1;
+  madvise(reader->base, reader->map_len, MADV_SEQUENTIAL);
+
+  reader->hdr = (journal_hdr_t *)reader->base;
+  if (memcmp(reader->hdr->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0) {
+    trinarkular_log("ERROR: %s is not a journal", filename);
+    goto err;
+  }
+  if (reader->hdr->byte_order != JOURNAL_BYTE_ORDER) {
+    trinarkular_log("ERROR: Journal has incompatible byte order");
+    goto err;
+  }
+  if (reader->hdr->format_version != JOURNAL_VERSION ||
+      reader->hdr->record_size != sizeof(trinarkular_journal_rec_t)) {
+    trinarkular_log("ERROR: Unsupported journal version %" PRIu32
+                    " (expecting %d)",
+                    reader->hdr->format_version, JOURNAL_VERSION);
+    goto err;
+  }
+
+  reader->recs = (const trinarkular_journal_rec_t *)(reader->base +
+                                                     sizeof(journal_hdr_t));
+  reader->capacity = (reader->map_len - sizeof(journal_hdr_t)) /
+                     sizeof(trinarkular_journal_rec_t);
+
+  return reader;
+
+err:
+  if (fd != -1) {
+    close(fd);
+  }
+  trinarkular_journal_close(reader);
+  return NULL;
+}
+
+void trinarkular_journal_close(trinarkular_journal_reader_t *reader)
+{
+  if (reader == NULL) {
+    return;
+  }
+
+  if (reader->base != NULL) {
+    munmap(reader->base, reader->map_len);
+  }
+  free(reader);
+}
+
+uint64_t trinarkular_journal_get_cnt(trinarkular_journal_reader_t *reader)
+{
+  uint64_t cnt = __atomic_load_n(&reader->hdr->cnt, __ATOMIC_ACQUIRE);
+
+  // never trust the count beyond what was mapped
+  return cnt < reader->capacity ? cnt : reader->capacity;
+}
+
+const trinarkular_journal_rec_t *
+trinarkular_journal_get_recs(trinarkular_journal_reader_t *reader)
+{
+  return reader->recs;
+}
+
+int64_t trinarkular_journal_scan(trinarkular_journal_reader_t *reader,
+                                 const trinarkular_journal_filter_t *filter,
+                                 trinarkular_journal_scan_cb_t *cb, void *user)
+{
+  const trinarkular_journal_rec_t *rec = reader->recs;
+  const trinarkular_journal_rec_t *end =
+    rec + trinarkular_journal_get_cnt(reader);
+  uint32_t ip_first = 0;
+  uint32_t ip_span = UINT32_MAX;
+  uint64_t time_first = 0;
+  uint64_t time_span = UINT64_MAX;
+  int64_t match_cnt = 0;
+
+  if (filter != NULL) {
+    if (filter->ip_last < filter->ip_first ||
+        filter->time_last < filter->time_first) {
+      return 0;
+    }
+    ip_first = filter->ip_first;
+    ip_span = filter->ip_last - filter->ip_first;
+    time_first = filter->time_first;
+    time_span = filter->time_last - filter->time_first;
+  }
+
+  // each range check is a single unsigned comparison, so the loop is a
+  // sequential pass over the mapping with one (rarely taken) branch
+  for (; rec < end; rec++) {
+    if ((uint32_t)(rec->network_ip - ip_first) > ip_span ||
+        (uint64_t)(rec->time - time_first) > time_span) {
+      continue;
+    }
+    match_cnt++;
+    if (cb(rec, user) != 0) {
+      return -1;
+    }
+  }
+
+  return match_cnt;
+}
@@ -0,0 +1,219 @@
+/*
+ * This file is part of trinarkular
+ *
+ * Copyright (C) 2015 The Regents of the University of California.
+ * Authors: Alistair King
+ *
+ * This software is Copyright (c) 2015 The Regents of the University of
+ * California. All Rights Reserved. Permission to copy, modify, and distribute this
+ * software and its documentation for academic research and education purposes,
+ * without fee, and without a written agreement is hereby granted, provided that
+ * the above copyright notice, this paragraph and the following three paragraphs
+ * appear in all copies. Permission to make use of this software for other than
+ * academic research and education purposes may be obtained by contacting:
+ *
+ * Office of Innovation and Commercialization
+ * 9500 Gilman Drive, Mail Code 0910
+ * University of California
+ * La Jolla, CA 92093-0910
+ * (858) 534-5815
+ * invent@ucsd.edu
+ *
+ * This software program and documentation are copyrighted by The Regents of the
+ * University of California. The software program and documentation are supplied
+ * "as is", without any accompanying services from The Regents. The Regents does
+ * not warrant that the operation of the program will be uninterrupted or
+ * error-free. The end-user understands that the program was developed for research
+ * purposes and is advised not to rely exclusively on the program for any reason.
+ *
+ * IN NO EVENT SHALL THE UNIVERSITY OF CALIFORNIA BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+ * PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF
+ * THE UNIVERSITY OF CALIFORNIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE. THE UNIVERSITY OF CALIFORNIA SPECIFICALLY DISCLAIMS ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS
+ * IS" BASIS, AND THE UNIVERSITY OF CALIFORNIA HAS NO OBLIGATIONS TO PROVIDE
+ * MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ * Report any bugs, questions or comments to alistair@caida.org
+ *
+ */
+
+#ifndef __TRINARKULAR_JOURNAL_H
+#define __TRINARKULAR_JOURNAL_H
+
+#include "trinarkular_belief.h"
+#include <stdint.h>
+
+/** @file
+ *
+ * @brief Header file that exposes the /24 state transition journal
+ *
+ * @author Alistair King
+ *
+ * The journal is a sequence of files, each holding a fixed-size header and an
+ * array of fixed-size records. Files are memory-mapped, so appending a record
+ * is a store into the page cache, and once a file is full the writer moves on
+ * to the next one in the sequence. A reader maps a file and scans the record
+ * array directly.
+ *
+ * Journal files are named `<prefix>.<seq>`, where seq starts at 0 (or after
+ * the last existing file with the same prefix) and increments with each file.
+ *
+ */
+
+/** Default number of records in each journal file (16 MiB files) */
+#define TRINARKULAR_JOURNAL_FILE_RECORDS_DEFAULT (1024 * 1024)
+
+/** Maximum length of a journal file name */
+#define TRINARKULAR_JOURNAL_PATH_LEN 1024
+
+/** A single /24 state transition (16 bytes)
+ *
+ * States are encoded as 0 (uncertain), 1 (down) and 2 (up). Probe types are
+ * encoded as 1 (periodic), 2 (adaptive) and 3 (recovery).
+ */
+typedef struct trinarkular_journal_rec {
+
+  /** Time of the transition (ms since the epoch) */
+  uint64_t time;
+
+  /** Network IP of the /24 (host byte order) */
+  uint32_t network_ip;
+
+  /** Belief after the transition */
+  trinarkular_belief_t belief;
+
+  /** State before (high nibble) and after (low nibble) the transition */
+  uint8_t states;
+
+  /** Type of the probe whose response caused the transition */
+  uint8_t probe_type;
+
+} trinarkular_journal_rec_t;
+
+/** Build the states field of a journal record */
+#define TRINARKULAR_JOURNAL_STATES(old_state, new_state)                       \
+  ((uint8_t)((((old_state)&0xf) << 4) | ((new_state)&0xf)))
+
+/** Get the state before the transition from a journal record */
+#define TRINARKULAR_JOURNAL_OLD_STATE(rec) (((rec)->states >> 4) & 0xf)
+
+/** Get the state after the transition from a journal record */
+#define TRINARKULAR_JOURNAL_NEW_STATE(rec) ((rec)->states & 0xf)
+
+/** Journal records that a scan should return (all bounds are inclusive) */
+typedef struct trinarkular_journal_filter {
+
+  /** First /24 network IP (host byte order) */
+  uint32_t ip_first;
+
+  /** Last /24 network IP (host byte order) */
+  uint32_t ip_last;
+
+  /** Earliest transition time (ms since the epoch) */
+  uint64_t time_first;
+
+  /** Latest transition time (ms since the epoch) */
+  uint64_t time_last;
+
+} trinarkular_journal_filter_t;
+
+/** Opaque journal writer */
+typedef struct trinarkular_journal trinarkular_journal_t;
+
+/** Opaque reader for a single journal file */
+typedef struct trinarkular_journal_reader trinarkular_journal_reader_t;
+
+/** Callback for journal records that match a scan filter
+ *
+ * @param rec           matching record
+ * @param user          user pointer given to the scan
+ * @return 0 to continue the scan, non-zero to stop it
+ */
+typedef int(trinarkular_journal_scan_cb_t)(const trinarkular_journal_rec_t *rec,
+                                           void *user);
+
+/** Create a journal writer
+ *
+ * @param prefix        path prefix of the journal files
+ * @param file_records  number of records in each file
+ * @param files_max     number of files to keep (0 to keep all files)
+ * @return pointer to a journal writer if successful, NULL otherwise
+ *
+ * The first file is created immediately so that configuration errors are
+ * reported at startup. Once more than files_max files have been written, the
+ * oldest file is removed each time that a new file is started.
+ */
+trinarkular_journal_t *trinarkular_journal_create(const char *prefix,
+                                                  uint64_t file_records,
+                                                  uint32_t files_max);
+
+/** Destroy a journal writer
+ *
+ * @param journal       journal writer to destroy
+ *
+ * The current file is truncated to the records that were written.
+ */
+void trinarkular_journal_destroy(trinarkular_journal_t *journal);
+
+/** Append a record to the journal
+ *
+ * @param journal       journal writer to append to
+ * @param rec           record to append
+ * @return 0 if the record was appended, -1 otherwise
+ *
+ * A journal writer must only be used by one thread. Readers may map a file
+ * while it is being written, and will see each record once it is complete.
+ */
+int trinarkular_journal_append(trinarkular_journal_t *journal,
+                               const trinarkular_journal_rec_t *rec);
+
+/** Open a journal file for reading
+ *
+ * @param filename      name of the journal file to open
+ * @return pointer to a journal reader if successful, NULL otherwise
+ */
+trinarkular_journal_reader_t *trinarkular_journal_open(const char *filename);
+
+/** Close a journal file
+ *
+ * @param reader        journal reader to close
+ */
+void trinarkular_journal_close(trinarkular_journal_reader_t *reader);
+
+/** Get the number of complete records in a journal file
+ *
+ * @param reader        journal reader to query
+ * @return the number of records
+ *
+ * If the file is still being written, the count may grow between calls (up to
+ * the capacity of the file).
+ */
+uint64_t trinarkular_journal_get_cnt(trinarkular_journal_reader_t *reader);
+
+/** Get the records of a journal file
+ *
+ * @param reader        journal reader to query
+ * @return pointer to the array of records (in the order they were appended)
+ *
+ * The first trinarkular_journal_get_cnt records of the array are valid.
+ */
+const trinarkular_journal_rec_t *
+trinarkular_journal_get_recs(trinarkular_journal_reader_t *reader);
+
+/** Scan a journal file for records that match a filter
+ *
+ * @param reader        journal reader to scan
+ * @param filter        records to return (NULL to return all records)
+ * @param cb            callback to call for each matching record
+ * @param user          user pointer to pass to the callback
+ * @return the number of matching records, or -1 if the callback stopped the
+ * scan
+ */
+int64_t trinarkular_journal_scan(trinarkular_journal_reader_t *reader,
+                                 const trinarkular_journal_filter_t *filter,
+                                 trinarkular_journal_scan_cb_t *cb, void *user);
+
+#endif /* __TRINARKULAR_JOURNAL_H */
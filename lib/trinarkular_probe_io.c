@@ -62,6 +62,9 @@
 
 #define BUFLEN 1024
 
+/** Number of bytes that a serialized request occupies */
+#define REQ_LEN (sizeof(uint32_t) + sizeof(uint8_t))
+
 #define SERIALIZE_VAL(from)                                                    \
   do {                                                                         \
     assert((len - written) >= sizeof(from));                                   \
@@ -86,7 +89,11 @@ char *trinarkular_probe_recv_str(void *src, int flags)
   size_t len;
   char *str = NULL;
 
-  if (zmq_msg_init(&llm) == -1 || zmq_msg_recv(&llm, src, 0) == -1) {
+  if (zmq_msg_init(&llm) == -1) {
+    goto err;
+  }
+  if (zmq_msg_recv(&llm, src, flags) == -1) {
+    zmq_msg_close(&llm);
     goto err;
   }
   len = zmq_msg_size(&llm);
@@ -171,6 +178,92 @@ err:
   return -1;
 }
 
+int trinarkular_probe_reqs_send(void *dst, trinarkular_probe_req_t *reqs,
+                                int reqs_cnt)
+{
+  assert(dst != NULL);
+  assert(reqs != NULL);
+  assert(reqs_cnt > 0 && reqs_cnt <= TRINARKULAR_PROBE_IO_REQS_MAX);
+
+  zmq_msg_t msg;
+  uint8_t *ptr;
+  size_t len = REQ_LEN * reqs_cnt;
+  size_t written = 0;
+  size_t s;
+  int i;
+
+  // send the command type ("REQS")
+  if (zmq_send(dst, "REQS", strlen("REQS"), ZMQ_SNDMORE) != strlen("REQS")) {
+    trinarkular_log("ERROR: Could not send requests command");
+    return -1;
+  }
+
+  // serialize all requests directly into a single message
+  if (zmq_msg_init_size(&msg, len) == -1) {
+    trinarkular_log("ERROR: Could not allocate requests message");
+    return -1;
+  }
+  ptr = zmq_msg_data(&msg);
+
+  for (i = 0; i < reqs_cnt; i++) {
+    // target ip (already in network order)
+    SERIALIZE_VAL(reqs[i].target_ip);
+
+    // wait
+    SERIALIZE_VAL(reqs[i].wait);
+  }
+
+  if (zmq_msg_send(&msg, dst, 0) != written) {
+    trinarkular_log("ERROR: Could not send requests message");
+    zmq_msg_close(&msg);
+    return -1;
+  }
+
+  return 0;
+}
+
+int trinarkular_probe_reqs_recv(void *src, trinarkular_probe_req_t *reqs,
+                                int reqs_len)
+{
+  zmq_msg_t msg;
+  uint8_t *buf;
+  size_t len;
+  size_t read = 0;
+  size_t s = 0;
+  int cnt = 0;
+
+  ASSERT_MORE;
+  if (zmq_msg_init(&msg) == -1 || zmq_msg_recv(&msg, src, 0) == -1) {
+    fprintf(stderr, "Could not receive reqs message\n");
+    goto err;
+  }
+  assert(zsocket_rcvmore(src) == 0);
+  buf = zmq_msg_data(&msg);
+  len = zmq_msg_size(&msg);
+
+  if ((len % REQ_LEN) != 0 || (len / REQ_LEN) > reqs_len) {
+    trinarkular_log("ERROR: Malformed requests message (%zu bytes)", len);
+    zmq_msg_close(&msg);
+    goto err;
+  }
+
+  while (read < len) {
+    // target ip (already in network order)
+    DESERIALIZE_VAL(reqs[cnt].target_ip);
+
+    // wait
+    DESERIALIZE_VAL(reqs[cnt].wait);
+
+    cnt++;
+  }
+
+  zmq_msg_close(&msg);
+  return cnt;
+
+err:
+  return -1;
+}
+
 int trinarkular_probe_resp_send(void *dst, trinarkular_probe_resp_t *resp)
 {
   uint8_t buf[BUFLEN];
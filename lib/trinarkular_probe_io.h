@@ -54,6 +54,9 @@
  *
  */
 
+/** Maximum number of requests that can be sent in a single message */
+#define TRINARKULAR_PROBE_IO_REQS_MAX 1024
+
 /** Receive a string from the given socket
  *
  * @param src           socket to receive from
@@ -79,6 +82,31 @@ int trinarkular_probe_req_send(void *dst, trinarkular_probe_req_t *req);
  */
 int trinarkular_probe_req_recv(void *src, trinarkular_probe_req_t *req);
 
+/** Send the given batch of probe requests over the given socket
+ *
+ * @param dst           socket to send the requests over
+ * @param reqs          array of requests to send
+ * @param reqs_cnt      number of requests in the array (at most
+ *                      TRINARKULAR_PROBE_IO_REQS_MAX)
+ * @return 0 if the requests were sent, -1 otherwise
+ *
+ * All requests are sent in a single message.
+ */
+int trinarkular_probe_reqs_send(void *dst, trinarkular_probe_req_t *reqs,
+                                int reqs_cnt);
+
+/** Receive a batch of probe requests from the given socket
+ *
+ * @param src           socket to receive the requests from
+ * @param reqs          array of requests to receive into
+ * @param reqs_len      number of requests the array has space for
+ * @return the number of requests received if successful, -1 otherwise
+ *
+ * This must be called after receiving a "REQS" command.
+ */
+int trinarkular_probe_reqs_recv(void *src, trinarkular_probe_req_t *reqs,
+                                int reqs_len);
+
 /** Send the given probe response over the given socket
  *
  * @param dst           socket to send the response over
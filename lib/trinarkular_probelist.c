@@ -40,76 +40,56 @@
  *
  */
 
-#include "trinarkular_probelist.h"
+#include "trinarkular_probelist_int.h"
 #include "trinarkular.h"
 #include "trinarkular_log.h"
 #include "config.h"
 #include "khash.h"
 #include "utils.h"
-#include "wandio_utils.h"
-#include "jsmn_utils.h"
-#include <arpa/inet.h>
 #include <assert.h>
-#include <netinet/in.h>
 #include <stdio.h>
-#include <sys/socket.h>
+#include <string.h>
+#include <sys/mman.h>
 #include <sys/types.h>
-#include <wandio.h>
-
-KHASH_INIT(32s24, uint32_t, trinarkular_slash24_t, 1, kh_int_hash_func,
-           kh_int_hash_equal);
-
-KHASH_INIT(32state, uint32_t, trinarkular_slash24_state_t, 1, kh_int_hash_func,
-           kh_int_hash_equal);
-
-struct trinarkular_probelist {
-
-  /** Current probelist version */
-  char *version;
-
-  /** List of /24s in this probelist */
-  uint32_t *slash24s;
-
-  /** Number of /24s in this probelist */
-  int slash24s_cnt;
-
-  /** Index of the current /24 */
-  int slash24_iter;
-
-  /** Buffer for deserializing /24s into */
-  // trinarkular_slash24_t slash24;
-
-  /** Buffer for deserializing state into */
-  // trinarkular_slash24_state_t state;
-
-  // Normally stored in redis:
-
-  /** Hash mapping from network IP to /24 */
-  khash_t(32s24) * s24_hash;
-
-  /** Hash mapping from network IP to state */
-  khash_t(32state) * state_hash;
-};
 
 /* ---------- PRIVATE FUNCTIONS ---------- */
 
-static int copy_state(trinarkular_slash24_state_t *to,
+static int copy_state(trinarkular_probelist_t *pl,
+                      trinarkular_slash24_state_t *to,
                       trinarkular_slash24_state_t *from)
 {
+  trinarkular_slash24_metrics_t *metrics;
   int i;
 
+  if (to == from) {
+    // a state reference saved back to its own /24
+    return 0;
+  }
+
   to->current_host = from->current_host;
   to->last_probe_type = from->last_probe_type;
   to->probe_budget = from->probe_budget;
   to->current_belief = from->current_belief;
   to->current_state = from->current_state;
   to->rounds_since_up = from->rounds_since_up;
-
-  // realloc metrics array
-  if ((to->metrics =
-         realloc(to->metrics, sizeof(trinarkular_slash24_metrics_t) *
-                                from->metrics_cnt)) == NULL) {
-    return -1;
+  to->probe_seq = from->probe_seq;
+  to->probe_driver = from->probe_driver;
+  to->probe_sent = from->probe_sent;
+  to->settled_belief = from->settled_belief;
+  to->exported_state = from->exported_state;
+  to->dirty = from->dirty;
+
+  // (the old metrics array stays in the arena until the arena is compacted)
+  if (to->metrics_cnt != from->metrics_cnt) {
+    if ((metrics = trinarkular_arena_alloc(
+           pl->metrics_arena,
+           sizeof(trinarkular_slash24_metrics_t) * from->metrics_cnt)) ==
+        NULL) {
+      return -1;
+    }
+    pl->metrics_garbage +=
+      sizeof(trinarkular_slash24_metrics_t) * to->metrics_cnt;
+    to->metrics = metrics;
   }
 
   // copy metrics
@@ -122,579 +102,768 @@ static int copy_state(trinarkular_slash24_state_t *to,
   return 0;
 }
 
-static void free_state(trinarkular_slash24_state_t *state)
+#define IDX_WORD(pl, network_ip) (&(pl)->idx[(network_ip) >> 14])
+#define IDX_BIT(network_ip) (1ULL << (((network_ip) >> 8) & 63))
+
+/** Get the index of the given /24 (-1 if it is not in the probelist) */
+static int slash24_idx(trinarkular_probelist_t *pl, uint32_t network_ip)
 {
-  if (state == NULL) {
-    return;
+  trinarkular_slash24_idx_t *w = IDX_WORD(pl, network_ip);
+  uint64_t bit = IDX_BIT(network_ip);
+
+  if ((w->bits & bit) == 0) {
+    return -1;
   }
+  // the index is the number of /24s that come before this one
+  return w->rank + __builtin_popcountll(w->bits & (bit - 1));
+}
 
-  free(state->metrics);
-  state->metrics = 0;
+/** Get the index of the given (borrowed) /24 */
+static size_t s24_idx(trinarkular_probelist_t *pl, trinarkular_slash24_t *s24)
+{
+  size_t idx = s24 - pl->records;
+
+  assert(idx < (size_t)pl->slash24s_cnt);
+  return idx;
 }
 
-static int add_host(trinarkular_slash24_t *s24, uint32_t host_ip)
+static void *aligned_array_alloc(size_t size)
 {
-  assert((host_ip & TRINARKULAR_SLASH24_NETMASK) == s24->network_ip);
+  void *arr = NULL;
 
-  uint8_t host_byte = host_ip & TRINARKULAR_SLASH24_HOSTMASK;
+  if (size == 0) {
+    return NULL;
+  }
+  if (posix_memalign(&arr, SLASH24_ARRAY_ALIGN, size) != 0) {
+    return NULL;
+  }
+  return arr;
+}
 
-  if ((s24->hosts =
-         realloc(s24->hosts, sizeof(uint8_t) * (s24->hosts_cnt + 1))) == NULL) {
+/** Allocate (uninitialized) per-/24 arrays for cnt /24s */
+static int slash24_arrays_alloc(int cnt, trinarkular_slash24_t **records,
+                                trinarkular_slash24_state_t **states,
+                                uint8_t **states_set)
+{
+  *records = aligned_array_alloc(sizeof(trinarkular_slash24_t) * cnt);
+  *states = aligned_array_alloc(sizeof(trinarkular_slash24_state_t) * cnt);
+  *states_set = aligned_array_alloc(cnt);
+  if (cnt > 0 && (*records == NULL || *states == NULL || *states_set == NULL)) {
+    free(*records);
+    free(*states);
+    free(*states_set);
     return -1;
   }
-
-  s24->hosts[s24->hosts_cnt++] = host_byte;
-
   return 0;
 }
 
-static int add_metadata(trinarkular_slash24_t *s24, char *md)
+static void slash24_arrays_free(trinarkular_probelist_t *pl)
 {
-  // 2019-12-19 AK: changed this from an assert to warning since we
-  // now have 2 /24s with >255 metas. They appear to be VPN networks
-  // or some such.
-  if (s24->md_cnt == UINT8_MAX) {
-    trinarkular_log("WARN: Dropping metadata for /24 (%x)", s24->network_ip);
-    return 0;
-  }
+  free(pl->records);
+  pl->records = NULL;
+  free(pl->states);
+  pl->states = NULL;
+  free(pl->states_set);
+  pl->states_set = NULL;
+}
 
-  if ((s24->md = realloc(s24->md, sizeof(char *) * (s24->md_cnt + 1))) ==
-      NULL) {
-    return -1;
+/** Do the two /24s (from different probelists) have the same metadata? */
+static int md_equal(trinarkular_probelist_t *a_pl, trinarkular_slash24_t *a,
+                    trinarkular_probelist_t *b_pl, trinarkular_slash24_t *b)
+{
+  int i;
+
+  if (a->md_cnt != b->md_cnt) {
+    return 0;
   }
-  if ((s24->md[s24->md_cnt] = strdup(md)) == NULL) {
-    return -1;
+  for (i = 0; i < a->md_cnt; i++) {
+    if (strcmp(a_pl->md_strs[a->md[i]], b_pl->md_strs[b->md[i]]) != 0) {
+      return 0;
+    }
   }
+  return 1;
+}
 
-  // this is an 8bit field to save memory
-  assert(s24->md_cnt < UINT8_MAX);
-  s24->md_cnt++;
+/** Do the two /24s have the same set of hosts? (Host order is ignored since
+    the hosts of JSON probelists are shuffled when they are loaded, and those
+    of binary probelists are in the order they were compiled in) */
+static int hosts_equal(trinarkular_slash24_t *a, trinarkular_slash24_t *b)
+{
+  uint64_t bits[4] = {0, 0, 0, 0};
+  int i;
 
-  return 0;
+  if (a->hosts_cnt != b->hosts_cnt) {
+    return 0;
+  }
+  for (i = 0; i < a->hosts_cnt; i++) {
+    bits[a->hosts[i] >> 6] |= 1ULL << (a->hosts[i] & 63);
+  }
+  for (i = 0; i < b->hosts_cnt; i++) {
+    if ((bits[b->hosts[i] >> 6] & (1ULL << (b->hosts[i] & 63))) == 0) {
+      return 0;
+    }
+  }
+  return 1;
 }
 
-static trinarkular_slash24_t *add_slash24(trinarkular_probelist_t *pl,
-                                          uint32_t network_ip)
+/** Append a pointer to a growable array */
+#define DIFF_APPEND(arr, cnt, alloc, val)                                      \
+  do {                                                                         \
+    if ((cnt) == (alloc)) {                                                    \
+      (alloc) = ((alloc) == 0) ? 1024 : (alloc)*2;                             \
+      if (((arr) = realloc((arr), sizeof(*(arr)) * (alloc))) == NULL) {        \
+        goto err;                                                              \
+      }                                                                        \
+    }                                                                          \
+    (arr)[(cnt)++] = (val);                                                    \
+  } while (0)
+
+/** Was the given /24 array allocated from an arena (rather than being part of
+    the mapping)? */
+static int arena_owned(trinarkular_probelist_t *pl, const void *arr)
 {
-  khiter_t k;
-  int khret;
-  trinarkular_slash24_t *s24 = NULL;
+  return arr != NULL &&
+         (pl->map_base == NULL || (const char *)arr < (char *)pl->map_base ||
+          (const char *)arr >= (char *)pl->map_base + pl->map_len);
+}
 
-  assert((network_ip & TRINARKULAR_SLASH24_NETMASK) == network_ip);
+/** Bytes of arena memory used by the host and metadata ID arrays of a /24 */
+static size_t slash24_arena_size(trinarkular_probelist_t *pl,
+                                 trinarkular_slash24_t *s24)
+{
+  size_t len = 0;
 
-  // first, add to the list of /24s
-  if ((pl->slash24s = realloc(
-         pl->slash24s, sizeof(uint32_t) * (pl->slash24s_cnt + 1))) == NULL) {
-    return NULL;
+  if (arena_owned(pl, s24->hosts) != 0) {
+    len += s24->hosts_cnt;
   }
-  pl->slash24s[pl->slash24s_cnt++] = network_ip;
-
-  // FILE ONLY
-  // now add to the map
-  k = kh_put(32s24, pl->s24_hash, network_ip, &khret);
-  if (khret == -1) {
-    trinarkular_log("ERROR: Could not add /24 to probelist");
-    return NULL;
+  if (arena_owned(pl, s24->md) != 0) {
+    len += sizeof(uint32_t) * s24->md_cnt;
   }
+  return len;
+}
 
-  // init all the fields
-  s24 = &kh_val(pl->s24_hash, k);
+/** Bytes of metrics owned by the state at the given index */
+static size_t state_metrics_size(trinarkular_probelist_t *pl, int idx)
+{
+  if (pl->states_set[idx] == 0) {
+    return 0;
+  }
+  return sizeof(trinarkular_slash24_metrics_t) * pl->states[idx].metrics_cnt;
+}
 
-  s24->network_ip = network_ip;
-  s24->hosts = NULL;
-  s24->hosts_cnt = 0;
-  s24->aeb = 0;
-  s24->md = NULL;
-  s24->md_cnt = 0;
+/** Copy the host and metadata ID arrays of all /24s into a fresh arena,
+    freeing the garbage left in the old one. (The metadata ID arrays of a JSON
+    probelist start out in the md arena, and are moved by the first
+    compaction) */
+static void hosts_arena_compact(trinarkular_probelist_t *pl)
+{
+  trinarkular_arena_t *arena;
+  trinarkular_slash24_t *s24;
+  uint8_t *hosts = NULL;
+  uint32_t *md = NULL;
+  int i;
 
-  return s24;
+  if ((arena = trinarkular_arena_create(0)) == NULL) {
+    return;
+  }
+  for (i = 0; i < pl->slash24s_cnt; i++) {
+    s24 = &pl->records[i];
+    if ((arena_owned(pl, s24->hosts) != 0 &&
+         (hosts = trinarkular_arena_alloc(arena, s24->hosts_cnt)) == NULL) ||
+        (arena_owned(pl, s24->md) != 0 &&
+         (md = trinarkular_arena_alloc(arena, sizeof(uint32_t) *
+                                                s24->md_cnt)) == NULL)) {
+      // the /24s copied so far use the new arena, so it must keep both
+      trinarkular_log("WARN: Could not compact probelist host arena");
+      trinarkular_arena_merge(arena, pl->arena);
+      break;
+    }
+    if (arena_owned(pl, s24->hosts) != 0) {
+      memcpy(hosts, s24->hosts, s24->hosts_cnt);
+      s24->hosts = hosts;
+    }
+    if (arena_owned(pl, s24->md) != 0) {
+      memcpy(md, s24->md, sizeof(uint32_t) * s24->md_cnt);
+      s24->md = md;
+    }
+  }
+  if (i == pl->slash24s_cnt) {
+    pl->arena_garbage = 0;
+  }
+  trinarkular_arena_destroy(pl->arena);
+  pl->arena = arena;
 }
 
-// DOES NOT FREE THE /24 structure
-static void free_slash24(trinarkular_slash24_t *s24)
+/** Copy the metrics arrays of all /24 states into a fresh arena, freeing the
+    garbage left in the old one */
+static void metrics_arena_compact(trinarkular_probelist_t *pl)
 {
+  trinarkular_arena_t *arena;
+  trinarkular_slash24_metrics_t *metrics;
+  size_t len;
   int i;
 
-  if (s24 == NULL) {
+  if ((arena = trinarkular_arena_create(0)) == NULL) {
     return;
   }
+  for (i = 0; i < pl->slash24s_cnt; i++) {
+    if ((len = state_metrics_size(pl, i)) == 0) {
+      continue;
+    }
+    if ((metrics = trinarkular_arena_alloc(arena, len)) == NULL) {
+      trinarkular_log("WARN: Could not compact probelist metrics arena");
+      trinarkular_arena_merge(arena, pl->metrics_arena);
+      break;
+    }
+    memcpy(metrics, pl->states[i].metrics, len);
+    pl->states[i].metrics = metrics;
+  }
+  if (i == pl->slash24s_cnt) {
+    pl->metrics_garbage = 0;
+  }
+  trinarkular_arena_destroy(pl->metrics_arena);
+  pl->metrics_arena = arena;
+}
 
-  free(s24->hosts);
-  s24->hosts = NULL;
-  s24->hosts_cnt = 0;
-
-  for (i = 0; i < s24->md_cnt; i++) {
-    free(s24->md[i]);
-    s24->md[i] = NULL;
+/** Compact the host and metrics arenas once at least half of either is
+    garbage, so that memory use does not grow with the number of reloads */
+static void arenas_maybe_compact(trinarkular_probelist_t *pl)
+{
+  if (pl->arena_garbage > trinarkular_arena_get_size(pl->arena) / 2) {
+    hosts_arena_compact(pl);
+  }
+  if (pl->metrics_garbage >
+      trinarkular_arena_get_size(pl->metrics_arena) / 2) {
+    metrics_arena_compact(pl);
   }
+}
+
+/** Recompute the ranks of the index words from first_word onward (the ranks
+    of the words before it must still be correct) */
+static void idx_ranks_update(trinarkular_probelist_t *pl, uint32_t first_word)
+{
+  uint32_t total = pl->idx[first_word].rank;
+  uint32_t i;
 
-  free(s24->md);
-  s24->md = NULL;
+  for (i = first_word; i < SLASH24_IDX_CNT; i++) {
+    pl->idx[i].rank = total;
+    total += __builtin_popcountll(pl->idx[i].bits);
+  }
 }
 
-#if 0
-static void
-destroy_slash24(trianrkular_slash24_t *s24)
+static int s24_cmp(const void *a, const void *b)
 {
-  free_slash24(s24);
-  free(s24);
+  uint32_t a_ip = ((const trinarkular_slash24_t *)a)->network_ip;
+  uint32_t b_ip = ((const trinarkular_slash24_t *)b)->network_ip;
+
+  return (a_ip > b_ip) - (a_ip < b_ip);
 }
-#endif
 
-static jsmntok_t *process_json_host(trinarkular_probelist_t *pl,
-                                    trinarkular_slash24_t *s24, char *json,
-                                    jsmntok_t *t)
+static int u32_cmp(const void *a, const void *b)
 {
-  int cnt = 0;
-  int i;
-  char host_str[INET_ADDRSTRLEN];
-  uint32_t host_ip;
-  int host_ip_set = 0;
+  uint32_t a_val = *(const uint32_t *)a;
+  uint32_t b_val = *(const uint32_t *)b;
 
-  jsmn_type_assert(t, JSMN_OBJECT);
-  cnt = t->size;
-  JSMN_NEXT(t);
+  return (a_val > b_val) - (a_val < b_val);
+}
 
-  for (i = 0; i < cnt; i++) {
-    // key
-    jsmn_type_assert(t, JSMN_STRING);
-    if (jsmn_streq(json, t, "host_ip")) {
-      JSMN_NEXT(t);
-      jsmn_type_assert(t, JSMN_STRING);
-      jsmn_strcpy(host_str, t, json);
-      inet_pton(AF_INET, host_str, &host_ip);
-      host_ip = ntohl(host_ip);
-      host_ip_set = 1;
-      JSMN_NEXT(t);
-    } else if (jsmn_streq(json, t, "e_b")) {
-      JSMN_NEXT(t);
-      jsmn_type_assert(t, JSMN_PRIMITIVE);
-      // ignore response rate field
-      JSMN_NEXT(t);
-    } else {
-      // ignore all other fields
-      JSMN_NEXT(t);
-      // skip the value
-      t = jsmn_skip(t);
-    }
+/** Move cnt /24s (and their states) from index src to index dst */
+static void slash24s_move(trinarkular_probelist_t *pl, uint32_t dst,
+                          uint32_t src, uint32_t cnt)
+{
+  if (cnt == 0 || dst == src) {
+    return;
   }
+  memmove(&pl->records[dst], &pl->records[src],
+          sizeof(trinarkular_slash24_t) * cnt);
+  memmove(&pl->states[dst], &pl->states[src],
+          sizeof(trinarkular_slash24_state_t) * cnt);
+  memmove(&pl->states_set[dst], &pl->states_set[src], cnt);
+}
+
+/** Merge the /24s appended since the probelist held old_cnt (sorted) /24s into
+    their sorted positions. Only the records after the first new /24 are moved,
+    and each of them only once. Nothing is changed if an error occurs */
+static int slash24s_merge(trinarkular_probelist_t *pl, int old_cnt)
+{
+  int add_cnt = pl->slash24s_cnt - old_cnt;
+  trinarkular_slash24_t *added = NULL;
+  uint32_t *ins = NULL;
+  uint32_t *remap = NULL;
+  uint32_t first, p, end;
+  int i, j;
 
-  if (host_ip_set == 0) {
-    trinarkular_log("ERROR: Missing field in host object");
+  if ((added = malloc(sizeof(trinarkular_slash24_t) * add_cnt)) == NULL) {
     goto err;
   }
-
-  if (add_host(s24, host_ip) != 0) {
-    trinarkular_log("ERROR: Could not add host to /24 (%s)", host_str);
+  memcpy(added, &pl->records[old_cnt], sizeof(trinarkular_slash24_t) * add_cnt);
+  qsort(added, add_cnt, sizeof(trinarkular_slash24_t), s24_cmp);
+
+  // existing /24s before the first new one do not move. (the ranks have not
+  // been updated yet, and no new /24 comes before it in its word)
+  first = slash24_idx(pl, added[0].network_ip);
+  if ((ins = malloc(sizeof(uint32_t) * add_cnt)) == NULL ||
+      (remap = malloc(sizeof(uint32_t) * (old_cnt - first + 1))) == NULL) {
     goto err;
   }
 
-  return t;
+  // the bits of the new /24s are already set, so only the ranks after the
+  // first of them change
+  idx_ranks_update(pl, added[0].network_ip >> 14);
+
+  // the number of existing /24s that come before each new one
+  for (j = 0; j < add_cnt; j++) {
+    ins[j] = slash24_idx(pl, added[j].network_ip) - j;
+  }
+
+  // update the probing order (the new /24s are still at the end). an existing
+  // /24 moves up by the number of new /24s inserted before it
+  for (p = first, j = 0; p < (uint32_t)old_cnt; p++) {
+    while (j < add_cnt && ins[j] <= p) {
+      j++;
+    }
+    remap[p - first] = p + j;
+  }
+  for (i = 0; i < old_cnt; i++) {
+    if (pl->slash24s[i] >= first) {
+      pl->slash24s[i] = remap[pl->slash24s[i] - first];
+    }
+  }
+  for (j = 0; j < add_cnt; j++) {
+    pl->slash24s[old_cnt + j] = ins[j] + j;
+  }
+
+  // working from the back, move each run of existing /24s up to make room
+  for (j = add_cnt - 1, end = old_cnt; j >= 0; j--) {
+    slash24s_move(pl, ins[j] + j + 1, ins[j], end - ins[j]);
+    pl->records[ins[j] + j] = added[j];
+    memset(&pl->states[ins[j] + j], 0, sizeof(trinarkular_slash24_state_t));
+    pl->states_set[ins[j] + j] = 0;
+    end = ins[j];
+  }
+
+  free(added);
+  free(ins);
+  free(remap);
+  return 0;
 
 err:
-  return NULL;
+  trinarkular_log("ERROR: Could not allocate /24 merge buffers");
+  free(added);
+  free(ins);
+  return -1;
 }
 
-static jsmntok_t *process_json_slash24(trinarkular_probelist_t *pl,
-                                       char *s24_str, char *json,
-                                       jsmntok_t *root_tok)
+/** Drop the /24s appended since the probelist held first_cnt /24s. They must
+    not have been merged yet (so they are still at the end of the record and
+    probing order arrays) */
+static void slash24s_truncate(trinarkular_probelist_t *pl, int first_cnt)
 {
-  jsmntok_t *t = root_tok + 1;
-  int i, j;
-
-  char *tmp;
-  trinarkular_slash24_t *s24 = NULL;
-  uint32_t network_ip = 0;
+  int i;
 
-  char str_tmp[1024];
+  for (i = first_cnt; i < pl->slash24s_cnt; i++) {
+    IDX_WORD(pl, pl->records[i].network_ip)->bits &=
+      ~IDX_BIT(pl->records[i].network_ip);
+    pl->arena_garbage += slash24_arena_size(pl, &pl->records[i]);
+  }
+  pl->slash24s_cnt = first_cnt;
+}
 
-  unsigned long host_cnt = 0;
-  int host_cnt_set = 0;
+/* ---------- PUBLIC FUNCTIONS ---------- */
 
-  double avg_resp_rate = 0;
-  int avg_resp_rate_set = 0;
+trinarkular_probelist_t *trinarkular_probelist_create(const char *filename)
+{
+  return trinarkular_probelist_create_threaded(filename, 1);
+}
 
-  int meta_cnt = 0;
-  int meta_set = 0;
+trinarkular_probelist_t *
+trinarkular_probelist_create_threaded(const char *filename, int thread_cnt)
+{
+  trinarkular_probelist_t *pl = NULL;
 
-  int host_arr_cnt = 0;
+  trinarkular_log("INFO: Creating probelist from %s", filename);
 
-  // first, add the /24 so that as we parse we can update it directly
+  if ((pl = malloc_zero(sizeof(trinarkular_probelist_t))) == NULL) {
+    return NULL;
+  }
 
-  // parse the /24 string into a network ip
-  if ((tmp = strchr(s24_str, '/')) == NULL) {
-    trinarkular_log("ERROR: Malformed /24 string: %s", s24_str);
+  // FILE-SPECIFIC
+  // (pages of the index that are never touched are never faulted in)
+  if ((pl->idx = calloc(SLASH24_IDX_CNT, sizeof(trinarkular_slash24_idx_t))) ==
+      NULL) {
+    trinarkular_log("ERROR: Could not allocate /24 index");
     goto err;
   }
-  *tmp = '\0';
-  inet_pton(AF_INET, s24_str, &network_ip);
-  network_ip = ntohl(network_ip);
-
-  // add to the probelist
-  if ((s24 = add_slash24(pl, network_ip)) == NULL) {
+  if ((pl->md_hash = kh_init(strid)) == NULL) {
+    trinarkular_log("ERROR: Could not allocate metadata map");
+    goto err;
+  }
+  if ((pl->arena = trinarkular_arena_create(0)) == NULL ||
+      (pl->md_arena = trinarkular_arena_create(0)) == NULL ||
+      (pl->metrics_arena = trinarkular_arena_create(0)) == NULL) {
+    trinarkular_log("ERROR: Could not allocate probelist arenas");
     goto err;
   }
 
-  // iterate over children of the /24 object
-  for (i = 0; i < root_tok->size; i++) {
-    // all keys must be strings
-    if (t->type != JSMN_STRING) {
-      fprintf(stderr, "ERROR: Encountered non-string key: '%.*s'\n",
-              t->end - t->start, json + t->start);
+  // read the probelist in from the file (compiled probelists are mapped
+  // directly, everything else is treated as JSON)
+  if (trinarkular_probelist_bin_detect(filename) != 0) {
+    if (trinarkular_probelist_bin_read(pl, filename) != 0) {
+      trinarkular_log("ERROR: Could not load binary probelist from file");
       goto err;
     }
-    // trinarkular_log("INFO: key: '%.*s'", t->end - t->start, json+t->start);
-
-    // version
-    if (jsmn_streq(json, t, "version")) {
-      JSMN_NEXT(t);
-      jsmn_type_assert(t, JSMN_STRING);
-      if (pl->version == NULL) { // assume all version strings are the same
-        jsmn_strcpy(str_tmp, t, json);
-        pl->version = strdup(str_tmp);
-        assert(pl->version != NULL);
-      }
-      JSMN_NEXT(t);
-
-      // host cnt
-    } else if (jsmn_streq(json, t, "host_cnt")) {
-      JSMN_NEXT(t);
-      jsmn_type_assert(t, JSMN_PRIMITIVE);
-      if (jsmn_strtoul(&host_cnt, json, t) != 0) {
-        trinarkular_log("ERROR: Could not parse host count");
-        goto err;
-      }
-      host_cnt_set = 1;
-      JSMN_NEXT(t);
-
-      // avg resp rate
-    } else if (jsmn_streq(json, t, "avg_resp_rate")) {
-      JSMN_NEXT(t);
-      jsmn_type_assert(t, JSMN_PRIMITIVE);
-      if (jsmn_strtod(&avg_resp_rate, json, t) != 0) {
-        trinarkular_log("ERROR: Could not parse avg resp rate");
-        goto err;
-      }
-      s24->aeb = avg_resp_rate;
-      avg_resp_rate_set = 1;
-      JSMN_NEXT(t);
-
-      // meta
-    } else if (jsmn_streq(json, t, "meta")) {
-      JSMN_NEXT(t);
-      jsmn_type_assert(t, JSMN_ARRAY);
-      meta_cnt = t->size; // number of meta strings
-      JSMN_NEXT(t);
-      for (j = 0; j < meta_cnt; j++) {
-        jsmn_type_assert(t, JSMN_STRING);
-        jsmn_strcpy(str_tmp, t, json);
-        if (add_metadata(s24, str_tmp) != 0) {
-          goto err;
-        }
-        JSMN_NEXT(t);
-      }
-      meta_set = 1;
-
-    } else if (jsmn_streq(json, t, "hosts")) {
-      JSMN_NEXT(t);
-      jsmn_type_assert(t, JSMN_ARRAY);
-      host_arr_cnt = t->size; // number of host objects
-      JSMN_NEXT(t);
-      for (j = 0; j < host_arr_cnt; j++) {
-        if ((t = process_json_host(pl, s24, json, t)) == NULL) {
-          goto err;
-        }
-      }
-
-      // now randomize the ordering
-      array_shuffle_fy(uint8_t, s24->hosts, s24->hosts_cnt);
-
-      // unknown key
-    } else {
-      trinarkular_log("WARN: Unrecognized key: %.*s", t->end - t->start,
-                      json + t->start);
-      JSMN_NEXT(t);
-      t = jsmn_skip(t);
-    }
+  } else if (trinarkular_probelist_json_read(pl, filename, thread_cnt) != 0) {
+    trinarkular_log("ERROR: Could not load probelist from file");
+    goto err;
   }
 
-  if (pl->version == NULL || host_cnt_set == 0 || avg_resp_rate_set == 0 ||
-      meta_set == 0 || host_arr_cnt == 0) {
-    trinarkular_log("ERROR: Missing field in /24 record");
+  if (trinarkular_probelist_build_index(pl) != 0) {
     goto err;
   }
 
-  // final sanity check
-  assert(host_arr_cnt == host_cnt);
+  // randomize the /24s
+  array_shuffle_fy(uint32_t, pl->slash24s, pl->slash24s_cnt);
 
-  return t;
+  return pl;
 
 err:
+  trinarkular_probelist_destroy(pl);
   return NULL;
 }
 
-// This will eventually be used to parse a blob from redis, with some
-// modifications (like not parsing the /24 key)
-static int process_json(trinarkular_probelist_t *pl, char *js, int jslen)
+void trinarkular_probelist_destroy(trinarkular_probelist_t *pl)
 {
-  int ret;
 
-  jsmn_parser p;
-  jsmntok_t *root = NULL;
-  jsmntok_t *t = NULL;
-  size_t tokcount = 128;
-
-  char s24_str[INET_ADDRSTRLEN + 3];
-
-  if (jslen == 0) {
-    trinarkular_log("ERROR: Empty JSON");
-    return 0;
+  if (pl == NULL) {
+    return;
   }
 
-  // prepare parser
-  jsmn_init(&p);
+  free(pl->version);
+  pl->version = NULL;
 
-  // allocate some tokens to start
-  if ((root = malloc(sizeof(jsmntok_t) * tokcount)) == NULL) {
-    trinarkular_log("ERROR: Could not malloc initial tokens");
-    goto err;
-  }
+  free(pl->slash24s);
+  pl->slash24s = NULL;
 
-again:
-  if ((ret = jsmn_parse(&p, js, jslen, root, tokcount)) < 0) {
-    if (ret == JSMN_ERROR_NOMEM) {
-      tokcount *= 2;
-      if ((root = realloc(root, sizeof(jsmntok_t) * tokcount)) == NULL) {
-        trinarkular_log("ERROR: Could not realloc tokens");
-        goto err;
-      }
-      goto again;
-    }
-    if (ret == JSMN_ERROR_INVAL) {
-      trinarkular_log("ERROR: Invalid character in JSON string");
-      goto err;
-    }
-    trinarkular_log("ERROR: JSON parser returned %d", ret);
-    goto err;
-  }
+  // state metrics belong to the metrics arena
+  slash24_arrays_free(pl);
+  pl->slash24s_cnt = 0;
 
-  t = root;
+  free(pl->idx);
+  pl->idx = NULL;
 
-  if (t->type != JSMN_STRING) {
-    trinarkular_log("ERROR: Malformed /24 object\n");
-    trinarkular_log("INFO: JSON: %s\n", js);
-    goto err;
+  if (pl->md_hash != NULL) {
+    kh_destroy(strid, pl->md_hash);
+    pl->md_hash = NULL;
+  }
+  free(pl->md_strs);
+  pl->md_strs = NULL;
+  pl->md_strs_cnt = 0;
+
+  trinarkular_arena_destroy(pl->arena);
+  pl->arena = NULL;
+  trinarkular_arena_destroy(pl->md_arena);
+  pl->md_arena = NULL;
+  trinarkular_arena_destroy(pl->metrics_arena);
+  pl->metrics_arena = NULL;
+
+  if (pl->map_base != NULL) {
+    munmap(pl->map_base, pl->map_len);
+    pl->map_base = NULL;
+    pl->map_len = 0;
   }
-  jsmn_strcpy(s24_str, t, js);
-  // trinarkular_log("INFO: Processing /24: '%s'", s24_str);
-  // move to the value
-  JSMN_NEXT(t);
 
-  if ((t = process_json_slash24(pl, s24_str, js, t)) == NULL) {
-    goto err;
+  free(pl);
+}
+
+int trinarkular_probelist_diff(trinarkular_probelist_t *old_pl,
+                               trinarkular_probelist_t *new_pl,
+                               trinarkular_probelist_diff_t *diff)
+{
+  int i = 0;
+  int j = 0;
+  trinarkular_slash24_t *old_s24;
+  trinarkular_slash24_t *new_s24;
+  int added_alloc = 0;
+  int removed_alloc = 0;
+  int updated_alloc = 0;
+
+  memset(diff, 0, sizeof(*diff));
+
+  // both /24 arrays are sorted by network IP, so walk them together
+  while (i < old_pl->slash24s_cnt || j < new_pl->slash24s_cnt) {
+    old_s24 = (i < old_pl->slash24s_cnt) ? &old_pl->records[i] : NULL;
+    new_s24 = (j < new_pl->slash24s_cnt) ? &new_pl->records[j] : NULL;
+
+    if (new_s24 == NULL ||
+        (old_s24 != NULL && old_s24->network_ip < new_s24->network_ip)) {
+      // /24 has gone away
+      DIFF_APPEND(diff->removed, diff->removed_cnt, removed_alloc,
+                  old_s24->network_ip);
+      i++;
+    } else if (old_s24 == NULL || new_s24->network_ip < old_s24->network_ip) {
+      // new /24
+      DIFF_APPEND(diff->added, diff->added_cnt, added_alloc, new_s24);
+      j++;
+    } else {
+      if (md_equal(old_pl, old_s24, new_pl, new_s24) == 0) {
+        // metadata changed, so the timeseries keys will change too. treat
+        // this as a remove and an add
+        DIFF_APPEND(diff->removed, diff->removed_cnt, removed_alloc,
+                    old_s24->network_ip);
+        DIFF_APPEND(diff->added, diff->added_cnt, added_alloc, new_s24);
+      } else if (old_s24->aeb != new_s24->aeb ||
+                 hosts_equal(old_s24, new_s24) == 0) {
+        DIFF_APPEND(diff->updated, diff->updated_cnt, updated_alloc, new_s24);
+      }
+      i++;
+      j++;
+    }
   }
 
-  free(root);
   return 0;
 
 err:
-  trinarkular_log("ERROR: Invalid JSON probelist");
-  free(root);
+  trinarkular_log("ERROR: Could not allocate probelist diff");
+  trinarkular_probelist_diff_free(diff);
   return -1;
 }
 
-static int read_file(trinarkular_probelist_t *pl, const char *filename)
+void trinarkular_probelist_diff_free(trinarkular_probelist_diff_t *diff)
 {
-  io_t *infile = NULL;
-
-  int ret;
-#define BUFSIZE 1024
-  char *js = NULL;
-  int js_alloc = BUFSIZE;
-  int jslen = 0;
-  char buf[1024];
-  char *bufp;
-  char *bufend = buf + BUFSIZE;
-
-  enum {
-    OUTER_OPEN,
-    S24,
-  } state = OUTER_OPEN;
-  int obj_start = 0;
-  int obj_end = 0;
-
-  // just be sure we're reading into a clean probelist
-  assert(pl->version == NULL && trinarkular_probelist_get_slash24_cnt(pl) == 0);
+  free(diff->added);
+  free(diff->removed);
+  free(diff->updated);
+  memset(diff, 0, sizeof(*diff));
+}
 
-  if ((infile = wandio_create(filename)) == NULL) {
-    trinarkular_log("ERROR: Could not open %s for reading\n", filename);
-    goto err;
+int trinarkular_probelist_add_slash24s(trinarkular_probelist_t *pl,
+                                       trinarkular_probelist_t *src_pl,
+                                       trinarkular_slash24_t **srcs, int cnt)
+{
+  khiter_t k;
+  int i, j;
+  uint32_t tmp;
+  uint32_t *md = NULL;
+  uint8_t *hosts = NULL;
+  const char *md_str;
+  char *md_cpy;
+  trinarkular_slash24_t s24;
+  trinarkular_slash24_t *src;
+  int first_cnt = pl->slash24s_cnt;
+
+  if (cnt == 0) {
+    return 0;
   }
-
-  if ((js = malloc(js_alloc)) == NULL) {
-    fprintf(stderr, "ERROR: Could not allocate JSON string buffer\n");
-    goto err;
+  // leave some room so that the arrays are not copied by every reload that
+  // adds a few /24s
+  if (pl->slash24s_cnt + cnt > pl->slash24s_alloc &&
+      trinarkular_probelist_reserve_slash24s(
+        pl, pl->slash24s_cnt + cnt + (pl->slash24s_cnt + cnt) / 8) != 0) {
+    return -1;
   }
 
-  // need to manually extract each /24 object so that we can do stream parsing
-  while ((ret = wandio_read(infile, buf, BUFSIZE)) > 0) {
-    bufp = buf;
-
-    switch (state) {
-    case OUTER_OPEN:
-      // skip chars until we find '{'
-      while (bufp < bufend && *bufp != '{') {
-        bufp++;
-      }
-      if (bufp == bufend) {
-        // read the next buffer
+  // if anything fails, the /24s appended so far are dropped again so that the
+  // index still matches the records
+
+  for (j = 0; j < cnt; j++) {
+    src = srcs[j];
+
+    // copy the hosts and metadata IDs into our own arena (only the metadata
+    // strings go in the md arena, since they are never freed)
+    md = NULL;
+    if ((hosts = trinarkular_arena_alloc(pl->arena, src->hosts_cnt)) == NULL ||
+        (src->md_cnt > 0 &&
+         (md = trinarkular_arena_alloc(pl->arena,
+                                       sizeof(uint32_t) * src->md_cnt)) ==
+           NULL)) {
+      trinarkular_log("ERROR: Could not allocate /24 copy");
+      goto err;
+    }
+    memcpy(hosts, src->hosts, src->hosts_cnt);
+    for (i = 0; i < src->md_cnt; i++) {
+      md_str = src_pl->md_strs[src->md[i]];
+      if ((k = kh_get(strid, pl->md_hash, (char *)md_str)) !=
+          kh_end(pl->md_hash)) {
+        md[i] = kh_val(pl->md_hash, k);
         continue;
       }
-      if (*bufp == '{') {
-        state = S24;
-        obj_start = 0;
-        obj_end = 0;
-        bufp++;
-      }
-    // fall through
-
-    case S24:
-      // copy until we have seen at least one '{' and then a matching number of
-      // '}'. if we see a '}' before any '{' then the json is over
-      while (bufp < bufend) {
-        // copy into json string
-        if (jslen == js_alloc) {
-          js_alloc *= 2;
-          if ((js = realloc(js, js_alloc)) == NULL) {
-            fprintf(stderr, "ERROR: Could not reallocate JSON string buffer\n");
-            goto err;
-          }
-        }
-        js[jslen++] = *bufp;
-
-        switch (*bufp) {
-        case '{':
-          obj_start++;
-          break;
-
-        case '}':
-          if (obj_start == 0) {
-            // end of json
-            goto done;
-          }
-          obj_end++;
-          if (obj_start == obj_end) {
-            // hand js off to /24 processing
-            if (process_json(pl, js, jslen) != 0) {
-              goto err;
-            }
-            obj_start = 0;
-            obj_end = 0;
-            jslen = 0;
-          }
-          break;
-
-        default:
-          break;
-        }
-        bufp++;
+      if ((md_cpy = trinarkular_arena_strndup(pl->md_arena, md_str,
+                                              strlen(md_str))) == NULL ||
+          trinarkular_probelist_intern_md(pl, md_cpy, &md[i]) != 0) {
+        goto err;
       }
     }
+
+    s24.network_ip = src->network_ip;
+    s24.hosts = hosts;
+    s24.hosts_cnt = src->hosts_cnt;
+    s24.aeb = src->aeb;
+    s24.md = md;
+    s24.md_cnt = src->md_cnt;
+    switch (trinarkular_probelist_append_slash24(pl, &s24)) {
+    case -1:
+      goto err;
+    case 1:
+      trinarkular_log("WARN: /24 already in probelist (%x)", s24.network_ip);
+      break;
+    }
   }
-  if (ret < 0) {
-    trinarkular_log("WARN: Reading from JSON file failed");
-    trinarkular_log("WARN: Probelist may be incomplete");
+
+  if (pl->slash24s_cnt == first_cnt) {
+    return 0;
+  }
+  if (slash24s_merge(pl, first_cnt) != 0) {
+    goto err;
   }
+  pl->slash24_iter = 0;
 
-done:
-  free(js);
-  if (infile != NULL) {
-    wandio_destroy(infile);
+  // the new /24s are still at the end of the probing order, so move each one
+  // to a random position
+  for (j = first_cnt; j < pl->slash24s_cnt; j++) {
+    i = rand() % (j + 1);
+    tmp = pl->slash24s[j];
+    pl->slash24s[j] = pl->slash24s[i];
+    pl->slash24s[i] = tmp;
   }
+
+  arenas_maybe_compact(pl);
   return 0;
 
 err:
-  free(js);
-  if (infile != NULL) {
-    wandio_destroy(infile);
-  }
+  slash24s_truncate(pl, first_cnt);
   return -1;
 }
 
-/* ---------- PUBLIC FUNCTIONS ---------- */
-
-trinarkular_probelist_t *trinarkular_probelist_create(const char *filename)
+int trinarkular_probelist_update_slash24(trinarkular_probelist_t *pl,
+                                         trinarkular_slash24_t *src)
 {
-  trinarkular_probelist_t *pl = NULL;
+  trinarkular_slash24_t *s24;
+  uint8_t *hosts;
 
-  trinarkular_log("INFO: Creating probelist from %s", filename);
+  if ((s24 = trinarkular_probelist_get_slash24(pl, src->network_ip)) == NULL) {
+    return -1;
+  }
 
-  if ((pl = malloc_zero(sizeof(trinarkular_probelist_t))) == NULL) {
-    return NULL;
+  // the old host array stays in the arena (or mapping) until the arena is
+  // compacted (or the probelist is destroyed)
+  if ((hosts = trinarkular_arena_alloc(pl->arena, src->hosts_cnt)) == NULL) {
+    trinarkular_log("ERROR: Could not allocate /24 hosts");
+    return -1;
+  }
+  memcpy(hosts, src->hosts, src->hosts_cnt);
+  if (arena_owned(pl, s24->hosts) != 0) {
+    pl->arena_garbage += s24->hosts_cnt;
   }
+  s24->hosts = hosts;
+  s24->hosts_cnt = src->hosts_cnt;
+  s24->aeb = src->aeb;
+  trinarkular_belief_compute_incrs(s24->aeb, s24->belief_incrs);
 
-  // FILE-SPECIFIC
-  if ((pl->s24_hash = kh_init(32s24)) == NULL) {
-    trinarkular_log("ERROR: Could not allocate /24 map");
-    goto err;
+  arenas_maybe_compact(pl);
+  return 0;
+}
+
+int trinarkular_probelist_remove_slash24s(trinarkular_probelist_t *pl,
+                                          uint32_t *network_ips, int cnt)
+{
+  uint32_t *rm = NULL;
+  int rm_cnt = 0;
+  uint32_t *remap = NULL;
+  trinarkular_slash24_t *s24;
+  uint32_t first, p, end;
+  int i, j, k, idx;
+
+  if (cnt == 0) {
+    return 0;
   }
-  if ((pl->state_hash = kh_init(32state)) == NULL) {
-    trinarkular_log("ERROR: Could not allocate state map");
+
+  // find the (sorted) indexes of the /24s to remove before the index changes
+  if ((rm = malloc(sizeof(uint32_t) * cnt)) == NULL) {
     goto err;
   }
+  for (i = 0; i < cnt; i++) {
+    if ((idx = slash24_idx(pl, network_ips[i])) != -1) {
+      rm[rm_cnt++] = idx;
+    }
+  }
+  if (rm_cnt == 0) {
+    free(rm);
+    return 0;
+  }
+  qsort(rm, rm_cnt, sizeof(uint32_t), u32_cmp);
+  for (i = 1, k = 1; i < rm_cnt; i++) {
+    if (rm[i] != rm[k - 1]) {
+      rm[k++] = rm[i];
+    }
+  }
+  rm_cnt = k;
 
-  // read the probelist in from the file
-  if (read_file(pl, filename) != 0) {
-    trinarkular_log("ERROR: Could not load probelist from file");
+  // /24s before the first removed one do not move
+  first = rm[0];
+  if ((remap = malloc(sizeof(uint32_t) * (pl->slash24s_cnt - first))) ==
+      NULL) {
     goto err;
   }
 
-  // randomize the /24s
-  array_shuffle_fy(uint32_t, pl->slash24s, pl->slash24s_cnt);
+  // (their host and metadata ID arrays and state metrics are left in the
+  // arenas until they are compacted)
+  for (i = 0; i < rm_cnt; i++) {
+    s24 = &pl->records[rm[i]];
+    IDX_WORD(pl, s24->network_ip)->bits &= ~IDX_BIT(s24->network_ip);
+    pl->arena_garbage += slash24_arena_size(pl, s24);
+    pl->metrics_garbage += state_metrics_size(pl, rm[i]);
+  }
+  idx_ranks_update(pl, pl->records[rm[0]].network_ip >> 14);
+
+  // update the probing order. a remaining /24 moves down by the number of
+  // /24s removed before it
+  for (p = first, j = 0; p < (uint32_t)pl->slash24s_cnt; p++) {
+    if (j < rm_cnt && rm[j] == p) {
+      remap[p - first] = UINT32_MAX;
+      j++;
+    } else {
+      remap[p - first] = p - j;
+    }
+  }
+  for (i = 0, k = 0; i < pl->slash24s_cnt; i++) {
+    if ((p = pl->slash24s[i]) >= first &&
+        (p = remap[p - first]) == UINT32_MAX) {
+      continue;
+    }
+    pl->slash24s[k++] = p;
+  }
 
-  return pl;
+  // close the gaps, moving each run of remaining /24s down once
+  for (j = 0; j < rm_cnt; j++) {
+    end = (j + 1 < rm_cnt) ? rm[j + 1] : (uint32_t)pl->slash24s_cnt;
+    slash24s_move(pl, rm[j] - j, rm[j] + 1, end - rm[j] - 1);
+  }
+  pl->slash24s_cnt -= rm_cnt;
+  pl->slash24_iter = 0;
+
+  free(rm);
+  free(remap);
+  arenas_maybe_compact(pl);
+  return 0;
 
 err:
-  trinarkular_probelist_destroy(pl);
-  return NULL;
+  trinarkular_log("ERROR: Could not allocate /24 removal buffers");
+  free(rm);
+  return -1;
 }
 
-void trinarkular_probelist_destroy(trinarkular_probelist_t *pl)
+int trinarkular_probelist_set_version(trinarkular_probelist_t *pl,
+                                      const char *version)
 {
-  khiter_t k;
+  char *cpy;
 
-  if (pl == NULL) {
-    return;
+  if ((cpy = strdup(version)) == NULL) {
+    return -1;
   }
-
   free(pl->version);
-  pl->version = NULL;
-
-  free(pl->slash24s);
-  pl->slash24s = NULL;
-  pl->slash24s_cnt = 0;
+  pl->version = cpy;
 
-  if (pl->s24_hash != NULL) {
-    for (k = kh_begin(pl->s24_hash); k < kh_end(pl->s24_hash); k++) {
-      if (kh_exist(pl->s24_hash, k) != 0) {
-        free_slash24(&kh_val(pl->s24_hash, k));
-      }
-    }
-    kh_destroy(32s24, pl->s24_hash);
-    pl->s24_hash = NULL;
-  }
-
-  if (pl->state_hash != NULL) {
-    for (k = kh_begin(pl->state_hash); k < kh_end(pl->state_hash); k++) {
-      if (kh_exist(pl->state_hash, k) != 0) {
-        free_state(&kh_val(pl->state_hash, k));
-      }
-    }
-    kh_destroy(32state, pl->state_hash);
-    pl->state_hash = NULL;
-  }
-
-  free(pl);
+  return 0;
 }
 
 char *trinarkular_probelist_get_version(trinarkular_probelist_t *pl)
@@ -722,7 +891,7 @@ trinarkular_probelist_get_next_slash24(trinarkular_probelist_t *pl)
   }
 
   // FILE SPECIFIC IMPLEMENTATION
-  s24 = trinarkular_probelist_get_slash24(pl, pl->slash24s[pl->slash24_iter]);
+  s24 = &pl->records[pl->slash24s[pl->slash24_iter]];
   // END
 
   pl->slash24_iter++;
@@ -739,18 +908,192 @@ trinarkular_slash24_t *
 trinarkular_probelist_get_slash24(trinarkular_probelist_t *pl,
                                   uint32_t network_ip)
 {
-  trinarkular_slash24_t *s24 = NULL;
-  khiter_t k;
+  int idx;
 
   // FILE SPECIFIC IMPLEMENTATION
-  if ((k = kh_get(32s24, pl->s24_hash, network_ip)) == kh_end(pl->s24_hash)) {
+  if ((idx = slash24_idx(pl, network_ip)) == -1 || idx >= pl->slash24s_cnt ||
+      pl->records[idx].network_ip != network_ip) {
     return NULL;
   }
-
-  s24 = &kh_val(pl->s24_hash, k);
   // END
 
-  return s24;
+  return &pl->records[idx];
+}
+
+trinarkular_slash24_t *
+trinarkular_probelist_get_slash24_array(trinarkular_probelist_t *pl)
+{
+  return pl->records;
+}
+
+trinarkular_slash24_state_t *
+trinarkular_probelist_get_slash24_state_array(trinarkular_probelist_t *pl)
+{
+  return pl->states;
+}
+
+int trinarkular_probelist_append_slash24(trinarkular_probelist_t *pl,
+                                         trinarkular_slash24_t *s24)
+{
+  trinarkular_slash24_idx_t *w = IDX_WORD(pl, s24->network_ip);
+  int idx;
+
+  if ((w->bits & IDX_BIT(s24->network_ip)) != 0) {
+    return 1;
+  }
+
+  if (pl->slash24s_cnt == pl->slash24s_alloc &&
+      trinarkular_probelist_reserve_slash24s(
+        pl, (pl->slash24s_alloc < 512) ? 1024 : pl->slash24s_alloc * 2) != 0) {
+    return -1;
+  }
+
+  idx = pl->slash24s_cnt++;
+  pl->records[idx] = *s24;
+  trinarkular_belief_compute_incrs(s24->aeb, pl->records[idx].belief_incrs);
+  memset(&pl->states[idx], 0, sizeof(trinarkular_slash24_state_t));
+  pl->states_set[idx] = 0;
+  pl->slash24s[idx] = idx;
+  w->bits |= IDX_BIT(s24->network_ip);
+
+  return 0;
+}
+
+int trinarkular_probelist_reserve_slash24s(trinarkular_probelist_t *pl,
+                                           int cnt)
+{
+  trinarkular_slash24_t *records;
+  trinarkular_slash24_state_t *states;
+  uint8_t *states_set;
+  uint32_t *s24s;
+
+  if (cnt <= pl->slash24s_alloc) {
+    return 0;
+  }
+
+  if (slash24_arrays_alloc(cnt, &records, &states, &states_set) != 0) {
+    trinarkular_log("ERROR: Could not allocate /24 arrays");
+    return -1;
+  }
+  if ((s24s = realloc(pl->slash24s, sizeof(uint32_t) * cnt)) == NULL) {
+    trinarkular_log("ERROR: Could not allocate /24 list");
+    free(records);
+    free(states);
+    free(states_set);
+    return -1;
+  }
+  if (pl->slash24s_cnt > 0) {
+    memcpy(records, pl->records,
+           sizeof(trinarkular_slash24_t) * pl->slash24s_cnt);
+    memcpy(states, pl->states,
+           sizeof(trinarkular_slash24_state_t) * pl->slash24s_cnt);
+    memcpy(states_set, pl->states_set, pl->slash24s_cnt);
+  }
+  slash24_arrays_free(pl);
+  pl->records = records;
+  pl->states = states;
+  pl->states_set = states_set;
+  pl->slash24s = s24s;
+  pl->slash24s_alloc = cnt;
+
+  return 0;
+}
+
+int trinarkular_probelist_build_index(trinarkular_probelist_t *pl)
+{
+  trinarkular_slash24_t *records = NULL;
+  trinarkular_slash24_state_t *states = NULL;
+  uint8_t *states_set = NULL;
+  uint32_t total = 0;
+  int i, j, k;
+
+  // nothing is changed until the new arrays have been allocated, so a failure
+  // leaves the index matching the records
+  for (i = 0; i < SLASH24_IDX_CNT; i++) {
+    total += __builtin_popcountll(pl->idx[i].bits);
+  }
+  if (slash24_arrays_alloc(total, &records, &states, &states_set) != 0) {
+    trinarkular_log("ERROR: Could not allocate /24 arrays");
+    return -1;
+  }
+
+  // count the /24s that come before each word
+  for (i = 0, total = 0; i < SLASH24_IDX_CNT; i++) {
+    pl->idx[i].rank = total;
+    total += __builtin_popcountll(pl->idx[i].bits);
+  }
+
+  // move each /24 directly to its sorted position
+  for (i = 0; i < pl->slash24s_cnt; i++) {
+    if ((j = slash24_idx(pl, pl->records[i].network_ip)) != -1) {
+      records[j] = pl->records[i];
+      states[j] = pl->states[i];
+      states_set[j] = pl->states_set[i];
+    }
+  }
+
+  // update the probing order (dropping removed /24s)
+  for (i = 0, k = 0; i < pl->slash24s_cnt; i++) {
+    if ((j = slash24_idx(pl, pl->records[pl->slash24s[i]].network_ip)) != -1) {
+      pl->slash24s[k++] = j;
+    }
+  }
+  assert(k == (int)total);
+
+  slash24_arrays_free(pl);
+  pl->records = records;
+  pl->states = states;
+  pl->states_set = states_set;
+  pl->slash24s_cnt = total;
+  pl->slash24s_alloc = total;
+  pl->slash24_iter = 0;
+
+  return 0;
+}
+
+uint32_t trinarkular_probelist_get_md_cnt(trinarkular_probelist_t *pl)
+{
+  return pl->md_strs_cnt;
+}
+
+const char *trinarkular_probelist_get_md(trinarkular_probelist_t *pl,
+                                         uint32_t md_id)
+{
+  assert(md_id < pl->md_strs_cnt);
+  return pl->md_strs[md_id];
+}
+
+int trinarkular_probelist_intern_md(trinarkular_probelist_t *pl, char *md,
+                                    uint32_t *md_id)
+{
+  khiter_t k;
+  int khret;
+
+  k = kh_put(strid, pl->md_hash, md, &khret);
+  if (khret == -1) {
+    trinarkular_log("ERROR: Could not add metadata to probelist");
+    return -1;
+  }
+  if (khret == 0) {
+    // already interned
+    *md_id = kh_val(pl->md_hash, k);
+    return 0;
+  }
+
+  if (pl->md_strs_cnt == pl->md_strs_alloc) {
+    pl->md_strs_alloc = (pl->md_strs_alloc == 0) ? 1024 : pl->md_strs_alloc * 2;
+    if ((pl->md_strs = realloc(pl->md_strs,
+                               sizeof(char *) * pl->md_strs_alloc)) == NULL) {
+      trinarkular_log("ERROR: Could not grow metadata table");
+      kh_del(strid, pl->md_hash, k);
+      return -1;
+    }
+  }
+  pl->md_strs[pl->md_strs_cnt] = md;
+  kh_val(pl->md_hash, k) = pl->md_strs_cnt;
+  *md_id = pl->md_strs_cnt++;
+
+  return 0;
 }
 
 trinarkular_slash24_state_t *trinarkular_slash24_state_create(int metrics_cnt)
@@ -786,7 +1129,8 @@ void trinarkular_slash24_state_destroy(trinarkular_slash24_state_t *state)
     return;
   }
 
-  free_state(state);
+  free(state->metrics);
+  state->metrics = NULL;
 
   free(state);
 }
@@ -795,40 +1139,74 @@ int trinarkular_probelist_save_slash24_state(trinarkular_probelist_t *pl,
                                              trinarkular_slash24_t *s24,
                                              trinarkular_slash24_state_t *state)
 {
-  khiter_t k;
-  int khret;
-  trinarkular_slash24_state_t *dest;
+  size_t idx;
 
   // FILE SPECIFIC IMPLEMENTATION
-  k = kh_put(32state, pl->state_hash, s24->network_ip, &khret);
-  if (khret == -1) {
-    trinarkular_log("ERROR: Could not save /24 state");
-    return -1;
+  idx = s24_idx(pl, s24);
+
+  if (pl->states_set[idx] == 0) {
+    // first use: need to clear the structure
+    pl->states[idx].metrics = NULL;
+    pl->states[idx].metrics_cnt = 0;
+    pl->states_set[idx] = 1;
   }
 
-  dest = &kh_val(pl->state_hash, k);
+  return copy_state(pl, &pl->states[idx], state);
+}
 
-  if (khret != 0) {
-    // first use: need to clear the structure
-    dest->metrics = NULL;
-    dest->metrics_cnt = 0;
+trinarkular_slash24_state_t *
+trinarkular_probelist_init_slash24_state(trinarkular_probelist_t *pl,
+                                         trinarkular_slash24_t *s24,
+                                         int metrics_cnt)
+{
+  trinarkular_slash24_state_t *state;
+  trinarkular_slash24_metrics_t *metrics = NULL;
+  size_t idx;
+
+  // to save memory this is an 8bit field
+  assert(metrics_cnt <= UINT8_MAX);
+
+  // FILE SPECIFIC IMPLEMENTATION
+  idx = s24_idx(pl, s24);
+
+  // (any existing metrics array stays in the arena until the arena is
+  // compacted)
+  pl->metrics_garbage += state_metrics_size(pl, idx);
+  if (metrics_cnt > 0) {
+    if ((metrics = trinarkular_arena_alloc(
+           pl->metrics_arena,
+           sizeof(trinarkular_slash24_metrics_t) * metrics_cnt)) == NULL) {
+      return NULL;
+    }
+    memset(metrics, 0, sizeof(trinarkular_slash24_metrics_t) * metrics_cnt);
   }
 
-  return copy_state(dest, state);
+  state = &pl->states[idx];
+  memset(state, 0, sizeof(*state));
+  state->metrics = metrics;
+  state->metrics_cnt = metrics_cnt;
+  pl->states_set[idx] = 1;
+
+  // the hosts of a binary probelist are in the (read-only) mapping, in the
+  // order they were compiled in, so they cannot be shuffled at load time.
+  // starting at a random host means that probers (and runs) that share a
+  // probelist still probe different hosts first
+  if (s24->hosts_cnt > 0) {
+    state->current_host = rand() % s24->hosts_cnt;
+  }
+
+  return state;
 }
 
 void *trinarkular_probelist_get_slash24_state(trinarkular_probelist_t *pl,
                                               trinarkular_slash24_t *s24)
 {
-  khiter_t k;
+  size_t idx;
 
   // FILE SPECIFIC IMPLEMENTATION
-  if ((k = kh_get(32state, pl->state_hash, s24->network_ip)) ==
-      kh_end(pl->state_hash)) {
-    return NULL;
-  }
+  idx = s24_idx(pl, s24);
 
-  return &kh_val(pl->state_hash, k);
+  return (pl->states_set[idx] != 0) ? &pl->states[idx] : NULL;
 }
 
 uint32_t trinarkular_probelist_get_next_host(trinarkular_slash24_t *s24,
@@ -43,6 +43,7 @@
 #ifndef __TRINARKULAR_PROBELIST_H
 #define __TRINARKULAR_PROBELIST_H
 
+#include "trinarkular_belief.h"
 #include <stdint.h>
 
 /** @file
@@ -91,18 +92,24 @@ typedef struct trinarkular_slash24_metrics {
   /** (kp idx) Value will be 0 (uncertain), 1 (down), or 2 (up) */
   int32_t state;
 
-  /** (shared kp idx) Value will be # /24s in each state */
-  int32_t overall[3]; // UNCERTAIN, DOWN, UP
-
 } __attribute__((packed)) trinarkular_slash24_metrics_t;
 
 /** Structure representing prober state for a /24
+ *
+ * Fields are ordered so that the structure is naturally aligned (and 24 bytes
+ * long), since the states of all /24s are scanned at the end of each round.
  *
  * NB: When modifying fields here, you MUST also modify the copy_state function
  * in trinarkular_probelist.c
  */
 typedef struct trinarkular_slash24_state {
 
+  /** Set of timeseries associated with this /24 (one per metadata)*/
+  trinarkular_slash24_metrics_t *metrics;
+
+  /** The current (log-odds) belief that this /24 is up */
+  trinarkular_belief_t current_belief;
+
   /** Index of the current host in the slash24 */
   uint8_t current_host;
 
@@ -116,9 +123,6 @@ typedef struct trinarkular_slash24_state {
    */
   uint8_t probe_budget;
 
-  /** The current belief value for this /24 */
-  float current_belief;
-
   /** Last stable state for this /24 (Warning: this **may not** match
       BELIEF_STATE(current_belief) if adaptive probing has been used) */
   uint8_t current_state;
@@ -128,13 +132,32 @@ typedef struct trinarkular_slash24_state {
       255, it is reset to RECOVERY_BACKOFF_MAX to avoid wrapping */
   uint8_t rounds_since_up;
 
-  /** Set of timeseries associated with this /24 (one per metadata)*/
-  trinarkular_slash24_metrics_t *metrics;
-
   /** Number of metric sets */
   uint8_t metrics_cnt;
 
-} __attribute__((packed)) trinarkular_slash24_state_t;
+  /** Sequence number of the last probe sent to this /24 (used to recognize
+      probe timeouts that have since been superseded) */
+  uint8_t probe_seq;
+
+  /** Index of the driver that the last probe was sent with (set by the
+      prober) */
+  uint8_t probe_driver;
+
+  /** Time that the last probe was sent (set by the prober) */
+  uint16_t probe_sent;
+
+  /** Belief that this /24 last settled on (set by the prober, exported at
+      the end of the round) */
+  trinarkular_belief_t settled_belief;
+
+  /** Stable state last exported to the timeseries (set by the prober) */
+  uint8_t exported_state;
+
+  /** Flags marking what this /24 is waiting on (e.g., to be exported at the
+      end of the round) (set by the prober) */
+  uint8_t dirty;
+
+} trinarkular_slash24_state_t;
 
 #define ADAPTIVE_BUDGET(s24state) ((s24state)->probe_budget & 0x0f)
 
@@ -147,29 +170,59 @@ typedef struct trinarkular_slash24_state {
   (s24state)->probe_budget =                                                   \
     ((s24state)->probe_budget & 0x0f) | (((val)&0x0f) << 4)
 
+/** Structure representing a /24 in the probelist (32 bytes, naturally
+    aligned) */
 typedef struct trinarkular_slash24 {
 
-  /** The network IP (first IP) of this /24 (in host byte order) */
-  uint32_t network_ip;
-
   /** List of target host bytes for this /24 (should be OR'd with the network
       IP) */
   uint8_t *hosts;
 
-  /** Number of host bytes */
-  uint16_t hosts_cnt;
+  /** List of metadata IDs (see trinarkular_probelist_get_md) */
+  uint32_t *md;
+
+  /** The network IP (first IP) of this /24 (in host byte order) */
+  uint32_t network_ip;
 
   /** The average response rate of recently responding hosts in this /24
    * (I.e. the A(E(b)) value from the paper) */
   float aeb;
 
-  /** List of metadata */
-  char **md;
+  /** Number of host bytes */
+  uint16_t hosts_cnt;
 
   /** Number of items in metadata list */
   uint8_t md_cnt;
 
-} __attribute__((packed)) trinarkular_slash24_t;
+  /** Belief increments for a negative (0) and positive (1) probe response
+      (computed from aeb when the /24 is added to a probelist) */
+  trinarkular_belief_t belief_incrs[2];
+
+} trinarkular_slash24_t;
+
+/** Differences between two versions of a probelist */
+typedef struct trinarkular_probelist_diff {
+
+  /** /24s (borrowed from the new probelist) that are not in the old one */
+  trinarkular_slash24_t **added;
+
+  /** Number of added /24s */
+  int added_cnt;
+
+  /** Network IPs of /24s in the old probelist that are not in the new one */
+  uint32_t *removed;
+
+  /** Number of removed /24s */
+  int removed_cnt;
+
+  /** /24s (borrowed from the new probelist) that are in both probelists with
+      the same metadata, but with different hosts or A(E(b)) */
+  trinarkular_slash24_t **updated;
+
+  /** Number of updated /24s */
+  int updated_cnt;
+
+} trinarkular_probelist_diff_t;
 
 /** @} */
 
@@ -179,12 +232,110 @@ typedef struct trinarkular_slash24 {
  */
 trinarkular_probelist_t *trinarkular_probelist_create(const char *filename);
 
+/** Create a new Trinarkular Probelist object, parsing JSON using threads
+ *
+ * @param filename      name of the probelist file to load
+ * @param thread_cnt    number of threads to parse a JSON probelist with
+ * @return pointer to a probelist object if successful, NULL otherwise
+ *
+ * If thread_cnt is 1 (or less), parsing is done by the calling thread.
+ * Compiled (binary) probelists are always loaded by the calling thread.
+ */
+trinarkular_probelist_t *
+trinarkular_probelist_create_threaded(const char *filename, int thread_cnt);
+
 /** Destroy the given Trinarkular Probelist
  *
  * @param pl            pointer to the probelist to destroy
  */
 void trinarkular_probelist_destroy(trinarkular_probelist_t *pl);
 
+/** Write the given probelist out in the compiled (binary) format
+ *
+ * @param pl            pointer to the probelist to write
+ * @param filename      name of the file to write to
+ * @return 0 if the probelist was written successfully, -1 otherwise
+ *
+ * The compiled format can be passed to trinarkular_probelist_create in place
+ * of the JSON probelist. It is memory-mapped at load time and so does not need
+ * to be parsed. The file is written to a temporary file and then renamed into
+ * place.
+ */
+int trinarkular_probelist_save_binary(trinarkular_probelist_t *pl,
+                                      const char *filename);
+
+/** Compute the differences between two probelists
+ *
+ * @param old_pl        pointer to the old probelist
+ * @param new_pl        pointer to the new probelist
+ * @param[out] diff     pointer to the diff structure to fill
+ * @return 0 if the diff was computed successfully, -1 otherwise
+ *
+ * A /24 whose metadata has changed is reported as both removed and added.
+ * Neither probelist is modified (and the iterators are not used), so this is
+ * safe to call while another thread is probing using old_pl. The diff borrows
+ * /24s from new_pl, and must be freed using trinarkular_probelist_diff_free.
+ */
+int trinarkular_probelist_diff(trinarkular_probelist_t *old_pl,
+                               trinarkular_probelist_t *new_pl,
+                               trinarkular_probelist_diff_t *diff);
+
+/** Free the contents of the given probelist diff
+ *
+ * @param diff          pointer to the diff to free
+ */
+void trinarkular_probelist_diff_free(trinarkular_probelist_diff_t *diff);
+
+/** Add copies of /24s from another probelist to the given probelist
+ *
+ * @param pl            pointer to the probelist to add the /24s to
+ * @param src_pl        pointer to the probelist that owns the /24s
+ * @param srcs          array of pointers to the /24s to copy
+ * @param cnt           number of /24s in the array
+ * @return 0 if the /24s were added successfully, -1 otherwise
+ *
+ * The new /24s are inserted at random positions in the probing order, and the
+ * /24 iterator is reset. All previously returned /24 and state pointers are
+ * invalidated by this call. If an error occurs, none of the /24s are added.
+ */
+int trinarkular_probelist_add_slash24s(trinarkular_probelist_t *pl,
+                                       trinarkular_probelist_t *src_pl,
+                                       trinarkular_slash24_t **srcs, int cnt);
+
+/** Update the hosts and A(E(b)) of a /24 using a /24 from another probelist
+ *
+ * @param pl            pointer to the probelist that owns the /24
+ * @param src           pointer to the /24 to copy hosts and A(E(b)) from
+ * @return 0 if the /24 was updated successfully, -1 otherwise
+ *
+ * The state (if any) associated with the /24 is retained.
+ */
+int trinarkular_probelist_update_slash24(trinarkular_probelist_t *pl,
+                                         trinarkular_slash24_t *src);
+
+/** Remove the given /24s (and any associated state) from the probelist
+ *
+ * @param pl            pointer to the probelist to remove /24s from
+ * @param network_ips   array of network IPs of the /24s to remove
+ * @param cnt           number of network IPs in the array
+ * @return 0 if the /24s were removed successfully, -1 otherwise
+ *
+ * The /24 iterator is reset. All previously returned /24 and state pointers
+ * are invalidated by this call. If an error occurs, none of the /24s are
+ * removed.
+ */
+int trinarkular_probelist_remove_slash24s(trinarkular_probelist_t *pl,
+                                          uint32_t *network_ips, int cnt);
+
+/** Set the version of the given probelist
+ *
+ * @param pl            pointer to the probelist to set version for
+ * @param version       version string to set (copied)
+ * @return 0 if the version was set successfully, -1 otherwise
+ */
+int trinarkular_probelist_set_version(trinarkular_probelist_t *pl,
+                                      const char *version);
+
 /** Get the version of the current probelist
  *
  * @param pl            pointer to the probelist to set version for
@@ -249,12 +400,34 @@ trinarkular_slash24_state_t *trinarkular_slash24_state_create(int metrics_cnt);
  */
 void trinarkular_slash24_state_destroy(trinarkular_slash24_state_t *state);
 
+/** Initialize (zeroed) state for the given /24
+ *
+ * @param pl            pointer to a probelist
+ * @param s24           pointer to the /24 (borrowed from the same probelist) to
+ *                      initialize state for
+ * @param metrics_cnt   number of metrics to allocate
+ * @return borrowed pointer to the state if successful, NULL otherwise
+ *
+ * Any existing state for the /24 is replaced. The returned state is stored in
+ * the probelist, and may be modified in place (see
+ * trinarkular_probelist_get_slash24_state).
+ */
+trinarkular_slash24_state_t *
+trinarkular_probelist_init_slash24_state(trinarkular_probelist_t *pl,
+                                         trinarkular_slash24_t *s24,
+                                         int metrics_cnt);
+
 /** Save state for the given /24
  *
  * @param pl            pointer to a probelist
- * @param s24           pointer to the /24 to save state for
+ * @param s24           pointer to the /24 (borrowed from the same probelist) to
+ *                      save state for
  * @param state         pointer to state to set
  * @return 0 if the state was set successfully, -1 otherwise
+ *
+ * The state is copied into the probelist. Saving the state pointer returned by
+ * trinarkular_probelist_get_slash24_state for the same /24 is a no-op, since
+ * changes to it have already been made in place.
  */
 int trinarkular_probelist_save_slash24_state(
   trinarkular_probelist_t *pl, trinarkular_slash24_t *s24,
@@ -262,12 +435,61 @@ int trinarkular_probelist_save_slash24_state(
 
 /** Get the state associated with the given /24
  *
- * @param s24           pointer to a /24
+ * @param pl            pointer to a probelist
+ * @param s24           pointer to a /24 (borrowed from the same probelist)
  * @return borrowed pointer to the state if set, NULL otherwise
+ *
+ * The state is stored alongside the /24, so this does not need a lookup. The
+ * returned state may be modified in place and does not need to be saved. It
+ * remains valid until /24s are added to or removed from the probelist.
  */
 void *trinarkular_probelist_get_slash24_state(trinarkular_probelist_t *pl,
                                               trinarkular_slash24_t *s24);
 
+/** Get the array of all /24s in the probelist
+ *
+ * @param pl            pointer to a probelist
+ * @return borrowed pointer to the first of trinarkular_probelist_get_slash24_cnt
+ * /24s (sorted by network IP)
+ *
+ * This (and trinarkular_probelist_get_slash24_state_array) allow scans over
+ * the entire probelist to stream through memory, rather than looking up each
+ * /24 in turn. The array is invalidated when /24s are added or removed.
+ */
+trinarkular_slash24_t *
+trinarkular_probelist_get_slash24_array(trinarkular_probelist_t *pl);
+
+/** Get the array of the states of all /24s in the probelist
+ *
+ * @param pl            pointer to a probelist
+ * @return borrowed pointer to the first of trinarkular_probelist_get_slash24_cnt
+ * states (parallel to the array returned by
+ * trinarkular_probelist_get_slash24_array)
+ *
+ * The state of a /24 that has not been initialized is zeroed.
+ */
+trinarkular_slash24_state_t *
+trinarkular_probelist_get_slash24_state_array(trinarkular_probelist_t *pl);
+
+/** Get the number of distinct metadata strings in the given probelist
+ *
+ * @param pl            pointer to the probelist
+ * @return number of metadata strings (valid IDs are 0 to this value - 1)
+ */
+uint32_t trinarkular_probelist_get_md_cnt(trinarkular_probelist_t *pl);
+
+/** Get the metadata string with the given ID
+ *
+ * @param pl            pointer to the probelist
+ * @param md_id         ID of the metadata (from the md list of a /24)
+ * @return borrowed pointer to the metadata string
+ *
+ * Metadata strings are interned, so each distinct string is stored only once
+ * and is shared by all /24s that have it.
+ */
+const char *trinarkular_probelist_get_md(trinarkular_probelist_t *pl,
+                                         uint32_t md_id);
+
 // Helper functions
 
 uint32_t
@@ -0,0 +1,551 @@
+/*
+ * This file is part of trinarkular
+ *
+ * Copyright (C) 2015 The Regents of the University of California.
+ * Authors: Alistair King
+ *
+ * This software is Copyright (c) 2015 The Regents of the University of
+ * California. All Rights Reserved. Permission to copy, modify, and distribute this
+ * software and its documentation for academic research and education purposes,
+ * without fee, and without a written agreement is hereby granted, provided that
+ * the above copyright notice, this paragraph and the following three paragraphs
+ * appear in all copies. Permission to make use of this software for other than
+ * academic research and education purposes may be obtained by contacting:
+ *
+ * Office of Innovation and Commercialization
+ * 9500 Gilman Drive, Mail Code 0910
+ * University of California
+ * La Jolla, CA 92093-0910
+ * (858) 534-5815
+ * invent@ucsd.edu
+ *
+ * This software program and documentation are copyrighted by The Regents of the
+ * University of California. The software program and documentation are supplied
+ * "as is", without any accompanying services from The Regents. The Regents does
+ * not warrant that the operation of the program will be uninterrupted or
+ * error-free. The end-user understands that the program was developed for research
+ * purposes and is advised not to rely exclusively on the program for any reason.
+ *
+ * IN NO EVENT SHALL THE UNIVERSITY OF CALIFORNIA BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+ * PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF
+ * THE UNIVERSITY OF CALIFORNIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE. THE UNIVERSITY OF CALIFORNIA SPECIFICALLY DISCLAIMS ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS
+ * IS" BASIS, AND THE UNIVERSITY OF CALIFORNIA HAS NO OBLIGATIONS TO PROVIDE
+ * MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ * Report any bugs, questions or comments to alistair@caida.org
+ *
+ */
+
+#include "trinarkular_probelist_int.h"
+#include "trinarkular.h"
+#include "trinarkular_log.h"
+#include "config.h"
+#include "khash.h"
+#include "utils.h"
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/* The compiled probelist is a fixed-layout file that is memory-mapped at load
+ * time. All sections are addressed by offsets relative to the start of the
+ * file, and each section begins on an 8-byte boundary:
+ *
+ *   header | version string | /24 table | host bytes | metadata refs |
+ *   metadata string offsets | metadata strings
+ *
+ * Metadata strings are interned: each distinct string is stored once and /24s
+ * refer to strings by index.
+ */
+
+/** Magic string at the start of every compiled probelist */
+#define PL_BIN_MAGIC "TRNKPLB"
+
+/** Current version of the compiled probelist format */
+#define PL_BIN_VERSION 1
+
+/** Written in native byte order so that files from hosts with a different
+    byte order can be rejected */
+#define PL_BIN_BYTE_ORDER 0x01020304
+
+#define PL_BIN_ALIGN(x) (((x) + 7) & ~((uint64_t)7))
+
+typedef struct pl_bin_hdr {
+
+  /** PL_BIN_MAGIC (NUL padded) */
+  char magic[8];
+
+  /** PL_BIN_VERSION */
+  uint32_t format_version;
+
+  /** PL_BIN_BYTE_ORDER */
+  uint32_t byte_order;
+
+  /** Total size of the file (used to detect truncated files) */
+  uint64_t file_size;
+
+  /** Number of /24 records */
+  uint64_t slash24_cnt;
+
+  /** Number of distinct metadata strings */
+  uint64_t md_str_cnt;
+
+  /** Probelist version string (NUL-terminated) */
+  uint64_t version_off;
+  uint64_t version_len;
+
+  /** Array of slash24_cnt pl_bin_slash24_t records */
+  uint64_t slash24s_off;
+
+  /** Host byte blob */
+  uint64_t hosts_off;
+  uint64_t hosts_len;
+
+  /** Array of uint32_t metadata string indexes */
+  uint64_t md_refs_off;
+  uint64_t md_refs_cnt;
+
+  /** Array of md_str_cnt uint32_t string offsets (into the string blob) */
+  uint64_t md_str_idx_off;
+
+  /** Blob of NUL-terminated metadata strings */
+  uint64_t md_str_off;
+  uint64_t md_str_len;
+
+} pl_bin_hdr_t;
+
+typedef struct pl_bin_slash24 {
+
+  /** Network IP of the /24 (host byte order) */
+  uint32_t network_ip;
+
+  /** Index of the first host byte in the host blob */
+  uint32_t hosts_idx;
+
+  /** Index of the first metadata reference in the md refs array */
+  uint32_t md_idx;
+
+  /** A(E(b)) for this /24 */
+  float aeb;
+
+  /** Number of host bytes */
+  uint16_t hosts_cnt;
+
+  /** Number of metadata references */
+  uint8_t md_cnt;
+
+  uint8_t unused;
+
+} pl_bin_slash24_t;
+
+#define SECTION_OK(off, len)                                                   \
+  ((off) <= map_len && (len) <= map_len - (off) && ((off)&7) == 0)
+
+/* ---------- READING ---------- */
+
+int trinarkular_probelist_bin_detect(const char *filename)
+{
+  char magic[sizeof(((pl_bin_hdr_t *)0)->magic)];
+  int fd;
+  ssize_t ret;
+
+  if ((fd = open(filename, O_RDONLY)) == -1) {
+    return 0;
+  }
+  ret = read(fd, magic, sizeof(magic));
+  close(fd);
+
+  return (ret == sizeof(magic) && memcmp(magic, PL_BIN_MAGIC,
+                                         sizeof(PL_BIN_MAGIC)) == 0);
+}
+
+int trinarkular_probelist_bin_read(trinarkular_probelist_t *pl,
+                                   const char *filename)
+{
+  int fd = -1;
+  struct stat st;
+  uint8_t *base = NULL;
+  size_t map_len = 0;
+  pl_bin_hdr_t *hdr;
+  pl_bin_slash24_t *recs;
+  uint8_t *hosts;
+  uint32_t *md_refs;
+  uint32_t *md_str_idx;
+  char *md_str;
+  uint64_t i;
+  uint32_t md_id;
+  int ret;
+  trinarkular_slash24_t s24;
+
+  assert(pl->version == NULL && pl->slash24s_cnt == 0);
+
+  if ((fd = open(filename, O_RDONLY)) == -1 || fstat(fd, &st) != 0) {
+    trinarkular_log("ERROR: Could not open %s (%s)", filename,
+                    strerror(errno));
+    goto err;
+  }
+  map_len = st.st_size;
+  if (map_len < sizeof(pl_bin_hdr_t)) {
+    trinarkular_log("ERROR: Truncated binary probelist");
+    goto err;
+  }
+
+  if ((base = mmap(NULL, map_len, PROT_READ, MAP_PRIVATE, fd, 0)) ==
+      MAP_FAILED) {
+    base = NULL;
+    trinarkular_log("ERROR: Could not map %s (%s)", filename, strerror(errno));
+    goto err;
+  }
+  close(fd);
+  fd = -1;
+  // the whole file is going to be touched
+  madvise(base, map_len, MADV_WILLNEED);
+
+  // hand the mapping to the probelist so that it is cleaned up on error
+  pl->map_base = base;
+  pl->map_len = map_len;
+
+  // validate the header
+  hdr = (pl_bin_hdr_t *)base;
+  if (memcmp(hdr->magic, PL_BIN_MAGIC, sizeof(PL_BIN_MAGIC)) != 0) {
+    trinarkular_log("ERROR: Not a binary probelist");
+    goto err;
+  }
+  if (hdr->byte_order != PL_BIN_BYTE_ORDER) {
+    trinarkular_log("ERROR: Binary probelist has incompatible byte order");
+    goto err;
+  }
+  if (hdr->format_version != PL_BIN_VERSION) {
+    trinarkular_log("ERROR: Unsupported binary probelist version %" PRIu32
+                    " (expecting %d)",
+                    hdr->format_version, PL_BIN_VERSION);
+    goto err;
+  }
+  if (hdr->file_size != map_len) {
+    trinarkular_log("ERROR: Binary probelist size mismatch (%" PRIu64
+                    " != %zu)",
+                    hdr->file_size, map_len);
+    goto err;
+  }
+  if (hdr->slash24_cnt > TRINARKULAR_SLASH24_CNT ||
+      hdr->md_str_cnt > UINT32_MAX || hdr->md_refs_cnt > UINT32_MAX ||
+      !SECTION_OK(hdr->version_off, hdr->version_len) ||
+      !SECTION_OK(hdr->slash24s_off,
+                  hdr->slash24_cnt * sizeof(pl_bin_slash24_t)) ||
+      !SECTION_OK(hdr->hosts_off, hdr->hosts_len) ||
+      !SECTION_OK(hdr->md_refs_off, hdr->md_refs_cnt * sizeof(uint32_t)) ||
+      !SECTION_OK(hdr->md_str_idx_off, hdr->md_str_cnt * sizeof(uint32_t)) ||
+      !SECTION_OK(hdr->md_str_off, hdr->md_str_len) ||
+      hdr->version_len == 0 || base[hdr->version_off + hdr->version_len - 1] !=
+                                 '\0' ||
+      (hdr->md_str_len != 0 &&
+       base[hdr->md_str_off + hdr->md_str_len - 1] != '\0')) {
+    trinarkular_log("ERROR: Corrupt binary probelist header");
+    goto err;
+  }
+
+  recs = (pl_bin_slash24_t *)(base + hdr->slash24s_off);
+  hosts = base + hdr->hosts_off;
+  md_refs = (uint32_t *)(base + hdr->md_refs_off);
+  md_str_idx = (uint32_t *)(base + hdr->md_str_idx_off);
+  md_str = (char *)(base + hdr->md_str_off);
+
+  if ((pl->version = strdup((char *)base + hdr->version_off)) == NULL) {
+    goto err;
+  }
+
+  // the metadata strings are already interned, so the metadata references
+  // can be used directly as metadata IDs
+  kh_resize(strid, pl->md_hash, hdr->md_str_cnt);
+  for (i = 0; i < hdr->md_str_cnt; i++) {
+    if (md_str_idx[i] >= hdr->md_str_len) {
+      trinarkular_log("ERROR: Corrupt metadata string offset");
+      goto err;
+    }
+    if (trinarkular_probelist_intern_md(pl, md_str + md_str_idx[i], &md_id) !=
+        0) {
+      goto err;
+    }
+    if (md_id != i) {
+      trinarkular_log("ERROR: Duplicate metadata string in binary probelist");
+      goto err;
+    }
+  }
+  for (i = 0; i < hdr->md_refs_cnt; i++) {
+    if (md_refs[i] >= hdr->md_str_cnt) {
+      trinarkular_log("ERROR: Corrupt metadata reference");
+      goto err;
+    }
+  }
+
+  if (hdr->slash24_cnt == 0) {
+    return 0;
+  }
+
+  // size the record array up front so that it never needs to grow
+  if (trinarkular_probelist_reserve_slash24s(pl, hdr->slash24_cnt) != 0) {
+    goto err;
+  }
+
+  for (i = 0; i < hdr->slash24_cnt; i++) {
+    if ((recs[i].network_ip & TRINARKULAR_SLASH24_NETMASK) !=
+          recs[i].network_ip ||
+        recs[i].hosts_cnt == 0 ||
+        recs[i].hosts_cnt > TRINARKULAR_SLASH24_HOST_CNT ||
+        (uint64_t)recs[i].hosts_idx + recs[i].hosts_cnt > hdr->hosts_len ||
+        (uint64_t)recs[i].md_idx + recs[i].md_cnt > hdr->md_refs_cnt) {
+      trinarkular_log("ERROR: Corrupt /24 record (%x)", recs[i].network_ip);
+      goto err;
+    }
+
+    s24.network_ip = recs[i].network_ip;
+    s24.hosts = hosts + recs[i].hosts_idx;
+    s24.hosts_cnt = recs[i].hosts_cnt;
+    s24.aeb = recs[i].aeb;
+    s24.md = (recs[i].md_cnt > 0) ? md_refs + recs[i].md_idx : NULL;
+    s24.md_cnt = recs[i].md_cnt;
+    if ((ret = trinarkular_probelist_append_slash24(pl, &s24)) == -1) {
+      goto err;
+    }
+    if (ret == 1) {
+      trinarkular_log("WARN: Duplicate /24 in binary probelist (%x)",
+                      recs[i].network_ip);
+    }
+  }
+
+  // the records have been indexed, the host and metadata pages will be read
+  // randomly from here on
+  madvise(base, map_len, MADV_RANDOM);
+
+  trinarkular_log("Mapped %d /24s (%" PRIu64 " metadata strings) from %s",
+                  pl->slash24s_cnt, hdr->md_str_cnt, filename);
+
+  return 0;
+
+err:
+  if (fd != -1) {
+    close(fd);
+  }
+  return -1;
+}
+
+/* ---------- WRITING ---------- */
+
+static int write_pad(FILE *fh, uint64_t *off)
+{
+  static const uint8_t zeros[8] = {0};
+  uint64_t pad = PL_BIN_ALIGN(*off) - *off;
+
+  if (pad > 0 && fwrite(zeros, 1, pad, fh) != pad) {
+    return -1;
+  }
+  *off += pad;
+  return 0;
+}
+
+static int write_raw(FILE *fh, uint64_t *off, const void *data, size_t len)
+{
+  if (len > 0 && fwrite(data, 1, len, fh) != len) {
+    return -1;
+  }
+  *off += len;
+  return 0;
+}
+
+int trinarkular_probelist_save_binary(trinarkular_probelist_t *pl,
+                                      const char *filename)
+{
+  pl_bin_hdr_t hdr;
+  int i;
+  trinarkular_slash24_t *s24;
+  char *tmpname = NULL;
+  FILE *fh = NULL;
+  uint64_t off = 0;
+  uint64_t md_refs_cnt = 0;
+  uint64_t hosts_len = 0;
+  uint32_t str_off;
+  uint32_t u32;
+  pl_bin_slash24_t rec;
+  int ret = -1;
+
+  assert(pl != NULL && filename != NULL);
+
+  if (pl->version == NULL) {
+    trinarkular_log("ERROR: Probelist has no version");
+    return -1;
+  }
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, PL_BIN_MAGIC, sizeof(PL_BIN_MAGIC));
+  hdr.format_version = PL_BIN_VERSION;
+  hdr.byte_order = PL_BIN_BYTE_ORDER;
+  hdr.slash24_cnt = pl->slash24s_cnt;
+
+  // first pass: size the sections (metadata is already interned, so the
+  // string table is written as-is and /24s refer to strings by metadata ID)
+  for (i = 0; i < pl->slash24s_cnt; i++) {
+    s24 = &pl->records[i];
+    assert(s24 != NULL);
+    hosts_len += s24->hosts_cnt;
+    md_refs_cnt += s24->md_cnt;
+  }
+  for (u32 = 0; u32 < pl->md_strs_cnt; u32++) {
+    hdr.md_str_len += strlen(pl->md_strs[u32]) + 1;
+  }
+  if (hosts_len > UINT32_MAX || md_refs_cnt > UINT32_MAX ||
+      hdr.md_str_len > UINT32_MAX) {
+    trinarkular_log("ERROR: Probelist too large for binary format");
+    goto done;
+  }
+  hdr.md_str_cnt = pl->md_strs_cnt;
+  hdr.hosts_len = hosts_len;
+  hdr.md_refs_cnt = md_refs_cnt;
+  hdr.version_len = strlen(pl->version) + 1;
+
+  // lay out the sections
+  off = PL_BIN_ALIGN(sizeof(hdr));
+  hdr.version_off = off;
+  off = PL_BIN_ALIGN(off + hdr.version_len);
+  hdr.slash24s_off = off;
+  off = PL_BIN_ALIGN(off + hdr.slash24_cnt * sizeof(pl_bin_slash24_t));
+  hdr.hosts_off = off;
+  off = PL_BIN_ALIGN(off + hdr.hosts_len);
+  hdr.md_refs_off = off;
+  off = PL_BIN_ALIGN(off + hdr.md_refs_cnt * sizeof(uint32_t));
+  hdr.md_str_idx_off = off;
+  off = PL_BIN_ALIGN(off + hdr.md_str_cnt * sizeof(uint32_t));
+  hdr.md_str_off = off;
+  hdr.file_size = off + hdr.md_str_len;
+
+  if ((tmpname = malloc(strlen(filename) + sizeof(".tmp"))) == NULL) {
+    goto done;
+  }
+  sprintf(tmpname, "%s.tmp", filename);
+  if ((fh = fopen(tmpname, "wb")) == NULL) {
+    trinarkular_log("ERROR: Could not open %s for writing (%s)", tmpname,
+                    strerror(errno));
+    goto done;
+  }
+
+  // second pass: write everything out in order
+  off = 0;
+  if (write_raw(fh, &off, &hdr, sizeof(hdr)) != 0 ||
+      write_pad(fh, &off) != 0 ||
+      write_raw(fh, &off, pl->version, hdr.version_len) != 0) {
+    goto io_err;
+  }
+
+  // /24 table
+  if (write_pad(fh, &off) != 0) {
+    goto io_err;
+  }
+  assert(off == hdr.slash24s_off);
+  hosts_len = 0;
+  md_refs_cnt = 0;
+  for (i = 0; i < pl->slash24s_cnt; i++) {
+    s24 = &pl->records[i];
+    memset(&rec, 0, sizeof(rec));
+    rec.network_ip = s24->network_ip;
+    rec.hosts_idx = hosts_len;
+    rec.hosts_cnt = s24->hosts_cnt;
+    rec.md_idx = md_refs_cnt;
+    rec.md_cnt = s24->md_cnt;
+    rec.aeb = s24->aeb;
+    if (write_raw(fh, &off, &rec, sizeof(rec)) != 0) {
+      goto io_err;
+    }
+    hosts_len += s24->hosts_cnt;
+    md_refs_cnt += s24->md_cnt;
+  }
+
+  // host bytes
+  if (write_pad(fh, &off) != 0) {
+    goto io_err;
+  }
+  assert(off == hdr.hosts_off);
+  for (i = 0; i < pl->slash24s_cnt; i++) {
+    s24 = &pl->records[i];
+    if (write_raw(fh, &off, s24->hosts, s24->hosts_cnt) != 0) {
+      goto io_err;
+    }
+  }
+
+  // metadata references
+  if (write_pad(fh, &off) != 0) {
+    goto io_err;
+  }
+  assert(off == hdr.md_refs_off);
+  for (i = 0; i < pl->slash24s_cnt; i++) {
+    s24 = &pl->records[i];
+    if (write_raw(fh, &off, s24->md, sizeof(uint32_t) * s24->md_cnt) != 0) {
+      goto io_err;
+    }
+  }
+
+  // metadata string offsets
+  if (write_pad(fh, &off) != 0) {
+    goto io_err;
+  }
+  assert(off == hdr.md_str_idx_off);
+  str_off = 0;
+  for (u32 = 0; u32 < pl->md_strs_cnt; u32++) {
+    if (write_raw(fh, &off, &str_off, sizeof(str_off)) != 0) {
+      goto io_err;
+    }
+    str_off += strlen(pl->md_strs[u32]) + 1;
+  }
+
+  // metadata strings
+  if (write_pad(fh, &off) != 0) {
+    goto io_err;
+  }
+  assert(off == hdr.md_str_off);
+  for (u32 = 0; u32 < pl->md_strs_cnt; u32++) {
+    if (write_raw(fh, &off, pl->md_strs[u32], strlen(pl->md_strs[u32]) + 1) !=
+        0) {
+      goto io_err;
+    }
+  }
+  assert(off == hdr.file_size);
+
+  if (fclose(fh) != 0) {
+    fh = NULL;
+    goto io_err;
+  }
+  fh = NULL;
+
+  if (rename(tmpname, filename) != 0) {
+    trinarkular_log("ERROR: Could not rename %s to %s (%s)", tmpname,
+                    filename, strerror(errno));
+    goto done;
+  }
+
+  trinarkular_log("Wrote %d /24s (%" PRIu32 " metadata strings) to %s",
+                  pl->slash24s_cnt, pl->md_strs_cnt, filename);
+  ret = 0;
+  goto done;
+
+io_err:
+  trinarkular_log("ERROR: Could not write to %s (%s)", tmpname,
+                  strerror(errno));
+  unlink(tmpname);
+
+done:
+  if (fh != NULL) {
+    fclose(fh);
+    unlink(tmpname);
+  }
+  free(tmpname);
+  return ret;
+}
@@ -0,0 +1,234 @@
+/*
+ * This file is part of trinarkular
+ *
+ * Copyright (C) 2015 The Regents of the University of California.
+ * Authors: Alistair King
+ *
+ * This software is Copyright (c) 2015 The Regents of the University of
+ * California. All Rights Reserved. Permission to copy, modify, and distribute this
+ * software and its documentation for academic research and education purposes,
+ * without fee, and without a written agreement is hereby granted, provided that
+ * the above copyright notice, this paragraph and the following three paragraphs
+ * appear in all copies. Permission to make use of this software for other than
+ * academic research and education purposes may be obtained by contacting:
+ *
+ * Office of Innovation and Commercialization
+ * 9500 Gilman Drive, Mail Code 0910
+ * University of California
+ * La Jolla, CA 92093-0910
+ * (858) 534-5815
+ * invent@ucsd.edu
+ *
+ * This software program and documentation are copyrighted by The Regents of the
+ * University of California. The software program and documentation are supplied
+ * "as is", without any accompanying services from The Regents. The Regents does
+ * not warrant that the operation of the program will be uninterrupted or
+ * error-free. The end-user understands that the program was developed for research
+ * purposes and is advised not to rely exclusively on the program for any reason.
+ *
+ * IN NO EVENT SHALL THE UNIVERSITY OF CALIFORNIA BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+ * PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF
+ * THE UNIVERSITY OF CALIFORNIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE. THE UNIVERSITY OF CALIFORNIA SPECIFICALLY DISCLAIMS ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS
+ * IS" BASIS, AND THE UNIVERSITY OF CALIFORNIA HAS NO OBLIGATIONS TO PROVIDE
+ * MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ * Report any bugs, questions or comments to alistair@caida.org
+ *
+ */
+
+#ifndef __TRINARKULAR_PROBELIST_INT_H
+#define __TRINARKULAR_PROBELIST_INT_H
+
+#include "trinarkular_probelist.h"
+#include "trinarkular_arena.h"
+#include "khash.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/** @file
+ *
+ * @brief Header file that exposes the private interface of the trinarkular
+ * probelist (shared between the probelist reader/writer implementations)
+ *
+ * @author Alistair King
+ *
+ */
+
+KHASH_INIT(strid, char *, uint32_t, 1, kh_str_hash_func, kh_str_hash_equal);
+
+/** Number of /24s in the IPv4 address space */
+#define SLASH24_SPACE_CNT (1 << 24)
+
+/** Number of words in the /24 index bitmap */
+#define SLASH24_IDX_CNT (SLASH24_SPACE_CNT / 64)
+
+/** Alignment of the per-/24 arrays (a cache line) */
+#define SLASH24_ARRAY_ALIGN 64
+
+/** One word of the /24 index: a bitmap of 64 consecutive /24s, and the number
+    of /24s in the probelist that come before them (i.e. the index of the record
+    of the first /24 set in the bitmap) */
+typedef struct trinarkular_slash24_idx {
+
+  /** Bitmap of /24s present in the probelist */
+  uint64_t bits;
+
+  /** Number of /24s present in all preceding words */
+  uint32_t rank;
+
+} trinarkular_slash24_idx_t;
+
+struct trinarkular_probelist {
+
+  /** Current probelist version */
+  char *version;
+
+  /** Indexes of the /24s in this probelist (in probing order) */
+  uint32_t *slash24s;
+
+  /** Number of /24s in this probelist */
+  int slash24s_cnt;
+
+  /** Number of /24s allocated (in all per-/24 arrays) */
+  int slash24s_alloc;
+
+  /** Index of the current /24 */
+  int slash24_iter;
+
+  // Per-/24 data is stored in parallel arrays (sorted by network IP once the
+  // index has been built) so that scans only touch the fields they need
+
+  /** /24s */
+  trinarkular_slash24_t *records;
+
+  /** Prober state of each /24 */
+  trinarkular_slash24_state_t *states;
+
+  /** Has state been initialized for each /24? */
+  uint8_t *states_set;
+
+  /** Index from network IP to /24 index (SLASH24_IDX_CNT words) */
+  trinarkular_slash24_idx_t *idx;
+
+  /** Arena that the metrics (timeseries key indices) of all /24 states are
+      allocated from */
+  trinarkular_arena_t *metrics_arena;
+
+  /** Arena that the host arrays of all (JSON) /24s are allocated from (along
+      with the metadata ID arrays of /24s added by a reload) */
+  trinarkular_arena_t *arena;
+
+  /** Arena that the metadata ID arrays and strings of all (JSON) /24s are
+      allocated from */
+  trinarkular_arena_t *md_arena;
+
+  /** Bytes of host and metadata ID arrays that are no longer used by any /24
+      (the arena is compacted once this is large enough) */
+  size_t arena_garbage;
+
+  /** Bytes of metrics arrays in the metrics arena that are no longer used by
+      any /24 state */
+  size_t metrics_garbage;
+
+  /** Interned metadata strings, indexed by metadata ID (strings belong to
+      md_arena or the mapping) */
+  char **md_strs;
+
+  /** Number of interned metadata strings */
+  uint32_t md_strs_cnt;
+
+  /** Number of metadata string pointers allocated */
+  uint32_t md_strs_alloc;
+
+  /** Hash mapping from metadata string to metadata ID */
+  khash_t(strid) * md_hash;
+
+  /** Base of the mapped binary probelist (NULL if loaded from JSON). When set,
+      the host and metadata arrays of each /24 point into this mapping and
+      must not be freed */
+  void *map_base;
+
+  /** Length of the mapped binary probelist */
+  size_t map_len;
+};
+
+/** Is the given file a compiled (binary) probelist?
+ *
+ * @param filename      name of the file to check
+ * @return 1 if the file starts with the binary probelist magic, 0 otherwise
+ */
+int trinarkular_probelist_bin_detect(const char *filename);
+
+/** Load a compiled (binary) probelist into the given (empty) probelist
+ *
+ * @param pl            pointer to the probelist to populate
+ * @param filename      name of the binary probelist file
+ * @return 0 if the probelist was loaded successfully, -1 otherwise
+ */
+int trinarkular_probelist_bin_read(trinarkular_probelist_t *pl,
+                                   const char *filename);
+
+/** Add a /24 to a probelist that is being built
+ *
+ * @param pl            pointer to the probelist
+ * @param s24           pointer to the /24 to add (copied)
+ * @return 0 if the /24 was added, 1 if it was already in the probelist, -1 if
+ * an error occurred
+ *
+ * The /24 cannot be found using trinarkular_probelist_get_slash24 until
+ * trinarkular_probelist_build_index has been called.
+ */
+int trinarkular_probelist_append_slash24(trinarkular_probelist_t *pl,
+                                         trinarkular_slash24_t *s24);
+
+/** Make room for the given number of /24s
+ *
+ * @param pl            pointer to the probelist
+ * @param cnt           total number of /24s the probelist will hold
+ * @return 0 if successful, -1 otherwise
+ */
+int trinarkular_probelist_reserve_slash24s(trinarkular_probelist_t *pl,
+                                           int cnt);
+
+/** Sort the /24 records and rebuild the index
+ *
+ * @param pl            pointer to the probelist
+ * @return 0 if successful, -1 otherwise
+ *
+ * /24s whose bit has been cleared from the index are dropped. This invalidates
+ * all /24 and state pointers. If an error occurs, the records and the index
+ * ranks are left unchanged.
+ */
+int trinarkular_probelist_build_index(trinarkular_probelist_t *pl);
+
+/** Intern the given metadata string
+ *
+ * @param pl            pointer to the probelist
+ * @param md            metadata string to intern
+ * @param[out] md_id    set to the ID of the metadata string
+ * @return 0 if the string was interned successfully, -1 otherwise
+ *
+ * The string is not copied, so it must live as long as the probelist (i.e. be
+ * allocated from the probelist md arena or be part of the mapping).
+ */
+int trinarkular_probelist_intern_md(trinarkular_probelist_t *pl, char *md,
+                                    uint32_t *md_id);
+
+/** Load a JSON probelist into the given (empty) probelist
+ *
+ * @param pl            pointer to the probelist to populate
+ * @param filename      name of the JSON probelist file
+ * @param thread_cnt    number of threads to parse /24 objects with
+ * @return 0 if the probelist was loaded successfully, -1 otherwise
+ *
+ * The file is scanned by the calling thread, and (if thread_cnt > 1) the /24
+ * objects are parsed in batches by a pool of worker threads.
+ */
+int trinarkular_probelist_json_read(trinarkular_probelist_t *pl,
+                                    const char *filename, int thread_cnt);
+
+#endif /* __TRINARKULAR_PROBELIST_INT_H */
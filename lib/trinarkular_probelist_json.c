@@ -0,0 +1,1136 @@
+/*
+ * This file is part of trinarkular
+ *
+ * Copyright (C) 2015 The Regents of the University of California.
+ * Authors: Alistair King
+ *
+ * This software is Copyright (c) 2015 The Regents of the University of
+ * California. All Rights Reserved. Permission to copy, modify, and distribute this
+ * software and its documentation for academic research and education purposes,
+ * without fee, and without a written agreement is hereby granted, provided that
+ * the above copyright notice, this paragraph and the following three paragraphs
+ * appear in all copies. Permission to make use of this software for other than
+ * academic research and education purposes may be obtained by contacting:
+ *
+ * Office of Innovation and Commercialization
+ * 9500 Gilman Drive, Mail Code 0910
+ * University of California
+ * La Jolla, CA 92093-0910
+ * (858) 534-5815
+ * invent@ucsd.edu
+ *
+ * This software program and documentation are copyrighted by The Regents of the
+ * University of California. The software program and documentation are supplied
+ * "as is", without any accompanying services from The Regents. The Regents does
+ * not warrant that the operation of the program will be uninterrupted or
+ * error-free. The end-user understands that the program was developed for research
+ * purposes and is advised not to rely exclusively on the program for any reason.
+ *
+ * IN NO EVENT SHALL THE UNIVERSITY OF CALIFORNIA BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+ * PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF
+ * THE UNIVERSITY OF CALIFORNIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE. THE UNIVERSITY OF CALIFORNIA SPECIFICALLY DISCLAIMS ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS
+ * IS" BASIS, AND THE UNIVERSITY OF CALIFORNIA HAS NO OBLIGATIONS TO PROVIDE
+ * MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ * Report any bugs, questions or comments to alistair@caida.org
+ *
+ */
+
+#include "trinarkular_probelist_int.h"
+#include "trinarkular.h"
+#include "trinarkular_log.h"
+#include "config.h"
+#include "utils.h"
+#include "wandio_utils.h"
+#include "jsmn_utils.h"
+#include <arpa/inet.h>
+#include <assert.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <wandio.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* The JSON probelist is a single object that maps each /24 string to a /24
+ * object. The loading thread reads the (decompressed) stream in large blocks
+ * and finds the boundaries of the top-level /24 objects by jumping between
+ * structural characters. Each block (together with the offsets of the
+ * complete objects it contains) becomes a batch, and only the trailing partial
+ * object is copied into the next block. A pool of worker threads tokenizes the
+ * batches and builds trinarkular_slash24_t records into per-thread buffers,
+ * which are then merged into the probelist once the whole file has been read.
+ */
+
+/** Size of each read from the input file (and so of each batch) */
+#define BLOCK_LEN (1024 * 1024)
+
+/** Number of batches that may be queued per worker */
+#define QUEUE_LEN_PER_THREAD 4
+
+/** A block of input containing complete /24 objects */
+typedef struct json_batch {
+
+  /** JSON text read from the file */
+  char *buf;
+
+  /** Number of bytes of buf that are complete objects */
+  size_t len;
+
+  /** Number of bytes of buf that have been read (len plus a partial object) */
+  size_t fill;
+
+  /** Number of bytes allocated for buf */
+  size_t alloc;
+
+  /** Offset of the start of each object in buf */
+  size_t *objs;
+
+  /** Number of objects in the batch */
+  int objs_cnt;
+
+  /** Number of object offsets allocated */
+  int objs_alloc;
+
+} json_batch_t;
+
+/** Per-worker parsing state */
+typedef struct json_worker {
+
+  /** Probelist version (as found by this worker) */
+  char *version;
+
+  /** /24s parsed by this worker */
+  trinarkular_slash24_t *slash24s;
+
+  /** Number of /24s parsed */
+  int slash24s_cnt;
+
+  /** Number of /24s allocated */
+  int slash24s_alloc;
+
+  /** Arena for host arrays (merged into the probelist arena) */
+  trinarkular_arena_t *arena;
+
+  /** Arena for metadata (merged into the probelist metadata arena) */
+  trinarkular_arena_t *md_arena;
+
+  /** Metadata strings interned by this worker, indexed by local metadata ID.
+      The /24s parsed by this worker use local IDs until they are merged */
+  char **md_strs;
+
+  /** Number of interned metadata strings */
+  uint32_t md_strs_cnt;
+
+  /** Number of metadata string pointers allocated */
+  uint32_t md_strs_alloc;
+
+  /** Hash mapping from metadata string to local metadata ID */
+  khash_t(strid) * md_hash;
+
+  /** Token buffer (reused between objects) */
+  jsmntok_t *toks;
+
+  /** Number of tokens allocated */
+  size_t toks_cnt;
+
+  /** Pointer back to the shared loader state */
+  struct json_loader *loader;
+
+  /** Worker thread */
+  pthread_t thread;
+
+} json_worker_t;
+
+/** Loader state shared between the scanner and the workers */
+typedef struct json_loader {
+
+  /** Protects all fields below */
+  pthread_mutex_t mutex;
+
+  /** Signalled when a batch is added to the queue, or loading ends */
+  pthread_cond_t not_empty;
+
+  /** Signalled when a batch is removed from the queue, or loading fails */
+  pthread_cond_t not_full;
+
+  /** Ring of queued batches */
+  json_batch_t **queue;
+
+  /** Size of the ring */
+  int queue_len;
+
+  /** Index of the next batch to dequeue */
+  int queue_head;
+
+  /** Number of batches in the queue */
+  int queue_cnt;
+
+  /** Set by the scanner once all batches have been queued */
+  int done;
+
+  /** Set by anyone that encounters an error */
+  int failed;
+
+} json_loader_t;
+
+/* ---------- PARSING ---------- */
+
+static int add_host(trinarkular_slash24_t *s24, uint32_t host_ip)
+{
+  assert((host_ip & TRINARKULAR_SLASH24_NETMASK) == s24->network_ip);
+
+  uint8_t host_byte = host_ip & TRINARKULAR_SLASH24_HOSTMASK;
+
+  // the hosts array was sized using the number of host objects
+  s24->hosts[s24->hosts_cnt++] = host_byte;
+
+  return 0;
+}
+
+static int intern_metadata(json_worker_t *wkr, char *md, uint32_t *md_id)
+{
+  khiter_t k;
+  int khret;
+
+  if ((k = kh_get(strid, wkr->md_hash, md)) != kh_end(wkr->md_hash)) {
+    *md_id = kh_val(wkr->md_hash, k);
+    return 0;
+  }
+
+  // first time this worker has seen this string, so copy it into the arena
+  if (wkr->md_strs_cnt == wkr->md_strs_alloc) {
+    wkr->md_strs_alloc =
+      (wkr->md_strs_alloc == 0) ? 1024 : wkr->md_strs_alloc * 2;
+    if ((wkr->md_strs = realloc(wkr->md_strs, sizeof(char *) *
+                                                wkr->md_strs_alloc)) == NULL) {
+      return -1;
+    }
+  }
+  if ((wkr->md_strs[wkr->md_strs_cnt] =
+         trinarkular_arena_strndup(wkr->md_arena, md, strlen(md))) == NULL) {
+    return -1;
+  }
+  k = kh_put(strid, wkr->md_hash, wkr->md_strs[wkr->md_strs_cnt], &khret);
+  if (khret == -1) {
+    return -1;
+  }
+  kh_val(wkr->md_hash, k) = wkr->md_strs_cnt;
+  *md_id = wkr->md_strs_cnt++;
+
+  return 0;
+}
+
+static int add_metadata(json_worker_t *wkr, trinarkular_slash24_t *s24,
+                        char *md)
+{
+  // 2019-12-19 AK: changed this from an assert to warning since we
+  // now have 2 /24s with >255 metas. They appear to be VPN networks
+  // or some such.
+  if (s24->md_cnt == UINT8_MAX) {
+    trinarkular_log("WARN: Dropping metadata for /24 (%x)", s24->network_ip);
+    return 0;
+  }
+
+  // the md array was sized using the number of metadata strings
+  if (intern_metadata(wkr, md, &s24->md[s24->md_cnt]) != 0) {
+    return -1;
+  }
+
+  // this is an 8bit field to save memory
+  assert(s24->md_cnt < UINT8_MAX);
+  s24->md_cnt++;
+
+  return 0;
+}
+
+static trinarkular_slash24_t *add_slash24(json_worker_t *wkr,
+                                          uint32_t network_ip)
+{
+  trinarkular_slash24_t *s24 = NULL;
+
+  assert((network_ip & TRINARKULAR_SLASH24_NETMASK) == network_ip);
+
+  if (wkr->slash24s_cnt == wkr->slash24s_alloc) {
+    wkr->slash24s_alloc =
+      (wkr->slash24s_alloc == 0) ? 1024 : wkr->slash24s_alloc * 2;
+    if ((wkr->slash24s =
+           realloc(wkr->slash24s, sizeof(trinarkular_slash24_t) *
+                                    wkr->slash24s_alloc)) == NULL) {
+      return NULL;
+    }
+  }
+
+  // init all the fields
+  s24 = &wkr->slash24s[wkr->slash24s_cnt++];
+
+  s24->network_ip = network_ip;
+  s24->hosts = NULL;
+  s24->hosts_cnt = 0;
+  s24->aeb = 0;
+  s24->md = NULL;
+  s24->md_cnt = 0;
+
+  return s24;
+}
+
+static jsmntok_t *process_json_host(trinarkular_slash24_t *s24, char *json,
+                                    jsmntok_t *t)
+{
+  int cnt = 0;
+  int i;
+  char host_str[INET_ADDRSTRLEN];
+  uint32_t host_ip;
+  int host_ip_set = 0;
+
+  jsmn_type_assert(t, JSMN_OBJECT);
+  cnt = t->size;
+  JSMN_NEXT(t);
+
+  for (i = 0; i < cnt; i++) {
+    // key
+    jsmn_type_assert(t, JSMN_STRING);
+    if (jsmn_streq(json, t, "host_ip")) {
+      JSMN_NEXT(t);
+      jsmn_type_assert(t, JSMN_STRING);
+      if (t->end - t->start >= INET_ADDRSTRLEN) {
+        trinarkular_log("ERROR: Malformed host IP: %.*s", t->end - t->start,
+                        json + t->start);
+        goto err;
+      }
+      jsmn_strcpy(host_str, t, json);
+      inet_pton(AF_INET, host_str, &host_ip);
+      host_ip = ntohl(host_ip);
+      host_ip_set = 1;
+      JSMN_NEXT(t);
+    } else if (jsmn_streq(json, t, "e_b")) {
+      JSMN_NEXT(t);
+      jsmn_type_assert(t, JSMN_PRIMITIVE);
+      // ignore response rate field
+      JSMN_NEXT(t);
+    } else {
+      // ignore all other fields
+      JSMN_NEXT(t);
+      // skip the value
+      t = jsmn_skip(t);
+    }
+  }
+
+  if (host_ip_set == 0) {
+    trinarkular_log("ERROR: Missing field in host object");
+    goto err;
+  }
+
+  if (add_host(s24, host_ip) != 0) {
+    trinarkular_log("ERROR: Could not add host to /24 (%s)", host_str);
+    goto err;
+  }
+
+  return t;
+
+err:
+  return NULL;
+}
+
+static jsmntok_t *process_json_slash24(json_worker_t *wkr, char *s24_str,
+                                       char *json, jsmntok_t *root_tok)
+{
+  jsmntok_t *t = root_tok + 1;
+  int i, j;
+
+  char *tmp;
+  trinarkular_slash24_t *s24 = NULL;
+  uint32_t network_ip = 0;
+
+  char str_tmp[1024];
+
+  unsigned long host_cnt = 0;
+  int host_cnt_set = 0;
+
+  double avg_resp_rate = 0;
+  int avg_resp_rate_set = 0;
+
+  int meta_cnt = 0;
+  int meta_set = 0;
+
+  int host_arr_cnt = 0;
+
+  // first, add the /24 so that as we parse we can update it directly
+
+  // parse the /24 string into a network ip
+  if ((tmp = strchr(s24_str, '/')) == NULL) {
+    trinarkular_log("ERROR: Malformed /24 string: %s", s24_str);
+    goto err;
+  }
+  *tmp = '\0';
+  inet_pton(AF_INET, s24_str, &network_ip);
+  network_ip = ntohl(network_ip);
+
+  // add to the worker's /24 buffer
+  if ((s24 = add_slash24(wkr, network_ip)) == NULL) {
+    goto err;
+  }
+
+  // iterate over children of the /24 object
+  for (i = 0; i < root_tok->size; i++) {
+    // all keys must be strings
+    if (t->type != JSMN_STRING) {
+      fprintf(stderr, "ERROR: Encountered non-string key: '%.*s'\n",
+              t->end - t->start, json + t->start);
+      goto err;
+    }
+
+    // version
+    if (jsmn_streq(json, t, "version")) {
+      JSMN_NEXT(t);
+      jsmn_type_assert(t, JSMN_STRING);
+      if (wkr->version == NULL) { // assume all version strings are the same
+        if (t->end - t->start >= sizeof(str_tmp)) {
+          trinarkular_log("ERROR: Version string too long");
+          goto err;
+        }
+        jsmn_strcpy(str_tmp, t, json);
+        wkr->version = strdup(str_tmp);
+        assert(wkr->version != NULL);
+      }
+      JSMN_NEXT(t);
+
+      // host cnt
+    } else if (jsmn_streq(json, t, "host_cnt")) {
+      JSMN_NEXT(t);
+      jsmn_type_assert(t, JSMN_PRIMITIVE);
+      if (jsmn_strtoul(&host_cnt, json, t) != 0) {
+        trinarkular_log("ERROR: Could not parse host count");
+        goto err;
+      }
+      host_cnt_set = 1;
+      JSMN_NEXT(t);
+
+      // avg resp rate
+    } else if (jsmn_streq(json, t, "avg_resp_rate")) {
+      JSMN_NEXT(t);
+      jsmn_type_assert(t, JSMN_PRIMITIVE);
+      if (jsmn_strtod(&avg_resp_rate, json, t) != 0) {
+        trinarkular_log("ERROR: Could not parse avg resp rate");
+        goto err;
+      }
+      s24->aeb = avg_resp_rate;
+      avg_resp_rate_set = 1;
+      JSMN_NEXT(t);
+
+      // meta
+    } else if (jsmn_streq(json, t, "meta")) {
+      JSMN_NEXT(t);
+      jsmn_type_assert(t, JSMN_ARRAY);
+      meta_cnt = t->size; // number of meta strings
+      if (meta_set != 0) {
+        trinarkular_log("ERROR: Duplicate meta field in /24 record");
+        goto err;
+      }
+      if (meta_cnt > 0 &&
+          (s24->md = trinarkular_arena_alloc(
+             wkr->md_arena, sizeof(uint32_t) * ((meta_cnt < UINT8_MAX)
+                                                ? meta_cnt
+                                                : UINT8_MAX))) == NULL) {
+        trinarkular_log("ERROR: Could not allocate metadata");
+        goto err;
+      }
+      JSMN_NEXT(t);
+      for (j = 0; j < meta_cnt; j++) {
+        jsmn_type_assert(t, JSMN_STRING);
+        if (t->end - t->start >= sizeof(str_tmp)) {
+          trinarkular_log("ERROR: Metadata string too long");
+          goto err;
+        }
+        jsmn_strcpy(str_tmp, t, json);
+        if (add_metadata(wkr, s24, str_tmp) != 0) {
+          goto err;
+        }
+        JSMN_NEXT(t);
+      }
+      meta_set = 1;
+
+    } else if (jsmn_streq(json, t, "hosts")) {
+      JSMN_NEXT(t);
+      jsmn_type_assert(t, JSMN_ARRAY);
+      if (s24->hosts != NULL) {
+        trinarkular_log("ERROR: Duplicate hosts field in /24 record");
+        goto err;
+      }
+      host_arr_cnt = t->size; // number of host objects
+      if (host_arr_cnt > 0 &&
+          (s24->hosts = trinarkular_arena_alloc(
+             wkr->arena, sizeof(uint8_t) * host_arr_cnt)) == NULL) {
+        trinarkular_log("ERROR: Could not allocate hosts");
+        goto err;
+      }
+      JSMN_NEXT(t);
+      for (j = 0; j < host_arr_cnt; j++) {
+        if ((t = process_json_host(s24, json, t)) == NULL) {
+          goto err;
+        }
+      }
+
+      // now randomize the ordering
+      array_shuffle_fy(uint8_t, s24->hosts, s24->hosts_cnt);
+
+      // unknown key
+    } else {
+      trinarkular_log("WARN: Unrecognized key: %.*s", t->end - t->start,
+                      json + t->start);
+      JSMN_NEXT(t);
+      t = jsmn_skip(t);
+    }
+  }
+
+  if (wkr->version == NULL || host_cnt_set == 0 || avg_resp_rate_set == 0 ||
+      meta_set == 0 || host_arr_cnt == 0) {
+    trinarkular_log("ERROR: Missing field in /24 record");
+    goto err;
+  }
+
+  // final sanity check
+  assert(host_arr_cnt == host_cnt);
+
+  return t;
+
+err:
+  return NULL;
+}
+
+// This will eventually be used to parse a blob from redis, with some
+// modifications (like not parsing the /24 key)
+static int process_json(json_worker_t *wkr, char *js, int jslen)
+{
+  int ret;
+
+  jsmn_parser p;
+  jsmntok_t *t = NULL;
+
+  char s24_str[INET_ADDRSTRLEN + 3];
+
+  if (jslen == 0) {
+    trinarkular_log("ERROR: Empty JSON");
+    return 0;
+  }
+
+  // prepare parser
+  jsmn_init(&p);
+
+again:
+  if ((ret = jsmn_parse(&p, js, jslen, wkr->toks, wkr->toks_cnt)) < 0) {
+    if (ret == JSMN_ERROR_NOMEM) {
+      wkr->toks_cnt *= 2;
+      if ((wkr->toks = realloc(wkr->toks, sizeof(jsmntok_t) *
+                                            wkr->toks_cnt)) == NULL) {
+        trinarkular_log("ERROR: Could not realloc tokens");
+        goto err;
+      }
+      goto again;
+    }
+    if (ret == JSMN_ERROR_INVAL) {
+      trinarkular_log("ERROR: Invalid character in JSON string");
+      goto err;
+    }
+    trinarkular_log("ERROR: JSON parser returned %d", ret);
+    goto err;
+  }
+
+  t = wkr->toks;
+
+  if (t->type != JSMN_STRING || t->end - t->start >= sizeof(s24_str)) {
+    trinarkular_log("ERROR: Malformed /24 object\n");
+    trinarkular_log("INFO: JSON: %.*s\n", jslen, js);
+    goto err;
+  }
+  jsmn_strcpy(s24_str, t, js);
+  // move to the value
+  JSMN_NEXT(t);
+
+  if ((t = process_json_slash24(wkr, s24_str, js, t)) == NULL) {
+    goto err;
+  }
+
+  return 0;
+
+err:
+  trinarkular_log("ERROR: Invalid JSON probelist");
+  return -1;
+}
+
+static int process_batch(json_worker_t *wkr, json_batch_t *batch)
+{
+  int i;
+  size_t end;
+
+  for (i = 0; i < batch->objs_cnt; i++) {
+    end = (i + 1 < batch->objs_cnt) ? batch->objs[i + 1] : batch->len;
+    if (process_json(wkr, batch->buf + batch->objs[i],
+                     end - batch->objs[i]) != 0) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/* ---------- BATCHES ---------- */
+
+/** Create a batch, seeded with the given partial object */
+static json_batch_t *batch_create(const char *carry, size_t carry_len)
+{
+  json_batch_t *batch;
+
+  if ((batch = malloc_zero(sizeof(json_batch_t))) == NULL) {
+    return NULL;
+  }
+  batch->alloc = BLOCK_LEN;
+  while (batch->alloc < carry_len + BLOCK_LEN) {
+    batch->alloc *= 2;
+  }
+  if ((batch->buf = malloc(batch->alloc)) == NULL) {
+    free(batch);
+    return NULL;
+  }
+  if (carry_len > 0) {
+    memcpy(batch->buf, carry, carry_len);
+  }
+  batch->fill = carry_len;
+  return batch;
+}
+
+static void batch_destroy(json_batch_t *batch)
+{
+  if (batch == NULL) {
+    return;
+  }
+  free(batch->buf);
+  free(batch->objs);
+  free(batch);
+}
+
+/** Record a complete object that ends at the given offset */
+static int batch_add_obj(json_batch_t *batch, size_t end)
+{
+  if (batch->objs_cnt == batch->objs_alloc) {
+    batch->objs_alloc = (batch->objs_alloc == 0) ? 1024 : batch->objs_alloc * 2;
+    if ((batch->objs = realloc(batch->objs, sizeof(size_t) *
+                                              batch->objs_alloc)) == NULL) {
+      return -1;
+    }
+  }
+  // objects are contiguous, so each starts where the last one ended
+  batch->objs[batch->objs_cnt++] = batch->len;
+  batch->len = end;
+  return 0;
+}
+
+/* ---------- WORKERS ---------- */
+
+static void worker_free(json_worker_t *wkr)
+{
+
+  free(wkr->version);
+  wkr->version = NULL;
+
+  // hosts and metadata that were not merged into the probelist are freed
+  // along with the arenas
+  free(wkr->slash24s);
+  wkr->slash24s = NULL;
+  wkr->slash24s_cnt = 0;
+
+  if (wkr->md_hash != NULL) {
+    kh_destroy(strid, wkr->md_hash);
+    wkr->md_hash = NULL;
+  }
+  free(wkr->md_strs);
+  wkr->md_strs = NULL;
+
+  trinarkular_arena_destroy(wkr->arena);
+  wkr->arena = NULL;
+  trinarkular_arena_destroy(wkr->md_arena);
+  wkr->md_arena = NULL;
+
+  free(wkr->toks);
+  wkr->toks = NULL;
+}
+
+static void *worker_run(void *arg)
+{
+  json_worker_t *wkr = (json_worker_t *)arg;
+  json_loader_t *ldr = wkr->loader;
+  json_batch_t *batch;
+
+  while (1) {
+    pthread_mutex_lock(&ldr->mutex);
+    while (ldr->queue_cnt == 0 && ldr->done == 0 && ldr->failed == 0) {
+      pthread_cond_wait(&ldr->not_empty, &ldr->mutex);
+    }
+    if (ldr->failed != 0 || ldr->queue_cnt == 0) {
+      // either something went wrong, or there is no more work
+      pthread_mutex_unlock(&ldr->mutex);
+      break;
+    }
+    batch = ldr->queue[ldr->queue_head];
+    ldr->queue_head = (ldr->queue_head + 1) % ldr->queue_len;
+    ldr->queue_cnt--;
+    pthread_cond_signal(&ldr->not_full);
+    pthread_mutex_unlock(&ldr->mutex);
+
+    if (process_batch(wkr, batch) != 0) {
+      pthread_mutex_lock(&ldr->mutex);
+      ldr->failed = 1;
+      pthread_cond_broadcast(&ldr->not_full);
+      pthread_cond_broadcast(&ldr->not_empty);
+      pthread_mutex_unlock(&ldr->mutex);
+    }
+    batch_destroy(batch);
+  }
+
+  return NULL;
+}
+
+/** Hand a batch to the workers (or process it directly if there are none)
+ *
+ * Takes ownership of the batch
+ */
+static int dispatch_batch(json_loader_t *ldr, json_worker_t *workers,
+                          int workers_cnt, json_batch_t *batch)
+{
+  int ret = 0;
+
+  if (batch->objs_cnt == 0) {
+    batch_destroy(batch);
+    return 0;
+  }
+
+  if (workers_cnt == 1) {
+    ret = process_batch(&workers[0], batch);
+    batch_destroy(batch);
+    return ret;
+  }
+
+  pthread_mutex_lock(&ldr->mutex);
+  while (ldr->queue_cnt == ldr->queue_len && ldr->failed == 0) {
+    pthread_cond_wait(&ldr->not_full, &ldr->mutex);
+  }
+  if (ldr->failed != 0) {
+    pthread_mutex_unlock(&ldr->mutex);
+    batch_destroy(batch);
+    return -1;
+  }
+  ldr->queue[(ldr->queue_head + ldr->queue_cnt) % ldr->queue_len] = batch;
+  ldr->queue_cnt++;
+  pthread_cond_signal(&ldr->not_empty);
+  pthread_mutex_unlock(&ldr->mutex);
+
+  return 0;
+}
+
+/* ---------- SCANNER ---------- */
+
+/** Find the next character that is structural outside of a string ('{', '}'
+ * or '"'), or end if there is none */
+static char *find_struct(char *p, char *end)
+{
+#ifdef __SSE2__
+  const __m128i ob = _mm_set1_epi8('{');
+  const __m128i cb = _mm_set1_epi8('}');
+  const __m128i qt = _mm_set1_epi8('"');
+  __m128i v;
+  int mask;
+
+  for (; p + 16 <= end; p += 16) {
+    v = _mm_loadu_si128((const __m128i *)p);
+    mask = _mm_movemask_epi8(_mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(v, ob), _mm_cmpeq_epi8(v, cb)),
+      _mm_cmpeq_epi8(v, qt)));
+    if (mask != 0) {
+      return p + __builtin_ctz(mask);
+    }
+  }
+#endif
+  for (; p < end; p++) {
+    if (*p == '{' || *p == '}' || *p == '"') {
+      break;
+    }
+  }
+  return p;
+}
+
+/** Find the next character that is structural inside a string ('"' or '\'),
+ * or end if there is none */
+static char *find_str_struct(char *p, char *end)
+{
+#ifdef __SSE2__
+  const __m128i qt = _mm_set1_epi8('"');
+  const __m128i bs = _mm_set1_epi8('\\');
+  __m128i v;
+  int mask;
+
+  for (; p + 16 <= end; p += 16) {
+    v = _mm_loadu_si128((const __m128i *)p);
+    mask = _mm_movemask_epi8(
+      _mm_or_si128(_mm_cmpeq_epi8(v, qt), _mm_cmpeq_epi8(v, bs)));
+    if (mask != 0) {
+      return p + __builtin_ctz(mask);
+    }
+  }
+#endif
+  for (; p < end; p++) {
+    if (*p == '"' || *p == '\\') {
+      break;
+    }
+  }
+  return p;
+}
+
+static int scan_file(json_loader_t *ldr, json_worker_t *workers,
+                     int workers_cnt, const char *filename)
+{
+  io_t *infile = NULL;
+
+  int64_t ret = 0;
+  json_batch_t *batch = NULL;
+  json_batch_t *next = NULL;
+  char *p;
+  char *end;
+
+  enum {
+    OUTER_OPEN,
+    S24,
+    DONE,
+  } state = OUTER_OPEN;
+  // nesting depth within the current /24 object
+  int depth = 0;
+  // are we inside a string?
+  int in_str = 0;
+  // offset in the current batch that scanning should resume from
+  size_t scan = 0;
+
+  if ((infile = wandio_create(filename)) == NULL) {
+    trinarkular_log("ERROR: Could not open %s for reading\n", filename);
+    goto err;
+  }
+
+  if ((batch = batch_create(NULL, 0)) == NULL) {
+    trinarkular_log("ERROR: Could not allocate JSON batch\n");
+    goto err;
+  }
+
+  while (state != DONE) {
+    // make room for a full block (this only grows the buffer if a single
+    // object is larger than a block)
+    if (batch->alloc - batch->fill < BLOCK_LEN) {
+      batch->alloc *= 2;
+      if ((batch->buf = realloc(batch->buf, batch->alloc)) == NULL) {
+        trinarkular_log("ERROR: Could not reallocate JSON batch\n");
+        goto err;
+      }
+    }
+    if ((ret = wandio_read(infile, batch->buf + batch->fill, BLOCK_LEN)) <=
+        0) {
+      break;
+    }
+    batch->fill += ret;
+
+    p = batch->buf + scan;
+    end = batch->buf + batch->fill;
+
+    while (p < end && state != DONE) {
+      if (state == OUTER_OPEN) {
+        // skip chars until we find '{'
+        if ((p = memchr(p, '{', end - p)) == NULL) {
+          p = end;
+          break;
+        }
+        state = S24;
+        p++;
+        // the first object starts just after the outer '{'
+        batch->len = p - batch->buf;
+        continue;
+      }
+
+      if (in_str != 0) {
+        if ((p = find_str_struct(p, end)) == end) {
+          break;
+        }
+        if (*p == '\\') {
+          // skip the escaped char (once we have it)
+          if (p + 1 == end) {
+            break;
+          }
+          p += 2;
+          continue;
+        }
+        in_str = 0;
+        p++;
+        continue;
+      }
+
+      if ((p = find_struct(p, end)) == end) {
+        break;
+      }
+      switch (*p) {
+      case '"':
+        in_str = 1;
+        break;
+
+      case '{':
+        depth++;
+        break;
+
+      case '}':
+        if (depth == 0) {
+          // a '}' before any '{' means the json is over
+          state = DONE;
+          break;
+        }
+        if (--depth == 0 &&
+            batch_add_obj(batch, p + 1 - batch->buf) != 0) {
+          trinarkular_log("ERROR: Could not grow JSON batch\n");
+          goto err;
+        }
+        break;
+      }
+      p++;
+    }
+    scan = p - batch->buf;
+
+    if (state == OUTER_OPEN) {
+      // nothing of interest yet, so don't bother keeping what we've read
+      batch->fill = 0;
+      scan = 0;
+      continue;
+    }
+
+    if (state != DONE && batch->len >= BLOCK_LEN) {
+      // hand this block off to /24 processing, and carry the partial object
+      // over to the next one
+      if ((next = batch_create(batch->buf + batch->len,
+                               batch->fill - batch->len)) == NULL) {
+        trinarkular_log("ERROR: Could not allocate JSON batch\n");
+        goto err;
+      }
+      scan -= batch->len;
+      if (dispatch_batch(ldr, workers, workers_cnt, batch) != 0) {
+        batch = next;
+        goto err;
+      }
+      batch = next;
+      next = NULL;
+    }
+  }
+  if (ret < 0) {
+    trinarkular_log("WARN: Reading from JSON file failed");
+    trinarkular_log("WARN: Probelist may be incomplete");
+  } else if (state != DONE) {
+    trinarkular_log("WARN: JSON probelist ended unexpectedly");
+    trinarkular_log("WARN: Probelist may be incomplete");
+  }
+
+  // anything after the last complete object is dropped
+  if (dispatch_batch(ldr, workers, workers_cnt, batch) != 0) {
+    batch = NULL;
+    goto err;
+  }
+  wandio_destroy(infile);
+  return 0;
+
+err:
+  batch_destroy(batch);
+  if (infile != NULL) {
+    wandio_destroy(infile);
+  }
+  return -1;
+}
+
+/* ---------- MERGING ---------- */
+
+/** Intern the worker's metadata into the probelist, and translate the local
+ * metadata IDs of its /24s into probelist metadata IDs */
+static int merge_worker_metadata(trinarkular_probelist_t *pl,
+                                 json_worker_t *wkr)
+{
+  uint32_t *remap = NULL;
+  uint32_t i;
+  int j, k;
+  trinarkular_slash24_t *s24;
+
+  if (wkr->md_strs_cnt == 0) {
+    return 0;
+  }
+  if ((remap = malloc(sizeof(uint32_t) * wkr->md_strs_cnt)) == NULL) {
+    trinarkular_log("ERROR: Could not allocate metadata ID map");
+    return -1;
+  }
+  for (i = 0; i < wkr->md_strs_cnt; i++) {
+    if (trinarkular_probelist_intern_md(pl, wkr->md_strs[i], &remap[i]) != 0) {
+      free(remap);
+      return -1;
+    }
+  }
+  for (j = 0; j < wkr->slash24s_cnt; j++) {
+    s24 = &wkr->slash24s[j];
+    for (k = 0; k < s24->md_cnt; k++) {
+      s24->md[k] = remap[s24->md[k]];
+    }
+  }
+
+  free(remap);
+  return 0;
+}
+
+static int merge_workers(trinarkular_probelist_t *pl, json_worker_t *workers,
+                         int workers_cnt)
+{
+  int i, j;
+  int total = 0;
+  int ret;
+  trinarkular_slash24_t *s24;
+
+  for (i = 0; i < workers_cnt; i++) {
+    if (merge_worker_metadata(pl, &workers[i]) != 0) {
+      return -1;
+    }
+    total += workers[i].slash24s_cnt;
+    if (pl->version == NULL && workers[i].version != NULL) {
+      pl->version = workers[i].version;
+      workers[i].version = NULL;
+    }
+    // the probelist takes ownership of all host and metadata memory
+    trinarkular_arena_merge(pl->arena, workers[i].arena);
+    trinarkular_arena_merge(pl->md_arena, workers[i].md_arena);
+  }
+
+  if (total == 0) {
+    return 0;
+  }
+
+  // size the record array up front so that it never needs to grow
+  if (trinarkular_probelist_reserve_slash24s(pl, total) != 0) {
+    return -1;
+  }
+
+  for (i = 0; i < workers_cnt; i++) {
+    for (j = 0; j < workers[i].slash24s_cnt; j++) {
+      s24 = &workers[i].slash24s[j];
+      if ((ret = trinarkular_probelist_append_slash24(pl, s24)) == -1) {
+        return -1;
+      }
+      if (ret == 1) {
+        // the first copy wins (the duplicate's memory stays in the arena)
+        trinarkular_log("WARN: Duplicate /24 in probelist (%x)",
+                        s24->network_ip);
+      }
+    }
+  }
+
+  return 0;
+}
+
+/* ---------- PUBLIC (INTERNAL) FUNCTIONS ---------- */
+
+int trinarkular_probelist_json_read(trinarkular_probelist_t *pl,
+                                    const char *filename, int thread_cnt)
+{
+  json_loader_t ldr;
+  json_worker_t *workers = NULL;
+  int workers_cnt = (thread_cnt < 1) ? 1 : thread_cnt;
+  int started = 0;
+  int ret = -1;
+  int i;
+
+  // just be sure we're reading into a clean probelist
+  assert(pl->version == NULL && trinarkular_probelist_get_slash24_cnt(pl) == 0);
+
+  memset(&ldr, 0, sizeof(ldr));
+  pthread_mutex_init(&ldr.mutex, NULL);
+  pthread_cond_init(&ldr.not_empty, NULL);
+  pthread_cond_init(&ldr.not_full, NULL);
+  ldr.queue_len = workers_cnt * QUEUE_LEN_PER_THREAD;
+  if ((ldr.queue = malloc(sizeof(json_batch_t *) * ldr.queue_len)) == NULL) {
+    goto done;
+  }
+
+  if ((workers = malloc_zero(sizeof(json_worker_t) * workers_cnt)) == NULL) {
+    goto done;
+  }
+  for (i = 0; i < workers_cnt; i++) {
+    workers[i].loader = &ldr;
+    if ((workers[i].arena = trinarkular_arena_create(0)) == NULL ||
+        (workers[i].md_arena = trinarkular_arena_create(0)) == NULL ||
+        (workers[i].md_hash = kh_init(strid)) == NULL) {
+      trinarkular_log("ERROR: Could not create parser arenas");
+      goto done;
+    }
+    workers[i].toks_cnt = 128;
+    if ((workers[i].toks = malloc(sizeof(jsmntok_t) * workers[i].toks_cnt)) ==
+        NULL) {
+      trinarkular_log("ERROR: Could not malloc initial tokens");
+      goto done;
+    }
+  }
+
+  // with a single thread, batches are parsed inline by the scanner
+  if (workers_cnt > 1) {
+    trinarkular_log("Parsing probelist using %d threads", workers_cnt);
+    for (started = 0; started < workers_cnt; started++) {
+      if (pthread_create(&workers[started].thread, NULL, worker_run,
+                         &workers[started]) != 0) {
+        trinarkular_log("ERROR: Could not start probelist parser thread");
+        ldr.failed = 1;
+        break;
+      }
+    }
+  }
+
+  if (ldr.failed == 0 && scan_file(&ldr, workers, workers_cnt, filename) != 0) {
+    pthread_mutex_lock(&ldr.mutex);
+    ldr.failed = 1;
+    pthread_mutex_unlock(&ldr.mutex);
+  }
+
+  // tell the workers that there are no more batches coming
+  pthread_mutex_lock(&ldr.mutex);
+  ldr.done = 1;
+  pthread_cond_broadcast(&ldr.not_empty);
+  pthread_mutex_unlock(&ldr.mutex);
+  for (i = 0; i < started; i++) {
+    pthread_join(workers[i].thread, NULL);
+  }
+
+  if (ldr.failed != 0) {
+    goto done;
+  }
+
+  if (merge_workers(pl, workers, workers_cnt) != 0) {
+    goto done;
+  }
+
+  ret = 0;
+
+done:
+  // anything left in the queue was abandoned by the workers
+  for (i = 0; i < ldr.queue_cnt; i++) {
+    batch_destroy(ldr.queue[(ldr.queue_head + i) % ldr.queue_len]);
+  }
+  free(ldr.queue);
+  if (workers != NULL) {
+    for (i = 0; i < workers_cnt; i++) {
+      worker_free(&workers[i]);
+    }
+    free(workers);
+  }
+  pthread_cond_destroy(&ldr.not_full);
+  pthread_cond_destroy(&ldr.not_empty);
+  pthread_mutex_destroy(&ldr.mutex);
+  return ret;
+}
@@ -47,6 +47,7 @@
 #include "trinarkular_log.h"
 #include "trinarkular_probelist.h"
 #include "trinarkular_signal.h"
+#include "trinarkular_timer_wheel.h"
 #include "config.h"
 #include "khash.h"
 #include "utils.h"
@@ -80,7 +81,16 @@
 // metric prefix for prober metadata
 #define METRIC_PREFIX_PROBER METRIC_PREFIX ".probers"
 
-#define CH_SLASH24 "__PFX_%s_24"
+#define CH_SLASH24_PREFIX "__PFX_"
+#define CH_SLASH24_SUFFIX "_24"
+
+// per-/24 key suffixes
+#define SLASH24_KEY_BELIEF CH_SLASH24_SUFFIX ".belief"
+#define SLASH24_KEY_STATE  CH_SLASH24_SUFFIX ".state"
+
+/** Maximum length of the variable part of a per-/24 key (a-b-c-d) plus the
+    longest suffix */
+#define SLASH24_KEY_VAR_MAX (15 + sizeof(SLASH24_KEY_BELIEF) - 1)
 
 // used to coordinate between main thread and probelist reload thread
 #define PROBELIST_RELOAD_NONE      0
@@ -107,6 +117,29 @@ static char *probe_types[] = {
   "recovery", // 3 => RECOVERY
 };
 
+/** Classes of probes whose rates are controlled separately */
+enum {
+  CTL_PERIODIC = 0, // PERIODIC probes
+  CTL_FOLLOWUP = 1, // ADAPTIVE and RECOVERY probes
+  CTL_CLASS_CNT = 2
+};
+
+static char *ctl_classes[] = {
+  "periodic", // 0 => CTL_PERIODIC
+  "followup", // 1 => CTL_FOLLOWUP
+};
+
+/** The factor that the window of each class is cut by under backpressure.
+    Periodic probes can simply wait for a later slice, but deferring adaptive
+    and recovery probes delays convergence, so they are cut more gently */
+static float ctl_decrease[] = {
+  0.5,  // 0 => CTL_PERIODIC
+  0.75, // 1 => CTL_FOLLOWUP
+};
+
+#define CTL_CLASS(probe_type)                                                  \
+  ((probe_type) == PERIODIC ? CTL_PERIODIC : CTL_FOLLOWUP)
+
 /** Possible bayesian inference states for a /24 */
 enum { UNCERTAIN = 0, DOWN = 1, UP = 2, BELIEF_STATE_CNT = 3 };
 
@@ -173,6 +206,61 @@ struct metrics {
 
   /** Value is the number of /24s that we are probing */
   int slash24_cnt;
+
+  /** Value is the peak number of outstanding probes in the round */
+  int outstanding_peak;
+
+  /** Value is the number of probes that timed out in the round */
+  int expired_probe_cnt;
+
+  /** Values are the probing windows (of each class) at the end of the round */
+  int ctl_window[CTL_CLASS_CNT];
+
+  /** Values are the number of times each window was cut in the round */
+  int ctl_decrease_cnt[CTL_CLASS_CNT];
+
+  /** Values are the number of probes of each class deferred in the round */
+  int ctl_deferred_cnt[CTL_CLASS_CNT];
+
+  /** Value is the number of /24s that were not periodically probed in the
+      round */
+  int unprobed_cnt;
+
+  /** Value is the peak driver queue depth in the round */
+  int queue_depth_peak;
+
+  /** Value is the peak driver response latency in the round */
+  int latency_peak;
+
+  /** Value is the duration of the last completed flush */
+  int flush_duration;
+
+  /** Value is how long the previous flush had been running when the round
+      ended (0 if it had completed) */
+  int flush_backlog;
+
+  /** Value is the number of flushes that have failed */
+  int flush_failed_cnt;
+
+  /** Value is the number of rounds that were not flushed because the
+      previous flush was still running */
+  int flush_skipped_cnt;
+
+  /** Value is the number of per-/24 values written in the round (-1 unless
+      delta emission is enabled) */
+  int flush_emitted_cnt;
+
+  /** Value is the number of unchanged per-/24 values that were not written
+      in the round (-1 unless delta emission is enabled) */
+  int flush_suppressed_cnt;
+
+  /** Value is the number of transition events that have been published (-1
+      unless events are enabled) */
+  int events_published_cnt;
+
+  /** Value is the number of transition events that have been dropped (-1
+      unless events are enabled) */
+  int events_dropped_cnt;
 };
 
 /** Max number of rounds that are currently being tracked. Most of the time this
@@ -199,14 +287,358 @@ typedef struct probing_stats {
   /** The number of /24s that we are probing */
   uint32_t slash24_cnt;
 
+  /** The sum of the peak number of probes outstanding in each worker */
+  uint64_t outstanding_peak;
+
+  /** The number of probes that timed out this round */
+  uint32_t expired_probe_cnt;
+
+  /** The sum of the probing windows (of each class) of the workers */
+  uint64_t ctl_window[CTL_CLASS_CNT];
+
+  /** The number of times the windows were cut this round */
+  uint32_t ctl_decrease_cnt[CTL_CLASS_CNT];
+
+  /** The number of probes of each class deferred this round */
+  uint32_t ctl_deferred_cnt[CTL_CLASS_CNT];
+
+  /** The number of /24s that were not periodically probed this round */
+  uint32_t unprobed_cnt;
+
+  /** The largest number of probes outstanding with a single driver */
+  uint64_t queue_depth_peak;
+
+  /** The largest (average) response latency of a single driver (in msec) */
+  uint32_t latency_peak;
+
 } probing_stats_t;
 
+/** Number of requests that are queued for a driver before they are sent to
+    it in a single batch */
+#define REQ_BATCH_LEN 1024
+
+/** Granularity (in msec) with which probe timeouts are tracked */
+#define EXPIRY_TICK_LEN 100
+
+/** Interval (in msec) at which the probing windows are adjusted */
+#define CTL_INTERVAL 1000
+
+/** Number of slices worth of probes of each class that may be outstanding in
+    the absence of backpressure */
+#define CTL_WINDOW_SLICES 5
+
+/** Windows are never cut below this fraction of their maximum */
+#define CTL_WINDOW_MIN_DIV 100
+
+/** Windows grow by this fraction of their maximum each interval without
+    backpressure */
+#define CTL_WINDOW_INCR_DIV 32
+
+/** Weight (as a right shift) of each new sample in the latency average */
+#define LATENCY_EWMA_SHIFT 3
+
+/** Units (in msec) of the probe_sent field of the /24 state */
+#define PROBE_SENT_UNIT 10
+
+/** probe_driver value of a /24 whose probe is waiting in the carry-over
+    queue */
+#define PROBE_DRIVER_DEFERRED UINT8_MAX
+
+/** Flags of the dirty field of the /24 state */
+/** The /24 is in a worker dirty list (to be exported this round) */
+#define DIRTY_EXPORT 0x01
+/** The /24 is waiting for its per-/24 keys to be registered */
+#define DIRTY_KEYS 0x02
+
 struct driver_wrap {
   int id;
   trinarkular_driver_t *driver;
-  trinarkular_prober_t *prober;
+  struct prober_worker *worker;
+
+  /** Requests waiting to be sent to the driver */
+  trinarkular_probe_req_t *reqs;
+
+  /** Number of requests waiting to be sent */
+  int reqs_cnt;
+
+  /** Number of probes sent to the driver that have not completed (i.e., the
+      depth of the driver queue) */
+  uint64_t outstanding;
+
+  /** Moving average of the latency of responsive probes (in msec) */
+  uint32_t latency;
+
+  /** Number of latency samples since the windows were last adjusted */
+  uint32_t latency_samples;
+};
+
+/** Name and arguments of a driver that each worker starts an instance of */
+struct driver_spec {
+  char *name;
+  char *args;
 };
 
+/** AIMD controller that limits the number of probes of one class that are
+    outstanding */
+typedef struct rate_ctl {
+
+  /** Number of probes of this class that may be outstanding */
+  uint32_t window;
+
+  /** Window in the absence of backpressure */
+  uint32_t window_max;
+
+  /** Smallest that the window may be cut to */
+  uint32_t window_min;
+
+  /** Number of intervals until the window may be cut again */
+  uint32_t hold;
+
+  /** Number of probes of this class that are outstanding */
+  uint64_t outstanding;
+
+  /** Number of times the window was cut this round */
+  uint32_t decrease_cnt;
+
+  /** Number of probes deferred (to a later slice, or the carry-over queue)
+      this round */
+  uint32_t deferred_cnt;
+
+} rate_ctl_t;
+
+/** An adaptive or recovery probe waiting for room in the window */
+typedef struct slash24_deferral {
+
+  /** /24 to probe */
+  uint32_t network_ip;
+
+  /** probe_seq of the /24 when the probe was deferred */
+  uint8_t probe_seq;
+
+} slash24_deferral_t;
+
+/** A state transition event waiting to be published */
+typedef struct slash24_event {
+
+  /** Topic of the event: the metadata name without its '[LN]:' prefix
+      (points into the active probelist), or EVENT_TOPIC_NONE */
+  const char *topic;
+
+  /** The transition */
+  trinarkular_journal_rec_t rec;
+
+} slash24_event_t;
+
+/** Topic of events that do not match any metadata */
+#define EVENT_TOPIC_NONE ""
+
+/** Maximum number of events that a worker holds before publishing them */
+#define EVENT_BATCH_LEN 1024
+
+/** Magic string at the start of every checkpoint */
+#define CKPT_MAGIC "TRNKCKP"
+
+/** Current version of the checkpoint format */
+#define CKPT_VERSION 1
+
+/** Written in native byte order so that checkpoints from hosts with a
+    different byte order can be rejected */
+#define CKPT_BYTE_ORDER 0x01020304
+
+/** Number of checkpoint records read at a time when warm starting */
+#define CKPT_READ_BATCH_LEN 65536
+
+/* A checkpoint is a header, followed by the (NUL-terminated) version of the
+ * probelist that it was taken from, followed by one record per /24. It is
+ * written to a temporary file that is renamed over the previous checkpoint, so
+ * a crash while writing leaves the previous checkpoint intact.
+ */
+typedef struct checkpoint_hdr {
+
+  /** CKPT_MAGIC (NUL padded) */
+  char magic[8];
+
+  /** CKPT_VERSION */
+  uint32_t format_version;
+
+  /** CKPT_BYTE_ORDER */
+  uint32_t byte_order;
+
+  /** Size of each record */
+  uint32_t record_size;
+
+  /** Length of the probelist version (including the NUL) */
+  uint32_t version_len;
+
+  /** Time that the checkpoint was taken (ms since the epoch) */
+  uint64_t time;
+
+  /** Number of /24 records */
+  uint64_t slash24_cnt;
+
+} checkpoint_hdr_t;
+
+/** The state of a /24 that survives a restart (8 bytes) */
+typedef struct checkpoint_rec {
+
+  /** Network IP of the /24 (host byte order) */
+  uint32_t network_ip;
+
+  /** Belief that the /24 last settled on */
+  trinarkular_belief_t belief;
+
+  /** Last stable state */
+  uint8_t state;
+
+  /** Rounds since the /24 was UP */
+  uint8_t rounds_since_up;
+
+} checkpoint_rec_t;
+
+/** Workers partition the active probelist by /24. Each worker queues the
+    periodic probes for the /24s that it owns, and handles the responses to
+    them using its own drivers. Only the worker that owns a /24 may modify its
+    state. */
+typedef struct prober_worker {
+
+  /** Worker ID (the worker owns the /24s for which WORKER_ID(ip) == id) */
+  int id;
+
+  /** Prober that this worker belongs to */
+  trinarkular_prober_t *prober;
+
+  /** Actor that runs the worker thread (NULL if the worker runs in the
+      prober thread) */
+  zactor_t *actor;
+
+  /** Loop that the worker's drivers are polled from (BORROWED if the worker
+      runs in the prober thread) */
+  zloop_t *loop;
+
+  /** Has the worker thread shut down? */
+  int dead;
+
+  /** Probe Driver instances */
+  struct driver_wrap drivers[TRINARKULAR_PROBER_DRIVER_MAX_CNT];
+
+  /** Number of prober drivers in use */
+  int drivers_cnt;
+
+  /** Index of the next driver to use for probing */
+  int drivers_next;
+
+  /** Number of probes queued with the driver(s) */
+  uint64_t outstanding_probe_cnt;
+
+  /** Deadlines of the outstanding probes (keyed by /24 and probe_seq) */
+  trinarkular_timer_wheel_t *expiry_wheel;
+
+  /** The number of probes that timed out this round */
+  uint32_t expired_probe_cnt;
+
+  /** Probing window controllers (one per class) */
+  rate_ctl_t ctl[CTL_CLASS_CNT];
+
+  /** Number of probes that timed out since the windows were last adjusted */
+  uint32_t ctl_expired_cnt;
+
+  /** Carry-over queue of adaptive and recovery probes */
+  slash24_deferral_t *deferred;
+
+  /** Index of the first probe in the carry-over queue */
+  uint32_t deferred_head;
+
+  /** Index after the last probe in the carry-over queue */
+  uint32_t deferred_cnt;
+
+  /** Number of deferrals allocated */
+  uint32_t deferred_alloc;
+
+  /** The largest number of probes outstanding with one of the drivers this
+      round */
+  uint64_t queue_depth_peak;
+
+  /** The largest response latency of one of the drivers this round */
+  uint32_t latency_peak;
+
+  /** Batch of responses received from a driver */
+  trinarkular_probe_resp_t *resps;
+
+  /** /24 (or NULL if it was not found) for each response in the batch */
+  trinarkular_slash24_t **resp_slash24s;
+
+  /** Indexes (into the probelist record array) of the /24s owned by this
+      worker, in probing order */
+  uint32_t *slash24s;
+
+  /** Number of /24s owned by this worker */
+  uint32_t slash24s_cnt;
+
+  /** Number of indexes allocated */
+  uint32_t slash24s_alloc;
+
+  /** Index of the next /24 to probe */
+  uint32_t slash24_iter;
+
+  /** The number of /24s that are in a slice */
+  int slice_size;
+
+  /** The number of periodic probes in the current slice that are waiting to
+      be paced out */
+  uint32_t slice_pending;
+
+  /** Pacing timer ID (-1 if not running) */
+  int pace_timer_id;
+
+  /** The largest number of probes outstanding this round */
+  uint64_t outstanding_peak;
+
+  /** The number of probes sent this round */
+  uint32_t probe_cnt[PROBE_TYPE_CNT];
+
+  /** The number of responses received this round */
+  uint32_t probe_complete_cnt[PROBE_TYPE_CNT];
+
+  /** The number of responsive probes this round */
+  uint32_t responsive_cnt[PROBE_TYPE_CNT];
+
+  /** Indexes of the /24s that have settled this round (each /24 is listed
+      at most once) */
+  uint32_t *dirty;
+
+  /** Number of dirty /24s */
+  uint32_t dirty_cnt;
+
+  /** Number of dirty /24 indexes allocated */
+  uint32_t dirty_alloc;
+
+  /** Journal that this worker's state transitions are appended to (NULL if
+      journaling is disabled) */
+  trinarkular_journal_t *journal;
+
+  /** Socket that events are pushed to the prober thread on (NULL if events
+      are disabled) */
+  zsock_t *events_sock;
+
+  /** Events waiting to be published */
+  slash24_event_t *events;
+
+  /** Number of events waiting to be published */
+  uint32_t events_cnt;
+
+  /** Time that the oldest waiting event was queued */
+  uint64_t events_first_time;
+
+  /** Number of events that have been dropped (because the prober thread was
+      not keeping up) */
+  uint64_t events_dropped_cnt;
+
+} prober_worker_t;
+
+/** Get the ID of the worker that owns the given /24 */
+#define WORKER_ID(prober, network_ip)                                          \
+  (((network_ip) >> 8) % (prober)->workers_cnt)
+
 struct params {
 
   /** Defaults to TRINARKULAR_PERIODIC_ROUND_DURATION_DEFAULT */
@@ -223,6 +655,58 @@ struct params {
 
   /** Defaults to 1 (sleep for alignment) */
   int sleep_align_start;
+
+  /** Defaults to 1 (parse the probelist in the loading thread, and generate
+      its keys in one other thread) */
+  int probelist_threads;
+
+  /** Defaults to 0 (rebuild all state when the probelist is reloaded) */
+  int incremental_reload;
+
+  /** Defaults to 0 (create the per-/24 keys of every /24 up front) */
+  int lazy_slash24_keys;
+
+  /** Defaults to 0 (write every per-/24 value every round) */
+  uint32_t delta_keyframe_interval;
+
+  /** Defaults to TRINARKULAR_JOURNAL_FILE_RECORDS_DEFAULT */
+  uint64_t journal_file_records;
+
+  /** Defaults to 0 (keep all journal files) */
+  uint32_t journal_files_max;
+
+  /** Defaults to TRINARKULAR_PROBER_EVENTS_MAX_LATENCY_DEFAULT */
+  uint32_t events_max_latency;
+
+  /** Defaults to TRINARKULAR_PROBER_EVENTS_HWM_DEFAULT */
+  int events_hwm;
+
+  /** Defaults to 0 (no checkpoints are written) */
+  uint64_t checkpoint_interval;
+
+  /** Defaults to 0 (never warm start from a checkpoint) */
+  uint64_t checkpoint_max_age;
+
+  /** Defaults to 1 (probe from the prober thread) */
+  int worker_threads;
+
+  /** Defaults to TRINARKULAR_PROBER_RESP_BATCH_SIZE_DEFAULT */
+  int resp_batch_size;
+
+  /** Defaults to 0 (queue each slice of periodic probes at once) */
+  int pacing_batch_size;
+
+  /** Defaults to 0 (spread each slice evenly across the slice interval) */
+  int pacing_rate;
+
+  /** Defaults to TRINARKULAR_PROBER_PROBE_EXPIRY_GRACE_DEFAULT */
+  uint32_t probe_expiry_grace;
+
+  /** Defaults to 0 (the periodic probe timeout) */
+  uint32_t backpressure_latency;
+
+  /** Defaults to 0 (the maximum periodic window, split across the drivers) */
+  uint32_t backpressure_queue_depth;
 };
 
 #define PARAM(pname) (prober->params.pname)
@@ -231,14 +715,10 @@ struct params {
 #define NEXT_STAT(sname)                                                       \
   (prober->pl_states[!prober->pl_state_active_idx].stats.sname)
 
-/** How often do we expect packet loss?
-    (Taken from the paper) */
-#define PACKET_LOSS_FREQUENCY 0.01
-
-#define BELIEF_UP_FRAC 0.9
-#define BELIEF_DOWN_FRAC 0.1
 #define BELIEF_STATE(s)                                                        \
-  (((s) < BELIEF_DOWN_FRAC) ? DOWN : ((s) > BELIEF_UP_FRAC) ? UP : UNCERTAIN)
+  (((s) < TRINARKULAR_BELIEF_DOWN_THRESHOLD)                                   \
+     ? DOWN                                                                    \
+     : ((s) > TRINARKULAR_BELIEF_UP_THRESHOLD) ? UP : UNCERTAIN)
 
 // convenience macros to ease data structure access
 #define ACTIVE_PL_STATE(p)   (p->pl_states[p->pl_state_active_idx])
@@ -250,6 +730,49 @@ struct params {
 #define NEXT_PL(p)           (p->pl_states[!p->pl_state_active_idx].pl)
 #define NEXT_KP_AGGR(p)      (p->pl_states[!p->pl_state_active_idx].kp_aggr)
 #define NEXT_KP_SLASH24(p)   (p->pl_states[!p->pl_state_active_idx].kp_slash24)
+#define NEXT_KP_AGGR_SNAP(p)                                                   \
+  (p->pl_states[!p->pl_state_active_idx].kp_aggr_snap)
+#define NEXT_KP_SLASH24_SNAP(p)                                                \
+  (p->pl_states[!p->pl_state_active_idx].kp_slash24_snap)
+
+/** Timeseries keys shared by all /24s that have a given metadata */
+typedef struct md_metrics {
+
+  /** (shared kp idx) Value will be # /24s in each state (-1 until the keys
+      have been created) */
+  int32_t overall[BELIEF_STATE_CNT];
+
+  /** Constant prefix of the per-/24 keys of this metadata (NULL if this
+      metadata does not have per-/24 keys) */
+  char *blocks_prefix;
+
+  /** Length of the per-/24 key prefix */
+  size_t blocks_prefix_len;
+
+} md_metrics_t;
+
+/** Minimum number of /24s that each thread of the per-metadata count
+    reduction is given */
+#define MD_REDUCE_MIN_SLASH24S 65536
+
+/** Part of the /24 state array that is counted by one reduction thread */
+typedef struct md_reduce_part {
+
+  /** /24 records and states to count */
+  trinarkular_slash24_t *records;
+  trinarkular_slash24_state_t *states;
+
+  /** Range of /24 indexes to count */
+  uint32_t first;
+  uint32_t last;
+
+  /** Dense (md_cnt x BELIEF_STATE_CNT) counts of /24s in each state */
+  uint32_t *cnts;
+
+  /** Is this part being counted by its own thread? */
+  int threaded;
+
+} md_reduce_part_t;
 
 /* Structure representing a probelist state.  We maintain two of these to
  * facilitate probelist reloads.
@@ -265,13 +788,60 @@ typedef struct probelist_state {
   /** Key package (non-/24 data) */
   timeseries_kp_t *kp_aggr;
 
+  /** Snapshots of the key packages that are written by the flusher thread.
+      They have the same keys as the live key packages (which are only ever
+      written by the main thread, and never flushed) */
+  timeseries_kp_t *kp_slash24_snap;
+  timeseries_kp_t *kp_aggr_snap;
+
   /** Indexes into the KP for overall metrics */
   struct metrics metrics;
 
+  /** Per-metadata metrics, indexed by probelist metadata ID */
+  md_metrics_t *md_metrics;
+
+  /** Number of per-metadata metrics allocated */
+  uint32_t md_metrics_cnt;
+
+  /** Number of /24s in each state, for each metadata (indexed by
+      md_id * BELIEF_STATE_CNT + state, and recomputed at the end of each
+      round) */
+  uint32_t *md_state_cnts;
+
   /** Probing statistics */
   probing_stats_t stats;
 } probelist_state_t;
 
+/** Number of /24s that each key generation thread is given at a time */
+#define KEY_GEN_BATCH_SLASH24S 65536
+
+/** Per-/24 keys of part of the /24 state array, generated by one thread */
+typedef struct key_gen_part {
+
+  /** Probelist state that the keys are for */
+  probelist_state_t *pl_state;
+
+  /** Range of /24 indexes to generate keys for */
+  uint32_t first;
+  uint32_t last;
+
+  /** NUL-separated keys, in the order that they are to be added */
+  char *buf;
+
+  /** Number of bytes of keys */
+  size_t buf_len;
+
+  /** Number of bytes allocated */
+  size_t buf_alloc;
+
+  /** Is this part being generated by its own thread? */
+  int threaded;
+
+  /** Set if the keys could not be generated */
+  int err;
+
+} key_gen_part_t;
+
 /* Structure representing a prober instance */
 struct trinarkular_prober {
 
@@ -308,23 +878,20 @@ struct trinarkular_prober {
   /** Periodic probe timer ID */
   int periodic_timer_id;
 
-  /** Probe Driver instances */
-  struct driver_wrap drivers[TRINARKULAR_PROBER_DRIVER_MAX_CNT];
+  /** Drivers that each worker starts an instance of */
+  struct driver_spec driver_specs[TRINARKULAR_PROBER_DRIVER_MAX_CNT];
 
-  /** Number of prober drivers in use */
-  int drivers_cnt;
+  /** Number of drivers added */
+  int driver_specs_cnt;
 
-  /** Index of the next driver to use for probing */
-  int drivers_next;
+  /** Workers that the active probelist is partitioned across */
+  prober_worker_t *workers;
 
-  /** Number of probes queued with the driver(s) */
-  uint64_t outstanding_probe_cnt;
+  /** Number of workers */
+  int workers_cnt;
 
   /* ==== Periodic Probing State ==== */
 
-  /** The number of /24s that are in a slice */
-  int slice_size;
-
   /** The current slice (i.e. how many times the slice timer has fired) */
   uint64_t current_slice;
 
@@ -340,81 +907,254 @@ struct trinarkular_prober {
   /** Filename of probelist */
   char *probelist_filename;
 
-};
+  /** Path prefix of the state transition journals (NULL if journaling is
+      disabled) */
+  char *journal_prefix;
 
-static char *graphite_safe(char *p)
-{
-  if (p == NULL) {
-    return p;
-  }
+  /* ==== Transition Event State ==== */
 
-  char *r = p;
-  while (*p != '\0') {
-    if (*p == '.') {
-      *p = '-';
-    }
-    if (*p == '*') {
-      *p = '-';
-    }
-    p++;
-  }
-  return r;
-}
+  /** Endpoint that transition events are published on (NULL if events are
+      disabled) */
+  char *events_endpoint;
 
-#define BUFFER_LEN 1024
+  /** Prefix of the metadata that events are published under (NULL to publish
+      all events with an empty topic) */
+  char *events_topic_prefix;
 
-static int init_kp(trinarkular_prober_t *prober)
-{
-  char buf[BUFFER_LEN];
-  int i;
+  /** Length of the topic prefix */
+  size_t events_topic_prefix_len;
 
-  // create key packages
-  if ((NEXT_KP_SLASH24(prober) =
-       timeseries_kp_init(prober->ts_slash24, 0)) == NULL ||
-      (NEXT_KP_AGGR(prober) = timeseries_kp_init(prober->ts_aggr, 0)) == NULL) {
-    return -1;
-  }
+  /** Inproc endpoint that the workers push events to */
+  char events_inproc[64];
 
-  // round id
-  snprintf(buf, BUFFER_LEN, METRIC_PREFIX_PROBER ".%s.meta.round_id",
-           prober->name_ts);
-  if ((NEXT_PL_STATE(prober).metrics.round_id =
-         timeseries_kp_add_key(NEXT_KP_AGGR(prober), buf)) == -1) {
-    return -1;
-  }
+  /** Socket that receives events from the workers */
+  zsock_t *events_pull;
 
-  // round duration
-  snprintf(buf, BUFFER_LEN, METRIC_PREFIX_PROBER ".%s.meta.round_duration",
-           prober->name_ts);
-  if ((NEXT_PL_STATE(prober).metrics.round_duration =
-         timeseries_kp_add_key(NEXT_KP_AGGR(prober), buf)) == -1) {
-    return -1;
-  }
+  /** Socket that events are published on */
+  zsock_t *events_pub;
 
-  for (i = PERIODIC; i <= RECOVERY; i++) {
-    // probe cnt
-    snprintf(buf, BUFFER_LEN, METRIC_PREFIX_PROBER ".%s.probing.%s.probe_cnt",
-             prober->name_ts, probe_types[i]);
-    if ((NEXT_PL_STATE(prober).metrics.round_probe_cnt[i] =
-           timeseries_kp_add_key(NEXT_KP_AGGR(prober), buf)) == -1) {
-      return -1;
-    }
+  /** Number of events that have been published */
+  uint64_t events_published_cnt;
 
-    // probe complete cnt
-    snprintf(buf, BUFFER_LEN,
-             METRIC_PREFIX_PROBER ".%s.probing.%s.completed_probe_cnt",
-             prober->name_ts, probe_types[i]);
-    if ((NEXT_PL_STATE(prober).metrics.round_probe_complete_cnt[i] =
-           timeseries_kp_add_key(NEXT_KP_AGGR(prober), buf)) == -1) {
-      return -1;
-    }
+  /* ==== Checkpoint State ==== */
 
-    // responsive cnt
-    snprintf(buf, BUFFER_LEN,
-             METRIC_PREFIX_PROBER ".%s.probing.%s.responsive_probe_cnt",
-             prober->name_ts, probe_types[i]);
-    if ((NEXT_PL_STATE(prober).metrics.round_responsive_cnt[i] =
-           timeseries_kp_add_key(NEXT_KP_AGGR(prober), buf)) == -1) {
+  /** Path of the checkpoint (NULL if checkpoints are disabled) */
+  char *checkpoint_path;
+
+  /** Thread that writes checkpoints */
+  pthread_t checkpointer;
+
+  /** Has the checkpoint thread been started? */
+  int checkpointer_started;
+
+  /** Protects the checkpoint job */
+  pthread_mutex_t ckpt_mutex;
+
+  /** Signalled when a checkpoint is submitted or completed */
+  pthread_cond_t ckpt_cond;
+
+  /** Is a checkpoint waiting to be (or being) written? */
+  int ckpt_pending;
+
+  /** Should the checkpoint thread exit once it is idle? */
+  int ckpt_shutdown;
+
+  /** Records of the checkpoint being written */
+  checkpoint_rec_t *ckpt_recs;
+
+  /** Number of records */
+  uint64_t ckpt_recs_cnt;
+
+  /** Number of records allocated */
+  uint64_t ckpt_recs_alloc;
+
+  /** Version of the probelist that the checkpoint was taken from */
+  char *ckpt_version;
+
+  /** Time that the checkpoint was taken */
+  uint64_t ckpt_time;
+
+  /** Number of checkpoints that have failed */
+  uint32_t ckpt_failed_cnt;
+
+  /** Time that the last checkpoint was taken (main thread only) */
+  uint64_t ckpt_last;
+
+  /* ==== State Table Export ==== */
+
+  /** Path of the shared state table (NULL if the export is disabled) */
+  char *state_table_path;
+
+  /** Shared state table that readers can map */
+  trinarkular_state_table_t *state_table;
+
+  /** Is the reloaded probelist (in the NEXT state) a diff against the active
+      probelist rather than a complete state? */
+  int reload_is_diff;
+
+  /** Differences between the active and reloaded probelists */
+  trinarkular_probelist_diff_t reload_diff;
+
+  /* ==== Timeseries Flushing State ==== */
+
+  /** Thread that flushes the KP snapshots */
+  pthread_t flusher;
+
+  /** Has the flusher thread been started? */
+  int flusher_started;
+
+  /** Protects the flush job and the flusher statistics */
+  pthread_mutex_t flush_mutex;
+
+  /** Signalled when a flush is submitted or completed */
+  pthread_cond_t flush_cond;
+
+  /** Snapshots being flushed (NULL if the flusher is idle) */
+  timeseries_kp_t *flush_kp_aggr;
+  timeseries_kp_t *flush_kp_slash24;
+
+  /** Time (in sec) to flush the snapshots for */
+  uint32_t flush_time;
+
+  /** Walltime that the current flush was submitted at */
+  uint64_t flush_start;
+
+  /** Duration (in msec) of the last completed flush */
+  uint64_t flush_duration;
+
+  /** Number of flushes that have failed */
+  uint32_t flush_failed_cnt;
+
+  /** Should the flusher exit once it is idle? */
+  int flush_shutdown;
+
+  /** Number of rounds that were not flushed (main thread only) */
+  uint32_t flush_skipped_cnt;
+
+  /** Do the per-/24 snapshots need to be fully re-copied (because a round
+      was skipped)? (main thread only) */
+  int snap_stale;
+
+  /* ==== Lazy Per-/24 Key State ==== */
+
+  /** Indexes of the /24s of the active probelist whose per-/24 keys are
+      waiting to be registered */
+  uint32_t *lazy_keys;
+
+  /** Number of /24s waiting for keys */
+  uint32_t lazy_keys_cnt;
+
+  /** Number of /24 indexes allocated */
+  uint32_t lazy_keys_alloc;
+
+  /* ==== Delta Emission State (main thread only) ==== */
+
+  /** Per-/24 keys whose snapshot values changed since the last flush */
+  uint32_t *emit_keys;
+
+  /** Number of changed keys */
+  uint32_t emit_keys_cnt;
+
+  /** Number of changed keys allocated */
+  uint32_t emit_keys_alloc;
+
+  /** Per-/24 keys that are enabled in the snapshot (unless
+      emitted_all is set) */
+  uint32_t *emitted_keys;
+
+  /** Number of enabled keys */
+  uint32_t emitted_keys_cnt;
+
+  /** Number of enabled keys allocated */
+  uint32_t emitted_keys_alloc;
+
+  /** Are all per-/24 keys enabled in the snapshot (i.e., was the last flush a
+      keyframe)? */
+  int emitted_all;
+
+  /** Number of per-/24 keys of the /24s in the active probelist */
+  uint32_t active_keys_cnt;
+
+  /** Number of delta rounds flushed since the last keyframe */
+  uint32_t delta_rounds;
+
+  /** Must the next flush be a keyframe? */
+  int keyframe_due;
+
+};
+
+#define BUFFER_LEN 1024
+
+/** Add the given key to the aggregate KP of the given state, and to its
+    snapshot. Both are given the same keys, so the key has the same index in
+    each */
+static int kp_add_key(probelist_state_t *pl_state, const char *key)
+{
+  int idx;
+
+  if ((idx = timeseries_kp_add_key(pl_state->kp_aggr, key)) == -1 ||
+      timeseries_kp_add_key(pl_state->kp_aggr_snap, key) != idx) {
+    return -1;
+  }
+  return idx;
+}
+
+static int init_kp(trinarkular_prober_t *prober)
+{
+  char buf[BUFFER_LEN];
+  int i;
+
+  // create key packages (and their snapshots)
+  if ((NEXT_KP_SLASH24(prober) =
+       timeseries_kp_init(prober->ts_slash24, 0)) == NULL ||
+      (NEXT_KP_AGGR(prober) = timeseries_kp_init(prober->ts_aggr, 0)) == NULL ||
+      (NEXT_KP_SLASH24_SNAP(prober) =
+       timeseries_kp_init(prober->ts_slash24, 0)) == NULL ||
+      (NEXT_KP_AGGR_SNAP(prober) =
+       timeseries_kp_init(prober->ts_aggr, 0)) == NULL) {
+    return -1;
+  }
+
+  // round id
+  snprintf(buf, BUFFER_LEN, METRIC_PREFIX_PROBER ".%s.meta.round_id",
+           prober->name_ts);
+  if ((NEXT_PL_STATE(prober).metrics.round_id =
+         kp_add_key(&NEXT_PL_STATE(prober), buf)) == -1) {
+    return -1;
+  }
+
+  // round duration
+  snprintf(buf, BUFFER_LEN, METRIC_PREFIX_PROBER ".%s.meta.round_duration",
+           prober->name_ts);
+  if ((NEXT_PL_STATE(prober).metrics.round_duration =
+         kp_add_key(&NEXT_PL_STATE(prober), buf)) == -1) {
+    return -1;
+  }
+
+  for (i = PERIODIC; i <= RECOVERY; i++) {
+    // probe cnt
+    snprintf(buf, BUFFER_LEN, METRIC_PREFIX_PROBER ".%s.probing.%s.probe_cnt",
+             prober->name_ts, probe_types[i]);
+    if ((NEXT_PL_STATE(prober).metrics.round_probe_cnt[i] =
+           kp_add_key(&NEXT_PL_STATE(prober), buf)) == -1) {
+      return -1;
+    }
+
+    // probe complete cnt
+    snprintf(buf, BUFFER_LEN,
+             METRIC_PREFIX_PROBER ".%s.probing.%s.completed_probe_cnt",
+             prober->name_ts, probe_types[i]);
+    if ((NEXT_PL_STATE(prober).metrics.round_probe_complete_cnt[i] =
+           kp_add_key(&NEXT_PL_STATE(prober), buf)) == -1) {
+      return -1;
+    }
+
+    // responsive cnt
+    snprintf(buf, BUFFER_LEN,
+             METRIC_PREFIX_PROBER ".%s.probing.%s.responsive_probe_cnt",
+             prober->name_ts, probe_types[i]);
+    if ((NEXT_PL_STATE(prober).metrics.round_responsive_cnt[i] =
+           kp_add_key(&NEXT_PL_STATE(prober), buf)) == -1) {
       return -1;
     }
   }
@@ -423,7 +1163,7 @@ static int init_kp(trinarkular_prober_t *prober)
     snprintf(buf, BUFFER_LEN, METRIC_PREFIX_PROBER ".%s.states.%s_slash24_cnt",
              prober->name_ts, belief_states[i]);
     if ((NEXT_PL_STATE(prober).metrics.slash24_state_cnts[i] =
-           timeseries_kp_add_key(NEXT_KP_AGGR(prober), buf)) == -1) {
+           kp_add_key(&NEXT_PL_STATE(prober), buf)) == -1) {
       return -1;
     }
   }
@@ -431,10 +1171,142 @@ static int init_kp(trinarkular_prober_t *prober)
   snprintf(buf, BUFFER_LEN, METRIC_PREFIX_PROBER ".%s.slash24_cnt",
            prober->name_ts);
   if ((NEXT_PL_STATE(prober).metrics.slash24_cnt =
-         timeseries_kp_add_key(NEXT_KP_AGGR(prober), buf)) == -1) {
+         kp_add_key(&NEXT_PL_STATE(prober), buf)) == -1) {
+    return -1;
+  }
+
+  snprintf(buf, BUFFER_LEN, METRIC_PREFIX_PROBER ".%s.probing.outstanding_peak",
+           prober->name_ts);
+  if ((NEXT_PL_STATE(prober).metrics.outstanding_peak =
+         kp_add_key(&NEXT_PL_STATE(prober), buf)) == -1) {
+    return -1;
+  }
+
+  snprintf(buf, BUFFER_LEN,
+           METRIC_PREFIX_PROBER ".%s.probing.expired_probe_cnt",
+           prober->name_ts);
+  if ((NEXT_PL_STATE(prober).metrics.expired_probe_cnt =
+         kp_add_key(&NEXT_PL_STATE(prober), buf)) == -1) {
+    return -1;
+  }
+
+  for (i = CTL_PERIODIC; i < CTL_CLASS_CNT; i++) {
+    snprintf(buf, BUFFER_LEN,
+             METRIC_PREFIX_PROBER ".%s.backpressure.%s.window",
+             prober->name_ts, ctl_classes[i]);
+    if ((NEXT_PL_STATE(prober).metrics.ctl_window[i] =
+           kp_add_key(&NEXT_PL_STATE(prober), buf)) == -1) {
+      return -1;
+    }
+
+    snprintf(buf, BUFFER_LEN,
+             METRIC_PREFIX_PROBER ".%s.backpressure.%s.decrease_cnt",
+             prober->name_ts, ctl_classes[i]);
+    if ((NEXT_PL_STATE(prober).metrics.ctl_decrease_cnt[i] =
+           kp_add_key(&NEXT_PL_STATE(prober), buf)) == -1) {
+      return -1;
+    }
+
+    snprintf(buf, BUFFER_LEN,
+             METRIC_PREFIX_PROBER ".%s.backpressure.%s.deferred_probe_cnt",
+             prober->name_ts, ctl_classes[i]);
+    if ((NEXT_PL_STATE(prober).metrics.ctl_deferred_cnt[i] =
+           kp_add_key(&NEXT_PL_STATE(prober), buf)) == -1) {
+      return -1;
+    }
+  }
+
+  snprintf(buf, BUFFER_LEN,
+           METRIC_PREFIX_PROBER ".%s.backpressure.unprobed_slash24_cnt",
+           prober->name_ts);
+  if ((NEXT_PL_STATE(prober).metrics.unprobed_cnt =
+         kp_add_key(&NEXT_PL_STATE(prober), buf)) == -1) {
     return -1;
   }
 
+  snprintf(buf, BUFFER_LEN,
+           METRIC_PREFIX_PROBER ".%s.backpressure.queue_depth_peak",
+           prober->name_ts);
+  if ((NEXT_PL_STATE(prober).metrics.queue_depth_peak =
+         kp_add_key(&NEXT_PL_STATE(prober), buf)) == -1) {
+    return -1;
+  }
+
+  snprintf(buf, BUFFER_LEN,
+           METRIC_PREFIX_PROBER ".%s.backpressure.latency_peak",
+           prober->name_ts);
+  if ((NEXT_PL_STATE(prober).metrics.latency_peak =
+         kp_add_key(&NEXT_PL_STATE(prober), buf)) == -1) {
+    return -1;
+  }
+
+  snprintf(buf, BUFFER_LEN, METRIC_PREFIX_PROBER ".%s.flush.duration",
+           prober->name_ts);
+  if ((NEXT_PL_STATE(prober).metrics.flush_duration =
+         kp_add_key(&NEXT_PL_STATE(prober), buf)) == -1) {
+    return -1;
+  }
+
+  snprintf(buf, BUFFER_LEN, METRIC_PREFIX_PROBER ".%s.flush.backlog",
+           prober->name_ts);
+  if ((NEXT_PL_STATE(prober).metrics.flush_backlog =
+         kp_add_key(&NEXT_PL_STATE(prober), buf)) == -1) {
+    return -1;
+  }
+
+  snprintf(buf, BUFFER_LEN, METRIC_PREFIX_PROBER ".%s.flush.failed_cnt",
+           prober->name_ts);
+  if ((NEXT_PL_STATE(prober).metrics.flush_failed_cnt =
+         kp_add_key(&NEXT_PL_STATE(prober), buf)) == -1) {
+    return -1;
+  }
+
+  snprintf(buf, BUFFER_LEN, METRIC_PREFIX_PROBER ".%s.flush.skipped_cnt",
+           prober->name_ts);
+  if ((NEXT_PL_STATE(prober).metrics.flush_skipped_cnt =
+         kp_add_key(&NEXT_PL_STATE(prober), buf)) == -1) {
+    return -1;
+  }
+
+  // delta emission counts are only meaningful (and only written) when delta
+  // emission is enabled
+  NEXT_PL_STATE(prober).metrics.flush_emitted_cnt = -1;
+  NEXT_PL_STATE(prober).metrics.flush_suppressed_cnt = -1;
+  if (PARAM(delta_keyframe_interval) != 0) {
+    snprintf(buf, BUFFER_LEN, METRIC_PREFIX_PROBER ".%s.flush.emitted_cnt",
+             prober->name_ts);
+    if ((NEXT_PL_STATE(prober).metrics.flush_emitted_cnt =
+           kp_add_key(&NEXT_PL_STATE(prober), buf)) == -1) {
+      return -1;
+    }
+
+    snprintf(buf, BUFFER_LEN, METRIC_PREFIX_PROBER ".%s.flush.suppressed_cnt",
+             prober->name_ts);
+    if ((NEXT_PL_STATE(prober).metrics.flush_suppressed_cnt =
+           kp_add_key(&NEXT_PL_STATE(prober), buf)) == -1) {
+      return -1;
+    }
+  }
+
+  // event counts are only written when events are enabled
+  NEXT_PL_STATE(prober).metrics.events_published_cnt = -1;
+  NEXT_PL_STATE(prober).metrics.events_dropped_cnt = -1;
+  if (prober->events_endpoint != NULL) {
+    snprintf(buf, BUFFER_LEN, METRIC_PREFIX_PROBER ".%s.events.published_cnt",
+             prober->name_ts);
+    if ((NEXT_PL_STATE(prober).metrics.events_published_cnt =
+           kp_add_key(&NEXT_PL_STATE(prober), buf)) == -1) {
+      return -1;
+    }
+
+    snprintf(buf, BUFFER_LEN, METRIC_PREFIX_PROBER ".%s.events.dropped_cnt",
+             prober->name_ts);
+    if ((NEXT_PL_STATE(prober).metrics.events_dropped_cnt =
+           kp_add_key(&NEXT_PL_STATE(prober), buf)) == -1) {
+      return -1;
+    }
+  }
+
   return 0;
 }
 
@@ -457,763 +1329,3502 @@ static void set_default_params(struct params *params)
 
   // sleep to align
   params->sleep_align_start = 1;
+
+  // probelist parser threads
+  params->probelist_threads = 1;
+
+  // rebuild all state on reload
+  params->incremental_reload = 0;
+
+  // create all per-/24 keys up front
+  params->lazy_slash24_keys = 0;
+
+  // write all per-/24 values every round
+  params->delta_keyframe_interval = 0;
+
+  // journal file size and retention
+  params->journal_file_records = TRINARKULAR_JOURNAL_FILE_RECORDS_DEFAULT;
+  params->journal_files_max = 0;
+
+  // no checkpoints
+  params->checkpoint_interval = 0;
+  params->checkpoint_max_age = 0;
+
+  // event batching and queueing
+  params->events_max_latency = TRINARKULAR_PROBER_EVENTS_MAX_LATENCY_DEFAULT;
+  params->events_hwm = TRINARKULAR_PROBER_EVENTS_HWM_DEFAULT;
+
+  // probe from the prober thread
+  params->worker_threads = 1;
+
+  // responses handled per wakeup
+  params->resp_batch_size = TRINARKULAR_PROBER_RESP_BATCH_SIZE_DEFAULT;
+
+  // no pacing
+  params->pacing_batch_size = 0;
+  params->pacing_rate = 0;
+
+  // time to wait for a response after the probe timeout
+  params->probe_expiry_grace = TRINARKULAR_PROBER_PROBE_EXPIRY_GRACE_DEFAULT;
+
+  // backpressure thresholds derived from the probe timeout and slice size
+  params->backpressure_latency = 0;
+  params->backpressure_queue_depth = 0;
 }
 
-static int slash24_metrics_create(trinarkular_prober_t *prober,
-                                  trinarkular_slash24_metrics_t *metrics,
-                                  const char *slash24_string, const char *md,
-                                  int per_block_stats)
+/** Get the index of the given key in the KP (and its snapshot), adding it if
+    needed */
+static int kp_get_or_add_key(timeseries_kp_t *kp, timeseries_kp_t *snap,
+                             const char *key)
 {
-  char buf[BUFFER_LEN];
-  int i;
-  uint64_t tmp;
-
-  // only include per-block stats if this MD is a leaf (e.g., don't track blocks
-  // at continent level)
-  if (per_block_stats != 0) {
-    // belief
-    snprintf(buf, BUFFER_LEN, METRIC_PREFIX_SLASH24
-             ".%s.probers.%s.blocks." CH_SLASH24 ".belief",
-             md, prober->name_ts, slash24_string);
-    if ((metrics->belief =
-         timeseries_kp_add_key(NEXT_KP_SLASH24(prober), buf)) == -1) {
-      return -1;
-    }
+  int idx;
 
-    // state
-    snprintf(buf, BUFFER_LEN,
-             METRIC_PREFIX_SLASH24 ".%s.probers.%s.blocks." CH_SLASH24 ".state",
-             md, prober->name_ts, slash24_string);
-    if ((metrics->state =
-         timeseries_kp_add_key(NEXT_KP_SLASH24(prober), buf)) == -1) {
+  if ((idx = timeseries_kp_get_key(kp, key)) == -1) {
+    if ((idx = timeseries_kp_add_key(kp, key)) == -1 ||
+        timeseries_kp_add_key(snap, key) != idx) {
       return -1;
     }
-  } else {
-    metrics->belief = -1;
-    metrics->state = -1;
+    return idx;
   }
+  // the key may have been disabled when a /24 was removed by a reload
+  timeseries_kp_enable_key(kp, idx);
+  timeseries_kp_enable_key(snap, idx);
+  return idx;
+}
+
+static int md_metrics_create(trinarkular_prober_t *prober,
+                             probelist_state_t *pl_state,
+                             md_metrics_t *md_metrics, const char *md_full)
+{
+  char buf[BUFFER_LEN];
+  // skip the '[LN]:' prefix
+  const char *md = md_full + 2;
+  int len;
+  int i;
 
-  // overall per-state stats
   for (i = UNCERTAIN; i < BELIEF_STATE_CNT; i++) {
     snprintf(buf, BUFFER_LEN,
              METRIC_PREFIX_SLASH24 ".%s.probers.%s.%s_slash24_cnt", md,
              prober->name_ts, belief_states[i]);
-    if ((metrics->overall[i] =
-           timeseries_kp_get_key(NEXT_KP_AGGR(prober), buf)) == -1 &&
-        (metrics->overall[i] =
-           timeseries_kp_add_key(NEXT_KP_AGGR(prober), buf)) == -1) {
+    // different metadata (e.g., 'L:' and 'N:' versions) may share keys
+    if ((md_metrics->overall[i] = kp_get_or_add_key(
+           pl_state->kp_aggr, pl_state->kp_aggr_snap, buf)) == -1) {
       return -1;
     }
   }
 
-  // add this /24 to the UP state
-  tmp = timeseries_kp_get(NEXT_KP_AGGR(prober), metrics->overall[UP]);
-  timeseries_kp_set(NEXT_KP_AGGR(prober), metrics->overall[UP], tmp + 1);
+  // only include per-block stats if this MD is a leaf (e.g., don't track blocks
+  // at continent level). the keys of each /24 only differ in the network IP,
+  // so everything before it is formatted once
+  if (md_full[0] == 'L') {
+    len = snprintf(buf, BUFFER_LEN,
+                   METRIC_PREFIX_SLASH24 ".%s.probers.%s.blocks."
+                   CH_SLASH24_PREFIX, md, prober->name_ts);
+    if (len >= BUFFER_LEN - (int)SLASH24_KEY_VAR_MAX ||
+        (md_metrics->blocks_prefix = strdup(buf)) == NULL) {
+      trinarkular_log("ERROR: Could not create per-/24 key prefix for %s",
+                      md_full);
+      return -1;
+    }
+    md_metrics->blocks_prefix_len = len;
+  }
 
   return 0;
 }
 
-static trinarkular_slash24_state_t *
-slash24_state_create(trinarkular_prober_t *prober, trinarkular_slash24_t *s24)
+/** Write the given decimal octet, returning the number of chars written */
+static inline int write_octet(char *p, uint8_t v)
 {
-  trinarkular_slash24_state_t *state = NULL;
-  uint32_t slash24_ip;
-  char slash24_str[INET_ADDRSTRLEN];
-  int i;
-
-  // need to first create the state
-  if ((state = trinarkular_slash24_state_create(s24->md_cnt)) == NULL) {
-    trinarkular_log("ERROR: Could not create slash24 state");
-    return NULL;
+  if (v >= 100) {
+    p[0] = '0' + v / 100;
+    p[1] = '0' + (v / 10) % 10;
+    p[2] = '0' + v % 10;
+    return 3;
   }
-
-  // initialize things
-  state->last_probe_type = UNPROBED;
-  ADAPTIVE_BUDGET_SET(state, TRINARKULAR_PROBER_ROUND_PROBE_BUDGET);
-  RECOVERY_BUDGET_SET(state, AEB_TO_RECOVERY(s24));
-  state->current_belief = 0.99; // as per paper
-  state->current_state = BELIEF_STATE(state->current_belief);
-  state->rounds_since_up = 0;
-
-  // convert the /24 to a string
-  slash24_ip = htonl(s24->network_ip);
-  inet_ntop(AF_INET, &slash24_ip, slash24_str, INET_ADDRSTRLEN);
-  graphite_safe(slash24_str);
-  for (i = 0; i < s24->md_cnt; i++) {
-    // create metrics for this metadata
-    if (slash24_metrics_create(prober, &state->metrics[i], slash24_str,
-                               s24->md[i]+2, // skip the '[LN]:' prefix
-                               (s24->md[i][0] == 'L') ? 1 : 0) != 0) {
-      trinarkular_log("ERROR: Could not create slash24 metrics for %s",
-                      s24->md[i]);
-      return NULL;
-    }
-    // to save a little memory, we free the metadata strings
-    free(s24->md[i]);
+  if (v >= 10) {
+    p[0] = '0' + v / 10;
+    p[1] = '0' + v % 10;
+    return 2;
   }
-  free(s24->md);
-  s24->md = NULL;
-  s24->md_cnt = 0;
+  p[0] = '0' + v;
+  return 1;
+}
 
-  NEXT_STAT(slash24_state_cnts[UP])++;
-  NEXT_STAT(slash24_cnt)++;
+/** Write the key prefix, the network IP (as a dashed quad) and the suffix
+    to buf, returning the length of the key (see
+    trinarkular_prober_write_slash24_key) */
+static inline size_t key_write(char *buf, const char *prefix,
+                               size_t prefix_len, uint32_t network_ip,
+                               const char *suffix, size_t suffix_len)
+{
+  char *p = buf;
+
+  memcpy(p, prefix, prefix_len);
+  p += prefix_len;
+
+  // the dotted-quad IP, with dashes to keep it graphite-safe
+  p += write_octet(p, network_ip >> 24);
+  *p++ = '-';
+  p += write_octet(p, (network_ip >> 16) & 0xff);
+  *p++ = '-';
+  p += write_octet(p, (network_ip >> 8) & 0xff);
+  *p++ = '-';
+  p += write_octet(p, network_ip & 0xff);
+
+  memcpy(p, suffix, suffix_len + 1);
+  return (p - buf) + suffix_len;
+}
 
-  // now, attach it
-  if (trinarkular_probelist_save_slash24_state(NEXT_PL(prober),
-                                               s24, state) != 0) {
-    goto err;
-  }
+/** Write the per-/24 key with the given suffix (including the NUL) to buf,
+ * which must have room for blocks_prefix_len + SLASH24_KEY_VAR_MAX + 1 chars.
+ * Returns the length of the key. */
+static size_t slash24_key_write(char *buf, const md_metrics_t *md_metrics,
+                                uint32_t network_ip, const char *suffix,
+                                size_t suffix_len)
+{
+  return key_write(buf, md_metrics->blocks_prefix,
+                   md_metrics->blocks_prefix_len, network_ip, suffix,
+                   suffix_len);
+}
+
+static int slash24_metrics_create(trinarkular_prober_t *prober,
+                                  probelist_state_t *pl_state,
+                                  trinarkular_slash24_metrics_t *metrics,
+                                  uint32_t md_id)
+{
+  md_metrics_t *md_metrics = &pl_state->md_metrics[md_id];
 
-  // and destroy it
-  trinarkular_slash24_state_destroy(state);
+  // per-/24 keys are added once the state of every new /24 exists
+  metrics->belief = -1;
+  metrics->state = -1;
 
-  return state;
+  // overall per-state stats (keys are only created once per metadata, and the
+  // values are computed at the end of each round)
+  if (md_metrics->overall[UP] == -1 &&
+      md_metrics_create(prober, pl_state, md_metrics,
+                        trinarkular_probelist_get_md(pl_state->pl, md_id)) !=
+        0) {
+    return -1;
+  }
 
-err:
-  trinarkular_slash24_state_destroy(state);
-  return NULL;
+  return 0;
 }
 
-static void reset_round_stats(trinarkular_prober_t *prober, uint64_t start_time)
+/** Add the per-/24 keys of the given /24, reusing any (disabled) keys left
+    from an earlier version of the probelist */
+static int slash24_keys_create(probelist_state_t *pl_state,
+                               trinarkular_slash24_t *s24,
+                               trinarkular_slash24_state_t *state)
 {
+  char buf[BUFFER_LEN];
+  md_metrics_t *md_metrics;
   int i;
 
-  ACTIVE_STAT(start_time) = start_time;
+  for (i = 0; i < state->metrics_cnt; i++) {
+    md_metrics = &pl_state->md_metrics[s24->md[i]];
+    if (md_metrics->blocks_prefix == NULL) {
+      continue;
+    }
 
-  for (i = UNPROBED; i < PROBE_TYPE_CNT; i++) {
-    ACTIVE_STAT(probe_cnt[i]) = 0;
-    ACTIVE_STAT(probe_complete_cnt[i]) = 0;
-    ACTIVE_STAT(responsive_cnt[i]) = 0;
+    slash24_key_write(buf, md_metrics, s24->network_ip, SLASH24_KEY_BELIEF,
+                      sizeof(SLASH24_KEY_BELIEF) - 1);
+    if ((state->metrics[i].belief = kp_get_or_add_key(
+           pl_state->kp_slash24, pl_state->kp_slash24_snap, buf)) == -1) {
+      return -1;
+    }
+
+    slash24_key_write(buf, md_metrics, s24->network_ip, SLASH24_KEY_STATE,
+                      sizeof(SLASH24_KEY_STATE) - 1);
+    if ((state->metrics[i].state = kp_get_or_add_key(
+           pl_state->kp_slash24, pl_state->kp_slash24_snap, buf)) == -1) {
+      return -1;
+    }
   }
+
+  return 0;
 }
 
-/** Queue a probe for the given /24 */
-static int queue_slash24_probe(trinarkular_prober_t *prober,
-                               trinarkular_slash24_t *s24,
-                               trinarkular_slash24_state_t *state,
-                               int probe_type)
+/** Make room for another key in the given key generation buffer */
+static int key_gen_reserve(key_gen_part_t *part, size_t len)
 {
-  uint32_t host_ip;
-  char ipbuf[INET_ADDRSTRLEN];
+  size_t alloc;
+  char *buf;
 
-  trinarkular_probe_req_t req = {
+  if (part->buf_len + len <= part->buf_alloc) {
+    return 0;
+  }
+  alloc = (part->buf_alloc == 0) ? (1 << 20) : part->buf_alloc * 2;
+  while (alloc < part->buf_len + len) {
+    alloc *= 2;
+  }
+  if ((buf = realloc(part->buf, alloc)) == NULL) {
+    return -1;
+  }
+  part->buf = buf;
+  part->buf_alloc = alloc;
+  return 0;
+}
+
+/** Generate the per-/24 keys of one part of the state array */
+static void *key_gen_run(void *data)
+{
+  key_gen_part_t *part = (key_gen_part_t *)data;
+  probelist_state_t *pl_state = part->pl_state;
+  trinarkular_slash24_t *records =
+    trinarkular_probelist_get_slash24_array(pl_state->pl);
+  trinarkular_slash24_state_t *states =
+    trinarkular_probelist_get_slash24_state_array(pl_state->pl);
+  md_metrics_t *md_metrics;
+  uint32_t idx;
+  int i;
+
+  part->buf_len = 0;
+  for (idx = part->first; idx < part->last; idx++) {
+    for (i = 0; i < states[idx].metrics_cnt; i++) {
+      md_metrics = &pl_state->md_metrics[records[idx].md[i]];
+      if (md_metrics->blocks_prefix == NULL) {
+        continue;
+      }
+      if (key_gen_reserve(part, (md_metrics->blocks_prefix_len +
+                                 SLASH24_KEY_VAR_MAX + 1) * 2) != 0) {
+        part->err = 1;
+        return NULL;
+      }
+      part->buf_len +=
+        slash24_key_write(part->buf + part->buf_len, md_metrics,
+                          records[idx].network_ip, SLASH24_KEY_BELIEF,
+                          sizeof(SLASH24_KEY_BELIEF) - 1) + 1;
+      part->buf_len +=
+        slash24_key_write(part->buf + part->buf_len, md_metrics,
+                          records[idx].network_ip, SLASH24_KEY_STATE,
+                          sizeof(SLASH24_KEY_STATE) - 1) + 1;
+    }
+  }
+
+  return NULL;
+}
+
+/** Start generating the keys of the given parts (each in its own thread, if
+    possible) */
+static void key_gen_start(key_gen_part_t *parts, pthread_t *threads, int cnt)
+{
+  int t, ret;
+
+  for (t = 0; t < cnt; t++) {
+    parts[t].threaded = 0;
+    parts[t].err = 0;
+    if (parts[t].first == parts[t].last) {
+      parts[t].buf_len = 0;
+      continue;
+    }
+    if ((ret = pthread_create(&threads[t], NULL, key_gen_run, &parts[t])) !=
+        0) {
+      trinarkular_log("WARN: pthread_create() returned %d", ret);
+      key_gen_run(&parts[t]);
+    } else {
+      parts[t].threaded = 1;
+    }
+  }
+}
+
+/** Wait for the keys of the given parts to be generated */
+static int key_gen_join(key_gen_part_t *parts, pthread_t *threads, int cnt)
+{
+  int t;
+  int rc = 0;
+
+  for (t = 0; t < cnt; t++) {
+    if (parts[t].threaded != 0) {
+      pthread_join(threads[t], NULL);
+      parts[t].threaded = 0;
+    }
+    if (parts[t].err != 0) {
+      trinarkular_log("ERROR: Could not generate per-/24 keys");
+      rc = -1;
+    }
+  }
+  return rc;
+}
+
+/** Add the generated keys of the given part to the (new) per-/24 KPs */
+static int key_gen_add(key_gen_part_t *part)
+{
+  probelist_state_t *pl_state = part->pl_state;
+  trinarkular_slash24_t *records =
+    trinarkular_probelist_get_slash24_array(pl_state->pl);
+  trinarkular_slash24_state_t *states =
+    trinarkular_probelist_get_slash24_state_array(pl_state->pl);
+  trinarkular_slash24_metrics_t *metrics;
+  const char *key = part->buf;
+  uint32_t idx;
+  int i;
+
+  // walk the /24s in the same order that the keys were generated in
+  for (idx = part->first; idx < part->last; idx++) {
+    for (i = 0; i < states[idx].metrics_cnt; i++) {
+      if (pl_state->md_metrics[records[idx].md[i]].blocks_prefix == NULL) {
+        continue;
+      }
+      metrics = &states[idx].metrics[i];
+
+      // the KPs are new, so there are no existing keys to look up
+      if ((metrics->belief =
+             timeseries_kp_add_key(pl_state->kp_slash24, key)) == -1 ||
+          timeseries_kp_add_key(pl_state->kp_slash24_snap, key) !=
+            metrics->belief) {
+        return -1;
+      }
+      key += strlen(key) + 1;
+
+      if ((metrics->state =
+             timeseries_kp_add_key(pl_state->kp_slash24, key)) == -1 ||
+          timeseries_kp_add_key(pl_state->kp_slash24_snap, key) !=
+            metrics->state) {
+        return -1;
+      }
+      key += strlen(key) + 1;
+    }
+  }
+
+  return 0;
+}
+
+/** Add the per-/24 keys of every /24 in the given (new) probelist state. The
+ * key strings are generated in batches by multiple threads, while the
+ * previous batch is added to the KPs (which are not thread safe). */
+static int slash24_keys_bulk_create(trinarkular_prober_t *prober,
+                                    probelist_state_t *pl_state)
+{
+  uint32_t slash24_cnt = trinarkular_probelist_get_slash24_cnt(pl_state->pl);
+  int threads_cnt = PARAM(probelist_threads);
+  key_gen_part_t *parts[2] = {NULL, NULL};
+  pthread_t *threads[2] = {NULL, NULL};
+  uint32_t next = 0;
+  int cur = 0;
+  int b, t;
+  int rc = -1;
+
+  if (threads_cnt < 1) {
+    threads_cnt = 1;
+  }
+
+  for (b = 0; b < 2; b++) {
+    if ((parts[b] = malloc_zero(sizeof(key_gen_part_t) * threads_cnt)) ==
+          NULL ||
+        (threads[b] = malloc_zero(sizeof(pthread_t) * threads_cnt)) == NULL) {
+      trinarkular_log("ERROR: Could not allocate key generation threads");
+      goto done;
+    }
+    for (t = 0; t < threads_cnt; t++) {
+      parts[b][t].pl_state = pl_state;
+    }
+  }
+
+  trinarkular_log("Generating per-/24 timeseries keys (%d threads)",
+                  threads_cnt);
+
+  // generate the first batch
+  for (t = 0; t < threads_cnt; t++) {
+    parts[cur][t].first = next;
+    next += (slash24_cnt - next < KEY_GEN_BATCH_SLASH24S)
+              ? slash24_cnt - next
+              : KEY_GEN_BATCH_SLASH24S;
+    parts[cur][t].last = next;
+  }
+  key_gen_start(parts[cur], threads[cur], threads_cnt);
+  if (key_gen_join(parts[cur], threads[cur], threads_cnt) != 0) {
+    goto done;
+  }
+
+  while (parts[cur][0].first != parts[cur][0].last) {
+    // generate the next batch while this one is added
+    for (t = 0; t < threads_cnt; t++) {
+      parts[!cur][t].first = next;
+      next += (slash24_cnt - next < KEY_GEN_BATCH_SLASH24S)
+                ? slash24_cnt - next
+                : KEY_GEN_BATCH_SLASH24S;
+      parts[!cur][t].last = next;
+    }
+    key_gen_start(parts[!cur], threads[!cur], threads_cnt);
+
+    for (t = 0; t < threads_cnt; t++) {
+      if (key_gen_add(&parts[cur][t]) != 0) {
+        trinarkular_log("ERROR: Could not add per-/24 keys");
+        key_gen_join(parts[!cur], threads[!cur], threads_cnt);
+        goto done;
+      }
+    }
+
+    if (key_gen_join(parts[!cur], threads[!cur], threads_cnt) != 0) {
+      goto done;
+    }
+    cur = !cur;
+  }
+
+  rc = 0;
+
+done:
+  for (b = 0; b < 2; b++) {
+    for (t = 0; parts[b] != NULL && t < threads_cnt; t++) {
+      free(parts[b][t].buf);
+    }
+    free(parts[b]);
+    free(threads[b]);
+  }
+  return rc;
+}
+
+static trinarkular_slash24_state_t *
+slash24_state_create(trinarkular_prober_t *prober, probelist_state_t *pl_state,
+                     trinarkular_slash24_t *s24)
+{
+  trinarkular_slash24_state_t *state = NULL;
+  int i;
+
+  // need to first create the state (in place, in the probelist)
+  if ((state = trinarkular_probelist_init_slash24_state(
+         pl_state->pl, s24, s24->md_cnt)) == NULL) {
+    trinarkular_log("ERROR: Could not create slash24 state");
+    return NULL;
+  }
+
+  // initialize things
+  state->last_probe_type = UNPROBED;
+  ADAPTIVE_BUDGET_SET(state, TRINARKULAR_PROBER_ROUND_PROBE_BUDGET);
+  RECOVERY_BUDGET_SET(state, AEB_TO_RECOVERY(s24));
+  state->current_belief = TRINARKULAR_BELIEF_MAX; // 0.99, as per paper
+  state->current_state = BELIEF_STATE(state->current_belief);
+  state->settled_belief = state->current_belief;
+  state->exported_state = state->current_state;
+  state->dirty = 0;
+  state->rounds_since_up = 0;
+
+  for (i = 0; i < s24->md_cnt; i++) {
+    // create metrics for this metadata
+    if (slash24_metrics_create(prober, pl_state, &state->metrics[i],
+                               s24->md[i]) != 0) {
+      trinarkular_log(
+        "ERROR: Could not create slash24 metrics for %s",
+        trinarkular_probelist_get_md(pl_state->pl, s24->md[i]));
+      return NULL;
+    }
+  }
+  pl_state->stats.slash24_state_cnts[UP]++;
+  pl_state->stats.slash24_cnt++;
+
+  return state;
+}
+
+static void reset_round_stats(trinarkular_prober_t *prober, uint64_t start_time)
+{
+  prober_worker_t *worker;
+  int i, w;
+
+  ACTIVE_STAT(start_time) = start_time;
+
+  for (i = UNPROBED; i < PROBE_TYPE_CNT; i++) {
+    ACTIVE_STAT(probe_cnt[i]) = 0;
+    ACTIVE_STAT(probe_complete_cnt[i]) = 0;
+    ACTIVE_STAT(responsive_cnt[i]) = 0;
+  }
+  ACTIVE_STAT(outstanding_peak) = 0;
+  ACTIVE_STAT(expired_probe_cnt) = 0;
+  for (i = CTL_PERIODIC; i < CTL_CLASS_CNT; i++) {
+    ACTIVE_STAT(ctl_window[i]) = 0;
+    ACTIVE_STAT(ctl_decrease_cnt[i]) = 0;
+    ACTIVE_STAT(ctl_deferred_cnt[i]) = 0;
+  }
+  ACTIVE_STAT(unprobed_cnt) = 0;
+  ACTIVE_STAT(queue_depth_peak) = 0;
+  ACTIVE_STAT(latency_peak) = 0;
+
+  for (w = 0; w < prober->workers_cnt; w++) {
+    worker = &prober->workers[w];
+    for (i = UNPROBED; i < PROBE_TYPE_CNT; i++) {
+      worker->probe_cnt[i] = 0;
+      worker->probe_complete_cnt[i] = 0;
+      worker->responsive_cnt[i] = 0;
+    }
+    worker->expired_probe_cnt = 0;
+    for (i = CTL_PERIODIC; i < CTL_CLASS_CNT; i++) {
+      worker->ctl[i].decrease_cnt = 0;
+      worker->ctl[i].deferred_cnt = 0;
+    }
+    worker->queue_depth_peak = 0;
+    worker->latency_peak = 0;
+    // start probing from the beginning of the worker's partition
+    worker->slash24_iter = 0;
+    worker->slice_pending = 0;
+    worker->outstanding_peak = worker->outstanding_probe_cnt;
+  }
+}
+
+/** Send the requests that are waiting for the given driver */
+static int driver_flush_reqs(struct driver_wrap *dw)
+{
+  if (dw->reqs_cnt == 0) {
+    return 0;
+  }
+  if (trinarkular_driver_queue_reqs(dw->driver, dw->reqs, dw->reqs_cnt) != 0) {
+    trinarkular_log("ERROR: Could not queue %d requests with driver %d",
+                    dw->reqs_cnt, dw->id);
+    return -1;
+  }
+  dw->reqs_cnt = 0;
+  return 0;
+}
+
+/** Send the requests that are waiting for each of the worker's drivers */
+static int worker_flush_reqs(prober_worker_t *worker)
+{
+  int i;
+
+  for (i = 0; i < worker->drivers_cnt; i++) {
+    if (driver_flush_reqs(&worker->drivers[i]) != 0) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/** Account for the completion (by response, timeout, or abandonment) of the
+    probe outstanding for the given /24 */
+static void probe_done(prober_worker_t *worker,
+                       trinarkular_slash24_state_t *state)
+{
+  assert(state->last_probe_type != UNPROBED);
+
+  // a deferred probe was never sent
+  if (state->probe_driver == PROBE_DRIVER_DEFERRED) {
+    return;
+  }
+
+  worker->outstanding_probe_cnt--;
+  worker->ctl[CTL_CLASS(state->last_probe_type)].outstanding--;
+  worker->drivers[state->probe_driver].outstanding--;
+}
+
+/** Send a probe to the next host in the given /24 (the request is not sent
+    until the driver's batch is full or worker_flush_reqs is called) */
+static int send_slash24_probe(prober_worker_t *worker,
+                              trinarkular_slash24_t *s24,
+                              trinarkular_slash24_state_t *state)
+{
+  trinarkular_prober_t *prober = worker->prober;
+  uint32_t host_ip;
+  char ipbuf[INET_ADDRSTRLEN];
+  uint64_t now = zclock_time();
+
+  trinarkular_probe_req_t req = {
     0, PARAM(periodic_probe_timeout),
   };
   struct driver_wrap *dw;
 
-  int ret;
+  int ret;
+
+  // identify the appropriate host to probe
+  host_ip = trinarkular_probelist_get_next_host(s24, state);
+  req.target_ip = htonl(host_ip);
+  inet_ntop(AF_INET, &req.target_ip, ipbuf, INET_ADDRSTRLEN);
+
+  state->probe_seq++;
+  state->probe_driver = worker->drivers_next;
+  state->probe_sent = now / PROBE_SENT_UNIT;
+  worker->probe_cnt[state->last_probe_type]++;
+
+  // if no response arrives by the deadline, the probe is treated as
+  // unresponsive
+  if (trinarkular_timer_wheel_add(
+        worker->expiry_wheel,
+        now + (PARAM(periodic_probe_timeout) * 1000) +
+          PARAM(probe_expiry_grace),
+        s24->network_ip, state->probe_seq) != 0) {
+    trinarkular_log("ERROR: Could not track probe timeout");
+    return -1;
+  }
+
+  // the request is sent with the rest of the driver's batch
+  dw = &worker->drivers[worker->drivers_next];
+  dw->reqs[dw->reqs_cnt++] = req;
+  if (dw->reqs_cnt == REQ_BATCH_LEN && (ret = driver_flush_reqs(dw)) != 0) {
+    return -1;
+  }
+  dw->outstanding++;
+  if (dw->outstanding > worker->queue_depth_peak) {
+    worker->queue_depth_peak = dw->outstanding;
+  }
+  worker->ctl[CTL_CLASS(state->last_probe_type)].outstanding++;
+  worker->outstanding_probe_cnt++;
+  if (worker->outstanding_probe_cnt > worker->outstanding_peak) {
+    worker->outstanding_peak = worker->outstanding_probe_cnt;
+  }
+
+  // move on to the next driver ready for the next probe
+  worker->drivers_next = (worker->drivers_next + 1) % worker->drivers_cnt;
+
+  return 0;
+}
+
+/** Add an adaptive or recovery probe for the given /24 to the carry-over
+    queue */
+static int defer_slash24_probe(prober_worker_t *worker,
+                               trinarkular_slash24_t *s24,
+                               trinarkular_slash24_state_t *state)
+{
+  slash24_deferral_t *deferred;
+  slash24_deferral_t *d;
+  uint32_t alloc;
+
+  if (worker->deferred_cnt == worker->deferred_alloc) {
+    if (worker->deferred_head > 0) {
+      // reuse the space of deferrals that have already been sent
+      memmove(worker->deferred, &worker->deferred[worker->deferred_head],
+              sizeof(slash24_deferral_t) *
+                (worker->deferred_cnt - worker->deferred_head));
+      worker->deferred_cnt -= worker->deferred_head;
+      worker->deferred_head = 0;
+    } else {
+      alloc = (worker->deferred_alloc == 0) ? 1024 : worker->deferred_alloc * 2;
+      if ((deferred = realloc(worker->deferred,
+                              sizeof(slash24_deferral_t) * alloc)) == NULL) {
+        trinarkular_log("ERROR: Could not grow carry-over queue");
+        return -1;
+      }
+      worker->deferred = deferred;
+      worker->deferred_alloc = alloc;
+    }
+  }
+
+  // (a timeout or response for an earlier probe no longer matches)
+  state->probe_seq++;
+  state->probe_driver = PROBE_DRIVER_DEFERRED;
+
+  d = &worker->deferred[worker->deferred_cnt++];
+  d->network_ip = s24->network_ip;
+  d->probe_seq = state->probe_seq;
+  worker->ctl[CTL_FOLLOWUP].deferred_cnt++;
+
+  return 0;
+}
+
+/** Queue a probe for the given /24. Adaptive and recovery probes are deferred
+    if their window is full. (Periodic probes are limited by the caller) */
+static int queue_slash24_probe(prober_worker_t *worker,
+                               trinarkular_slash24_t *s24,
+                               trinarkular_slash24_state_t *state,
+                               int probe_type)
+{
+  rate_ctl_t *ctl = &worker->ctl[CTL_FOLLOWUP];
+
+  assert(state != NULL);
+  // slash24_state is valid here
+
+  // indicate that we are waiting for a response
+  state->last_probe_type = probe_type;
+
+  // decrement the probe budget (periodic doesn't affect this)
+  // (its up to the caller to ensure that we have enough probes in the budget)
+  if (probe_type == ADAPTIVE) {
+    assert(ADAPTIVE_BUDGET(state) > 0);
+    ADAPTIVE_BUDGET_SET(state, ADAPTIVE_BUDGET(state) - 1);
+  } else if (probe_type == RECOVERY) {
+    assert(RECOVERY_BUDGET(state) > 0);
+    RECOVERY_BUDGET_SET(state, RECOVERY_BUDGET(state) - 1);
+  }
+
+  // (probes that are already waiting go first)
+  if (probe_type != PERIODIC &&
+      (ctl->outstanding >= ctl->window ||
+       worker->deferred_head < worker->deferred_cnt)) {
+    return defer_slash24_probe(worker, s24, state);
+  }
+
+  // (state was modified in place, so there is nothing to save)
+
+  return send_slash24_probe(worker, s24, state);
+}
+
+/** Note that the given per-/24 key must be written in the next (delta)
+    flush */
+static void emit_key(trinarkular_prober_t *prober, uint32_t key)
+{
+  uint32_t *keys;
+  uint32_t alloc;
+
+  if (prober->emit_keys_cnt == prober->emit_keys_alloc) {
+    alloc = (prober->emit_keys_alloc == 0) ? 1024 : prober->emit_keys_alloc * 2;
+    if ((keys = realloc(prober->emit_keys, sizeof(uint32_t) * alloc)) ==
+        NULL) {
+      // write everything instead
+      trinarkular_log("WARN: Could not grow changed key list");
+      prober->keyframe_due = 1;
+      return;
+    }
+    prober->emit_keys = keys;
+    prober->emit_keys_alloc = alloc;
+  }
+  prober->emit_keys[prober->emit_keys_cnt++] = key;
+}
+
+/** Set the value of a per-/24 key in the snapshot, noting whether it changed
+    (if using delta emission) */
+static void snap_set(trinarkular_prober_t *prober, timeseries_kp_t *snap,
+                     uint32_t key, uint64_t value)
+{
+  // the snapshot holds the last value written for each key
+  if (PARAM(delta_keyframe_interval) != 0) {
+    if (timeseries_kp_get(snap, key) == value) {
+      return;
+    }
+    emit_key(prober, key);
+  }
+  timeseries_kp_set(snap, key, value);
+}
+
+/** Does the given /24 have (leaf) metadata that it has no per-/24 keys for? */
+static int slash24_keys_missing(probelist_state_t *pl_state,
+                                trinarkular_slash24_t *s24,
+                                trinarkular_slash24_state_t *state)
+{
+  int i;
+
+  for (i = 0; i < state->metrics_cnt; i++) {
+    if (state->metrics[i].belief == -1 &&
+        pl_state->md_metrics[s24->md[i]].blocks_prefix != NULL) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/** Queue the given /24 to have its per-/24 keys registered (once the KP
+    snapshots are not being flushed) */
+static void lazy_keys_add(trinarkular_prober_t *prober, uint32_t idx,
+                          trinarkular_slash24_state_t *state)
+{
+  uint32_t *lazy_keys;
+  uint32_t alloc;
+
+  if (prober->lazy_keys_cnt == prober->lazy_keys_alloc) {
+    alloc = (prober->lazy_keys_alloc == 0) ? 1024 : prober->lazy_keys_alloc * 2;
+    if ((lazy_keys = realloc(prober->lazy_keys, sizeof(uint32_t) * alloc)) ==
+        NULL) {
+      // the /24 will be queued again the next time it settles
+      trinarkular_log("WARN: Could not grow lazy key list");
+      return;
+    }
+    prober->lazy_keys = lazy_keys;
+    prober->lazy_keys_alloc = alloc;
+  }
+
+  prober->lazy_keys[prober->lazy_keys_cnt++] = idx;
+  state->dirty |= DIRTY_KEYS;
+}
+
+/** Register the per-/24 keys of the queued /24s, and set them to the last
+ * exported values of the /24s. The keys are resolved in a batch by the
+ * flusher (timeseries_kp_flush resolves any new keys first). Must only be
+ * called while the workers are paused and the flusher is idle. */
+static int lazy_keys_register(trinarkular_prober_t *prober)
+{
+  probelist_state_t *pl_state = &ACTIVE_PL_STATE(prober);
+  trinarkular_slash24_t *records =
+    trinarkular_probelist_get_slash24_array(pl_state->pl);
+  trinarkular_slash24_state_t *states =
+    trinarkular_probelist_get_slash24_state_array(pl_state->pl);
+  trinarkular_slash24_state_t *state;
+  trinarkular_slash24_metrics_t *metrics;
+  uint64_t belief;
+  uint32_t c;
+  int i;
+
+  for (c = 0; c < prober->lazy_keys_cnt; c++) {
+    state = &states[prober->lazy_keys[c]];
+    state->dirty &= ~DIRTY_KEYS;
+    if (slash24_keys_create(pl_state, &records[prober->lazy_keys[c]], state) !=
+        0) {
+      trinarkular_log("ERROR: Could not register per-/24 keys");
+      prober->lazy_keys_cnt = 0;
+      return -1;
+    }
+
+    belief = trinarkular_belief_to_prob(state->settled_belief) * 100;
+    for (i = 0; i < state->metrics_cnt; i++) {
+      metrics = &state->metrics[i];
+      if (metrics->belief != -1) {
+        timeseries_kp_set(pl_state->kp_slash24, metrics->belief, belief);
+        timeseries_kp_set(pl_state->kp_slash24_snap, metrics->belief, belief);
+      }
+      if (metrics->state != -1) {
+        timeseries_kp_set(pl_state->kp_slash24, metrics->state,
+                          state->exported_state);
+        timeseries_kp_set(pl_state->kp_slash24_snap, metrics->state,
+                          state->exported_state);
+      }
+      // new keys are always written
+      if (PARAM(delta_keyframe_interval) != 0 && metrics->belief != -1) {
+        emit_key(prober, metrics->belief);
+        emit_key(prober, metrics->state);
+        prober->active_keys_cnt += 2;
+      }
+    }
+  }
+  prober->lazy_keys_cnt = 0;
+
+  return 0;
+}
+
+/** Merge the per-round statistics of the workers, and update the state counts
+ * and timeseries values of the /24s that settled this round. The per-/24
+ * values are also written to the given snapshot (if not NULL). Must only be
+ * called while the workers are paused. */
+static void workers_merge_stats(trinarkular_prober_t *prober,
+                                timeseries_kp_t *snap)
+{
+  trinarkular_slash24_t *records =
+    trinarkular_probelist_get_slash24_array(ACTIVE_PL(prober));
+  trinarkular_slash24_state_t *states =
+    trinarkular_probelist_get_slash24_state_array(ACTIVE_PL(prober));
+  trinarkular_slash24_state_t *state = NULL;
+  prober_worker_t *worker = NULL;
+  int old_state, new_state;
+  uint64_t belief;
+  uint32_t c;
+  int i, w;
+
+  for (w = 0; w < prober->workers_cnt; w++) {
+    worker = &prober->workers[w];
+
+    for (i = UNPROBED; i < PROBE_TYPE_CNT; i++) {
+      ACTIVE_STAT(probe_cnt[i]) += worker->probe_cnt[i];
+      ACTIVE_STAT(probe_complete_cnt[i]) += worker->probe_complete_cnt[i];
+      ACTIVE_STAT(responsive_cnt[i]) += worker->responsive_cnt[i];
+    }
+    ACTIVE_STAT(outstanding_peak) += worker->outstanding_peak;
+    ACTIVE_STAT(expired_probe_cnt) += worker->expired_probe_cnt;
+    for (i = CTL_PERIODIC; i < CTL_CLASS_CNT; i++) {
+      ACTIVE_STAT(ctl_window[i]) += worker->ctl[i].window;
+      ACTIVE_STAT(ctl_decrease_cnt[i]) += worker->ctl[i].decrease_cnt;
+      ACTIVE_STAT(ctl_deferred_cnt[i]) += worker->ctl[i].deferred_cnt;
+    }
+    ACTIVE_STAT(unprobed_cnt) += worker->slash24s_cnt - worker->slash24_iter;
+    if (worker->queue_depth_peak > ACTIVE_STAT(queue_depth_peak)) {
+      ACTIVE_STAT(queue_depth_peak) = worker->queue_depth_peak;
+    }
+    if (worker->latency_peak > ACTIVE_STAT(latency_peak)) {
+      ACTIVE_STAT(latency_peak) = worker->latency_peak;
+    }
+
+    // each dirty /24 is exported once, with whatever it last settled on
+    for (c = 0; c < worker->dirty_cnt; c++) {
+      state = &states[worker->dirty[c]];
+      old_state = state->exported_state;
+      new_state = state->current_state;
+      belief = trinarkular_belief_to_prob(state->settled_belief) * 100;
+
+      // update overall belief stats (the per-metadata counts are recomputed
+      // once all changes are in)
+      if (old_state != new_state) {
+        ACTIVE_STAT(slash24_state_cnts[old_state])--;
+        ACTIVE_STAT(slash24_state_cnts[new_state])++;
+      }
+
+      // a /24 without keys only gets them once it leaves the UP state
+      if (PARAM(lazy_slash24_keys) != 0 && new_state != UP &&
+          (state->dirty & DIRTY_KEYS) == 0 &&
+          slash24_keys_missing(&ACTIVE_PL_STATE(prober),
+                               &records[worker->dirty[c]], state) != 0) {
+        lazy_keys_add(prober, worker->dirty[c], state);
+      }
+
+      // update the timeseries
+      for (i = 0; i < state->metrics_cnt; i++) {
+        if (state->metrics[i].belief != -1) {
+          timeseries_kp_set(ACTIVE_KP_SLASH24(prober), state->metrics[i].belief,
+                            belief);
+          if (snap != NULL) {
+            snap_set(prober, snap, state->metrics[i].belief, belief);
+          }
+        }
+        if (state->metrics[i].state != -1) {
+          timeseries_kp_set(ACTIVE_KP_SLASH24(prober), state->metrics[i].state,
+                            new_state);
+          if (snap != NULL) {
+            snap_set(prober, snap, state->metrics[i].state, new_state);
+          }
+        }
+      }
+
+      state->exported_state = new_state;
+      state->dirty &= ~DIRTY_EXPORT;
+    }
+    worker->dirty_cnt = 0;
+  }
+}
+
+/** Count the /24s in each state for each metadata in one part of the state
+    array */
+static void *md_reduce_run(void *data)
+{
+  md_reduce_part_t *part = (md_reduce_part_t *)data;
+  trinarkular_slash24_t *records = part->records;
+  trinarkular_slash24_state_t *states = part->states;
+  uint32_t *cnts = part->cnts;
+  uint32_t idx;
+  int i;
+
+  for (idx = part->first; idx < part->last; idx++) {
+    // (an uninitialized state has no metrics)
+    for (i = 0; i < states[idx].metrics_cnt; i++) {
+      cnts[records[idx].md[i] * BELIEF_STATE_CNT +
+           states[idx].current_state]++;
+    }
+  }
+
+  return NULL;
+}
+
+/** Recompute the per-metadata state counts of the active probelist, using
+ * (up to) one thread per worker, and write them to the aggregate KP. Must
+ * only be called while the workers are paused. */
+static int md_metrics_reduce(trinarkular_prober_t *prober)
+{
+  probelist_state_t *pl_state = &ACTIVE_PL_STATE(prober);
+  uint32_t slash24_cnt = trinarkular_probelist_get_slash24_cnt(pl_state->pl);
+  uint32_t cnts_len = pl_state->md_metrics_cnt * BELIEF_STATE_CNT;
+  md_reduce_part_t *parts = NULL;
+  pthread_t *threads = NULL;
+  int threads_cnt = prober->workers_cnt;
+  md_metrics_t *md_metrics;
+  uint32_t md_id;
+  uint64_t tmp;
+  uint32_t j;
+  int i, t, ret;
+
+  if ((uint32_t)threads_cnt > slash24_cnt / MD_REDUCE_MIN_SLASH24S) {
+    threads_cnt = slash24_cnt / MD_REDUCE_MIN_SLASH24S;
+  }
+  if (threads_cnt < 1) {
+    threads_cnt = 1;
+  }
+
+  if ((parts = malloc_zero(sizeof(md_reduce_part_t) * threads_cnt)) == NULL ||
+      (threads = malloc_zero(sizeof(pthread_t) * threads_cnt)) == NULL) {
+    trinarkular_log("ERROR: Could not allocate reduction threads");
+    goto err;
+  }
+
+  // the first part is counted directly into the state counts (by this thread)
+  memset(pl_state->md_state_cnts, 0, sizeof(uint32_t) * cnts_len);
+  for (t = 0; t < threads_cnt; t++) {
+    parts[t].records = trinarkular_probelist_get_slash24_array(pl_state->pl);
+    parts[t].states =
+      trinarkular_probelist_get_slash24_state_array(pl_state->pl);
+    parts[t].first = ((uint64_t)slash24_cnt * t) / threads_cnt;
+    parts[t].last = ((uint64_t)slash24_cnt * (t + 1)) / threads_cnt;
+    if (t == 0) {
+      parts[t].cnts = pl_state->md_state_cnts;
+    } else if ((parts[t].cnts = malloc_zero(sizeof(uint32_t) * cnts_len)) ==
+               NULL) {
+      trinarkular_log("ERROR: Could not allocate reduction counts");
+      goto err;
+    }
+  }
+
+  for (t = 1; t < threads_cnt; t++) {
+    if ((ret = pthread_create(&threads[t], NULL, md_reduce_run, &parts[t])) !=
+        0) {
+      // count this part ourselves instead
+      trinarkular_log("WARN: pthread_create() returned %d", ret);
+      md_reduce_run(&parts[t]);
+    } else {
+      parts[t].threaded = 1;
+    }
+  }
+  md_reduce_run(&parts[0]);
+
+  for (t = 1; t < threads_cnt; t++) {
+    if (parts[t].threaded != 0) {
+      pthread_join(threads[t], NULL);
+    }
+    for (j = 0; j < cnts_len; j++) {
+      pl_state->md_state_cnts[j] += parts[t].cnts[j];
+    }
+    free(parts[t].cnts);
+  }
+  free(parts);
+  free(threads);
+
+  // different metadata may share keys, so they are zeroed before any counts
+  // are added
+  for (md_id = 0; md_id < pl_state->md_metrics_cnt; md_id++) {
+    md_metrics = &pl_state->md_metrics[md_id];
+    if (md_metrics->overall[UP] == -1) {
+      continue;
+    }
+    for (i = UNCERTAIN; i < BELIEF_STATE_CNT; i++) {
+      timeseries_kp_set(pl_state->kp_aggr, md_metrics->overall[i], 0);
+    }
+  }
+  for (md_id = 0; md_id < pl_state->md_metrics_cnt; md_id++) {
+    md_metrics = &pl_state->md_metrics[md_id];
+    if (md_metrics->overall[UP] == -1) {
+      continue;
+    }
+    for (i = UNCERTAIN; i < BELIEF_STATE_CNT; i++) {
+      tmp = timeseries_kp_get(pl_state->kp_aggr, md_metrics->overall[i]);
+      timeseries_kp_set(
+        pl_state->kp_aggr, md_metrics->overall[i],
+        tmp + pl_state->md_state_cnts[md_id * BELIEF_STATE_CNT + i]);
+    }
+  }
+
+  return 0;
+
+err:
+  if (parts != NULL) {
+    for (t = 1; t < threads_cnt; t++) {
+      free(parts[t].cnts);
+    }
+  }
+  free(parts);
+  free(threads);
+  return -1;
+}
+
+/** Copy all values of the src KP to the dst KP (which has the same keys) */
+static void kp_copy_values(timeseries_kp_t *dst, timeseries_kp_t *src)
+{
+  int size = timeseries_kp_size(src);
+  int i;
+
+  for (i = 0; i < size; i++) {
+    timeseries_kp_set(dst, i, timeseries_kp_get(src, i));
+  }
+}
+
+/** Flush the KP snapshots that are handed over by the main thread */
+static void *flusher_run(void *data)
+{
+  trinarkular_prober_t *prober = (trinarkular_prober_t *)data;
+  timeseries_kp_t *kp_aggr, *kp_slash24;
+  uint32_t time;
+  int rc;
+
+  pthread_mutex_lock(&prober->flush_mutex);
+  while (1) {
+    while (prober->flush_kp_aggr == NULL && prober->flush_shutdown == 0) {
+      pthread_cond_wait(&prober->flush_cond, &prober->flush_mutex);
+    }
+    if (prober->flush_kp_aggr == NULL) {
+      // shutting down, and there is nothing left to flush
+      break;
+    }
+    kp_aggr = prober->flush_kp_aggr;
+    kp_slash24 = prober->flush_kp_slash24;
+    time = prober->flush_time;
+    pthread_mutex_unlock(&prober->flush_mutex);
+
+    // the main thread does not touch the snapshots until we are done
+    rc = 0;
+    if (timeseries_kp_flush(kp_aggr, time) != 0 ||
+        timeseries_kp_flush(kp_slash24, time) != 0) {
+      trinarkular_log("ERROR: Could not flush timeseries for %" PRIu32, time);
+      rc = -1;
+    }
+
+    pthread_mutex_lock(&prober->flush_mutex);
+    prober->flush_duration = zclock_time() - prober->flush_start;
+    if (rc != 0) {
+      prober->flush_failed_cnt++;
+    }
+    prober->flush_kp_aggr = NULL;
+    prober->flush_kp_slash24 = NULL;
+    pthread_cond_broadcast(&prober->flush_cond);
+  }
+  pthread_mutex_unlock(&prober->flush_mutex);
+
+  return NULL;
+}
+
+static int flusher_start(trinarkular_prober_t *prober)
+{
+  int ret;
+
+  if ((ret = pthread_create(&prober->flusher, NULL, flusher_run, prober)) !=
+      0) {
+    trinarkular_log("ERROR: pthread_create() returned %d", ret);
+    return -1;
+  }
+  prober->flusher_started = 1;
+  return 0;
+}
+
+/** Block until the flusher has finished with the snapshots (if it has them) */
+static void flusher_wait(trinarkular_prober_t *prober)
+{
+  pthread_mutex_lock(&prober->flush_mutex);
+  while (prober->flush_kp_aggr != NULL) {
+    pthread_cond_wait(&prober->flush_cond, &prober->flush_mutex);
+  }
+  pthread_mutex_unlock(&prober->flush_mutex);
+}
+
+/** Let the flusher finish any pending flush, and then stop it */
+static void flusher_stop(trinarkular_prober_t *prober)
+{
+  if (prober->flusher_started == 0) {
+    return;
+  }
+  pthread_mutex_lock(&prober->flush_mutex);
+  prober->flush_shutdown = 1;
+  pthread_cond_broadcast(&prober->flush_cond);
+  pthread_mutex_unlock(&prober->flush_mutex);
+
+  pthread_join(prober->flusher, NULL);
+  prober->flusher_started = 0;
+}
+
+/** Write the submitted checkpoint to a temporary file, and then rename it
+    over the previous checkpoint */
+static int checkpoint_write(trinarkular_prober_t *prober)
+{
+  char tmpname[1024];
+  FILE *fh = NULL;
+  checkpoint_hdr_t hdr;
+
+  if (snprintf(tmpname, sizeof(tmpname), "%s.tmp", prober->checkpoint_path) >=
+      (int)sizeof(tmpname)) {
+    trinarkular_log("ERROR: Checkpoint path too long");
+    return -1;
+  }
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, CKPT_MAGIC, sizeof(CKPT_MAGIC));
+  hdr.format_version = CKPT_VERSION;
+  hdr.byte_order = CKPT_BYTE_ORDER;
+  hdr.record_size = sizeof(checkpoint_rec_t);
+  hdr.version_len = strlen(prober->ckpt_version) + 1;
+  hdr.time = prober->ckpt_time;
+  hdr.slash24_cnt = prober->ckpt_recs_cnt;
+
+  if ((fh = fopen(tmpname, "wb")) == NULL) {
+    trinarkular_log("ERROR: Could not create %s (%s)", tmpname,
+                    strerror(errno));
+    goto err;
+  }
+  // the data must be on disk before the rename makes it the checkpoint
+  if (fwrite(&hdr, sizeof(hdr), 1, fh) != 1 ||
+      fwrite(prober->ckpt_version, hdr.version_len, 1, fh) != 1 ||
+      fwrite(prober->ckpt_recs, sizeof(checkpoint_rec_t),
+             prober->ckpt_recs_cnt, fh) != prober->ckpt_recs_cnt ||
+      fflush(fh) != 0 || fsync(fileno(fh)) != 0) {
+    trinarkular_log("ERROR: Could not write %s (%s)", tmpname,
+                    strerror(errno));
+    goto err;
+  }
+  if (fclose(fh) != 0) {
+    fh = NULL;
+    trinarkular_log("ERROR: Could not write %s (%s)", tmpname,
+                    strerror(errno));
+    goto err;
+  }
+  fh = NULL;
+
+  if (rename(tmpname, prober->checkpoint_path) != 0) {
+    trinarkular_log("ERROR: Could not rename %s (%s)", tmpname,
+                    strerror(errno));
+    goto err;
+  }
+
+  return 0;
+
+err:
+  if (fh != NULL) {
+    fclose(fh);
+  }
+  unlink(tmpname);
+  return -1;
+}
+
+/** Checkpoint thread: writes each checkpoint that the main thread submits */
+static void *checkpointer_run(void *data)
+{
+  trinarkular_prober_t *prober = (trinarkular_prober_t *)data;
+  uint64_t start;
+  int rc;
+
+  pthread_mutex_lock(&prober->ckpt_mutex);
+  while (1) {
+    while (prober->ckpt_pending == 0 && prober->ckpt_shutdown == 0) {
+      pthread_cond_wait(&prober->ckpt_cond, &prober->ckpt_mutex);
+    }
+    if (prober->ckpt_pending == 0) {
+      // shutting down, and there is nothing left to write
+      break;
+    }
+    pthread_mutex_unlock(&prober->ckpt_mutex);
+
+    // the main thread does not touch the job until we are done
+    start = zclock_time();
+    if ((rc = checkpoint_write(prober)) == 0) {
+      trinarkular_log("Checkpointed %" PRIu64 " /24s in %" PRIu64 "ms",
+                      prober->ckpt_recs_cnt, zclock_time() - start);
+    }
+
+    pthread_mutex_lock(&prober->ckpt_mutex);
+    if (rc != 0) {
+      prober->ckpt_failed_cnt++;
+    }
+    prober->ckpt_pending = 0;
+    pthread_cond_broadcast(&prober->ckpt_cond);
+  }
+  pthread_mutex_unlock(&prober->ckpt_mutex);
+
+  return NULL;
+}
+
+static int checkpointer_start(trinarkular_prober_t *prober)
+{
+  int ret;
+
+  if (prober->checkpoint_path == NULL || PARAM(checkpoint_interval) == 0) {
+    return 0;
+  }
+
+  if ((ret = pthread_create(&prober->checkpointer, NULL, checkpointer_run,
+                            prober)) != 0) {
+    trinarkular_log("ERROR: pthread_create() returned %d", ret);
+    return -1;
+  }
+  prober->checkpointer_started = 1;
+  // the first checkpoint is taken after one interval
+  prober->ckpt_last = zclock_time();
+  return 0;
+}
+
+/** Let the checkpoint thread finish any pending checkpoint, and then stop
+    it */
+static void checkpointer_stop(trinarkular_prober_t *prober)
+{
+  if (prober->checkpointer_started == 0) {
+    return;
+  }
+  pthread_mutex_lock(&prober->ckpt_mutex);
+  prober->ckpt_shutdown = 1;
+  pthread_cond_broadcast(&prober->ckpt_cond);
+  pthread_mutex_unlock(&prober->ckpt_mutex);
+
+  pthread_join(prober->checkpointer, NULL);
+  prober->checkpointer_started = 0;
+}
+
+/** If a checkpoint is due, copy the state of every /24 and submit it to the
+    checkpoint thread (must be called while the workers are paused). Only the
+    copy is done in the main thread. */
+static int checkpoint_submit(trinarkular_prober_t *prober, uint64_t now)
+{
+  trinarkular_probelist_t *pl = ACTIVE_PL(prober);
+  trinarkular_slash24_t *records = trinarkular_probelist_get_slash24_array(pl);
+  trinarkular_slash24_state_t *states =
+    trinarkular_probelist_get_slash24_state_array(pl);
+  uint32_t slash24_cnt = trinarkular_probelist_get_slash24_cnt(pl);
+  checkpoint_rec_t *recs;
+  int busy;
+  uint32_t i;
+
+  if (prober->checkpointer_started == 0 ||
+      now - prober->ckpt_last < PARAM(checkpoint_interval)) {
+    return 0;
+  }
+
+  pthread_mutex_lock(&prober->ckpt_mutex);
+  busy = prober->ckpt_pending;
+  pthread_mutex_unlock(&prober->ckpt_mutex);
+  if (busy != 0) {
+    trinarkular_log("WARN: Previous checkpoint still being written, skipping");
+    return 0;
+  }
+  prober->ckpt_last = now;
+
+  // the checkpoint thread is idle, so the job can be filled in without
+  // holding the lock
+  if (slash24_cnt > prober->ckpt_recs_alloc) {
+    if ((recs = realloc(prober->ckpt_recs,
+                        sizeof(checkpoint_rec_t) * slash24_cnt)) == NULL) {
+      trinarkular_log("ERROR: Could not allocate checkpoint");
+      return -1;
+    }
+    prober->ckpt_recs = recs;
+    prober->ckpt_recs_alloc = slash24_cnt;
+  }
+  free(prober->ckpt_version);
+  if ((prober->ckpt_version = strdup(trinarkular_probelist_get_version(pl))) ==
+      NULL) {
+    trinarkular_log("ERROR: Could not copy probelist version");
+    return -1;
+  }
+
+  // the settled (rather than current) belief is saved, since a /24 that is
+  // being adaptively probed has not yet made up its mind
+  recs = prober->ckpt_recs;
+  for (i = 0; i < slash24_cnt; i++) {
+    recs[i].network_ip = records[i].network_ip;
+    recs[i].belief = states[i].settled_belief;
+    recs[i].state = states[i].current_state;
+    recs[i].rounds_since_up = states[i].rounds_since_up;
+  }
+  prober->ckpt_recs_cnt = slash24_cnt;
+  prober->ckpt_time = now;
+
+  pthread_mutex_lock(&prober->ckpt_mutex);
+  prober->ckpt_pending = 1;
+  pthread_cond_broadcast(&prober->ckpt_cond);
+  pthread_mutex_unlock(&prober->ckpt_mutex);
+
+  return 0;
+}
+
+/** Copy all per-/24 values of the live KP to the snapshot, noting which
+    changed (if using delta emission) */
+static void snap_copy_slash24(trinarkular_prober_t *prober)
+{
+  timeseries_kp_t *src = ACTIVE_KP_SLASH24(prober);
+  timeseries_kp_t *snap = ACTIVE_PL_STATE(prober).kp_slash24_snap;
+  int size = timeseries_kp_size(src);
+  int i;
+
+  for (i = 0; i < size; i++) {
+    snap_set(prober, snap, i, timeseries_kp_get(src, i));
+  }
+}
+
+/** Enable (or disable) the per-/24 keys of every /24 of the active probelist
+    in the snapshot, returning the number of keys */
+static uint32_t snap_enable_all(trinarkular_prober_t *prober, int enable)
+{
+  trinarkular_probelist_t *pl = ACTIVE_PL(prober);
+  trinarkular_slash24_state_t *states =
+    trinarkular_probelist_get_slash24_state_array(pl);
+  timeseries_kp_t *snap = ACTIVE_PL_STATE(prober).kp_slash24_snap;
+  uint32_t slash24_cnt = trinarkular_probelist_get_slash24_cnt(pl);
+  trinarkular_slash24_metrics_t *metrics;
+  uint32_t cnt = 0;
+  uint32_t idx;
+  int i;
+
+  for (idx = 0; idx < slash24_cnt; idx++) {
+    for (i = 0; i < states[idx].metrics_cnt; i++) {
+      metrics = &states[idx].metrics[i];
+      if (metrics->belief == -1) {
+        continue;
+      }
+      if (enable != 0) {
+        timeseries_kp_enable_key(snap, metrics->belief);
+        timeseries_kp_enable_key(snap, metrics->state);
+      } else {
+        timeseries_kp_disable_key(snap, metrics->belief);
+        timeseries_kp_disable_key(snap, metrics->state);
+      }
+      cnt += 2;
+    }
+  }
+  return cnt;
+}
+
+/** Enable only the per-/24 keys that are to be written in this flush (i.e.,
+ * those that changed, or all of them if this is a keyframe), and set the
+ * emission metrics. Must only be called while the flusher is idle. */
+static void delta_prepare(trinarkular_prober_t *prober)
+{
+  timeseries_kp_t *snap = ACTIVE_PL_STATE(prober).kp_slash24_snap;
+  uint32_t *keys;
+  uint32_t alloc;
+  uint32_t i;
+
+  if (prober->keyframe_due != 0 ||
+      prober->delta_rounds + 1 >= PARAM(delta_keyframe_interval)) {
+    trinarkular_log("Writing per-/24 keyframe");
+    prober->active_keys_cnt = snap_enable_all(prober, 1);
+    prober->emitted_all = 1;
+    prober->emit_keys_cnt = 0;
+    prober->keyframe_due = 0;
+    prober->delta_rounds = 0;
+
+    if (ACTIVE_METRICS(prober).flush_emitted_cnt != -1) {
+      timeseries_kp_set(ACTIVE_KP_AGGR(prober),
+                        ACTIVE_METRICS(prober).flush_emitted_cnt,
+                        prober->active_keys_cnt);
+      timeseries_kp_set(ACTIVE_KP_AGGR(prober),
+                        ACTIVE_METRICS(prober).flush_suppressed_cnt, 0);
+    }
+    return;
+  }
+
+  // stop writing whatever was written last time
+  if (prober->emitted_all != 0) {
+    snap_enable_all(prober, 0);
+    prober->emitted_all = 0;
+  } else {
+    for (i = 0; i < prober->emitted_keys_cnt; i++) {
+      timeseries_kp_disable_key(snap, prober->emitted_keys[i]);
+    }
+  }
+
+  for (i = 0; i < prober->emit_keys_cnt; i++) {
+    timeseries_kp_enable_key(snap, prober->emit_keys[i]);
+  }
+
+  if (ACTIVE_METRICS(prober).flush_emitted_cnt != -1) {
+    timeseries_kp_set(ACTIVE_KP_AGGR(prober),
+                      ACTIVE_METRICS(prober).flush_emitted_cnt,
+                      prober->emit_keys_cnt);
+    timeseries_kp_set(ACTIVE_KP_AGGR(prober),
+                      ACTIVE_METRICS(prober).flush_suppressed_cnt,
+                      (prober->active_keys_cnt > prober->emit_keys_cnt)
+                        ? prober->active_keys_cnt - prober->emit_keys_cnt
+                        : 0);
+  }
+
+  // the keys written now are the ones to disable next time
+  keys = prober->emitted_keys;
+  alloc = prober->emitted_keys_alloc;
+  prober->emitted_keys = prober->emit_keys;
+  prober->emitted_keys_cnt = prober->emit_keys_cnt;
+  prober->emitted_keys_alloc = prober->emit_keys_alloc;
+  prober->emit_keys = keys;
+  prober->emit_keys_cnt = 0;
+  prober->emit_keys_alloc = alloc;
+
+  prober->delta_rounds++;
+}
+
+static int end_of_round(trinarkular_prober_t *prober, int round_id)
+{
+  uint64_t now = zclock_time();
+  uint64_t aligned_start =
+    ((uint64_t)(ACTIVE_STAT(start_time) / PARAM(periodic_round_duration))) *
+    PARAM(periodic_round_duration);
+  uint64_t flush_duration, flush_backlog;
+  uint32_t flush_failed_cnt;
+  int flush_busy;
+  uint64_t events_dropped_cnt = 0;
+  int i;
+
+  // the flusher may still be writing the previous round
+  pthread_mutex_lock(&prober->flush_mutex);
+  flush_busy = (prober->flush_kp_aggr != NULL);
+  flush_backlog = flush_busy ? now - prober->flush_start : 0;
+  flush_duration = prober->flush_duration;
+  flush_failed_cnt = prober->flush_failed_cnt;
+  pthread_mutex_unlock(&prober->flush_mutex);
+
+  // the workers write the entries of the state table as /24s settle, so only
+  // the completed round is recorded here
+  if (prober->state_table != NULL) {
+    trinarkular_state_table_begin_update(prober->state_table);
+    trinarkular_state_table_set_round(prober->state_table, round_id, now);
+    trinarkular_state_table_end_update(prober->state_table);
+  }
+
+  // if the per-/24 snapshot is up to date, only the /24s that settled this
+  // round need to be copied to it
+  workers_merge_stats(prober, (flush_busy == 0 && prober->snap_stale == 0)
+                                ? ACTIVE_PL_STATE(prober).kp_slash24_snap
+                                : NULL);
+
+  if (md_metrics_reduce(prober) != 0) {
+    trinarkular_log("WARN: Could not count /24s per metadata");
+  }
+
+  // new per-/24 keys can only be added while the flusher is idle (otherwise
+  // they wait until the next round)
+  if (flush_busy == 0 && prober->lazy_keys_cnt > 0) {
+    trinarkular_log("Registering per-/24 keys for %" PRIu32 " /24s",
+                    prober->lazy_keys_cnt);
+    if (lazy_keys_register(prober) != 0) {
+      trinarkular_log("WARN: Could not register per-/24 keys");
+    }
+  }
+
+  if (checkpoint_submit(prober, now) != 0) {
+    trinarkular_log("WARN: Could not checkpoint /24 state");
+  }
+
+  timeseries_kp_set(ACTIVE_KP_AGGR(prober),
+                    ACTIVE_METRICS(prober).round_id, round_id);
+  timeseries_kp_set(ACTIVE_KP_AGGR(prober),
+                    ACTIVE_METRICS(prober).round_duration,
+                    now - ACTIVE_STAT(start_time));
+
+  for (i = PERIODIC; i < PROBE_TYPE_CNT; i++) {
+    timeseries_kp_set(ACTIVE_KP_AGGR(prober),
+                      ACTIVE_METRICS(prober).round_probe_cnt[i],
+                      ACTIVE_STAT(probe_cnt[i]));
+    timeseries_kp_set(ACTIVE_KP_AGGR(prober),
+                      ACTIVE_METRICS(prober).round_probe_complete_cnt[i],
+                      ACTIVE_STAT(probe_complete_cnt[i]));
+    timeseries_kp_set(ACTIVE_KP_AGGR(prober),
+                      ACTIVE_METRICS(prober).round_responsive_cnt[i],
+                      ACTIVE_STAT(responsive_cnt[i]));
+  }
+
+  for (i = UNCERTAIN; i < BELIEF_STATE_CNT; i++) {
+    timeseries_kp_set(ACTIVE_KP_AGGR(prober),
+                      ACTIVE_METRICS(prober).slash24_state_cnts[i],
+                      ACTIVE_STAT(slash24_state_cnts[i]));
+  }
+
+  timeseries_kp_set(ACTIVE_KP_AGGR(prober), ACTIVE_METRICS(prober).slash24_cnt,
+                    ACTIVE_STAT(slash24_cnt));
+
+  timeseries_kp_set(ACTIVE_KP_AGGR(prober),
+                    ACTIVE_METRICS(prober).outstanding_peak,
+                    ACTIVE_STAT(outstanding_peak));
+
+  timeseries_kp_set(ACTIVE_KP_AGGR(prober),
+                    ACTIVE_METRICS(prober).expired_probe_cnt,
+                    ACTIVE_STAT(expired_probe_cnt));
+
+  for (i = CTL_PERIODIC; i < CTL_CLASS_CNT; i++) {
+    timeseries_kp_set(ACTIVE_KP_AGGR(prober),
+                      ACTIVE_METRICS(prober).ctl_window[i],
+                      ACTIVE_STAT(ctl_window[i]));
+    timeseries_kp_set(ACTIVE_KP_AGGR(prober),
+                      ACTIVE_METRICS(prober).ctl_decrease_cnt[i],
+                      ACTIVE_STAT(ctl_decrease_cnt[i]));
+    timeseries_kp_set(ACTIVE_KP_AGGR(prober),
+                      ACTIVE_METRICS(prober).ctl_deferred_cnt[i],
+                      ACTIVE_STAT(ctl_deferred_cnt[i]));
+  }
+  timeseries_kp_set(ACTIVE_KP_AGGR(prober),
+                    ACTIVE_METRICS(prober).unprobed_cnt,
+                    ACTIVE_STAT(unprobed_cnt));
+  timeseries_kp_set(ACTIVE_KP_AGGR(prober),
+                    ACTIVE_METRICS(prober).queue_depth_peak,
+                    ACTIVE_STAT(queue_depth_peak));
+  timeseries_kp_set(ACTIVE_KP_AGGR(prober),
+                    ACTIVE_METRICS(prober).latency_peak,
+                    ACTIVE_STAT(latency_peak));
+
+  if (flush_busy != 0) {
+    prober->flush_skipped_cnt++;
+  }
+  timeseries_kp_set(ACTIVE_KP_AGGR(prober),
+                    ACTIVE_METRICS(prober).flush_duration, flush_duration);
+  timeseries_kp_set(ACTIVE_KP_AGGR(prober),
+                    ACTIVE_METRICS(prober).flush_backlog, flush_backlog);
+  timeseries_kp_set(ACTIVE_KP_AGGR(prober),
+                    ACTIVE_METRICS(prober).flush_failed_cnt, flush_failed_cnt);
+  timeseries_kp_set(ACTIVE_KP_AGGR(prober),
+                    ACTIVE_METRICS(prober).flush_skipped_cnt,
+                    prober->flush_skipped_cnt);
+
+  // the workers are paused, so their counters can be read
+  if (ACTIVE_METRICS(prober).events_published_cnt != -1) {
+    for (i = 0; i < prober->workers_cnt; i++) {
+      events_dropped_cnt += prober->workers[i].events_dropped_cnt;
+    }
+    timeseries_kp_set(ACTIVE_KP_AGGR(prober),
+                      ACTIVE_METRICS(prober).events_published_cnt,
+                      prober->events_published_cnt);
+    timeseries_kp_set(ACTIVE_KP_AGGR(prober),
+                      ACTIVE_METRICS(prober).events_dropped_cnt,
+                      events_dropped_cnt);
+  }
+
+  trinarkular_log("round %d completed in %" PRIu64 "ms (ideal: %" PRIu64 "ms)",
+                  round_id, now - ACTIVE_STAT(start_time),
+                  PARAM(periodic_round_duration));
+  trinarkular_log("round periodic response rate: %d/%d (%0.0f%%)",
+                  ACTIVE_STAT(responsive_cnt[PERIODIC]),
+                  ACTIVE_STAT(probe_cnt[PERIODIC]),
+                  ACTIVE_STAT(responsive_cnt[PERIODIC]) * 100.0 /
+                    ACTIVE_STAT(probe_cnt[PERIODIC]));
+
+  if (flush_busy != 0) {
+    // rather than stall probing, this round is not written. the live KPs are
+    // up to date, so the next snapshot will include its changes
+    trinarkular_log("WARN: Previous flush still running after %" PRIu64 "ms, "
+                    "skipping flush of round %d",
+                    flush_backlog, round_id);
+    prober->snap_stale = 1;
+    return 0;
+  }
+
+  // update the snapshots and hand them to the flusher
+  if (prober->snap_stale != 0) {
+    snap_copy_slash24(prober);
+    prober->snap_stale = 0;
+  }
+  if (PARAM(delta_keyframe_interval) != 0) {
+    delta_prepare(prober);
+  }
+  kp_copy_values(ACTIVE_PL_STATE(prober).kp_aggr_snap, ACTIVE_KP_AGGR(prober));
+
+  pthread_mutex_lock(&prober->flush_mutex);
+  prober->flush_kp_aggr = ACTIVE_PL_STATE(prober).kp_aggr_snap;
+  prober->flush_kp_slash24 = ACTIVE_PL_STATE(prober).kp_slash24_snap;
+  prober->flush_time = aligned_start / 1000;
+  prober->flush_start = now;
+  pthread_cond_signal(&prober->flush_cond);
+  pthread_mutex_unlock(&prober->flush_mutex);
+
+  return 0;
+}
+
+int probelist_state_destroy(probelist_state_t *pl_state)
+{
+  uint32_t i;
+
+  trinarkular_probelist_destroy(pl_state->pl);
+  pl_state->pl = NULL;
+
+  for (i = 0; i < pl_state->md_metrics_cnt; i++) {
+    free(pl_state->md_metrics[i].blocks_prefix);
+  }
+  free(pl_state->md_metrics);
+  pl_state->md_metrics = NULL;
+  free(pl_state->md_state_cnts);
+  pl_state->md_state_cnts = NULL;
+  pl_state->md_metrics_cnt = 0;
+
+  // destroy the key packages
+  timeseries_kp_free(&pl_state->kp_slash24);
+  pl_state->kp_slash24 = NULL;
+  timeseries_kp_free(&pl_state->kp_aggr);
+  pl_state->kp_aggr = NULL;
+  timeseries_kp_free(&pl_state->kp_slash24_snap);
+  pl_state->kp_slash24_snap = NULL;
+  timeseries_kp_free(&pl_state->kp_aggr_snap);
+  pl_state->kp_aggr_snap = NULL;
+
+  return 0;
+}
+
+/** Make sure there are metrics for every metadata in the probelist */
+static int md_metrics_grow(probelist_state_t *pl_state)
+{
+  uint32_t md_cnt = trinarkular_probelist_get_md_cnt(pl_state->pl);
+  uint32_t md_id;
+  md_metrics_t *md_metrics;
+  uint32_t *md_state_cnts;
+  int i;
+
+  if (md_cnt <= pl_state->md_metrics_cnt) {
+    return 0;
+  }
+  if ((md_metrics = realloc(pl_state->md_metrics,
+                            sizeof(md_metrics_t) * md_cnt)) == NULL) {
+    trinarkular_log("ERROR: Could not allocate metadata metrics");
+    return -1;
+  }
+  pl_state->md_metrics = md_metrics;
+  if ((md_state_cnts =
+         realloc(pl_state->md_state_cnts,
+                 sizeof(uint32_t) * md_cnt * BELIEF_STATE_CNT)) == NULL) {
+    trinarkular_log("ERROR: Could not allocate metadata state counts");
+    return -1;
+  }
+  pl_state->md_state_cnts = md_state_cnts;
+
+  // keys are created as they are first needed
+  for (md_id = pl_state->md_metrics_cnt; md_id < md_cnt; md_id++) {
+    for (i = UNCERTAIN; i < BELIEF_STATE_CNT; i++) {
+      md_metrics[md_id].overall[i] = -1;
+    }
+    md_metrics[md_id].blocks_prefix = NULL;
+    md_metrics[md_id].blocks_prefix_len = 0;
+  }
+  pl_state->md_metrics_cnt = md_cnt;
+
+  return 0;
+}
+
+/** Force libtimeseries to resolve all keys in the given KP */
+static int resolve_kp(timeseries_kp_t *kp, const char *name)
+{
+  trinarkular_log("Resolving %d timeseries keys (%s KP)",
+                  timeseries_kp_size(kp), name);
+  while (timeseries_kp_resolve(kp) != 0) {
+    trinarkular_log("WARN: Could not resolve timeseries keys. Retrying");
+    if (sleep(10) != 0) {
+      trinarkular_log("WARN: Sleep interrupted, exiting");
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/** Remove a /24 from the statistics and disable its per-/24 keys */
+static void slash24_state_remove(probelist_state_t *pl_state,
+                                 trinarkular_slash24_state_t *state)
+{
+  int i;
+
+  for (i = 0; i < state->metrics_cnt; i++) {
+    if (state->metrics[i].belief != -1) {
+      timeseries_kp_disable_key(pl_state->kp_slash24,
+                                state->metrics[i].belief);
+      timeseries_kp_disable_key(pl_state->kp_slash24_snap,
+                                state->metrics[i].belief);
+    }
+    if (state->metrics[i].state != -1) {
+      timeseries_kp_disable_key(pl_state->kp_slash24, state->metrics[i].state);
+      timeseries_kp_disable_key(pl_state->kp_slash24_snap,
+                                state->metrics[i].state);
+    }
+  }
+  pl_state->stats.slash24_state_cnts[state->current_state]--;
+  pl_state->stats.slash24_cnt--;
+}
+
+/** Load the new probelist and compute its differences from the active one.
+ * The active probelist is only read (and not modified by the main thread
+ * while a reload is running), so this is safe to run in the reload thread. */
+static int trinarkular_prober_prepare_probelist_diff(
+  trinarkular_prober_t *prober)
+{
+  trinarkular_log("Preparing probelist diff");
+
+  assert(NEXT_PL(prober) == NULL);
+
+  if ((NEXT_PL(prober) =
+       trinarkular_probelist_create_threaded(
+         prober->probelist_filename, PARAM(probelist_threads))) == NULL) {
+    trinarkular_log("ERROR: Could not create probelist file");
+    goto err;
+  }
+
+  if (trinarkular_probelist_diff(ACTIVE_PL(prober), NEXT_PL(prober),
+                                 &prober->reload_diff) != 0) {
+    goto err;
+  }
+  prober->reload_is_diff = 1;
+
+  trinarkular_log("Probelist diff: %d added, %d removed, %d updated /24s",
+                  prober->reload_diff.added_cnt,
+                  prober->reload_diff.removed_cnt,
+                  prober->reload_diff.updated_cnt);
+
+  return 0;
+
+err:
+  probelist_state_destroy(&NEXT_PL_STATE(prober));
+  prober->reload_probelist_state = PROBELIST_RELOAD_NONE;
+  return -1;
+}
+
+/** Apply the reload diff to the active probelist state. Unchanged /24s keep
+ * their belief state and timeseries keys. */
+static int apply_probelist_diff(trinarkular_prober_t *prober)
+{
+  probelist_state_t *pl_state = &ACTIVE_PL_STATE(prober);
+  trinarkular_probelist_diff_t *diff = &prober->reload_diff;
+  trinarkular_slash24_t *s24 = NULL;
+  trinarkular_slash24_state_t *state = NULL;
+  int i;
+
+  // removed /24s (including those whose metadata changed)
+  for (i = 0; i < diff->removed_cnt; i++) {
+    if ((s24 = trinarkular_probelist_get_slash24(pl_state->pl,
+                                                 diff->removed[i])) != NULL &&
+        (state = trinarkular_probelist_get_slash24_state(pl_state->pl, s24)) !=
+          NULL) {
+      // a response to a probe still in flight will not find the /24
+      if (state->last_probe_type != UNPROBED) {
+        probe_done(&prober->workers[WORKER_ID(prober, s24->network_ip)],
+                   state);
+      }
+      slash24_state_remove(pl_state, state);
+    }
+  }
+  if (trinarkular_probelist_remove_slash24s(pl_state->pl, diff->removed,
+                                            diff->removed_cnt) != 0) {
+    return -1;
+  }
+
+  // /24s with new hosts (state is retained)
+  for (i = 0; i < diff->updated_cnt; i++) {
+    if (trinarkular_probelist_update_slash24(pl_state->pl, diff->updated[i]) !=
+        0) {
+      return -1;
+    }
+  }
+
+  // new /24s start in the UP state, just as they do for a full reload
+  if (trinarkular_probelist_add_slash24s(pl_state->pl, NEXT_PL(prober),
+                                         diff->added, diff->added_cnt) != 0 ||
+      md_metrics_grow(pl_state) != 0) {
+    return -1;
+  }
+  for (i = 0; i < diff->added_cnt; i++) {
+    if ((s24 = trinarkular_probelist_get_slash24(
+           pl_state->pl, diff->added[i]->network_ip)) == NULL ||
+        (state = slash24_state_create(prober, pl_state, s24)) == NULL ||
+        (PARAM(lazy_slash24_keys) == 0 &&
+         slash24_keys_create(pl_state, s24, state) != 0)) {
+      trinarkular_log("ERROR: Could not create /24 state");
+      return -1;
+    }
+  }
+
+  if (diff->added_cnt > 0 &&
+      ((PARAM(lazy_slash24_keys) == 0 &&
+        resolve_kp(pl_state->kp_slash24_snap, "Per-/24") != 0) ||
+       resolve_kp(pl_state->kp_aggr_snap, "Aggregate") != 0)) {
+    return -1;
+  }
+
+  if (trinarkular_probelist_set_version(
+        pl_state->pl, trinarkular_probelist_get_version(NEXT_PL(prober))) !=
+      0) {
+    return -1;
+  }
+
+  // only the entries of the /24s that came and went change (updated /24s keep
+  // their state)
+  if (prober->state_table != NULL) {
+    trinarkular_state_table_begin_update(prober->state_table);
+    for (i = 0; i < diff->removed_cnt; i++) {
+      trinarkular_state_table_unset(prober->state_table, diff->removed[i]);
+    }
+    for (i = 0; i < diff->added_cnt; i++) {
+      s24 = trinarkular_probelist_get_slash24(pl_state->pl,
+                                              diff->added[i]->network_ip);
+      state = trinarkular_probelist_get_slash24_state(pl_state->pl, s24);
+      trinarkular_state_table_set(prober->state_table, s24->network_ip,
+                                  state->settled_belief, state->current_state);
+    }
+    trinarkular_state_table_end_update(prober->state_table);
+  }
+
+  return 0;
+}
+
+/** Create the key packages, statistics and /24 states for the (already
+ * loaded) next probelist */
+static int next_probelist_state_init(trinarkular_prober_t *prober)
+{
+  int i = 0;
+  trinarkular_slash24_t *s24 = NULL;
+
+  // re-initialize key packages
+  if (init_kp(prober) != 0) {
+    trinarkular_log("ERROR: Could not create timeseries key package");
+    goto err;
+  }
+
+  // per-metadata metrics are created as they are first needed
+  if (md_metrics_grow(&NEXT_PL_STATE(prober)) != 0) {
+    goto err;
+  }
+
+  // re-initialize statistics
+  for (i = UNCERTAIN; i < BELIEF_STATE_CNT; i++) {
+      NEXT_PL_STATE(prober).stats.slash24_state_cnts[i] = 0;
+  }
+  NEXT_PL_STATE(prober).stats.slash24_cnt = 0;
+
+  // and create all the state (including aggregate timeseries metrics)
+  trinarkular_probelist_reset_slash24_iter(NEXT_PL(prober));
+
+  // iterates over the entire probelist.
+  while ((s24 =
+          trinarkular_probelist_get_next_slash24(NEXT_PL(prober))) != NULL) {
+    if (slash24_state_create(prober, &NEXT_PL_STATE(prober), s24) == NULL) {
+      trinarkular_log("ERROR: Could not create /24 state");
+      goto err;
+    }
+  }
+
+  // followed by the per-/24 metrics (in bulk), unless they are created as
+  // each /24 first changes state
+  if (PARAM(lazy_slash24_keys) == 0 &&
+      slash24_keys_bulk_create(prober, &NEXT_PL_STATE(prober)) != 0) {
+    goto err;
+  }
+
+  // force libtimeseries to resolve all keys (only the snapshots are flushed)
+  if (resolve_kp(NEXT_KP_SLASH24_SNAP(prober), "Per-/24") != 0 ||
+      resolve_kp(NEXT_KP_AGGR_SNAP(prober), "Aggregate") != 0) {
+    return -1;
+  }
+
+  return 0;
+
+err:
+  return -1;
+}
+
+static int trinarkular_prober_prepare_probelist(trinarkular_prober_t *prober)
+{
+  trinarkular_log("Preparing probelist to be assigned");
+
+  assert(NEXT_PL(prober) == NULL);
+
+  // create new probelist
+  if ((NEXT_PL(prober) =
+       trinarkular_probelist_create_threaded(
+         prober->probelist_filename, PARAM(probelist_threads))) == NULL) {
+    trinarkular_log("ERROR: Could not create probelist file");
+    goto err;
+  }
+
+  if (next_probelist_state_init(prober) != 0) {
+    goto err;
+  }
+
+  return 0;
+
+err:
+  probelist_state_destroy(&NEXT_PL_STATE(prober));
+  prober->reload_probelist_state = PROBELIST_RELOAD_NONE;
+  return -1;
+}
+
+/** Partition the active probelist across the workers. Must only be called
+ * while the workers are paused (or before they have been started). */
+static int workers_partition(trinarkular_prober_t *prober)
+{
+  trinarkular_probelist_t *pl = ACTIVE_PL(prober);
+  trinarkular_slash24_t *records = trinarkular_probelist_get_slash24_array(pl);
+  trinarkular_slash24_t *s24 = NULL;
+  prober_worker_t *worker = NULL;
+  rate_ctl_t *ctl = NULL;
+  uint32_t *slash24s;
+  uint32_t cnt;
+  int i, w;
+
+  // count the /24s owned by each worker
+  for (w = 0; w < prober->workers_cnt; w++) {
+    prober->workers[w].slash24s_cnt = 0;
+  }
+  trinarkular_probelist_reset_slash24_iter(pl);
+  while ((s24 = trinarkular_probelist_get_next_slash24(pl)) != NULL) {
+    prober->workers[WORKER_ID(prober, s24->network_ip)].slash24s_cnt++;
+  }
+
+  for (w = 0; w < prober->workers_cnt; w++) {
+    worker = &prober->workers[w];
+    cnt = worker->slash24s_cnt;
+    if (cnt > worker->slash24s_alloc) {
+      if ((slash24s = realloc(worker->slash24s, sizeof(uint32_t) * cnt)) ==
+          NULL) {
+        trinarkular_log("ERROR: Could not allocate worker partition");
+        return -1;
+      }
+      worker->slash24s = slash24s;
+      worker->slash24s_alloc = cnt;
+    }
+    worker->slash24s_cnt = 0;
+    worker->slash24_iter = 0;
+
+    // compute the slice size
+    worker->slice_size = cnt / PARAM(periodic_round_slices);
+    if (worker->slice_size * PARAM(periodic_round_slices) < cnt) {
+      // round up to ensure we cover everything in the interval
+      worker->slice_size++;
+    }
+
+    // size the windows for the slice (current windows are kept unless they
+    // no longer fit)
+    for (i = CTL_PERIODIC; i < CTL_CLASS_CNT; i++) {
+      ctl = &worker->ctl[i];
+      ctl->window_max = (worker->slice_size * CTL_WINDOW_SLICES) + 1;
+      ctl->window_min = (ctl->window_max / CTL_WINDOW_MIN_DIV) + 1;
+      if (ctl->window == 0 || ctl->window > ctl->window_max) {
+        ctl->window = ctl->window_max;
+      } else if (ctl->window < ctl->window_min) {
+        ctl->window = ctl->window_min;
+      }
+    }
+  }
+
+  // each worker probes its /24s in the same (random) order as the probelist
+  trinarkular_probelist_reset_slash24_iter(pl);
+  while ((s24 = trinarkular_probelist_get_next_slash24(pl)) != NULL) {
+    worker = &prober->workers[WORKER_ID(prober, s24->network_ip)];
+    worker->slash24s[worker->slash24s_cnt++] = s24 - records;
+  }
+
+  for (w = 0; w < prober->workers_cnt; w++) {
+    trinarkular_log("Worker %d: %d /24s, Periodic Probing Slice Size: %d", w,
+                    prober->workers[w].slash24s_cnt,
+                    prober->workers[w].slice_size);
+  }
+
+  return 0;
+}
+
+/** Rewrite the state table from the state of every /24 in the active
+    probelist. Must only be called while the workers are paused. */
+static void state_table_rebuild(trinarkular_prober_t *prober)
+{
+  trinarkular_slash24_t *records =
+    trinarkular_probelist_get_slash24_array(ACTIVE_PL(prober));
+  trinarkular_slash24_state_t *states =
+    trinarkular_probelist_get_slash24_state_array(ACTIVE_PL(prober));
+  uint32_t cnt = trinarkular_probelist_get_slash24_cnt(ACTIVE_PL(prober));
+  uint32_t i;
+
+  trinarkular_state_table_begin_update(prober->state_table);
+  trinarkular_state_table_clear(prober->state_table);
+  for (i = 0; i < cnt; i++) {
+    trinarkular_state_table_set(prober->state_table, records[i].network_ip,
+                                states[i].settled_belief,
+                                states[i].current_state);
+  }
+  trinarkular_state_table_end_update(prober->state_table);
+}
+
+static int trinarkular_prober_update_probelist(trinarkular_prober_t *prober)
+{
+  prober_worker_t *worker = NULL;
+  int swap = 1;
+  int ret;
+  int i, w;
+
+  trinarkular_log("Updating probelist");
+
+  // the snapshots of the active state are about to be changed (or destroyed)
+  flusher_wait(prober);
+
+  // queued /24 indexes are about to become invalid. there is no point in
+  // registering keys for a state that is being replaced
+  if (prober->reload_is_diff != 0 && lazy_keys_register(prober) != 0) {
+    trinarkular_log("WARN: Could not register per-/24 keys");
+  }
+  prober->lazy_keys_cnt = 0;
+
+  // the set of per-/24 keys is about to change, so everything is written at
+  // the end of the next round
+  prober->emit_keys_cnt = 0;
+  prober->emitted_keys_cnt = 0;
+  prober->emitted_all = 1;
+  prober->keyframe_due = 1;
+
+  if (prober->reload_is_diff != 0) {
+    prober->reload_is_diff = 0;
+    // patch the active state in place. the new probelist is only needed
+    // until the diff has been applied
+    ret = apply_probelist_diff(prober);
+    trinarkular_probelist_diff_free(&prober->reload_diff);
+    if (ret == 0) {
+      probelist_state_destroy(&NEXT_PL_STATE(prober));
+      swap = 0;
+    } else {
+      // the active state may be partially patched, so it is replaced with
+      // state created from the new probelist (as for a full reload)
+      trinarkular_log("WARN: Could not apply probelist diff, "
+                      "falling back to a full reload");
+      if (next_probelist_state_init(prober) != 0) {
+        trinarkular_log("ERROR: Could not create state for new probelist");
+        probelist_state_destroy(&NEXT_PL_STATE(prober));
+        return -1;
+      }
+    }
+  }
+
+  if (swap != 0) {
+    // destroy active state if there is any (there may not be if we are
+    // loading the probelist for the first time)
+    probelist_state_destroy(&ACTIVE_PL_STATE(prober));
+
+    // make index point to the other probelist state now
+    prober->pl_state_active_idx = !prober->pl_state_active_idx;
+
+    // no probes are outstanding (or deferred) for the new state (responses to
+    // earlier probes are ignored)
+    for (w = 0; w < prober->workers_cnt; w++) {
+      worker = &prober->workers[w];
+      worker->outstanding_probe_cnt = 0;
+      for (i = CTL_PERIODIC; i < CTL_CLASS_CNT; i++) {
+        worker->ctl[i].outstanding = 0;
+      }
+      for (i = 0; i < worker->drivers_cnt; i++) {
+        worker->drivers[i].outstanding = 0;
+      }
+      worker->deferred_head = worker->deferred_cnt = 0;
+      trinarkular_timer_wheel_clear(worker->expiry_wheel);
+    }
+  }
+
+  if (ACTIVE_PL(prober) == NULL) {
+    return -1;
+  }
+
+  trinarkular_log("Probelist size: %d /24s, version: %s",
+                  trinarkular_probelist_get_slash24_cnt(ACTIVE_PL(prober)),
+                  trinarkular_probelist_get_version(ACTIVE_PL(prober)));
+
+  // the /24s (and their indexes) may have changed
+  if (workers_partition(prober) != 0) {
+    return -1;
+  }
+
+  // the table is created once the first probelist has been loaded (a diff
+  // updates only the entries that changed)
+  if (prober->state_table != NULL && swap != 0) {
+    state_table_rebuild(prober);
+  }
+
+  return 0;
+}
+
+static void *reload_probelist(void *arg)
+{
+  trinarkular_log("I'm the thread that reloads the probelist");
+
+  trinarkular_prober_t *prober = (trinarkular_prober_t *) arg;
+
+  if (PARAM(incremental_reload) != 0) {
+    if (trinarkular_prober_prepare_probelist_diff(prober) != 0) {
+      trinarkular_log(
+        "ERROR: trinarkular_prober_prepare_probelist_diff() failed");
+      return NULL;
+    }
+  } else if (trinarkular_prober_prepare_probelist(prober) != 0) {
+    trinarkular_log("ERROR: trinarkular_prober_prepare_probelist() failed");
+    return NULL;
+  }
+
+  prober->reload_probelist_state = PROBELIST_RELOAD_DONE;
+  trinarkular_log("Probelist successfully reloaded in separate thread");
+
+  return NULL;
+}
+
+static void schedule_probelist_reload(trinarkular_prober_t *prober)
+{
+  pthread_t handle = 0;
+  int ret = 0;
+
+  trinarkular_log("A probelist reload is scheduled");
+
+  // run probelist reload code in separate thread so we don't stall probing
+  trinarkular_log("Creating thread to reload probelist");
+  if ((ret = pthread_create(&handle, NULL, reload_probelist,
+                            (void *) prober)) == 0) {
+    // detach thread, so its resources are automatically freed, without having
+    // to call pthread_join()
+    if ((ret = pthread_detach(handle)) != 0) {
+      trinarkular_log("ERROR: pthread_detach() returned %d", ret);
+    }
+  } else {
+    trinarkular_log("ERROR: pthread_create() returned %d", ret);
+    prober->reload_probelist_state = PROBELIST_RELOAD_NONE;
+    return;
+  }
+  prober->reload_probelist_state = PROBELIST_RELOAD_RUNNING;
+}
+
+/** Queue periodic probes for (up to) the next cnt /24s owned by the given
+    worker, as long as the periodic window allows. Returns the number of probes
+    queued, or -1 if an error occurred */
+static int worker_queue_periodic(prober_worker_t *worker, int cnt)
+{
+  trinarkular_probelist_t *pl = ACTIVE_PL(worker->prober);
+  trinarkular_slash24_t *records = trinarkular_probelist_get_slash24_array(pl);
+  int queued_cnt = 0;
+
+  trinarkular_slash24_t *s24 = NULL;         // BORROWED
+  trinarkular_slash24_state_t *state = NULL; // BORROWED
+
+  while (queued_cnt < cnt && worker->slash24_iter < worker->slash24s_cnt &&
+         worker->ctl[CTL_PERIODIC].outstanding <
+           worker->ctl[CTL_PERIODIC].window) {
+    // get a slash24 to probe
+    s24 = &records[worker->slash24s[worker->slash24_iter++]];
+
+    // get the state for this /24
+    if ((state = trinarkular_probelist_get_slash24_state(pl, s24)) == NULL) {
+      return -1;
+    }
+
+    // if we still haven't got a response to our last probe (and it hasn't
+    // timed out yet), lets give up on it and send a new probe
+    if (state->last_probe_type != UNPROBED) {
+      trinarkular_log("INFO: re-probing /24 with last_probe_type of %d",
+                      state->last_probe_type);
+      probe_done(worker, state);
+      state->last_probe_type = UNPROBED;
+    }
+
+    // reset the probe budgets
+    ADAPTIVE_BUDGET_SET(state, TRINARKULAR_PROBER_ROUND_PROBE_BUDGET);
+    RECOVERY_BUDGET_SET(state, AEB_TO_RECOVERY(s24));
+    if (BELIEF_STATE(state->current_belief) == UP) {
+      state->rounds_since_up = 0;
+    } else {
+      if (state->rounds_since_up < 255) {
+        state->rounds_since_up++;
+      } else {
+        state->rounds_since_up = RECOVERY_BACKOFF_MAX;
+      }
+    }
+    // queue a probe to a random host
+    if (queue_slash24_probe(worker, s24, state, PERIODIC) != 0) {
+      return -1;
+    }
+
+    queued_cnt++;
+  }
+
+  if (worker_flush_reqs(worker) != 0) {
+    return -1;
+  }
+
+  return queued_cnt;
+}
+
+/** Queue (up to) cnt of the worker's pending periodic probes. Returns the
+    number of probes queued, or -1 if an error occurred */
+static int worker_queue_pending(prober_worker_t *worker, uint32_t cnt)
+{
+  int queued_cnt;
+
+  if (worker->slice_pending < cnt) {
+    cnt = worker->slice_pending;
+  }
+  if ((queued_cnt = worker_queue_periodic(worker, cnt)) < 0) {
+    return -1;
+  }
+  worker->slice_pending -= queued_cnt;
+
+  // all of our /24s have been probed this round
+  if (worker->slash24_iter == worker->slash24s_cnt) {
+    worker->slice_pending = 0;
+  }
+
+  return queued_cnt;
+}
+
+/** Send deferred adaptive/recovery probes, and then pending periodic probes,
+    while their windows allow */
+static int worker_drain_deferred(prober_worker_t *worker)
+{
+  trinarkular_prober_t *prober = worker->prober;
+  trinarkular_probelist_t *pl = ACTIVE_PL(prober);
+  rate_ctl_t *ctl = &worker->ctl[CTL_FOLLOWUP];
+  slash24_deferral_t *d = NULL;
+  trinarkular_slash24_t *s24 = NULL;
+  trinarkular_slash24_state_t *state = NULL;
+
+  while (worker->deferred_head < worker->deferred_cnt &&
+         ctl->outstanding < ctl->window) {
+    d = &worker->deferred[worker->deferred_head++];
+    // the /24 may have been removed, answered, or probed again since
+    if ((s24 = trinarkular_probelist_get_slash24(pl, d->network_ip)) == NULL ||
+        (state = trinarkular_probelist_get_slash24_state(pl, s24)) == NULL ||
+        state->last_probe_type == UNPROBED ||
+        state->probe_driver != PROBE_DRIVER_DEFERRED ||
+        state->probe_seq != d->probe_seq) {
+      continue;
+    }
+    if (send_slash24_probe(worker, s24, state) != 0) {
+      return -1;
+    }
+  }
+  if (worker->deferred_head == worker->deferred_cnt) {
+    worker->deferred_head = worker->deferred_cnt = 0;
+  }
+
+  // (paced probes are queued by the pacing timer)
+  if (PARAM(pacing_batch_size) == 0 && worker->slice_pending > 0 &&
+      worker_queue_pending(worker, worker->slice_pending) < 0) {
+    return -1;
+  }
+
+  return worker_flush_reqs(worker);
+}
+
+/** Queue the next batch of paced periodic probes */
+static int handle_pace_timer(zloop_t *loop, int timer_id, void *arg)
+{
+  prober_worker_t *worker = (prober_worker_t *)arg;
+  trinarkular_prober_t *prober = worker->prober;
+
+  CHECK_SHUTDOWN;
+
+  // (probes held back by the window stay pending)
+  if (worker_queue_pending(worker, PARAM(pacing_batch_size)) < 0) {
+    return -1;
+  }
+
+  // nothing left to queue until the next slice
+  if (worker->slice_pending == 0) {
+    if (worker->pace_timer_id != -1) {
+      zloop_timer_end(loop, worker->pace_timer_id);
+      worker->pace_timer_id = -1;
+    }
+  }
+
+  return 0;
+}
+
+/** Start pacing the pending periodic probes of the worker across the slice
+    interval (or at the target probing rate) */
+static int worker_start_pacing(prober_worker_t *worker)
+{
+  trinarkular_prober_t *prober = worker->prober;
+  uint64_t slice_duration =
+    PARAM(periodic_round_duration) / PARAM(periodic_round_slices);
+  uint32_t batches;
+  uint64_t interval;
+
+  if (worker->pace_timer_id != -1) {
+    zloop_timer_end(worker->loop, worker->pace_timer_id);
+    worker->pace_timer_id = -1;
+  }
+
+  // the first batch is queued now, the rest are spread over the slice (so the
+  // last batch is queued one interval before the slice ends)
+  if (handle_pace_timer(worker->loop, worker->pace_timer_id, worker) != 0) {
+    return -1;
+  }
+  if (worker->slice_pending == 0) {
+    return 0;
+  }
+
+  if (PARAM(pacing_rate) > 0) {
+    // each worker probes at its share of the target rate
+    interval = ((uint64_t)PARAM(pacing_batch_size) * 1000 *
+                prober->workers_cnt) / PARAM(pacing_rate);
+  } else {
+    batches = (worker->slice_pending + PARAM(pacing_batch_size) - 1) /
+              PARAM(pacing_batch_size);
+    interval = slice_duration / (batches + 1);
+  }
+  if (interval == 0) {
+    interval = 1;
+  }
+
+  if ((worker->pace_timer_id = zloop_timer(worker->loop, interval, 0,
+                                           handle_pace_timer, worker)) < 0) {
+    trinarkular_log("ERROR: Could not create pacing timer");
+    return -1;
+  }
+
+  return 0;
+}
+
+/** Queue the next slice of periodic probes for the /24s owned by the given
+    worker */
+static int worker_probe_slice(prober_worker_t *worker)
+{
+  trinarkular_prober_t *prober = worker->prober;
+  int queued_cnt;
+
+  if (worker->slash24_iter == worker->slash24s_cnt) {
+    trinarkular_log("No /24s left to probe (worker %d)", worker->id);
+    return 0;
+  }
+
+  trinarkular_log("INFO: %" PRIu64 " outstanding requests (slice size is %d, "
+                  "periodic window is %" PRIu32 ") (worker %d)",
+                  worker->outstanding_probe_cnt, worker->slice_size,
+                  worker->ctl[CTL_PERIODIC].window, worker->id);
+
+  // probes that could not be sent in the last slice (because of backpressure,
+  // or at the target pacing rate) are carried over rather than skipped
+  if (worker->slice_pending > 0) {
+    trinarkular_log("WARN: %d periodic probes carried over (worker %d)",
+                    worker->slice_pending, worker->id);
+    worker->ctl[CTL_PERIODIC].deferred_cnt += worker->slice_pending;
+  }
+  worker->slice_pending += worker->slice_size;
+
+  if (PARAM(pacing_batch_size) > 0) {
+    return worker_start_pacing(worker);
+  }
+
+  if ((queued_cnt = worker_queue_pending(worker, worker->slice_pending)) < 0) {
+    return -1;
+  }
+
+  trinarkular_log("Queued %d /24s, %d pending (worker %d)", queued_cnt,
+                  worker->slice_pending, worker->id);
+
+  return 0;
+}
+
+/** Wait for a signal on the given socket. A signal handler (e.g., SIGHUP to
+    reload the probelist) may interrupt the wait, in which case it is retried
+    unless we were asked to shut down. */
+static int sock_wait(void *sock)
+{
+  int rc;
+
+  while ((rc = zsock_wait(sock)) == -1 && errno == EINTR &&
+         zctx_interrupted == 0)
+    ;
+
+  return rc;
+}
+
+/** Receive a string from the given socket (retrying as for sock_wait) */
+static char *str_recv(void *sock)
+{
+  char *str;
+
+  while ((str = zstr_recv(sock)) == NULL && errno == EINTR &&
+         zctx_interrupted == 0)
+    ;
+
+  return str;
+}
+
+/** Send the given command to every worker thread */
+static int workers_send(trinarkular_prober_t *prober, const char *command)
+{
+  prober_worker_t *worker = NULL;
+  int w;
+
+  for (w = 0; w < prober->workers_cnt; w++) {
+    worker = &prober->workers[w];
+    if (worker->actor == NULL) {
+      continue;
+    }
+    if (worker->dead != 0 || zstr_send(worker->actor, command) != 0) {
+      trinarkular_log("ERROR: Could not send %s command to worker %d", command,
+                      w);
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+static int event_cmp(const void *a, const void *b)
+{
+  const slash24_event_t *ea = (const slash24_event_t *)a;
+  const slash24_event_t *eb = (const slash24_event_t *)b;
+  int cmp;
+
+  if ((cmp = strcmp(ea->topic, eb->topic)) != 0) {
+    return cmp;
+  }
+  if (ea->rec.time != eb->rec.time) {
+    return (ea->rec.time < eb->rec.time) ? -1 : 1;
+  }
+  return (ea->rec.network_ip > eb->rec.network_ip) -
+         (ea->rec.network_ip < eb->rec.network_ip);
+}
+
+/** Push the queued events to the prober thread, one message per topic. If
+    the prober thread is not keeping up, the events are dropped rather than
+    blocking probing. */
+static int worker_publish_events(prober_worker_t *worker)
+{
+  trinarkular_prober_t *prober = worker->prober;
+  void *sock;
+  const char *topic;
+  size_t topic_len;
+  zmq_msg_t msg;
+  trinarkular_journal_rec_t *recs;
+  uint32_t first, last, i;
+
+  if (worker->events_cnt == 0) {
+    return 0;
+  }
+  sock = zsock_resolve(worker->events_sock);
+
+  // group the events by topic
+  if (prober->events_topic_prefix != NULL) {
+    qsort(worker->events, worker->events_cnt, sizeof(slash24_event_t),
+          event_cmp);
+  }
+
+  for (first = 0; first < worker->events_cnt; first = last) {
+    topic = worker->events[first].topic;
+    topic_len = strlen(topic);
+    for (last = first + 1; last < worker->events_cnt &&
+                           strcmp(worker->events[last].topic, topic) == 0;
+         last++)
+      ;
+
+    if (zmq_send(sock, topic, topic_len, ZMQ_SNDMORE | ZMQ_DONTWAIT) == -1) {
+      if (errno != EAGAIN) {
+        trinarkular_log("ERROR: Could not send event topic");
+        return -1;
+      }
+      worker->events_dropped_cnt += last - first;
+      continue;
+    }
+
+    // once the first frame is queued, the rest of the message will be
+    if (zmq_msg_init_size(&msg, sizeof(trinarkular_journal_rec_t) *
+                                  (last - first)) == -1) {
+      trinarkular_log("ERROR: Could not create event message");
+      return -1;
+    }
+    recs = (trinarkular_journal_rec_t *)zmq_msg_data(&msg);
+    for (i = first; i < last; i++) {
+      recs[i - first] = worker->events[i].rec;
+    }
+    if (zmq_msg_send(&msg, sock, ZMQ_DONTWAIT) == -1) {
+      zmq_msg_close(&msg);
+      trinarkular_log("ERROR: Could not send events");
+      return -1;
+    }
+  }
+
+  worker->events_cnt = 0;
+  return 0;
+}
+
+/** Publish the queued events if the oldest has waited for the maximum
+    latency */
+static int worker_publish_events_due(prober_worker_t *worker)
+{
+  trinarkular_prober_t *prober = worker->prober;
+
+  if (worker->events_cnt == 0 ||
+      zclock_time() - worker->events_first_time < PARAM(events_max_latency)) {
+    return 0;
+  }
+  return worker_publish_events(worker);
+}
+
+/** Wait until every worker has paused. Until the workers are resumed, the
+ * prober thread may access the state of any /24. */
+static int workers_pause(trinarkular_prober_t *prober)
+{
+  prober_worker_t *worker = NULL;
+  int w;
+
+  if (workers_send(prober, "PAUSE") != 0) {
+    return -1;
+  }
+
+  for (w = 0; w < prober->workers_cnt; w++) {
+    worker = &prober->workers[w];
+    if (worker->actor == NULL) {
+      // (see handle_worker_cmd)
+      if (worker_publish_events(worker) != 0) {
+        return -1;
+      }
+      continue;
+    }
+    // the worker thread also signals when it exits
+    if (sock_wait(worker->actor) != 0 || worker->dead != 0) {
+      trinarkular_log("ERROR: Worker %d has shut down", w);
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/** Queue the next slice of periodic probes in every worker */
+static int workers_probe_slice(trinarkular_prober_t *prober)
+{
+  int w;
+
+  for (w = 0; w < prober->workers_cnt; w++) {
+    if (prober->workers[w].actor == NULL &&
+        worker_probe_slice(&prober->workers[w]) != 0) {
+      return -1;
+    }
+  }
+
+  return workers_send(prober, "SLICE");
+}
+
+/** Queue the next set of periodic probes */
+static int handle_timer(zloop_t *loop, int timer_id, void *arg)
+{
+  trinarkular_prober_t *prober = (trinarkular_prober_t *)arg;
+
+  uint64_t probing_round = prober->current_slice / PARAM(periodic_round_slices);
+
+  uint64_t now = zclock_time();
+
+  CHECK_SHUTDOWN;
+
+  // do we have to reload the probelist?
+  if (prober->reload_probelist_state == PROBELIST_RELOAD_SCHEDULED) {
+    schedule_probelist_reload(prober);
+  }
+
+  // have we reached the end of the round and need to start over?
+  if (prober->probing_started == 0 ||
+      prober->current_slice % PARAM(periodic_round_slices) == 0) {
+    // the round statistics and probelist may only be touched while the
+    // workers are paused
+    if (workers_pause(prober) != 0) {
+      return -1;
+    }
+
+    // dump end of round stats
+    if (probing_round > 0) {
+      trinarkular_log("ending round %d", probing_round - 1);
+
+      if (end_of_round(prober, probing_round - 1) != 0) {
+        trinarkular_log("WARN: Could not dump end-of-round stats");
+      }
+
+      // check if we're done reloading the probelist
+      if (prober->reload_probelist_state == PROBELIST_RELOAD_RUNNING) {
+        trinarkular_log("Probelist reload still in progress.  "
+                        "Waiting until next round.");
+      } else if (prober->reload_probelist_state == PROBELIST_RELOAD_DONE) {
+        trinarkular_log("Probelist reload done.  Now updating probelist.");
+        if (trinarkular_prober_update_probelist(prober) != 0) {
+          trinarkular_log("ERROR: Could not update probelist");
+          return -1;
+        }
+        prober->reload_probelist_state = PROBELIST_RELOAD_NONE;
+      }
+    }
 
-  assert(state != NULL);
-  // slash24_state is valid here
+    // check if we reached the round limit
+    if (PARAM(periodic_round_limit) > 0 &&
+        probing_round >= PARAM(periodic_round_limit)) {
+      trinarkular_log("round limit (%d) reached, shutting down",
+                      PARAM(periodic_round_limit));
+      return -1;
+    }
 
-  // identify the appropriate host to probe
-  host_ip = trinarkular_probelist_get_next_host(s24, state);
-  req.target_ip = htonl(host_ip);
-  inet_ntop(AF_INET, &req.target_ip, ipbuf, INET_ADDRSTRLEN);
+    trinarkular_log("starting round %d", probing_round);
+    // reset round stats
+    reset_round_stats(prober, now);
 
-  // indicate that we are waiting for a response
-  state->last_probe_type = probe_type;
-  ACTIVE_STAT(probe_cnt[probe_type])++;
+    prober->probing_started = 1;
 
-  // decrement the probe budget (periodic doesn't affect this)
-  // (its up to the caller to ensure that we have enough probes in the budget)
-  if (probe_type == ADAPTIVE) {
-    assert(ADAPTIVE_BUDGET(state) > 0);
-    ADAPTIVE_BUDGET_SET(state, ADAPTIVE_BUDGET(state) - 1);
-  } else if (probe_type == RECOVERY) {
-    assert(RECOVERY_BUDGET(state) > 0);
-    RECOVERY_BUDGET_SET(state, RECOVERY_BUDGET(state) - 1);
+    if (workers_send(prober, "RESUME") != 0) {
+      return -1;
+    }
   }
 
-  dw = &prober->drivers[prober->drivers_next];
-  if ((ret = trinarkular_driver_queue_req(dw->driver, &req)) != 0) {
+  if (workers_probe_slice(prober) != 0) {
     return -1;
   }
-  prober->outstanding_probe_cnt++;
 
-  // move on to the next driver ready for the next probe
-  prober->drivers_next = (prober->drivers_next + 1) % prober->drivers_cnt;
-
-  // save the state
-  if (trinarkular_probelist_save_slash24_state(ACTIVE_PL(prober),
-                                               s24, state) != 0) {
-    return -1;
-  }
+  trinarkular_log("Queued slice %" PRIu64 " (round: %" PRIu64 ")",
+                  prober->current_slice, probing_round);
 
+  prober->current_slice++;
+  CHECK_SHUTDOWN;
   return 0;
 }
 
-static int end_of_round(trinarkular_prober_t *prober, int round_id)
-{
-  uint64_t now = zclock_time();
-  uint64_t aligned_start =
-    ((uint64_t)(ACTIVE_STAT(start_time) / PARAM(periodic_round_duration))) *
-    PARAM(periodic_round_duration);
-  int i;
+#define BECOMING_UNCERTAIN(old, old_state, new, new_state)                     \
+  (((new_state) == UNCERTAIN) || ((old_state) == UP && (old) > (new)) ||       \
+   ((old_state) == DOWN && (new) > (old)))
 
-  timeseries_kp_set(ACTIVE_KP_AGGR(prober),
-                    ACTIVE_METRICS(prober).round_id, round_id);
-  timeseries_kp_set(ACTIVE_KP_AGGR(prober),
-                    ACTIVE_METRICS(prober).round_duration,
-                    now - ACTIVE_STAT(start_time));
+/** Mark the given /24 as settled this round. Its timeseries are updated from
+    the dirty list at the end of the round */
+static int worker_mark_dirty(prober_worker_t *worker,
+                             trinarkular_slash24_t *s24,
+                             trinarkular_slash24_state_t *state)
+{
+  trinarkular_probelist_t *pl = ACTIVE_PL(worker->prober);
+  uint32_t *dirty;
+  uint32_t alloc;
 
-  for (i = PERIODIC; i < PROBE_TYPE_CNT; i++) {
-    timeseries_kp_set(ACTIVE_KP_AGGR(prober),
-                      ACTIVE_METRICS(prober).round_probe_cnt[i],
-                      ACTIVE_STAT(probe_cnt[i]));
-    timeseries_kp_set(ACTIVE_KP_AGGR(prober),
-                      ACTIVE_METRICS(prober).round_probe_complete_cnt[i],
-                      ACTIVE_STAT(probe_complete_cnt[i]));
-    timeseries_kp_set(ACTIVE_KP_AGGR(prober),
-                      ACTIVE_METRICS(prober).round_responsive_cnt[i],
-                      ACTIVE_STAT(responsive_cnt[i]));
+  if ((state->dirty & DIRTY_EXPORT) != 0) {
+    // already listed, the merge will pick up the latest settled belief
+    return 0;
   }
 
-  for (i = UNCERTAIN; i < BELIEF_STATE_CNT; i++) {
-    timeseries_kp_set(ACTIVE_KP_AGGR(prober),
-                      ACTIVE_METRICS(prober).slash24_state_cnts[i],
-                      ACTIVE_STAT(slash24_state_cnts[i]));
+  if (worker->dirty_cnt == worker->dirty_alloc) {
+    alloc = (worker->dirty_alloc == 0) ? 1024 : worker->dirty_alloc * 2;
+    if ((dirty = realloc(worker->dirty, sizeof(uint32_t) * alloc)) == NULL) {
+      trinarkular_log("ERROR: Could not grow dirty /24 list");
+      return -1;
+    }
+    worker->dirty = dirty;
+    worker->dirty_alloc = alloc;
   }
 
-  timeseries_kp_set(ACTIVE_KP_AGGR(prober), ACTIVE_METRICS(prober).slash24_cnt,
-                    ACTIVE_STAT(slash24_cnt));
+  worker->dirty[worker->dirty_cnt++] =
+    s24 - trinarkular_probelist_get_slash24_array(pl);
+  state->dirty |= DIRTY_EXPORT;
 
-  trinarkular_log("round %d completed in %" PRIu64 "ms (ideal: %" PRIu64 "ms)",
-                  round_id, now - ACTIVE_STAT(start_time),
-                  PARAM(periodic_round_duration));
-  trinarkular_log("round periodic response rate: %d/%d (%0.0f%%)",
-                  ACTIVE_STAT(responsive_cnt[PERIODIC]),
-                  ACTIVE_STAT(probe_cnt[PERIODIC]),
-                  ACTIVE_STAT(responsive_cnt[PERIODIC]) * 100.0 /
-                    ACTIVE_STAT(probe_cnt[PERIODIC]));
+  return 0;
+}
 
-  // flush the kps
-  if (timeseries_kp_flush(ACTIVE_KP_AGGR(prober), aligned_start / 1000) != 0 ||
-      timeseries_kp_flush(ACTIVE_KP_SLASH24(prober),
-                          aligned_start / 1000) != 0) {
+/** Add the latency of the probe for the given /24 to the average of the
+    driver that it was sent with */
+static void driver_sample_latency(struct driver_wrap *dw,
+                                  trinarkular_slash24_state_t *state)
+{
+  uint16_t now = zclock_time() / PROBE_SENT_UNIT;
+  uint32_t latency = (uint16_t)(now - state->probe_sent) * PROBE_SENT_UNIT;
+
+  if (dw->latency_samples == 0 && dw->latency == 0) {
+    dw->latency = latency;
+  } else {
+    dw->latency = dw->latency - (dw->latency >> LATENCY_EWMA_SHIFT) +
+                  (latency >> LATENCY_EWMA_SHIFT);
+  }
+  dw->latency_samples++;
+}
+
+/** Queue an event for publishing, publishing the queued events first if
+    the queue is full */
+static int worker_queue_event(prober_worker_t *worker, const char *topic,
+                              trinarkular_journal_rec_t *rec)
+{
+  if (worker->events_cnt == EVENT_BATCH_LEN &&
+      worker_publish_events(worker) != 0) {
     return -1;
   }
+
+  if (worker->events_cnt == 0) {
+    worker->events_first_time = rec->time;
+  }
+  worker->events[worker->events_cnt].topic = topic;
+  worker->events[worker->events_cnt].rec = *rec;
+  worker->events_cnt++;
+
   return 0;
 }
 
-int probelist_state_destroy(probelist_state_t *pl_state)
+/** Record a state transition of the given /24 in the worker's journal and
+    event stream */
+static int worker_transition(prober_worker_t *worker,
+                             trinarkular_slash24_t *s24,
+                             trinarkular_slash24_state_t *state,
+                             trinarkular_belief_t new_belief, int new_state,
+                             int probe_type)
 {
-  trinarkular_probelist_destroy(pl_state->pl);
-  pl_state->pl = NULL;
+  trinarkular_prober_t *prober = worker->prober;
+  trinarkular_journal_rec_t rec;
+  const char *topics[UINT8_MAX];
+  const char *md;
+  int topic_cnt = 0;
+  int i, j;
+
+  if (worker->journal == NULL && worker->events_sock == NULL) {
+    return 0;
+  }
 
-  // destroy the key packages
-  timeseries_kp_free(&pl_state->kp_slash24);
-  pl_state->kp_slash24 = NULL;
-  timeseries_kp_free(&pl_state->kp_aggr);
-  pl_state->kp_aggr = NULL;
+  rec.time = zclock_time();
+  rec.network_ip = s24->network_ip;
+  rec.belief = new_belief;
+  rec.states = TRINARKULAR_JOURNAL_STATES(state->current_state, new_state);
+  rec.probe_type = probe_type;
+
+  // losing the journal must not stop probing
+  if (worker->journal != NULL &&
+      trinarkular_journal_append(worker->journal, &rec) != 0) {
+    trinarkular_log("WARN: Disabling journal for worker %d", worker->id);
+    trinarkular_journal_destroy(worker->journal);
+    worker->journal = NULL;
+  }
+
+  if (worker->events_sock == NULL) {
+    return 0;
+  }
+
+  // the event is published once under each matching metadata topic. the
+  // 'L:' and 'N:' versions of a metadata share a topic
+  if (prober->events_topic_prefix != NULL) {
+    for (i = 0; i < s24->md_cnt; i++) {
+      // skip the '[LN]:' prefix
+      md = trinarkular_probelist_get_md(ACTIVE_PL(prober), s24->md[i]) + 2;
+      if (strncmp(md, prober->events_topic_prefix,
+                  prober->events_topic_prefix_len) != 0) {
+        continue;
+      }
+      for (j = 0; j < topic_cnt && strcmp(topics[j], md) != 0; j++)
+        ;
+      if (j < topic_cnt) {
+        continue;
+      }
+      if (worker_queue_event(worker, md, &rec) != 0) {
+        return -1;
+      }
+      topics[topic_cnt++] = md;
+    }
+  }
+  if (topic_cnt == 0) {
+    return worker_queue_event(worker, EVENT_TOPIC_NONE, &rec);
+  }
 
   return 0;
 }
 
-static int trinarkular_prober_prepare_probelist(trinarkular_prober_t *prober)
+/** Update the belief of the given /24 using the given response */
+static int handle_resp(prober_worker_t *worker, trinarkular_probe_resp_t *resp,
+                       trinarkular_slash24_t *s24)
 {
-  int i = 0;
-  trinarkular_slash24_t *s24 = NULL;
+  trinarkular_prober_t *prober = worker->prober;
+  trinarkular_slash24_state_t *state = NULL;
+  trinarkular_belief_t new_belief_up;
+  int old_belief_state;
+  int new_belief_state;
+  int probe_type;
 
-  trinarkular_log("Preparing probelist to be assigned");
+  // TARGET IP IS IN NETWORK BYTE ORDER
 
-  assert(NEXT_PL(prober) == NULL);
+  // the /24 for this probe was looked up with the rest of the batch
+  if (s24 == NULL) {
+    trinarkular_log("WARN: Missing /24 for %x", ntohl(resp->target_ip));
+    return 0;
+  }
+  // only this worker probes (and so may modify the state of) this /24
+  assert(WORKER_ID(prober, s24->network_ip) == worker->id);
 
-  // create new probelist
-  if ((NEXT_PL(prober) =
-       trinarkular_probelist_create(prober->probelist_filename)) == NULL) {
-    trinarkular_log("ERROR: Could not create probelist file");
+  // grab the state for this /24
+  if ((state = trinarkular_probelist_get_slash24_state(ACTIVE_PL(prober),
+                                                       s24)) == NULL) {
+    trinarkular_log("ERROR: Missing state for %x", ntohl(resp->target_ip));
     goto err;
   }
 
-  // re-initialize key packages
-  if (init_kp(prober) != 0) {
-    trinarkular_log("ERROR: Could not create timeseries key package");
-    goto err;
+  // since periodic probing will reset adaptive probing state, this can cause
+  // responses to become out of sync. simply ignore a response that we don't
+  // care about. (NB: in practice this should rarely, if ever, happen since a
+  // round is much longer than the timeout)
+  if (state->last_probe_type == UNPROBED) {
+    return 0;
   }
+  // (last_probe_type is reset once the /24 settles)
+  probe_type = state->last_probe_type;
 
-  // re-initialize statistics
-  for (i = UNCERTAIN; i < BELIEF_STATE_CNT; i++) {
-      NEXT_PL_STATE(prober).stats.slash24_state_cnts[i] = 0;
+  // the latency of responsive probes includes the time they spent queued in
+  // the driver
+  if (resp->verdict != 0 && state->probe_driver != PROBE_DRIVER_DEFERRED) {
+    driver_sample_latency(&worker->drivers[state->probe_driver], state);
   }
-  NEXT_PL_STATE(prober).stats.slash24_cnt = 0;
+  probe_done(worker, state);
 
-  // and create all the state (including timeseries metrics)
-  trinarkular_probelist_reset_slash24_iter(NEXT_PL(prober));
+  // update the overall per-round statistics
+  worker->probe_complete_cnt[state->last_probe_type]++;
+  worker->responsive_cnt[state->last_probe_type] += resp->verdict;
 
-  // iterates over the entire probelist.
-  while ((s24 =
-          trinarkular_probelist_get_next_slash24(NEXT_PL(prober))) != NULL) {
-    if (slash24_state_create(prober, s24) == NULL) {
-      trinarkular_log("ERROR: Could not create /24 state");
-      goto err;
+  // update the bayesian model given a positive (1) or negative (0) response
+  new_belief_up = TRINARKULAR_BELIEF_UPDATE(
+    state->current_belief, s24->belief_incrs[resp->verdict != 0]);
+  old_belief_state = BELIEF_STATE(state->current_belief);
+  new_belief_state = BELIEF_STATE(new_belief_up);
+
+#ifdef DEBUG_PROBING
+  fprintf(stdout, "%f (%s) -> %f (%s)",
+          trinarkular_belief_to_prob(state->current_belief),
+          belief_icons[old_belief_state],
+          trinarkular_belief_to_prob(new_belief_up),
+          belief_icons[new_belief_state]);
+#endif
+
+  // if new state is uncertain, or we are moving toward uncertainty, send more
+  // probes
+  if (BECOMING_UNCERTAIN(state->current_belief, old_belief_state,
+                         new_belief_up, new_belief_state)) {
+    // we'd like to send an adaptive probe, but do we have any left in the
+    // budget?
+    if (ADAPTIVE_BUDGET(state) > 0) {
+      if (queue_slash24_probe(worker, s24, state, ADAPTIVE) != 0) {
+        return -1;
+      }
+#ifdef DEBUG_PROBING
+      fprintf(stdout, " ADAPTIVE");
+#endif
+
+      // AK removes this urgent recovery to save some probes. consider enabling
+      // if probe usage is not a problem as it might help some unstable blocks
+#if 0
+      // no more adaptive probes left, but if we are changing state away from
+      // UP, we'd better be darn sure, so lets switch to recovery probing right
+      // now (unless this is the first round...)
+    } else if (state->current_state == UP && RECOVERY_BUDGET(state) > 0 &&
+               prober->current_slice != 0) {
+      // queue a recovery probe
+      if (queue_slash24_probe(worker, s24, state, RECOVERY) != 0) {
+        return -1;
+      }
+#ifdef DEBUG_PROBING
+      fprintf(stdout, " ADAPTIVE-RECOVERY");
+#endif
+#endif
+
+      // we ideally would have liked to send an adaptive probe since belief has
+      // changed, but we're out of probes, so we give up and if the block is not
+      // already uncertain, we move belief to 0.5 (uncertain)
+    } else {
+      if (new_belief_state != UNCERTAIN) {
+        new_belief_up = TRINARKULAR_BELIEF_UNCERTAIN; // 0.5
+        new_belief_state = UNCERTAIN;
+      }
+      state->last_probe_type = UNPROBED;
+#ifdef DEBUG_PROBING
+      fprintf(stdout, " DONE-ADAPTIVE");
+#endif
     }
-  }
 
-  // force libtimeseries to resolve all keys
-  trinarkular_log("Resolving %d timeseries keys (Per-/24 KP)",
-                  timeseries_kp_size(NEXT_KP_SLASH24(prober)));
-  while (timeseries_kp_resolve(NEXT_KP_SLASH24(prober)) != 0) {
-    trinarkular_log("WARN: Could not resolve timeseries keys. Retrying");
-    if (sleep(10) != 0) {
-      trinarkular_log("WARN: Sleep interrupted, exiting");
+    // otherwise, if we are down and staying down, send recovery probes to try
+    // and get back up.
+  } else if (old_belief_state == DOWN && new_belief_state == DOWN &&
+             RECOVERY_ELIGIBLE(state) != 0 &&
+             RECOVERY_BUDGET(state) > 0) {
+    // queue a recovery probe
+    if (queue_slash24_probe(worker, s24, state, RECOVERY) != 0) {
       return -1;
     }
+#ifdef DEBUG_PROBING
+    fprintf(stdout, " RECOVERY");
+#endif
+
+  } else {
+    // No adaptive/recovery probe sent
+    state->last_probe_type = UNPROBED;
+#ifdef DEBUG_PROBING
+    fprintf(stdout, " DONE");
+#endif
   }
-  trinarkular_log("Resolving %d timeseries keys (Aggregate KP)",
-                  timeseries_kp_size(NEXT_KP_AGGR(prober)));
-  while (timeseries_kp_resolve(NEXT_KP_AGGR(prober)) != 0) {
-    trinarkular_log("WARN: Could not resolve timeseries keys. Retrying");
-    if (sleep(10) != 0) {
-      trinarkular_log("WARN: Sleep interrupted, exiting");
+
+#ifdef DEBUG_PROBING
+  fprintf(stdout, " %d %d %d\n", ADAPTIVE_BUDGET(state), RECOVERY_BUDGET(state),
+          state->rounds_since_up);
+#endif
+
+  // only update statistics if we have stopped probing this /24 (otherwise we
+  // run the risk of dumping info about a /24 while the prober is converging on
+  // a decision)
+  if (state->last_probe_type == UNPROBED) {
+    // the KPs are shared by all workers, so the overall belief stats and the
+    // timeseries are updated at the end of the round
+    if (worker_mark_dirty(worker, s24, state) != 0) {
+      goto err;
+    }
+
+    if (new_belief_state != state->current_state &&
+        worker_transition(worker, s24, state, new_belief_up, new_belief_state,
+                          probe_type) != 0) {
+      goto err;
+    }
+
+    // update the stable state
+    state->settled_belief = new_belief_up;
+    state->current_state = new_belief_state;
+
+    // readers of the state table see the /24 settle now, rather than at the
+    // end of the round (we are the only writer of its entry)
+    if (prober->state_table != NULL) {
+      trinarkular_state_table_set(prober->state_table, s24->network_ip,
+                                  new_belief_up, new_belief_state);
+    }
+  }
+
+  // update the belief
+  state->current_belief = new_belief_up;
+
+  return 0;
+
+err:
+  return -1;
+}
+
+static int handle_driver_resp(zloop_t *loop, zsock_t *reader, void *arg)
+{
+  struct driver_wrap *dw = (struct driver_wrap *)arg;
+  prober_worker_t *worker = dw->worker;
+  trinarkular_prober_t *prober = worker->prober;
+  trinarkular_probelist_t *pl = ACTIVE_PL(prober);
+  int resps_cnt;
+  int i;
+
+  CHECK_SHUTDOWN;
+
+  // drain the responses that are ready (up to the batch size)
+  if ((resps_cnt = trinarkular_driver_recv_resps(
+         dw->driver, worker->resps, PARAM(resp_batch_size))) < 0) {
+    trinarkular_log("ERROR: Could not receive responses");
+    return -1;
+  }
+
+  // find the /24s for the whole batch before touching any state
+  for (i = 0; i < resps_cnt; i++) {
+    worker->resp_slash24s[i] = trinarkular_probelist_get_slash24(
+      pl, ntohl(worker->resps[i].target_ip) & TRINARKULAR_SLASH24_NETMASK);
+  }
+
+  for (i = 0; i < resps_cnt; i++) {
+    if (handle_resp(worker, &worker->resps[i], worker->resp_slash24s[i]) !=
+        0) {
       return -1;
     }
   }
 
-  return 0;
+  // events are batched across the responses handled in each wakeup
+  if (worker_publish_events_due(worker) != 0) {
+    return -1;
+  }
 
-err:
-  probelist_state_destroy(&NEXT_PL_STATE(prober));
-  prober->reload_probelist_state = PROBELIST_RELOAD_NONE;
-  return -1;
+  // send any adaptive/recovery probes that the batch triggered (and any that
+  // were waiting for the probes that completed)
+  return worker_drain_deferred(worker);
 }
 
-static void trinarkular_prober_update_probelist(trinarkular_prober_t *prober)
+/** Treat a probe that has not been answered by its deadline as unresponsive */
+static int handle_probe_expiry(uint32_t network_ip, uint32_t seq, void *user)
 {
-  trinarkular_log("Updating probelist");
-
-  // destroy active state if there is any (there may not be if we are loading
-  // the probelist for the first time)
-  probelist_state_destroy(&ACTIVE_PL_STATE(prober));
-
-  // make index point to the other probelist state now
-  prober->pl_state_active_idx = !prober->pl_state_active_idx;
+  prober_worker_t *worker = (prober_worker_t *)user;
+  trinarkular_probelist_t *pl = ACTIVE_PL(worker->prober);
+  trinarkular_slash24_t *s24 = NULL;
+  trinarkular_slash24_state_t *state = NULL;
+  trinarkular_probe_resp_t resp;
 
-  // compute the slice size
-  prober->slice_size = trinarkular_probelist_get_slash24_cnt(ACTIVE_PL(prober))/
-                       PARAM(periodic_round_slices);
-  if (prober->slice_size * PARAM(periodic_round_slices) <
-      trinarkular_probelist_get_slash24_cnt(ACTIVE_PL(prober))) {
-    // round up to ensure we cover everything in the interval
-    prober->slice_size++;
+  // the /24 may have been removed, answered, or probed again since
+  if ((s24 = trinarkular_probelist_get_slash24(pl, network_ip)) == NULL ||
+      (state = trinarkular_probelist_get_slash24_state(pl, s24)) == NULL ||
+      state->last_probe_type == UNPROBED || state->probe_seq != seq) {
+    return 0;
   }
-  trinarkular_log("Periodic Probing Slice Size: %d", prober->slice_size);
 
-  trinarkular_log("Probelist size: %d /24s, version: %s",
-                  trinarkular_probelist_get_slash24_cnt(ACTIVE_PL(prober)),
-                  trinarkular_probelist_get_version(ACTIVE_PL(prober)));
+  worker->expired_probe_cnt++;
+  worker->ctl_expired_cnt++;
+
+  resp.target_ip = htonl(network_ip);
+  resp.verdict = 0;
+  return handle_resp(worker, &resp, s24);
 }
 
-static void *reload_probelist(void *arg)
+static int handle_expiry_timer(zloop_t *loop, int timer_id, void *arg)
 {
-  trinarkular_log("I'm the thread that reloads the probelist");
+  prober_worker_t *worker = (prober_worker_t *)arg;
+  trinarkular_prober_t *prober = worker->prober;
 
-  trinarkular_prober_t *prober = (trinarkular_prober_t *) arg;
+  CHECK_SHUTDOWN;
 
-  if (trinarkular_prober_prepare_probelist(prober) != 0) {
-    trinarkular_log("ERROR: trinarkular_prober_prepare_probelist() failed");
-    return NULL;
+  if (trinarkular_timer_wheel_expire(worker->expiry_wheel, zclock_time(),
+                                     handle_probe_expiry, worker) < 0) {
+    trinarkular_log("ERROR: Could not expire probes");
+    return -1;
   }
 
-  prober->reload_probelist_state = PROBELIST_RELOAD_DONE;
-  trinarkular_log("Probelist successfully reloaded in separate thread");
+  if (worker_publish_events_due(worker) != 0) {
+    return -1;
+  }
 
-  return NULL;
+  // send any adaptive/recovery probes that the timeouts triggered
+  return worker_drain_deferred(worker);
 }
 
-static void schedule_probelist_reload(trinarkular_prober_t *prober)
+/** Update the window of the given class (AIMD). After a cut, the window is
+    held for the given number of intervals */
+static void rate_ctl_update(rate_ctl_t *ctl, int class, int backpressure,
+                            uint32_t hold)
 {
-  pthread_t handle = 0;
-  int ret = 0;
-
-  trinarkular_log("A probelist reload is scheduled");
+  if (ctl->hold > 0) {
+    ctl->hold--;
+  }
 
-  // run probelist reload code in separate thread so we don't stall probing
-  trinarkular_log("Creating thread to reload probelist");
-  if ((ret = pthread_create(&handle, NULL, reload_probelist,
-                            (void *) prober)) == 0) {
-    // detach thread, so its resources are automatically freed, without having
-    // to call pthread_join()
-    if ((ret = pthread_detach(handle)) != 0) {
-      trinarkular_log("ERROR: pthread_detach() returned %d", ret);
+  if (backpressure != 0) {
+    if (ctl->hold == 0) {
+      ctl->window *= ctl_decrease[class];
+      if (ctl->window < ctl->window_min) {
+        ctl->window = ctl->window_min;
+      }
+      ctl->decrease_cnt++;
+      ctl->hold = hold;
+    }
+  } else if (ctl->window < ctl->window_max) {
+    ctl->window += (ctl->window_max / CTL_WINDOW_INCR_DIV) + 1;
+    if (ctl->window > ctl->window_max) {
+      ctl->window = ctl->window_max;
     }
-  } else {
-    trinarkular_log("ERROR: pthread_create() returned %d", ret);
-    prober->reload_probelist_state = PROBELIST_RELOAD_NONE;
-    return;
   }
-  prober->reload_probelist_state = PROBELIST_RELOAD_RUNNING;
 }
 
-/** Queue the next set of periodic probes */
-static int handle_timer(zloop_t *loop, int timer_id, void *arg)
+/** Adjust the probing windows according to the backpressure from the
+    drivers */
+static int handle_ctl_timer(zloop_t *loop, int timer_id, void *arg)
 {
-  trinarkular_prober_t *prober = (trinarkular_prober_t *)arg;
-  int slice_cnt = 0;
-  int queued_cnt = 0;
-
-  uint64_t probing_round = prober->current_slice / PARAM(periodic_round_slices);
-
-  uint64_t now = zclock_time();
-
-  trinarkular_slash24_t *s24 = NULL;         // BORROWED
-  trinarkular_slash24_state_t *state = NULL; // BORROWED
+  prober_worker_t *worker = (prober_worker_t *)arg;
+  trinarkular_prober_t *prober = worker->prober;
+  struct driver_wrap *dw = NULL;
+  uint64_t depth_max = PARAM(backpressure_queue_depth);
+  uint32_t latency_max = PARAM(backpressure_latency);
+  uint32_t hold;
+  int backpressure;
+  int i;
 
   CHECK_SHUTDOWN;
 
-  // do we have to reload the probelist?
-  if (prober->reload_probelist_state == PROBELIST_RELOAD_SCHEDULED) {
-    schedule_probelist_reload(prober);
+  if (depth_max == 0) {
+    depth_max = worker->ctl[CTL_PERIODIC].window_max / worker->drivers_cnt;
+  }
+  if (latency_max == 0) {
+    latency_max = PARAM(periodic_probe_timeout) * 1000;
   }
 
-  // have we reached the end of the probelist and need to start over?
-  if (prober->probing_started == 0 ||
-      trinarkular_probelist_has_more_slash24(ACTIVE_PL(prober)) == 0) {
-    // only reset if the round has ended (should only happen when probelist is
-    // smaller than slice count
-    if (prober->current_slice % PARAM(periodic_round_slices) != 0) {
-      trinarkular_log("No /24s left to probe in round %" PRIu64, probing_round);
-      goto done;
+  // lost responses, a backed-up driver queue, or responses that take longer
+  // than the timeout all mean that the driver is not keeping up
+  backpressure = (worker->ctl_expired_cnt > 0);
+  worker->ctl_expired_cnt = 0;
+  for (i = 0; i < worker->drivers_cnt; i++) {
+    dw = &worker->drivers[i];
+    if (dw->outstanding > depth_max ||
+        (dw->latency_samples > 0 && dw->latency > latency_max)) {
+      backpressure = 1;
     }
-
-    // dump end of round stats
-    if (probing_round > 0) {
-      trinarkular_log("ending round %d", probing_round - 1);
-
-      if (end_of_round(prober, probing_round - 1) != 0) {
-        trinarkular_log("WARN: Could not dump end-of-round stats");
-      }
-
-      // check if we're done reloading the probelist
-      if (prober->reload_probelist_state == PROBELIST_RELOAD_RUNNING) {
-        trinarkular_log("Probelist reload still in progress.  "
-                        "Waiting until next round.");
-      } else if (prober->reload_probelist_state == PROBELIST_RELOAD_DONE) {
-        trinarkular_log("Probelist reload done.  Now updating probelist.");
-        trinarkular_prober_update_probelist(prober);
-        prober->reload_probelist_state = PROBELIST_RELOAD_NONE;
-      }
+    if (dw->latency_samples > 0 && dw->latency > worker->latency_peak) {
+      worker->latency_peak = dw->latency;
     }
+    dw->latency_samples = 0;
+  }
 
-    // check if we reached the round limit
-    if (PARAM(periodic_round_limit) > 0 &&
-        probing_round >= PARAM(periodic_round_limit)) {
-      trinarkular_log("round limit (%d) reached, shutting down",
-                      PARAM(periodic_round_limit));
-      return -1;
-    }
+  // cut the windows at most once per probe lifetime, since the probes already
+  // in flight keep the backpressure up until then
+  hold = ((PARAM(periodic_probe_timeout) * 1000) + CTL_INTERVAL - 1) /
+         CTL_INTERVAL;
+  for (i = CTL_PERIODIC; i < CTL_CLASS_CNT; i++) {
+    rate_ctl_update(&worker->ctl[i], i, backpressure, hold);
+  }
 
-    trinarkular_log("starting round %d", probing_round);
-    trinarkular_probelist_reset_slash24_iter(ACTIVE_PL(prober));
-    // reset round stats
-    reset_round_stats(prober, now);
+  // the windows may have grown
+  return worker_drain_deferred(worker);
+}
 
-    prober->probing_started = 1;
+static int start_driver(struct driver_wrap *dw, char *driver_name,
+                        char *driver_config)
+{
+  // start user-specified driver
+  if ((dw->driver = trinarkular_driver_create_by_name(driver_name,
+                                                      driver_config)) == NULL) {
+    return -1;
   }
 
-  // check if there are still a few slices of probes outstanding.  this is a
-  // good indication that scamper is not keeping up with the probing rate
-  // (probably due to our timers firing close together).  in this case we skip
-  // the entire slice.
-  if (prober->outstanding_probe_cnt > prober->slice_size * 5) {
-    trinarkular_log(
-      "WARN: %d outstanding requests (slice size is %d), skipping slice.",
-      prober->outstanding_probe_cnt, prober->slice_size);
-    goto done;
+  // add the driver to the worker's event loop
+  if (zloop_reader(dw->worker->loop,
+                   trinarkular_driver_get_recv_socket(dw->driver),
+                   handle_driver_resp, dw) != 0) {
+    trinarkular_log("ERROR: Could not add driver to prober event loop");
+    return -1;
   }
 
-  trinarkular_log("INFO: %" PRIu64 " outstanding requests (slice size is %d)",
-                  prober->outstanding_probe_cnt, prober->slice_size);
+  return 0;
+}
 
-  for (slice_cnt = 0; slice_cnt < prober->slice_size; slice_cnt++) {
-    // get a slash24 to probe
-    if ((s24 =
-         trinarkular_probelist_get_next_slash24(ACTIVE_PL(prober))) == NULL) {
-      // end of /24s
-      break;
-    }
-    // get the state for this /24
-    if ((state = trinarkular_probelist_get_slash24_state(ACTIVE_PL(prober),
-                                                         s24)) == NULL) {
-      return -1;
-    }
+/** Start an instance of each of the prober's drivers for the given worker */
+static int worker_start_drivers(prober_worker_t *worker)
+{
+  trinarkular_prober_t *prober = worker->prober;
+  struct driver_wrap *dw;
+  int i;
 
-    // if we still haven't got a response to our last probe, lets give up on it
-    // and send a new probe
-    if (state->last_probe_type != UNPROBED) {
-      trinarkular_log("INFO: re-probing /24 with last_probe_type of %d",
-                      state->last_probe_type);
-      state->last_probe_type = UNPROBED;
+  for (i = 0; i < prober->driver_specs_cnt; i++) {
+    dw = &worker->drivers[worker->drivers_cnt];
+    dw->id = worker->drivers_cnt;
+    dw->worker = worker;
+    dw->reqs_cnt = 0;
+    if ((dw->reqs = malloc(sizeof(trinarkular_probe_req_t) * REQ_BATCH_LEN)) ==
+        NULL) {
+      trinarkular_log("ERROR: Could not allocate request batch");
+      return -1;
     }
 
-    // reset the probe budgets
-    ADAPTIVE_BUDGET_SET(state, TRINARKULAR_PROBER_ROUND_PROBE_BUDGET);
-    RECOVERY_BUDGET_SET(state, AEB_TO_RECOVERY(s24));
-    if (BELIEF_STATE(state->current_belief) == UP) {
-      state->rounds_since_up = 0;
-    } else {
-      if (state->rounds_since_up < 255) {
-        state->rounds_since_up++;
-      } else {
-        state->rounds_since_up = RECOVERY_BACKOFF_MAX;
-      }
-    }
-    // queue a probe to a random host
-    if (queue_slash24_probe(prober, s24, state, PERIODIC) != 0) {
+    if (start_driver(dw, prober->driver_specs[i].name,
+                     prober->driver_specs[i].args) != 0) {
+      free(dw->reqs);
+      dw->reqs = NULL;
       return -1;
     }
 
-    queued_cnt++;
+    worker->drivers_cnt++;
   }
 
-  trinarkular_log("Queued %d /24s in slice %" PRIu64 " (round: %" PRIu64 ")",
-                  queued_cnt, prober->current_slice, probing_round);
-
-done:
-  prober->current_slice++;
-  CHECK_SHUTDOWN;
   return 0;
 }
 
-// update the bayesian model given a positive (1) or negative (0) probe response
-static float update_bayesian_belief(trinarkular_slash24_t *s24,
-                                    trinarkular_slash24_state_t *state,
-                                    int probe_response)
+/** Start checking for probes that have passed their deadline, and for
+    backpressure from the drivers */
+static int worker_start_timers(prober_worker_t *worker)
 {
-  // B(U)
-  float BU = state->current_belief;
+  if (zloop_timer(worker->loop, EXPIRY_TICK_LEN, 0, handle_expiry_timer,
+                  worker) < 0) {
+    trinarkular_log("ERROR: Could not create probe expiry timer");
+    return -1;
+  }
+
+  if (zloop_timer(worker->loop, CTL_INTERVAL, 0, handle_ctl_timer, worker) <
+      0) {
+    trinarkular_log("ERROR: Could not create backpressure timer");
+    return -1;
+  }
 
-  // B(~U)
-  float BD = 1.0 - BU;
+  return 0;
+}
 
-  // P(p|~U)
-  float PpD = (1.0 - PACKET_LOSS_FREQUENCY) / TRINARKULAR_SLASH24_HOST_CNT;
+static int handle_events_timer(zloop_t *loop, int timer_id, void *arg)
+{
+  prober_worker_t *worker = (prober_worker_t *)arg;
+  trinarkular_prober_t *prober = worker->prober;
 
-  // P(p|U)
-  float PpU = s24->aeb;
+  CHECK_SHUTDOWN;
 
-  // P(n|U)
-  float PnU = 1.0 - PpU;
+  // no event waits for (much) longer than the maximum latency, even if the
+  // worker is otherwise idle
+  return worker_publish_events(worker);
+}
 
-  // P(n|~U)
-  float PnD = 1.0 - PpD;
+/** Connect to the prober thread's event socket (must be called from the
+    thread that the worker runs in) */
+static int worker_start_events(prober_worker_t *worker)
+{
+  trinarkular_prober_t *prober = worker->prober;
 
-  float new_belief_down;
+  if (prober->events_endpoint == NULL) {
+    return 0;
+  }
 
-  // Positive response
-  if (probe_response != 0) {
-    new_belief_down = (PpD * BD) / ((PpD*BD) + (PpU*BU));
-  } else { // Negative, or no response
-    new_belief_down = (PnD*BD) / ((PnD*BD) + (PnU*BU));
+  if ((worker->events_sock = zsock_new(ZMQ_PUSH)) == NULL) {
+    trinarkular_log("ERROR: Could not create event socket");
+    return -1;
+  }
+  zsock_set_sndhwm(worker->events_sock, PARAM(events_hwm));
+  if (zsock_connect(worker->events_sock, "%s", prober->events_inproc) != 0) {
+    trinarkular_log("ERROR: Could not connect event socket");
+    return -1;
   }
 
-  // capping as per sec 4.2 of paper
-  if (new_belief_down > 0.99) {
-    new_belief_down = 0.99;
-  } else if (new_belief_down < 0.01) {
-    new_belief_down = 0.01;
+  if (PARAM(events_max_latency) != 0 &&
+      zloop_timer(worker->loop, PARAM(events_max_latency), 0,
+                  handle_events_timer, worker) < 0) {
+    trinarkular_log("ERROR: Could not create event timer");
+    return -1;
   }
 
-  // convert B(~U) to B(U) and return
-  return 1 - new_belief_down;
+  return 0;
 }
 
-#define BECOMING_UNCERTAIN(old, new)                                           \
-  ((BELIEF_STATE(new) == UNCERTAIN) ||                                         \
-   (BELIEF_STATE(old) == UP && (old > new)) ||                                 \
-   (BELIEF_STATE(old) == DOWN && (new > old)))
-
-static int handle_driver_resp(zloop_t *loop, zsock_t *reader, void *arg)
+static void worker_destroy_drivers(prober_worker_t *worker)
 {
-  struct driver_wrap *dw = (struct driver_wrap *)arg;
-  trinarkular_prober_t *prober = dw->prober;
-  trinarkular_probe_resp_t resp;
-  trinarkular_slash24_t *s24 = NULL;
-  trinarkular_slash24_state_t *state = NULL;
-  float new_belief_up;
   int i;
-  uint64_t tmp;
-  int key;
 
-  CHECK_SHUTDOWN;
+  for (i = 0; i < worker->drivers_cnt; i++) {
+    trinarkular_driver_destroy(worker->drivers[i].driver);
+    free(worker->drivers[i].reqs);
+    worker->drivers[i].reqs = NULL;
+  }
+  worker->drivers_cnt = 0;
+}
 
-  if (trinarkular_driver_recv_resp(dw->driver, &resp, 0) != 1) {
-    trinarkular_log("ERROR: Could not receive response");
-    goto err;
+static int handle_worker_cmd(zloop_t *loop, zsock_t *pipe, void *arg)
+{
+  prober_worker_t *worker = (prober_worker_t *)arg;
+  trinarkular_prober_t *prober = worker->prober;
+  char *command = NULL;
+
+  if ((command = str_recv(pipe)) == NULL) {
+    goto shutdown;
+  }
+  if (zctx_interrupted != 0 || prober->shutdown != 0) {
+    goto shutdown;
   }
 
-  // TARGET IP IS IN NETWORK BYTE ORDER
+  if (strcmp("$TERM", command) == 0) {
+    goto shutdown;
+  } else if (strcmp("SLICE", command) == 0) {
+    if (worker_probe_slice(worker) != 0) {
+      goto shutdown;
+    }
+  } else if (strcmp("PAUSE", command) == 0) {
+    // queued events refer to the metadata of the active probelist, which may
+    // be replaced while we are paused
+    if (worker_publish_events(worker) != 0) {
+      goto shutdown;
+    }
+    // the prober thread may access the state of our /24s until it tells us to
+    // resume
+    if (zsock_signal(pipe, 0) != 0) {
+      goto shutdown;
+    }
+    zstr_free(&command);
+    if ((command = str_recv(pipe)) == NULL ||
+        strcmp("RESUME", command) != 0) {
+      goto shutdown;
+    }
+  } else {
+    trinarkular_log("WARN: Unknown command received (%s)", command);
+  }
 
-  // find the /24 for this probe
-  if ((s24 = trinarkular_probelist_get_slash24(
-         ACTIVE_PL(prober), (ntohl(resp.target_ip) &
-                             TRINARKULAR_SLASH24_NETMASK))) == NULL) {
-    trinarkular_log("WARN: Missing /24 for %x", ntohl(resp.target_ip));
-    return 0;
+  zstr_free(&command);
+  return 0;
+
+shutdown:
+  zstr_free(&command);
+  worker->dead = 1;
+  return -1;
+}
+
+static void worker_run(zsock_t *pipe, void *args)
+{
+  prober_worker_t *worker = (prober_worker_t *)args;
+
+  if ((worker->loop = zloop_new()) == NULL) {
+    trinarkular_log("ERROR: Could not create worker loop");
+    goto shutdown;
   }
-  prober->outstanding_probe_cnt--;
 
-  // grab the state for this /24
-  if ((state = trinarkular_probelist_get_slash24_state(ACTIVE_PL(prober),
-                                                       s24)) == NULL) {
-    trinarkular_log("ERROR: Missing state for %x", ntohl(resp.target_ip));
-    goto err;
+  // poll the prober thread for commands
+  if (zloop_reader(worker->loop, pipe, handle_worker_cmd, worker) != 0) {
+    trinarkular_log("ERROR: Could not add reader to worker loop");
+    goto shutdown;
   }
 
-  // since periodic probing will reset adaptive probing state, this can cause
-  // responses to become out of sync. simply ignore a response that we don't
-  // care about. (NB: in practice this should rarely, if ever, happen since a
-  // round is much longer than the timeout)
-  if (state->last_probe_type == UNPROBED) {
-    return 0;
+  // drivers must be polled from the thread that they are created in
+  if (worker_start_drivers(worker) != 0 || worker_start_timers(worker) != 0 ||
+      worker_start_events(worker) != 0) {
+    goto shutdown;
   }
 
-  // update the overall per-round statistics
-  ACTIVE_STAT(probe_complete_cnt[state->last_probe_type])++;
-  ACTIVE_STAT(responsive_cnt[state->last_probe_type]) += resp.verdict;
+  // signal that we are ready for commands
+  if (zsock_signal(pipe, 0) != 0) {
+    trinarkular_log("ERROR: Could not send ready signal to prober thread");
+    goto shutdown;
+  }
 
-  new_belief_up = update_bayesian_belief(s24, state, resp.verdict);
+  while (zloop_start(worker->loop) == 0) {
+    // Only reenter zloop_start() if we got a SIGHUP.
+    if (errno == EINTR && sighup_received) {
+      sighup_received = 0;
+    } else {
+      break;
+    }
+  }
 
-#ifdef DEBUG_PROBING
-  fprintf(stdout, "%f (%s) -> %f (%s)", state->current_belief,
-          belief_icons[BELIEF_STATE(state->current_belief)], new_belief_up,
-          belief_icons[BELIEF_STATE(new_belief_up)]);
-#endif
+  trinarkular_log("worker %d shutting down", worker->id);
 
-  // if new state is uncertain, or we are moving toward uncertainty, send more
-  // probes
-  if (BECOMING_UNCERTAIN(state->current_belief, new_belief_up)) {
-    // we'd like to send an adaptive probe, but do we have any left in the
-    // budget?
-    if (ADAPTIVE_BUDGET(state) > 0) {
-      if (queue_slash24_probe(prober, s24, state, ADAPTIVE) != 0) {
-        return -1;
-      }
-#ifdef DEBUG_PROBING
-      fprintf(stdout, " ADAPTIVE");
-#endif
+shutdown:
+  worker->dead = 1;
+  worker_destroy_drivers(worker);
+  zsock_destroy(&worker->events_sock);
+  zloop_destroy(&worker->loop);
+}
 
-      // AK removes this urgent recovery to save some probes. consider enabling
-      // if probe usage is not a problem as it might help some unstable blocks
-#if 0
-      // no more adaptive probes left, but if we are changing state away from
-      // UP, we'd better be darn sure, so lets switch to recovery probing right
-      // now (unless this is the first round...)
-    } else if (state->current_state == UP && RECOVERY_BUDGET(state) > 0 &&
-               prober->current_slice != 0) {
-      // queue a recovery probe
-      if (queue_slash24_probe(prober, s24, state, RECOVERY) != 0) {
-        return -1;
-      }
-#ifdef DEBUG_PROBING
-      fprintf(stdout, " ADAPTIVE-RECOVERY");
-#endif
-#endif
+static int workers_init(trinarkular_prober_t *prober)
+{
+  prober_worker_t *worker = NULL;
+  char buf[TRINARKULAR_JOURNAL_PATH_LEN];
+  int w;
 
-      // we ideally would have liked to send an adaptive probe since belief has
-      // changed, but we're out of probes, so we give up and if the block is not
-      // already uncertain, we move belief to 0.5 (uncertain)
-    } else {
-      if (BELIEF_STATE(new_belief_up) != UNCERTAIN) {
-        new_belief_up = 0.5; // => UNCERTAIN
-      }
-      state->last_probe_type = UNPROBED;
-#ifdef DEBUG_PROBING
-      fprintf(stdout, " DONE-ADAPTIVE");
-#endif
+  if ((prober->workers = malloc_zero(sizeof(prober_worker_t) *
+                                     PARAM(worker_threads))) == NULL) {
+    trinarkular_log("ERROR: Could not allocate workers");
+    return -1;
+  }
+  prober->workers_cnt = PARAM(worker_threads);
+
+  for (w = 0; w < prober->workers_cnt; w++) {
+    worker = &prober->workers[w];
+    worker->id = w;
+    worker->prober = prober;
+    worker->pace_timer_id = -1;
+
+    if ((worker->resps = malloc(sizeof(trinarkular_probe_resp_t) *
+                                PARAM(resp_batch_size))) == NULL ||
+        (worker->resp_slash24s = malloc(sizeof(trinarkular_slash24_t *) *
+                                        PARAM(resp_batch_size))) == NULL) {
+      trinarkular_log("ERROR: Could not allocate response batch");
+      return -1;
     }
 
-    // otherwise, if we are down and staying down, send recovery probes to try
-    // and get back up.
-  } else if (BELIEF_STATE(state->current_belief) == DOWN &&
-             BELIEF_STATE(new_belief_up) == DOWN &&
-             RECOVERY_ELIGIBLE(state) != 0 &&
-             RECOVERY_BUDGET(state) > 0) {
-    // queue a recovery probe
-    if (queue_slash24_probe(prober, s24, state, RECOVERY) != 0) {
+    if (prober->events_endpoint != NULL &&
+        (worker->events =
+           malloc(sizeof(slash24_event_t) * EVENT_BATCH_LEN)) == NULL) {
+      trinarkular_log("ERROR: Could not allocate event batch");
       return -1;
     }
-#ifdef DEBUG_PROBING
-    fprintf(stdout, " RECOVERY");
-#endif
-
-  } else {
-    // No adaptive/recovery probe sent
-    state->last_probe_type = UNPROBED;
-#ifdef DEBUG_PROBING
-    fprintf(stdout, " DONE");
-#endif
-  }
-
-#ifdef DEBUG_PROBING
-  fprintf(stdout, " %d %d %d\n", ADAPTIVE_BUDGET(state), RECOVERY_BUDGET(state),
-          state->rounds_since_up);
-#endif
 
-  // only update statistics if we have stopped probing this /24 (otherwise we
-  // run the risk of dumping info about a /24 while the prober is converging on
-  // a decision)
-  if (state->last_probe_type == UNPROBED) {
-    // update overall belief stats
-    // decrement current state
-    ACTIVE_STAT(slash24_state_cnts[state->current_state])--;
-    // increment new state
-    ACTIVE_STAT(slash24_state_cnts[BELIEF_STATE(new_belief_up)])++;
+    if ((worker->expiry_wheel = trinarkular_timer_wheel_create(
+           EXPIRY_TICK_LEN, zclock_time())) == NULL) {
+      trinarkular_log("ERROR: Could not create probe expiry wheel");
+      return -1;
+    }
 
-    // update the timeseries
-    for (i = 0; i < state->metrics_cnt; i++) {
-      if (state->metrics[i].belief != -1) {
-        timeseries_kp_set(ACTIVE_KP_SLASH24(prober), state->metrics[i].belief,
-                          new_belief_up * 100);
+    // each worker has its own journal so that appending needs no locking
+    if (prober->journal_prefix != NULL) {
+      if (snprintf(buf, sizeof(buf), "%s.w%d", prober->journal_prefix, w) >=
+          (int)sizeof(buf)) {
+        trinarkular_log("ERROR: Journal path too long");
+        return -1;
       }
-      if (state->metrics[i].state != -1) {
-        timeseries_kp_set(ACTIVE_KP_SLASH24(prober), state->metrics[i].state,
-                          BELIEF_STATE(new_belief_up));
+      if ((worker->journal = trinarkular_journal_create(
+             buf, PARAM(journal_file_records), PARAM(journal_files_max))) ==
+          NULL) {
+        return -1;
       }
+    }
+  }
+
+  return 0;
+}
 
-      // update the overall stats for this metric
-      // decrement the old state
-      key = state->metrics[i].overall[state->current_state];
-      tmp = timeseries_kp_get(ACTIVE_KP_AGGR(prober), key);
-      assert(tmp > 0);
-      timeseries_kp_set(ACTIVE_KP_AGGR(prober), key, tmp - 1);
-      // increment the new state
-      key = state->metrics[i].overall[BELIEF_STATE(new_belief_up)];
-      tmp = timeseries_kp_get(ACTIVE_KP_AGGR(prober), key);
-      timeseries_kp_set(ACTIVE_KP_AGGR(prober), key, tmp + 1);
+static int workers_start(trinarkular_prober_t *prober)
+{
+  prober_worker_t *worker = NULL;
+  int w;
+
+  // a single worker runs in the prober thread
+  if (prober->workers_cnt == 1) {
+    prober->workers[0].loop = prober->loop;
+    if (worker_start_drivers(&prober->workers[0]) != 0 ||
+        worker_start_events(&prober->workers[0]) != 0) {
+      return -1;
     }
+    return worker_start_timers(&prober->workers[0]);
+  }
 
-    // update the stable state
-    state->current_state = BELIEF_STATE(new_belief_up);
+  for (w = 0; w < prober->workers_cnt; w++) {
+    worker = &prober->workers[w];
+    if ((worker->actor = zactor_new(worker_run, worker)) == NULL) {
+      trinarkular_log("ERROR: Could not start worker thread");
+      return -1;
+    }
+    // by the time zactor_new returns, the worker has started its drivers
+    if (worker->dead != 0) {
+      trinarkular_log("ERROR: Worker %d has already shut down", w);
+      return -1;
+    }
   }
 
-  // update the belief
-  state->current_belief = new_belief_up;
+  trinarkular_log("%d worker threads started", prober->workers_cnt);
 
   return 0;
-
-err:
-  return -1;
 }
 
-static int start_driver(struct driver_wrap *dw, char *driver_name,
-                        char *driver_config)
+static void workers_destroy(trinarkular_prober_t *prober)
 {
-  // start user-specified driver
-  if ((dw->driver = trinarkular_driver_create_by_name(driver_name,
-                                                      driver_config)) == NULL) {
-    return -1;
-  }
+  prober_worker_t *worker = NULL;
+  int w;
 
-  // add the driver to our event loop
-  if (zloop_reader(dw->prober->loop,
-                   trinarkular_driver_get_recv_socket(dw->driver),
-                   handle_driver_resp, dw) != 0) {
-    trinarkular_log("ERROR: Could not add driver to prober event loop");
-    return -1;
+  for (w = 0; w < prober->workers_cnt; w++) {
+    worker = &prober->workers[w];
+
+    if (worker->actor != NULL) {
+      // the worker thread destroys its own drivers
+      zactor_destroy(&worker->actor);
+    } else {
+      worker_destroy_drivers(worker);
+      zsock_destroy(&worker->events_sock);
+    }
+
+    if (worker->outstanding_probe_cnt != 0) {
+      trinarkular_log("WARN: %" PRIu64 " outstanding probes at shutdown "
+                      "(worker %d)",
+                      worker->outstanding_probe_cnt, w);
+    }
+
+    free(worker->slash24s);
+    free(worker->dirty);
+    free(worker->resps);
+    free(worker->resp_slash24s);
+    free(worker->deferred);
+    free(worker->events);
+    trinarkular_timer_wheel_destroy(worker->expiry_wheel);
+    trinarkular_journal_destroy(worker->journal);
   }
 
-  return 0;
+  free(prober->workers);
+  prober->workers = NULL;
+  prober->workers_cnt = 0;
 }
 
 trinarkular_prober_t *trinarkular_prober_create(const char *name,
@@ -1241,11 +4852,10 @@ trinarkular_prober_t *trinarkular_prober_create(const char *name,
   prober->probelist_filename = strdup(probelist);
   assert(prober->probelist_filename != NULL);
 
-  // prepare and assign probelist
-  if (trinarkular_prober_prepare_probelist(prober) != 0) {
-    goto err;
-  }
-  trinarkular_prober_update_probelist(prober);
+  pthread_mutex_init(&prober->flush_mutex, NULL);
+  pthread_cond_init(&prober->flush_cond, NULL);
+  pthread_mutex_init(&prober->ckpt_mutex, NULL);
+  pthread_cond_init(&prober->ckpt_cond, NULL);
 
   // create the reactor
   if ((prober->loop = zloop_new()) == NULL) {
@@ -1276,20 +4886,54 @@ void trinarkular_prober_destroy(trinarkular_prober_t *prober)
   prober->name_ts = NULL;
   free(prober->probelist_filename);
   prober->probelist_filename = NULL;
+  free(prober->journal_prefix);
+  prober->journal_prefix = NULL;
+  free(prober->events_endpoint);
+  prober->events_endpoint = NULL;
+  free(prober->events_topic_prefix);
+  prober->events_topic_prefix = NULL;
+  free(prober->lazy_keys);
+  prober->lazy_keys = NULL;
+  free(prober->emit_keys);
+  prober->emit_keys = NULL;
+  free(prober->emitted_keys);
+  prober->emitted_keys = NULL;
 
   zloop_destroy(&prober->loop);
 
-  if (prober->outstanding_probe_cnt != 0) {
-    trinarkular_log("WARN: %d outstanding probes at shutdown",
-                    prober->outstanding_probe_cnt);
-  }
-
-  // shut down the probe driver(s)
-  for (i = 0; i < prober->drivers_cnt; i++) {
-    trinarkular_driver_destroy(prober->drivers[i].driver);
+  // finish writing the last round (and checkpoint)
+  flusher_stop(prober);
+  pthread_mutex_destroy(&prober->flush_mutex);
+  pthread_cond_destroy(&prober->flush_cond);
+  checkpointer_stop(prober);
+  pthread_mutex_destroy(&prober->ckpt_mutex);
+  pthread_cond_destroy(&prober->ckpt_cond);
+  free(prober->checkpoint_path);
+  prober->checkpoint_path = NULL;
+  free(prober->ckpt_recs);
+  prober->ckpt_recs = NULL;
+  free(prober->ckpt_version);
+  prober->ckpt_version = NULL;
+
+  // the table file is left for readers
+  trinarkular_state_table_destroy(prober->state_table);
+  prober->state_table = NULL;
+  free(prober->state_table_path);
+  prober->state_table_path = NULL;
+
+  // shut down the workers and their probe driver(s)
+  workers_destroy(prober);
+
+  zsock_destroy(&prober->events_pull);
+  zsock_destroy(&prober->events_pub);
+
+  for (i = 0; i < prober->driver_specs_cnt; i++) {
+    free(prober->driver_specs[i].name);
+    free(prober->driver_specs[i].args);
   }
-  prober->drivers_cnt = 0;
+  prober->driver_specs_cnt = 0;
 
+  trinarkular_probelist_diff_free(&prober->reload_diff);
   probelist_state_destroy(&ACTIVE_PL_STATE(prober));
   probelist_state_destroy(&NEXT_PL_STATE(prober));
 
@@ -1298,6 +4942,182 @@ void trinarkular_prober_destroy(trinarkular_prober_t *prober)
   free(prober);
 }
 
+/** Restore the state of the /24s of the active probelist from the
+    checkpoint, if it is recent enough and was taken from the same version of
+    the probelist. The restored /24s are exported at the end of the first
+    round. */
+static int checkpoint_restore(trinarkular_prober_t *prober)
+{
+  trinarkular_probelist_t *pl = ACTIVE_PL(prober);
+  const char *version = trinarkular_probelist_get_version(pl);
+  FILE *fh = NULL;
+  checkpoint_hdr_t hdr;
+  checkpoint_rec_t *recs = NULL;
+  char *ckpt_version = NULL;
+  trinarkular_slash24_t *s24;
+  trinarkular_slash24_state_t *state;
+  uint64_t now = zclock_time();
+  uint64_t remain, restored_cnt = 0;
+  size_t cnt, i;
+
+  if (prober->checkpoint_path == NULL || PARAM(checkpoint_max_age) == 0) {
+    return 0;
+  }
+
+  if ((fh = fopen(prober->checkpoint_path, "rb")) == NULL) {
+    trinarkular_log("No checkpoint found at %s, cold starting",
+                    prober->checkpoint_path);
+    return 0;
+  }
+
+  // a checkpoint that cannot be used is not an error, we just cold start
+  if (fread(&hdr, sizeof(hdr), 1, fh) != 1 ||
+      memcmp(hdr.magic, CKPT_MAGIC, sizeof(CKPT_MAGIC)) != 0 ||
+      hdr.byte_order != CKPT_BYTE_ORDER ||
+      hdr.format_version != CKPT_VERSION ||
+      hdr.record_size != sizeof(checkpoint_rec_t) || hdr.version_len == 0 ||
+      hdr.version_len > 4096) {
+    trinarkular_log("WARN: Unsupported or corrupt checkpoint, cold starting");
+    goto done;
+  }
+  if (now < hdr.time || now - hdr.time > PARAM(checkpoint_max_age)) {
+    trinarkular_log("WARN: Checkpoint is too old, cold starting");
+    goto done;
+  }
+  if ((ckpt_version = malloc(hdr.version_len)) == NULL ||
+      (recs = malloc(sizeof(checkpoint_rec_t) * CKPT_READ_BATCH_LEN)) ==
+        NULL) {
+    trinarkular_log("ERROR: Could not allocate checkpoint buffers");
+    goto err;
+  }
+  if (fread(ckpt_version, hdr.version_len, 1, fh) != 1 ||
+      ckpt_version[hdr.version_len - 1] != '\0') {
+    trinarkular_log("WARN: Corrupt checkpoint, cold starting");
+    goto done;
+  }
+  if (version == NULL || strcmp(version, ckpt_version) != 0) {
+    trinarkular_log("WARN: Checkpoint is for probelist version %s, cold "
+                    "starting",
+                    ckpt_version);
+    goto done;
+  }
+
+  // every /24 starts UP, so a restored /24 is marked dirty to be counted (and
+  // exported) in its restored state
+  for (remain = hdr.slash24_cnt; remain > 0; remain -= cnt) {
+    cnt = (remain < CKPT_READ_BATCH_LEN) ? remain : CKPT_READ_BATCH_LEN;
+    if (fread(recs, sizeof(checkpoint_rec_t), cnt, fh) != cnt) {
+      trinarkular_log("WARN: Truncated checkpoint, partially warm started");
+      break;
+    }
+    for (i = 0; i < cnt; i++) {
+      if (recs[i].state >= BELIEF_STATE_CNT ||
+          (s24 = trinarkular_probelist_get_slash24(
+             pl, recs[i].network_ip)) == NULL ||
+          (state = trinarkular_probelist_get_slash24_state(pl, s24)) ==
+            NULL) {
+        continue;
+      }
+      state->current_belief = recs[i].belief;
+      state->settled_belief = recs[i].belief;
+      state->current_state = recs[i].state;
+      state->rounds_since_up = recs[i].rounds_since_up;
+      if (worker_mark_dirty(
+            &prober->workers[WORKER_ID(prober, s24->network_ip)], s24,
+            state) != 0) {
+        goto err;
+      }
+      restored_cnt++;
+    }
+  }
+
+  trinarkular_log("Warm started %" PRIu64 " /24s from %s (%" PRIu64 "s old)",
+                  restored_cnt, prober->checkpoint_path,
+                  (now - hdr.time) / 1000);
+
+done:
+  free(ckpt_version);
+  free(recs);
+  fclose(fh);
+  return 0;
+
+err:
+  free(ckpt_version);
+  free(recs);
+  fclose(fh);
+  return -1;
+}
+
+/** Forward a batch of events from a worker to the subscribers */
+static int handle_events(zloop_t *loop, zsock_t *reader, void *arg)
+{
+  trinarkular_prober_t *prober = (trinarkular_prober_t *)arg;
+  zmsg_t *msg = NULL;
+  zframe_t *recs;
+
+  CHECK_SHUTDOWN;
+
+  if ((msg = zmsg_recv(reader)) == NULL) {
+    trinarkular_log("ERROR: Could not receive events");
+    return -1;
+  }
+  if ((recs = zmsg_last(msg)) != NULL) {
+    prober->events_published_cnt +=
+      zframe_size(recs) / sizeof(trinarkular_journal_rec_t);
+  }
+
+  // a PUB socket drops messages for subscribers that are at their HWM rather
+  // than blocking
+  if (zmsg_send(&msg, prober->events_pub) != 0) {
+    trinarkular_log("WARN: Could not publish events");
+    zmsg_destroy(&msg);
+  }
+
+  return 0;
+}
+
+/** Create the event sockets (before the workers connect to them) */
+static int events_start(trinarkular_prober_t *prober)
+{
+  if (prober->events_endpoint == NULL) {
+    return 0;
+  }
+
+  snprintf(prober->events_inproc, sizeof(prober->events_inproc),
+           "inproc://trinarkular-events-%p", (void *)prober);
+  if ((prober->events_pull = zsock_new(ZMQ_PULL)) == NULL) {
+    trinarkular_log("ERROR: Could not create event socket");
+    return -1;
+  }
+  zsock_set_rcvhwm(prober->events_pull, PARAM(events_hwm));
+  if (zsock_bind(prober->events_pull, "%s", prober->events_inproc) == -1) {
+    trinarkular_log("ERROR: Could not bind event socket");
+    return -1;
+  }
+
+  if ((prober->events_pub = zsock_new(ZMQ_PUB)) == NULL) {
+    trinarkular_log("ERROR: Could not create event socket");
+    return -1;
+  }
+  zsock_set_sndhwm(prober->events_pub, PARAM(events_hwm));
+  if (zsock_bind(prober->events_pub, "%s", prober->events_endpoint) == -1) {
+    trinarkular_log("ERROR: Could not bind event socket to %s",
+                    prober->events_endpoint);
+    return -1;
+  }
+
+  if (zloop_reader(prober->loop, prober->events_pull, handle_events, prober) !=
+      0) {
+    trinarkular_log("ERROR: Could not add event reader to loop");
+    return -1;
+  }
+
+  trinarkular_log("publishing transition events on %s",
+                  prober->events_endpoint);
+
+  return 0;
+}
+
 int trinarkular_prober_start(trinarkular_prober_t *prober)
 {
   uint32_t periodic_timeout;
@@ -1307,12 +5127,37 @@ int trinarkular_prober_start(trinarkular_prober_t *prober)
   assert(prober != NULL);
   assert(prober->started == 0);
 
-  if (ACTIVE_PL(prober) == NULL ||
-      trinarkular_probelist_get_slash24_cnt(ACTIVE_PL(prober)) == 0) {
+  // the probelist is partitioned across the workers when it is assigned
+  if (workers_init(prober) != 0) {
+    return -1;
+  }
+
+  // prepare and assign probelist (done here rather than at create time so
+  // that parameters such as the parser thread count can be set first)
+  if (trinarkular_prober_prepare_probelist(prober) != 0 ||
+      trinarkular_prober_update_probelist(prober) != 0) {
+    return -1;
+  }
+
+  if (trinarkular_probelist_get_slash24_cnt(ACTIVE_PL(prober)) == 0) {
     trinarkular_log("ERROR: Missing or empty probelist. Refusing to start");
     return -1;
   }
 
+  // pick up where the last run left off
+  if (checkpoint_restore(prober) != 0) {
+    return -1;
+  }
+
+  // publish the (possibly restored) state of every /24
+  if (prober->state_table_path != NULL) {
+    if ((prober->state_table =
+           trinarkular_state_table_create(prober->state_table_path)) == NULL) {
+      return -1;
+    }
+    state_table_rebuild(prober);
+  }
+
   // create the periodic probe timer
   periodic_timeout =
     PARAM(periodic_round_duration) / PARAM(periodic_round_slices);
@@ -1326,14 +5171,21 @@ int trinarkular_prober_start(trinarkular_prober_t *prober)
     return -1;
   }
 
-  // start the default driver if needed
-  if (prober->drivers_cnt == 0 &&
+  // use the default driver if needed
+  if (prober->driver_specs_cnt == 0 &&
       trinarkular_prober_add_driver(prober, TRINARKULAR_PROBER_DRIVER_DEFAULT,
                                     TRINARKULAR_PROBER_DRIVER_ARGS_DEFAULT) !=
         0) {
     return -1;
   }
 
+  // start the workers (and their drivers), the timeseries flusher, and the
+  // checkpoint thread
+  if (events_start(prober) != 0 || workers_start(prober) != 0 ||
+      flusher_start(prober) != 0 || checkpointer_start(prober) != 0) {
+    return -1;
+  }
+
   prober->started = 1;
 
   // wait so that our round starts at a nice time
@@ -1417,25 +5269,216 @@ void trinarkular_prober_disable_sleep_align_start(trinarkular_prober_t *prober)
   PARAM(sleep_align_start) = 0;
 }
 
+void trinarkular_prober_set_probelist_threads(trinarkular_prober_t *prober,
+                                              int threads)
+{
+  assert(prober != NULL);
+  assert(threads > 0);
+
+  trinarkular_log("%d", threads);
+  PARAM(probelist_threads) = threads;
+}
+
+void trinarkular_prober_enable_incremental_reload(trinarkular_prober_t *prober)
+{
+  assert(prober != NULL);
+
+  PARAM(incremental_reload) = 1;
+}
+
+void trinarkular_prober_enable_lazy_slash24_keys(trinarkular_prober_t *prober)
+{
+  assert(prober != NULL);
+  assert(prober->started == 0);
+
+  PARAM(lazy_slash24_keys) = 1;
+}
+
+void trinarkular_prober_enable_delta_emission(trinarkular_prober_t *prober,
+                                              uint32_t keyframe_interval)
+{
+  assert(prober != NULL);
+  assert(prober->started == 0);
+  assert(keyframe_interval > 0);
+
+  PARAM(delta_keyframe_interval) = keyframe_interval;
+}
+
+int trinarkular_prober_enable_journal(trinarkular_prober_t *prober,
+                                      const char *prefix, uint64_t file_records,
+                                      uint32_t files_max)
+{
+  assert(prober != NULL);
+  assert(prober->started == 0);
+  assert(prefix != NULL);
+  assert(file_records > 0);
+
+  trinarkular_log("%s %" PRIu64 " %" PRIu32, prefix, file_records, files_max);
+
+  free(prober->journal_prefix);
+  if ((prober->journal_prefix = strdup(prefix)) == NULL) {
+    trinarkular_log("ERROR: Could not copy journal prefix");
+    return -1;
+  }
+  PARAM(journal_file_records) = file_records;
+  PARAM(journal_files_max) = files_max;
+
+  return 0;
+}
+
+int trinarkular_prober_enable_checkpoint(trinarkular_prober_t *prober,
+                                         const char *path, uint64_t interval,
+                                         uint64_t max_age)
+{
+  assert(prober != NULL);
+  assert(prober->started == 0);
+  assert(path != NULL);
+
+  trinarkular_log("%s %" PRIu64 " %" PRIu64, path, interval, max_age);
+
+  free(prober->checkpoint_path);
+  if ((prober->checkpoint_path = strdup(path)) == NULL) {
+    trinarkular_log("ERROR: Could not copy checkpoint path");
+    return -1;
+  }
+  PARAM(checkpoint_interval) = interval;
+  PARAM(checkpoint_max_age) = max_age;
+
+  return 0;
+}
+
+int trinarkular_prober_enable_state_table(trinarkular_prober_t *prober,
+                                          const char *path)
+{
+  assert(prober != NULL);
+  assert(prober->started == 0);
+  assert(path != NULL);
+
+  trinarkular_log("%s", path);
+
+  free(prober->state_table_path);
+  if ((prober->state_table_path = strdup(path)) == NULL) {
+    trinarkular_log("ERROR: Could not copy state table path");
+    return -1;
+  }
+
+  return 0;
+}
+
+int trinarkular_prober_enable_events(trinarkular_prober_t *prober,
+                                     const char *endpoint,
+                                     const char *topic_prefix,
+                                     uint32_t max_latency, int hwm)
+{
+  assert(prober != NULL);
+  assert(prober->started == 0);
+  assert(endpoint != NULL);
+  assert(hwm > 0);
+
+  trinarkular_log("%s %s %" PRIu32 " %d", endpoint,
+                  topic_prefix != NULL ? topic_prefix : "", max_latency, hwm);
+
+  free(prober->events_endpoint);
+  free(prober->events_topic_prefix);
+  prober->events_topic_prefix = NULL;
+  if ((prober->events_endpoint = strdup(endpoint)) == NULL ||
+      (topic_prefix != NULL &&
+       (prober->events_topic_prefix = strdup(topic_prefix)) == NULL)) {
+    trinarkular_log("ERROR: Could not copy event configuration");
+    return -1;
+  }
+  prober->events_topic_prefix_len =
+    (topic_prefix != NULL) ? strlen(topic_prefix) : 0;
+  PARAM(events_max_latency) = max_latency;
+  PARAM(events_hwm) = hwm;
+
+  return 0;
+}
+
+void trinarkular_prober_set_resp_batch_size(trinarkular_prober_t *prober,
+                                            int batch_size)
+{
+  assert(prober != NULL);
+  assert(prober->started == 0);
+  assert(batch_size > 0);
+
+  trinarkular_log("%d", batch_size);
+  PARAM(resp_batch_size) = batch_size;
+}
+
+void trinarkular_prober_enable_pacing(trinarkular_prober_t *prober,
+                                      int batch_size, int rate)
+{
+  assert(prober != NULL);
+  assert(batch_size > 0);
+  assert(rate >= 0);
+
+  trinarkular_log("%d probes per batch, %d probes/sec", batch_size, rate);
+  PARAM(pacing_batch_size) = batch_size;
+  PARAM(pacing_rate) = rate;
+}
+
+void trinarkular_prober_set_probe_expiry_grace(trinarkular_prober_t *prober,
+                                               uint32_t grace)
+{
+  assert(prober != NULL);
+
+  trinarkular_log("%" PRIu32, grace);
+  PARAM(probe_expiry_grace) = grace;
+}
+
+void trinarkular_prober_set_backpressure(trinarkular_prober_t *prober,
+                                         uint32_t latency,
+                                         uint32_t queue_depth)
+{
+  assert(prober != NULL);
+
+  trinarkular_log("%" PRIu32 "ms latency, %" PRIu32 " queued probes", latency,
+                  queue_depth);
+  PARAM(backpressure_latency) = latency;
+  PARAM(backpressure_queue_depth) = queue_depth;
+}
+
+void trinarkular_prober_set_worker_threads(trinarkular_prober_t *prober,
+                                           int threads)
+{
+  assert(prober != NULL);
+  assert(prober->started == 0);
+  assert(threads > 0 && threads <= TRINARKULAR_PROBER_WORKER_MAX_CNT);
+
+  trinarkular_log("%d", threads);
+  PARAM(worker_threads) = threads;
+}
+
 int trinarkular_prober_add_driver(trinarkular_prober_t *prober,
                                   char *driver_name, char *driver_args)
 {
+  struct driver_spec *spec;
+
   assert(prober != NULL);
+  assert(prober->started == 0);
 
   trinarkular_log("%s %s", driver_name, driver_args);
 
-  prober->drivers[prober->drivers_cnt].id = prober->drivers_cnt;
-  prober->drivers[prober->drivers_cnt].prober = prober;
+  if (prober->driver_specs_cnt == TRINARKULAR_PROBER_DRIVER_MAX_CNT) {
+    trinarkular_log("ERROR: At most %d drivers can be used",
+                    TRINARKULAR_PROBER_DRIVER_MAX_CNT);
+    return -1;
+  }
 
-  // initialize the driver
-  if (start_driver(&prober->drivers[prober->drivers_cnt], driver_name,
-                   driver_args) != 0) {
+  // the drivers are started by each worker
+  spec = &prober->driver_specs[prober->driver_specs_cnt];
+  if ((spec->name = strdup(driver_name)) == NULL ||
+      (driver_args != NULL && (spec->args = strdup(driver_args)) == NULL)) {
+    trinarkular_log("ERROR: Could not copy driver configuration");
+    free(spec->name);
+    spec->name = NULL;
     return -1;
   }
 
-  prober->drivers_cnt++;
+  prober->driver_specs_cnt++;
 
-  trinarkular_log("%d drivers", prober->drivers_cnt);
+  trinarkular_log("%d drivers", prober->driver_specs_cnt);
 
   return 0;
 }
@@ -1451,3 +5494,12 @@ void trinarkular_prober_reload_probelist(trinarkular_prober_t *prober)
     trinarkular_log("Probelist reload scheduled");
   }
 }
+
+size_t trinarkular_prober_write_slash24_key(char *buf, const char *prefix,
+                                            size_t prefix_len,
+                                            uint32_t network_ip,
+                                            const char *suffix,
+                                            size_t suffix_len)
+{
+  return key_write(buf, prefix, prefix_len, network_ip, suffix, suffix_len);
+}
@@ -76,6 +76,29 @@
 /** Default timeout for periodic probes (default: 3 seconds) */
 #define TRINARKULAR_PROBER_PERIODIC_PROBE_TIMEOUT_DEFAULT 3
 
+/** Default time (in msec) to wait for a response after the probe timeout
+    before the probe is considered lost (default: 5 seconds) */
+#define TRINARKULAR_PROBER_PROBE_EXPIRY_GRACE_DEFAULT 5000
+
+/** Default maximum number of probe responses to handle each time a driver
+    wakes the prober up */
+#define TRINARKULAR_PROBER_RESP_BATCH_SIZE_DEFAULT 1024
+
+/** Default maximum time (in msec) that a transition event waits before it is
+    published (default: 1 second) */
+#define TRINARKULAR_PROBER_EVENTS_MAX_LATENCY_DEFAULT 1000
+
+/** Default high water mark (in messages) of the transition event sockets */
+#define TRINARKULAR_PROBER_EVENTS_HWM_DEFAULT 10000
+
+/** Default time (in msec) between checkpoints of the /24 state (default:
+    10min) */
+#define TRINARKULAR_PROBER_CHECKPOINT_INTERVAL_DEFAULT 600000
+
+/** Default maximum age (in msec) of a checkpoint that the prober will warm
+    start from (default: 1 hour) */
+#define TRINARKULAR_PROBER_CHECKPOINT_MAX_AGE_DEFAULT 3600000
+
 /** Default probe driver to use (scamper) */
 #define TRINARKULAR_PROBER_DRIVER_DEFAULT "test"
 
@@ -85,6 +108,10 @@
 /** Maximum number of probers that can be used */
 #define TRINARKULAR_PROBER_DRIVER_MAX_CNT 100
 
+/** Maximum number of worker threads that the probelist can be partitioned
+    across */
+#define TRINARKULAR_PROBER_WORKER_MAX_CNT 64
+
 /** @} */
 
 /**
@@ -191,6 +218,205 @@ void trinarkular_prober_set_periodic_probe_timeout(trinarkular_prober_t *prober,
  */
 void trinarkular_prober_disable_sleep_align_start(trinarkular_prober_t *prober);
 
+/** Set the number of threads used to parse a JSON probelist (and to generate
+ * its per-/24 timeseries keys)
+ *
+ * @param prober        pointer to the prober to set parameter for
+ * @param threads       number of parser threads (1 parses inline)
+ */
+void trinarkular_prober_set_probelist_threads(trinarkular_prober_t *prober,
+                                              int threads);
+
+/** Enable incremental probelist reloads
+ *
+ * @param prober        pointer to the prober to set parameter for
+ *
+ * When enabled, a reloaded probelist is compared with the active probelist and
+ * only /24s that have been added, removed, or changed are updated. Unchanged
+ * /24s keep their belief state and timeseries keys.
+ */
+void trinarkular_prober_enable_incremental_reload(trinarkular_prober_t *prober);
+
+/** Enable lazy registration of per-/24 keys
+ *
+ * @param prober        pointer to the prober to set parameter for
+ *
+ * When enabled, the per-/24 belief and state keys of a /24 are only created
+ * once the /24 first settles in a state other than UP, so the per-/24
+ * timeseries only contain /24s that have changed state (a /24 without
+ * timeseries has been UP since the probelist was loaded). New keys are
+ * resolved in a batch when the round is flushed.
+ */
+void trinarkular_prober_enable_lazy_slash24_keys(trinarkular_prober_t *prober);
+
+/** Enable delta emission of per-/24 timeseries
+ *
+ * @param prober            pointer to the prober to set parameter for
+ * @param keyframe_interval number of rounds between keyframes (must be > 0)
+ *
+ * When enabled, only per-/24 values that changed since they were last written
+ * are flushed at the end of a round. Every keyframe_interval rounds (and after
+ * a probelist reload), all per-/24 values are written.
+ */
+void trinarkular_prober_enable_delta_emission(trinarkular_prober_t *prober,
+                                              uint32_t keyframe_interval);
+
+/** Enable journaling of /24 state transitions
+ *
+ * @param prober        pointer to the prober to set parameter for
+ * @param prefix        path prefix of the journal files
+ * @param file_records  number of records in each journal file
+ * @param files_max     number of journal files to keep per worker (0 to keep
+ *                      all files)
+ * @return 0 if successful, -1 otherwise
+ *
+ * When enabled, each worker appends a record to its own journal (with the
+ * prefix `<prefix>.w<worker id>`) whenever a /24 settles in a different state.
+ * See trinarkular_journal.h for the journal format and reader API.
+ */
+int trinarkular_prober_enable_journal(trinarkular_prober_t *prober,
+                                      const char *prefix, uint64_t file_records,
+                                      uint32_t files_max);
+
+/** Enable checkpointing of /24 state, and warm starting from it
+ *
+ * @param prober        pointer to the prober to set parameter for
+ * @param path          path of the checkpoint file
+ * @param interval      time (in msec) between checkpoints (0 to only warm
+ *                      start)
+ * @param max_age       maximum age (in msec) of a checkpoint to warm start
+ *                      from (0 to never warm start)
+ * @return 0 if successful, -1 otherwise
+ *
+ * Checkpoints are taken at the end of a round (once interval has passed since
+ * the last one) and written by a background thread, replacing the previous
+ * checkpoint atomically. When the prober starts, /24s of the probelist take
+ * the belief, state and recovery backoff that they had in the checkpoint, as
+ * long as the checkpoint was taken from the same version of the probelist.
+ */
+int trinarkular_prober_enable_checkpoint(trinarkular_prober_t *prober,
+                                         const char *path, uint64_t interval,
+                                         uint64_t max_age);
+
+/** Enable export of /24 state to a shared state table
+ *
+ * @param prober        pointer to the prober to set parameter for
+ * @param path          path of the state table file (e.g., in /dev/shm)
+ * @return 0 if successful, -1 otherwise
+ *
+ * The table is created when the prober starts, and rebuilt when the probelist
+ * is reloaded. Each worker writes the entry of a /24 as soon as the /24
+ * settles. Other processes can map it read-only to look up the current state
+ * of any /24 without slowing the prober. See trinarkular_state_table.h for the
+ * reader API.
+ */
+int trinarkular_prober_enable_state_table(trinarkular_prober_t *prober,
+                                          const char *path);
+
+/** Enable publishing of /24 state transition events
+ *
+ * @param prober        pointer to the prober to set parameter for
+ * @param endpoint      ZMQ endpoint to bind the PUB socket to
+ * @param topic_prefix  prefix of the metadata to use as topics (NULL to
+ *                      publish all events with an empty topic)
+ * @param max_latency   maximum time (in msec) that an event waits to be
+ *                      batched with others (0 to publish every batch of
+ *                      responses)
+ * @param hwm           high water mark (in messages) of the event sockets
+ * @return 0 if successful, -1 otherwise
+ *
+ * Each message has two frames: the topic, and an array of
+ * trinarkular_journal_rec_t records (see trinarkular_journal.h), one for each
+ * /24 that settled in a different state. Topics are metadata names without
+ * their 'L:'/'N:' location prefix (e.g. "asn.12345"). An event is published
+ * once under each distinct topic of the /24 that starts with topic_prefix
+ * (e.g. "asn."), so subscribers can subscribe to (prefixes of) metadata.
+ * Events for /24s without matching metadata are published with an empty
+ * topic.
+ *
+ * Events are never allowed to block probing: when the prober thread is behind,
+ * workers drop events (and count them), and the PUB socket drops messages for
+ * subscribers that have reached the high water mark.
+ */
+int trinarkular_prober_enable_events(trinarkular_prober_t *prober,
+                                     const char *endpoint,
+                                     const char *topic_prefix,
+                                     uint32_t max_latency, int hwm);
+
+/** Enable paced periodic probing
+ *
+ * @param prober        pointer to the prober to set parameter for
+ * @param batch_size    number of periodic probes to queue at a time
+ * @param rate          target number of periodic probes per second (across all
+ *                      workers), or 0 to spread each slice evenly across the
+ *                      slice interval
+ *
+ * By default all of the periodic probes in a slice are queued with the driver
+ * at once. When pacing is enabled they are instead queued in batches on a
+ * timer. Probes that cannot be sent within a slice at the target rate are
+ * carried over to the next slice.
+ */
+void trinarkular_prober_enable_pacing(trinarkular_prober_t *prober,
+                                      int batch_size, int rate);
+
+/** Set the maximum number of probe responses handled per wakeup
+ *
+ * @param prober        pointer to the prober to set parameter for
+ * @param batch_size    maximum number of responses to drain from a driver at
+ *                      once
+ *
+ * All responses that are ready (up to this limit) are handled together, and
+ * any adaptive or recovery probes that they trigger are sent to the driver in
+ * a single batch.
+ */
+void trinarkular_prober_set_resp_batch_size(trinarkular_prober_t *prober,
+                                            int batch_size);
+
+/** Set how long to wait past the probe timeout before a probe expires
+ *
+ * @param prober        pointer to the prober to set parameter for
+ * @param grace         time to wait for a late response (in msec)
+ *
+ * A probe whose response has not arrived by the time the probe timeout and
+ * this grace period have passed (e.g. because the driver lost it) is treated
+ * as unresponsive, and the belief of its /24 is updated accordingly.
+ */
+void trinarkular_prober_set_probe_expiry_grace(trinarkular_prober_t *prober,
+                                               uint32_t grace);
+
+/** Set the thresholds at which the prober backs off from the drivers
+ *
+ * @param prober        pointer to the prober to set parameter for
+ * @param latency       average response latency (in msec) of a driver above
+ *                      which it is considered saturated (0 for the periodic
+ *                      probe timeout)
+ * @param queue_depth   number of outstanding probes of a driver above which it
+ *                      is considered saturated (0 for five slices worth of
+ *                      probes, split across the drivers)
+ *
+ * The number of periodic probes, and separately the number of adaptive and
+ * recovery probes, that may be outstanding is controlled by AIMD: it is cut
+ * whenever a driver is saturated (or probes time out), and grows again
+ * otherwise. Probes that do not fit are carried over rather than skipped.
+ */
+void trinarkular_prober_set_backpressure(trinarkular_prober_t *prober,
+                                         uint32_t latency,
+                                         uint32_t queue_depth);
+
+/** Set the number of worker threads to partition probing across
+ *
+ * @param prober        pointer to the prober to set parameter for
+ * @param threads       number of worker threads (1 probes from the thread that
+ *                      calls trinarkular_prober_start)
+ *
+ * Each /24 is owned by exactly one worker, which queues its periodic probes,
+ * handles its responses and updates its belief. Every worker has its own
+ * instance of each of the drivers added to the prober. Per-round statistics
+ * and timeseries values are merged at the end of each round.
+ */
+void trinarkular_prober_set_worker_threads(trinarkular_prober_t *prober,
+                                           int threads);
+
 /** Add an instance of the given driver to the prober
  *
  * @param prober        pointer to the prober to set parameter for
@@ -200,6 +426,8 @@ void trinarkular_prober_disable_sleep_align_start(trinarkular_prober_t *prober);
  *
  * The first time this is called, the default prober is replaced, successive
  * calls will add addition drivers that will be used in a round-robin fashion.
+ * Drivers are started by trinarkular_prober_start (one instance per worker
+ * thread).
  */
 int trinarkular_prober_add_driver(trinarkular_prober_t *prober,
                                   char *driver_name, char *driver_args);
@@ -210,4 +438,25 @@ int trinarkular_prober_add_driver(trinarkular_prober_t *prober,
  */
 void trinarkular_prober_reload_probelist(trinarkular_prober_t *prober);
 
+/** Write the timeseries key of a /24
+ *
+ * @param buf           buffer to write the key to (must have room for
+ *                      prefix_len + 15 + suffix_len + 1 chars)
+ * @param prefix        part of the key before the network IP
+ * @param prefix_len    length of prefix
+ * @param network_ip    network IP of the /24 (host byte order)
+ * @param suffix        part of the key after the network IP
+ * @param suffix_len    length of suffix
+ * @return the length of the key (not including the NUL)
+ *
+ * The network IP is written as a dotted quad with dashes instead of dots
+ * (e.g. "192-0-2-0"). This is the writer that the prober builds all per-/24
+ * keys with.
+ */
+size_t trinarkular_prober_write_slash24_key(char *buf, const char *prefix,
+                                            size_t prefix_len,
+                                            uint32_t network_ip,
+                                            const char *suffix,
+                                            size_t suffix_len);
+
 #endif /* __TRINARKULAR_PROBER_H */
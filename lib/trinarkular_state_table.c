@@ -0,0 +1,427 @@
+/*
+ * This file is part of trinarkular
+ *
+ * Copyright (C) 2015 The Regents of the University of California.
+ * Authors: Alistair King
+ *
+ * This software is Copyright (c) 2015 The Regents of the University of
+ * California. All Rights Reserved. Permission to copy, modify, and distribute this
+ * software and its documentation for academic research and education purposes,
+ * without fee, and without a written agreement is hereby granted, provided that
+ * the above copyright notice, this paragraph and the following three paragraphs
+ * appear in all copies. Permission to make use of this software for other than
+ * academic research and education purposes may be obtained by contacting:
+ *
+ * Office of Innovation and Commercialization
+ * 9500 Gilman Drive, Mail Code 0910
+ * University of California
+ * La Jolla, CA 92093-0910
+ * (858) 534-5815
+ * invent@ucsd.edu
+ *
+ * This software program and documentation are copyrighted by The Regents of the
+ * University of California. The software program and documentation are supplied
+ * "as is", without any accompanying services from The Regents. The Regents does
+ * not warrant that the operation of the program will be uninterrupted or
+ * error-free. The end-user understands that the program was developed for research
+ * purposes and is advised not to rely exclusively on the program for any reason.
+ *
+ * IN NO EVENT SHALL THE UNIVERSITY OF CALIFORNIA BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+ * PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF
+ * THE UNIVERSITY OF CALIFORNIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE. THE UNIVERSITY OF CALIFORNIA SPECIFICALLY DISCLAIMS ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS
+ * IS" BASIS, AND THE UNIVERSITY OF CALIFORNIA HAS NO OBLIGATIONS TO PROVIDE
+ * MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ * Report any bugs, questions or comments to alistair@caida.org
+ *
+ */
+
+#include "trinarkular_state_table.h"
+#include "trinarkular.h"
+#include "trinarkular_log.h"
+#include "config.h"
+#include "utils.h"
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/* The table file is a header page followed by TRINARKULAR_SLASH24_CNT
+ * entries. The header has a page to itself so that the entries are page
+ * aligned, and the sequence number has a cache line to itself.
+ */
+
+/** Magic string at the start of every state table */
+#define ST_MAGIC "TRNKSTT"
+
+/** Current version of the state table format */
+#define ST_VERSION 1
+
+/** Written in native byte order so that tables from hosts with a different
+    byte order can be rejected */
+#define ST_BYTE_ORDER 0x01020304
+
+/** Size of the header (and offset of the entries) */
+#define ST_HDR_SIZE 4096
+
+/** Size of the table file */
+#define ST_FILE_SIZE                                                           \
+  (ST_HDR_SIZE +                                                               \
+   sizeof(trinarkular_state_table_entry_t) * (size_t)TRINARKULAR_SLASH24_CNT)
+
+#define ST_IDX(network_ip) ((network_ip) >> 8)
+
+/** An entry as a single word, so that it can be written and read atomically
+    (entries are 4 byte aligned since they start on a page boundary) */
+typedef uint32_t __attribute__((may_alias)) st_word_t;
+
+static inline void entry_store(trinarkular_state_table_entry_t *entry,
+                               const trinarkular_state_table_entry_t *value)
+{
+  st_word_t word;
+
+  memcpy(&word, value, sizeof(word));
+  __atomic_store_n((st_word_t *)entry, word, __ATOMIC_RELAXED);
+}
+
+static inline void entry_load(const trinarkular_state_table_entry_t *entry,
+                              trinarkular_state_table_entry_t *value)
+{
+  st_word_t word = __atomic_load_n((const st_word_t *)entry, __ATOMIC_RELAXED);
+
+  memcpy(value, &word, sizeof(word));
+}
+
+typedef struct st_hdr {
+
+  /** ST_MAGIC (NUL padded) */
+  char magic[8];
+
+  /** ST_VERSION */
+  uint32_t format_version;
+
+  /** ST_BYTE_ORDER */
+  uint32_t byte_order;
+
+  /** Size of each entry */
+  uint32_t entry_size;
+
+  /** Unused */
+  uint32_t pad;
+
+  /** Round that the table reflects */
+  uint64_t round_id;
+
+  /** Time that the round completed (ms since the epoch) */
+  uint64_t time;
+
+  /** Sequence lock (odd while an update is in progress) */
+  uint64_t seq __attribute__((aligned(64)));
+
+} st_hdr_t;
+
+struct trinarkular_state_table {
+
+  /** Mapping of the table file */
+  uint8_t *base;
+
+  /** Header (points into the mapping) */
+  st_hdr_t *hdr;
+
+  /** Entries (point into the mapping) */
+  trinarkular_state_table_entry_t *entries;
+
+  /** Sequence number (only changed by the writer) */
+  uint64_t seq;
+};
+
+struct trinarkular_state_table_reader {
+
+  /** Mapping of the table file */
+  uint8_t *base;
+
+  /** Header (points into the mapping) */
+  st_hdr_t *hdr;
+
+  /** Entries (point into the mapping) */
+  const trinarkular_state_table_entry_t *entries;
+};
+
+/* ---------- WRITING ---------- */
+
+trinarkular_state_table_t *trinarkular_state_table_create(const char *path)
+{
+  trinarkular_state_table_t *table = NULL;
+  int fd = -1;
+
+  assert(sizeof(st_hdr_t) <= ST_HDR_SIZE);
+  assert(sizeof(trinarkular_state_table_entry_t) == sizeof(st_word_t));
+
+  if ((table = malloc_zero(sizeof(trinarkular_state_table_t))) == NULL) {
+    trinarkular_log("ERROR: Could not allocate state table");
+    return NULL;
+  }
+
+  // readers of the previous table keep their (now unlinked) mapping, rather
+  // than seeing it truncated
+  if ((unlink(path) != 0 && errno != ENOENT) ||
+      (fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644)) == -1 ||
+      ftruncate(fd, ST_FILE_SIZE) != 0) {
+    trinarkular_log("ERROR: Could not create state table %s (%s)", path,
+                    strerror(errno));
+    goto err;
+  }
+
+  if ((table->base = mmap(NULL, ST_FILE_SIZE, PROT_READ | PROT_WRITE,
+                          MAP_SHARED, fd, 0)) == MAP_FAILED) {
+    table->base = NULL;
+    trinarkular_log("ERROR: Could not map state table %s (%s)", path,
+                    strerror(errno));
+    goto err;
+  }
+  close(fd);
+  fd = -1;
+
+  table->hdr = (st_hdr_t *)table->base;
+  table->entries =
+    (trinarkular_state_table_entry_t *)(table->base + ST_HDR_SIZE);
+
+  // the file is zero-filled by ftruncate (i.e., empty, with seq 0), so the
+  // magic is written last to mark the table as ready
+  table->hdr->format_version = ST_VERSION;
+  table->hdr->byte_order = ST_BYTE_ORDER;
+  table->hdr->entry_size = sizeof(trinarkular_state_table_entry_t);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(table->hdr->magic, ST_MAGIC, sizeof(ST_MAGIC));
+
+  trinarkular_log("exporting /24 state to %s", path);
+
+  return table;
+
+err:
+  if (fd != -1) {
+    close(fd);
+  }
+  trinarkular_state_table_destroy(table);
+  return NULL;
+}
+
+void trinarkular_state_table_destroy(trinarkular_state_table_t *table)
+{
+  if (table == NULL) {
+    return;
+  }
+
+  if (table->base != NULL) {
+    munmap(table->base, ST_FILE_SIZE);
+  }
+  free(table);
+}
+
+void trinarkular_state_table_begin_update(trinarkular_state_table_t *table)
+{
+  assert((table->seq & 1) == 0);
+
+  // the odd sequence number must be visible before any entry changes
+  table->seq++;
+  __atomic_store_n(&table->hdr->seq, table->seq, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void trinarkular_state_table_end_update(trinarkular_state_table_t *table)
+{
+  assert((table->seq & 1) == 1);
+
+  table->seq++;
+  __atomic_store_n(&table->hdr->seq, table->seq, __ATOMIC_RELEASE);
+}
+
+void trinarkular_state_table_set_round(trinarkular_state_table_t *table,
+                                       uint64_t round_id, uint64_t time)
+{
+  table->hdr->round_id = round_id;
+  table->hdr->time = time;
+}
+
+void trinarkular_state_table_set(trinarkular_state_table_t *table,
+                                 uint32_t network_ip,
+                                 trinarkular_belief_t belief, uint8_t state)
+{
+  trinarkular_state_table_entry_t entry;
+
+  entry.belief = belief;
+  entry.state = state;
+  entry.flags = TRINARKULAR_STATE_TABLE_PRESENT;
+  entry_store(&table->entries[ST_IDX(network_ip)], &entry);
+}
+
+void trinarkular_state_table_unset(trinarkular_state_table_t *table,
+                                   uint32_t network_ip)
+{
+  trinarkular_state_table_entry_t entry;
+
+  memset(&entry, 0, sizeof(entry));
+  entry_store(&table->entries[ST_IDX(network_ip)], &entry);
+}
+
+void trinarkular_state_table_clear(trinarkular_state_table_t *table)
+{
+  memset(table->entries, 0,
+         sizeof(trinarkular_state_table_entry_t) * TRINARKULAR_SLASH24_CNT);
+}
+
+/* ---------- READING ---------- */
+
+trinarkular_state_table_reader_t *
+trinarkular_state_table_open(const char *path)
+{
+  trinarkular_state_table_reader_t *reader = NULL;
+  int fd = -1;
+  struct stat st;
+
+  if ((reader = malloc_zero(sizeof(trinarkular_state_table_reader_t))) ==
+      NULL) {
+    trinarkular_log("ERROR: Could not allocate state table reader");
+    return NULL;
+  }
+
+  if ((fd = open(path, O_RDONLY)) == -1 || fstat(fd, &st) != 0) {
+    trinarkular_log("ERROR: Could not open %s (%s)", path, strerror(errno));
+    goto err;
+  }
+  if ((size_t)st.st_size != ST_FILE_SIZE) {
+    trinarkular_log("ERROR: %s is not a state table (size mismatch)", path);
+    goto err;
+  }
+
+  if ((reader->base = mmap(NULL, ST_FILE_SIZE, PROT_READ, MAP_SHARED, fd,
+                           0)) == MAP_FAILED) {
+    reader->base = NULL;
+    trinarkular_log("ERROR: Could not map %s (%s)", path, strerror(errno));
+    goto err;
+  }
+  close(fd);
+  fd = -1;
+
+  reader->hdr = (st_hdr_t *)reader->base;
+  if (memcmp(reader->hdr->magic, ST_MAGIC, sizeof(ST_MAGIC)) != 0) {
+    trinarkular_log("ERROR: %s is not a state table", path);
+    goto err;
+  }
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  if (reader->hdr->byte_order != ST_BYTE_ORDER) {
+    trinarkular_log("ERROR: State table has incompatible byte order");
+    goto err;
+  }
+  if (reader->hdr->format_version != ST_VERSION ||
+      reader->hdr->entry_size != sizeof(trinarkular_state_table_entry_t)) {
+    trinarkular_log("ERROR: Unsupported state table version %d (expecting %d)",
+                    reader->hdr->format_version, ST_VERSION);
+    goto err;
+  }
+
+  reader->entries =
+    (const trinarkular_state_table_entry_t *)(reader->base + ST_HDR_SIZE);
+
+  return reader;
+
+err:
+  if (fd != -1) {
+    close(fd);
+  }
+  trinarkular_state_table_close(reader);
+  return NULL;
+}
+
+void trinarkular_state_table_close(trinarkular_state_table_reader_t *reader)
+{
+  if (reader == NULL) {
+    return;
+  }
+
+  if (reader->base != NULL) {
+    munmap(reader->base, ST_FILE_SIZE);
+  }
+  free(reader);
+}
+
+uint64_t
+trinarkular_state_table_read_begin(trinarkular_state_table_reader_t *reader)
+{
+  uint64_t seq;
+
+  // an update is brief (except when the probelist is reloaded)
+  while (((seq = __atomic_load_n(&reader->hdr->seq, __ATOMIC_ACQUIRE)) & 1) !=
+         0) {
+    sched_yield();
+  }
+
+  return seq;
+}
+
+int trinarkular_state_table_read_retry(trinarkular_state_table_reader_t *reader,
+                                       uint64_t seq)
+{
+  // the entry reads must complete before the sequence number is re-read
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&reader->hdr->seq, __ATOMIC_RELAXED) != seq;
+}
+
+const trinarkular_state_table_entry_t *
+trinarkular_state_table_get_entries(trinarkular_state_table_reader_t *reader)
+{
+  return reader->entries;
+}
+
+int trinarkular_state_table_lookup(trinarkular_state_table_reader_t *reader,
+                                   uint32_t network_ip,
+                                   trinarkular_state_table_entry_t *entry,
+                                   uint64_t *round_id)
+{
+  uint64_t seq;
+
+  do {
+    seq = trinarkular_state_table_read_begin(reader);
+    entry_load(&reader->entries[ST_IDX(network_ip)], entry);
+    if (round_id != NULL) {
+      *round_id = reader->hdr->round_id;
+    }
+  } while (trinarkular_state_table_read_retry(reader, seq) != 0);
+
+  return (entry->flags & TRINARKULAR_STATE_TABLE_PRESENT) != 0;
+}
+
+void trinarkular_state_table_copy(trinarkular_state_table_reader_t *reader,
+                                  uint32_t first_ip, uint32_t last_ip,
+                                  trinarkular_state_table_entry_t *entries,
+                                  uint64_t *round_id, uint64_t *time)
+{
+  uint64_t seq;
+  uint32_t i;
+
+  assert(first_ip <= last_ip);
+
+  do {
+    seq = trinarkular_state_table_read_begin(reader);
+    for (i = ST_IDX(first_ip); i <= ST_IDX(last_ip); i++) {
+      entry_load(&reader->entries[i], &entries[i - ST_IDX(first_ip)]);
+    }
+    if (round_id != NULL) {
+      *round_id = reader->hdr->round_id;
+    }
+    if (time != NULL) {
+      *time = reader->hdr->time;
+    }
+  } while (trinarkular_state_table_read_retry(reader, seq) != 0);
+}
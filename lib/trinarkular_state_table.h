@@ -0,0 +1,254 @@
+/*
+ * This file is part of trinarkular
+ *
+ * Copyright (C) 2015 The Regents of the University of California.
+ * Authors: Alistair King
+ *
+ * This software is Copyright (c) 2015 The Regents of the University of
+ * California. All Rights Reserved. Permission to copy, modify, and distribute this
+ * software and its documentation for academic research and education purposes,
+ * without fee, and without a written agreement is hereby granted, provided that
+ * the above copyright notice, this paragraph and the following three paragraphs
+ * appear in all copies. Permission to make use of this software for other than
+ * academic research and education purposes may be obtained by contacting:
+ *
+ * Office of Innovation and Commercialization
+ * 9500 Gilman Drive, Mail Code 0910
+ * University of California
+ * La Jolla, CA 92093-0910
+ * (858) 534-5815
+ * invent@ucsd.edu
+ *
+ * This software program and documentation are copyrighted by The Regents of the
+ * University of California. The software program and documentation are supplied
+ * "as is", without any accompanying services from The Regents. The Regents does
+ * not warrant that the operation of the program will be uninterrupted or
+ * error-free. The end-user understands that the program was developed for research
+ * purposes and is advised not to rely exclusively on the program for any reason.
+ *
+ * IN NO EVENT SHALL THE UNIVERSITY OF CALIFORNIA BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+ * PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF
+ * THE UNIVERSITY OF CALIFORNIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE. THE UNIVERSITY OF CALIFORNIA SPECIFICALLY DISCLAIMS ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS
+ * IS" BASIS, AND THE UNIVERSITY OF CALIFORNIA HAS NO OBLIGATIONS TO PROVIDE
+ * MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ * Report any bugs, questions or comments to alistair@caida.org
+ *
+ */
+
+#ifndef __TRINARKULAR_STATE_TABLE_H
+#define __TRINARKULAR_STATE_TABLE_H
+
+#include "trinarkular_belief.h"
+#include <stdint.h>
+
+/** @file
+ *
+ * @brief Header file that exposes the shared /24 state table
+ *
+ * @author Alistair King
+ *
+ * The state table is a memory-mapped file (e.g., in /dev/shm) that holds the
+ * settled belief and state of every /24 that the prober is probing. It has
+ * one entry for each of the TRINARKULAR_SLASH24_CNT /24s in IPv4 (indexed by
+ * network IP >> 8), so a reader can look up a /24 without any searching.
+ *
+ * The prober writes the entry of a /24 as soon as the /24 settles, so the
+ * table holds the current state rather than that of the last completed round.
+ * Each /24 has a single writer (the worker that owns it), and entries are
+ * written and read atomically, so a single entry is always consistent.
+ *
+ * Changes that span many entries (rebuilding or patching the table when the
+ * probelist is reloaded, and recording the last completed round) are
+ * protected by a sequence lock: the sequence number is odd while such an
+ * update is in progress, and readers retry if the sequence number changed
+ * while they were reading. A range of entries that is read consistently with
+ * the sequence lock reflects a single probelist, but /24s may settle (one
+ * entry at a time) while it is read. Readers never block (or even communicate
+ * with) the writers.
+ *
+ */
+
+/** The /24 is in the probelist (entries without this flag are unused) */
+#define TRINARKULAR_STATE_TABLE_PRESENT 0x01
+
+/** A /24 in the state table (4 bytes)
+ *
+ * States are encoded as 0 (uncertain), 1 (down) and 2 (up).
+ */
+typedef struct trinarkular_state_table_entry {
+
+  /** Belief that the /24 last settled on */
+  trinarkular_belief_t belief;
+
+  /** Last stable state */
+  uint8_t state;
+
+  /** TRINARKULAR_STATE_TABLE_* flags */
+  uint8_t flags;
+
+} trinarkular_state_table_entry_t;
+
+/** Opaque state table writer */
+typedef struct trinarkular_state_table trinarkular_state_table_t;
+
+/** Opaque state table reader */
+typedef struct trinarkular_state_table_reader
+  trinarkular_state_table_reader_t;
+
+/** Create a state table (replacing any existing table)
+ *
+ * @param path          path of the table file
+ * @return pointer to a state table writer if successful, NULL otherwise
+ *
+ * The table starts empty. The file is left in place when the writer is
+ * destroyed, so readers can still see the last state.
+ */
+trinarkular_state_table_t *trinarkular_state_table_create(const char *path);
+
+/** Destroy a state table writer
+ *
+ * @param table         state table writer to destroy
+ */
+void trinarkular_state_table_destroy(trinarkular_state_table_t *table);
+
+/** Begin an update of the whole state table
+ *
+ * @param table         state table writer to update
+ *
+ * Readers retry until trinarkular_state_table_end_update is called, so
+ * updates should be brief. Nothing may call trinarkular_state_table_set
+ * outside the update while it is in progress.
+ */
+void trinarkular_state_table_begin_update(trinarkular_state_table_t *table);
+
+/** End an update of the state table
+ *
+ * @param table         state table writer that is being updated
+ */
+void trinarkular_state_table_end_update(trinarkular_state_table_t *table);
+
+/** Set the last round that has completed (only during an update)
+ *
+ * @param table         state table writer that is being updated
+ * @param round_id      ID of the round that just completed
+ * @param time          time that the round completed (ms since the epoch)
+ *
+ * Entries are updated as /24s settle, so they may be newer than this round.
+ */
+void trinarkular_state_table_set_round(trinarkular_state_table_t *table,
+                                       uint64_t round_id, uint64_t time);
+
+/** Set the state of a /24
+ *
+ * @param table         state table writer
+ * @param network_ip    network IP of the /24 (host byte order)
+ * @param belief        belief that the /24 settled on
+ * @param state         state of the /24
+ *
+ * The entry is written atomically, so this may be called outside an update
+ * (e.g., by the worker thread that owns the /24), as long as each entry only
+ * has one writer at a time.
+ */
+void trinarkular_state_table_set(trinarkular_state_table_t *table,
+                                 uint32_t network_ip,
+                                 trinarkular_belief_t belief, uint8_t state);
+
+/** Remove a /24 from the state table
+ *
+ * @param table         state table writer
+ * @param network_ip    network IP of the /24 (host byte order)
+ *
+ * As for trinarkular_state_table_set, the entry is written atomically.
+ */
+void trinarkular_state_table_unset(trinarkular_state_table_t *table,
+                                   uint32_t network_ip);
+
+/** Remove all /24s from the state table (only during an update)
+ *
+ * @param table         state table writer that is being updated
+ */
+void trinarkular_state_table_clear(trinarkular_state_table_t *table);
+
+/** Open a state table for reading
+ *
+ * @param path          path of the table file
+ * @return pointer to a state table reader if successful, NULL otherwise
+ */
+trinarkular_state_table_reader_t *
+trinarkular_state_table_open(const char *path);
+
+/** Close a state table reader
+ *
+ * @param reader        state table reader to close
+ */
+void trinarkular_state_table_close(trinarkular_state_table_reader_t *reader);
+
+/** Begin a consistent read of the state table
+ *
+ * @param reader        state table reader to read with
+ * @return the sequence number to pass to trinarkular_state_table_read_retry
+ *
+ * Waits for any update that is in progress to end.
+ */
+uint64_t
+trinarkular_state_table_read_begin(trinarkular_state_table_reader_t *reader);
+
+/** Check whether a read of the state table must be retried
+ *
+ * @param reader        state table reader that was read with
+ * @param seq           sequence number returned by
+ *                      trinarkular_state_table_read_begin
+ * @return 1 if the table was updated during the read (and so anything read
+ * since trinarkular_state_table_read_begin must be discarded), 0 otherwise
+ */
+int trinarkular_state_table_read_retry(trinarkular_state_table_reader_t *reader,
+                                       uint64_t seq);
+
+/** Get the entries of the state table (for zero-copy reads)
+ *
+ * @param reader        state table reader
+ * @return pointer to the TRINARKULAR_SLASH24_CNT entries (indexed by network
+ * IP >> 8)
+ *
+ * Entries must be read between trinarkular_state_table_read_begin and
+ * trinarkular_state_table_read_retry.
+ */
+const trinarkular_state_table_entry_t *
+trinarkular_state_table_get_entries(trinarkular_state_table_reader_t *reader);
+
+/** Look up a /24 in the state table
+ *
+ * @param reader        state table reader to read with
+ * @param network_ip    network IP of the /24 (host byte order)
+ * @param entry[out]    filled with the entry of the /24
+ * @param round_id[out] if not NULL, filled with the last round that had
+ *                      completed
+ * @return 1 if the /24 is in the table, 0 otherwise
+ */
+int trinarkular_state_table_lookup(trinarkular_state_table_reader_t *reader,
+                                   uint32_t network_ip,
+                                   trinarkular_state_table_entry_t *entry,
+                                   uint64_t *round_id);
+
+/** Copy a consistent range of the state table
+ *
+ * @param reader        state table reader to read with
+ * @param first_ip      network IP of the first /24 to copy
+ * @param last_ip       network IP of the last /24 to copy
+ * @param entries[out]  array to fill with one entry per /24 in the range
+ * @param round_id[out] if not NULL, filled with the last round that had
+ *                      completed
+ * @param time[out]     if not NULL, filled with the time that the round
+ *                      completed
+ */
+void trinarkular_state_table_copy(trinarkular_state_table_reader_t *reader,
+                                  uint32_t first_ip, uint32_t last_ip,
+                                  trinarkular_state_table_entry_t *entries,
+                                  uint64_t *round_id, uint64_t *time);
+
+#endif /* __TRINARKULAR_STATE_TABLE_H */
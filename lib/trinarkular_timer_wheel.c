@@ -0,0 +1,342 @@
+/*
+ * This file is part of trinarkular
+ *
+ * Copyright (C) 2015 The Regents of the University of California.
+ * Authors: Alistair King
+ *
+ * This software is Copyright (c) 2015 The Regents of the University of
+ * California. All Rights Reserved. Permission to copy, modify, and distribute this
+ * software and its documentation for academic research and education purposes,
+ * without fee, and without a written agreement is hereby granted, provided that
+ * the above copyright notice, this paragraph and the following three paragraphs
+ * appear in all copies. Permission to make use of this software for other than
+ * academic research and education purposes may be obtained by contacting:
+ *
+ * Office of Innovation and Commercialization
+ * 9500 Gilman Drive, Mail Code 0910
+ * University of California
+ * La Jolla, CA 92093-0910
+ * (858) 534-5815
+ * invent@ucsd.edu
+ *
+ * This software program and documentation are copyrighted by The Regents of the
+ * University of California. The software program and documentation are supplied
+ * "as is", without any accompanying services from The Regents. The Regents does
+ * not warrant that the operation of the program will be uninterrupted or
+ * error-free. The end-user understands that the program was developed for research
+ * purposes and is advised not to rely exclusively on the program for any reason.
+ *
+ * IN NO EVENT SHALL THE UNIVERSITY OF CALIFORNIA BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+ * PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF
+ * THE UNIVERSITY OF CALIFORNIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE. THE UNIVERSITY OF CALIFORNIA SPECIFICALLY DISCLAIMS ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS
+ * IS" BASIS, AND THE UNIVERSITY OF CALIFORNIA HAS NO OBLIGATIONS TO PROVIDE
+ * MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ * Report any bugs, questions or comments to alistair@caida.org
+ *
+ */
+
+#include "trinarkular_timer_wheel.h"
+#include "config.h"
+#include "utils.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Number of bits of the expiry tick used to index a level */
+#define LEVEL_BITS 8
+
+/** Number of slots in each level */
+#define LEVEL_SLOTS (1 << LEVEL_BITS)
+
+#define LEVEL_MASK (LEVEL_SLOTS - 1)
+
+/** Number of levels in the wheel */
+#define LEVEL_CNT 2
+
+/** Initial number of timers allocated for a slot */
+#define SLOT_ALLOC_MIN 64
+
+typedef struct wheel_timer {
+
+  /** Tick that the timer expires at */
+  uint64_t expiry;
+
+  /** Key to pass to the callback */
+  uint32_t key;
+
+  /** Cookie to pass to the callback */
+  uint32_t cookie;
+
+} wheel_timer_t;
+
+typedef struct wheel_slot {
+
+  /** Timers in this slot (unordered) */
+  wheel_timer_t *timers;
+
+  /** Number of timers in this slot */
+  uint32_t timers_cnt;
+
+  /** Number of timers allocated */
+  uint32_t timers_alloc;
+
+} wheel_slot_t;
+
+struct trinarkular_timer_wheel {
+
+  /** Length of a tick (in msec) */
+  uint64_t tick_len;
+
+  /** Next tick to process (all earlier timers have fired) */
+  uint64_t tick;
+
+  /** Level 0 has a slot per tick, level 1 has a slot per LEVEL_SLOTS ticks */
+  wheel_slot_t slots[LEVEL_CNT][LEVEL_SLOTS];
+
+  /** Number of pending timers */
+  uint64_t timers_cnt;
+};
+
+/* ---------- PRIVATE FUNCTIONS ---------- */
+
+static int slot_append(wheel_slot_t *slot, wheel_timer_t *timer)
+{
+  wheel_timer_t *timers;
+  uint32_t alloc;
+
+  if (slot->timers_cnt == slot->timers_alloc) {
+    alloc = (slot->timers_alloc == 0) ? SLOT_ALLOC_MIN : slot->timers_alloc * 2;
+    if ((timers = realloc(slot->timers, sizeof(wheel_timer_t) * alloc)) ==
+        NULL) {
+      return -1;
+    }
+    slot->timers = timers;
+    slot->timers_alloc = alloc;
+  }
+
+  slot->timers[slot->timers_cnt++] = *timer;
+  return 0;
+}
+
+/** Take the timers out of the given slot so that they can be processed while
+    new timers are added to the (now empty) slot */
+static wheel_timer_t *slot_detach(wheel_slot_t *slot, uint32_t *cnt,
+                                  uint32_t *alloc)
+{
+  wheel_timer_t *timers = slot->timers;
+
+  *cnt = slot->timers_cnt;
+  *alloc = slot->timers_alloc;
+  slot->timers = NULL;
+  slot->timers_cnt = 0;
+  slot->timers_alloc = 0;
+
+  return timers;
+}
+
+/** Give a detached array back to its slot (so that it can be reused), unless
+    the slot has since allocated a new one */
+static void slot_restore(wheel_slot_t *slot, wheel_timer_t *timers,
+                         uint32_t alloc)
+{
+  if (slot->timers != NULL) {
+    free(timers);
+    return;
+  }
+  slot->timers = timers;
+  slot->timers_alloc = alloc;
+}
+
+static wheel_slot_t *find_slot(trinarkular_timer_wheel_t *wheel,
+                               uint64_t expiry)
+{
+  uint64_t delta;
+
+  assert(expiry >= wheel->tick);
+  delta = expiry - wheel->tick;
+
+  if (delta < LEVEL_SLOTS) {
+    return &wheel->slots[0][expiry & LEVEL_MASK];
+  }
+  if (delta < (uint64_t)LEVEL_SLOTS * LEVEL_SLOTS) {
+    return &wheel->slots[1][(expiry >> LEVEL_BITS) & LEVEL_MASK];
+  }
+
+  // beyond the span of the wheel. park the timer in the level 1 slot that
+  // will be cascaded last, and it will be re-added from there
+  return &wheel->slots[1][((wheel->tick >> LEVEL_BITS) - 1) & LEVEL_MASK];
+}
+
+static int add_timer(trinarkular_timer_wheel_t *wheel, wheel_timer_t *timer)
+{
+  // a timer that has already expired fires with the next tick
+  if (timer->expiry < wheel->tick) {
+    timer->expiry = wheel->tick;
+  }
+  return slot_append(find_slot(wheel, timer->expiry), timer);
+}
+
+/** Move the timers in the level 1 slot for the current tick down to level 0 */
+static int cascade(trinarkular_timer_wheel_t *wheel)
+{
+  wheel_slot_t *slot =
+    &wheel->slots[1][(wheel->tick >> LEVEL_BITS) & LEVEL_MASK];
+  wheel_timer_t *timers;
+  uint32_t cnt, alloc, i;
+  int ret = 0;
+
+  if (slot->timers_cnt == 0) {
+    return 0;
+  }
+
+  timers = slot_detach(slot, &cnt, &alloc);
+  for (i = 0; i < cnt; i++) {
+    if (add_timer(wheel, &timers[i]) != 0) {
+      wheel->timers_cnt -= cnt - i;
+      ret = -1;
+      break;
+    }
+  }
+  slot_restore(slot, timers, alloc);
+
+  return ret;
+}
+
+/** Fire the timers that expire in the current tick, and move on to the next
+    tick */
+static int process_tick(trinarkular_timer_wheel_t *wheel,
+                        trinarkular_timer_wheel_cb_t *cb, void *user)
+{
+  wheel_slot_t *slot;
+  wheel_timer_t *timers;
+  uint64_t tick = wheel->tick;
+  uint32_t cnt, alloc, i;
+  int fired = 0;
+
+  if ((tick & LEVEL_MASK) == 0 && cascade(wheel) != 0) {
+    return -1;
+  }
+
+  slot = &wheel->slots[0][tick & LEVEL_MASK];
+  // timers added by the callbacks go to later ticks
+  wheel->tick++;
+  if (slot->timers_cnt == 0) {
+    return 0;
+  }
+
+  timers = slot_detach(slot, &cnt, &alloc);
+  for (i = 0; i < cnt; i++) {
+    assert(timers[i].expiry == tick);
+    wheel->timers_cnt--;
+    fired++;
+    if (cb(timers[i].key, timers[i].cookie, user) != 0) {
+      wheel->timers_cnt -= cnt - i - 1;
+      fired = -1;
+      break;
+    }
+  }
+  slot_restore(slot, timers, alloc);
+
+  return fired;
+}
+
+/* ---------- PUBLIC FUNCTIONS ---------- */
+
+trinarkular_timer_wheel_t *trinarkular_timer_wheel_create(uint64_t tick_len,
+                                                          uint64_t now)
+{
+  trinarkular_timer_wheel_t *wheel;
+
+  assert(tick_len > 0);
+
+  if ((wheel = malloc_zero(sizeof(trinarkular_timer_wheel_t))) == NULL) {
+    return NULL;
+  }
+
+  wheel->tick_len = tick_len;
+  wheel->tick = now / tick_len;
+
+  return wheel;
+}
+
+void trinarkular_timer_wheel_destroy(trinarkular_timer_wheel_t *wheel)
+{
+  int l, s;
+
+  if (wheel == NULL) {
+    return;
+  }
+
+  for (l = 0; l < LEVEL_CNT; l++) {
+    for (s = 0; s < LEVEL_SLOTS; s++) {
+      free(wheel->slots[l][s].timers);
+    }
+  }
+
+  free(wheel);
+}
+
+int trinarkular_timer_wheel_add(trinarkular_timer_wheel_t *wheel,
+                                uint64_t expiry, uint32_t key, uint32_t cookie)
+{
+  wheel_timer_t timer;
+
+  timer.expiry = expiry / wheel->tick_len;
+  timer.key = key;
+  timer.cookie = cookie;
+
+  if (add_timer(wheel, &timer) != 0) {
+    return -1;
+  }
+  wheel->timers_cnt++;
+
+  return 0;
+}
+
+int trinarkular_timer_wheel_expire(trinarkular_timer_wheel_t *wheel,
+                                   uint64_t now,
+                                   trinarkular_timer_wheel_cb_t *cb,
+                                   void *user)
+{
+  uint64_t now_tick = now / wheel->tick_len;
+  int fired = 0;
+  int ret;
+
+  // the current tick has not finished yet
+  while (wheel->tick < now_tick) {
+    // skip straight to the current tick if there is nothing to fire
+    if (wheel->timers_cnt == 0) {
+      wheel->tick = now_tick;
+      break;
+    }
+    if ((ret = process_tick(wheel, cb, user)) < 0) {
+      return -1;
+    }
+    fired += ret;
+  }
+
+  return fired;
+}
+
+void trinarkular_timer_wheel_clear(trinarkular_timer_wheel_t *wheel)
+{
+  int l, s;
+
+  for (l = 0; l < LEVEL_CNT; l++) {
+    for (s = 0; s < LEVEL_SLOTS; s++) {
+      wheel->slots[l][s].timers_cnt = 0;
+    }
+  }
+  wheel->timers_cnt = 0;
+}
+
+uint64_t trinarkular_timer_wheel_get_cnt(trinarkular_timer_wheel_t *wheel)
+{
+  return wheel->timers_cnt;
+}
@@ -0,0 +1,136 @@
+/*
+ * This file is part of trinarkular
+ *
+ * Copyright (C) 2015 The Regents of the University of California.
+ * Authors: Alistair King
+ *
+ * This software is Copyright (c) 2015 The Regents of the University of
+ * California. All Rights Reserved. Permission to copy, modify, and distribute this
+ * software and its documentation for academic research and education purposes,
+ * without fee, and without a written agreement is hereby granted, provided that
+ * the above copyright notice, this paragraph and the following three paragraphs
+ * appear in all copies. Permission to make use of this software for other than
+ * academic research and education purposes may be obtained by contacting:
+ *
+ * Office of Innovation and Commercialization
+ * 9500 Gilman Drive, Mail Code 0910
+ * University of California
+ * La Jolla, CA 92093-0910
+ * (858) 534-5815
+ * invent@ucsd.edu
+ *
+ * This software program and documentation are copyrighted by The Regents of the
+ * University of California. The software program and documentation are supplied
+ * "as is", without any accompanying services from The Regents. The Regents does
+ * not warrant that the operation of the program will be uninterrupted or
+ * error-free. The end-user understands that the program was developed for research
+ * purposes and is advised not to rely exclusively on the program for any reason.
+ *
+ * IN NO EVENT SHALL THE UNIVERSITY OF CALIFORNIA BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+ * PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF
+ * THE UNIVERSITY OF CALIFORNIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE. THE UNIVERSITY OF CALIFORNIA SPECIFICALLY DISCLAIMS ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS
+ * IS" BASIS, AND THE UNIVERSITY OF CALIFORNIA HAS NO OBLIGATIONS TO PROVIDE
+ * MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ * Report any bugs, questions or comments to alistair@caida.org
+ *
+ */
+
+#ifndef __TRINARKULAR_TIMER_WHEEL_H
+#define __TRINARKULAR_TIMER_WHEEL_H
+
+#include <stdint.h>
+
+/** @file
+ *
+ * @brief Header file that exposes a hierarchical timer wheel
+ *
+ * @author Alistair King
+ *
+ * Timers are hashed into slots by their expiry tick. The first level has one
+ * slot per tick, and the second level has one slot per full rotation of the
+ * first level. Second level slots are cascaded into the first level as it
+ * wraps, so both adding and expiring a timer are (amortized) O(1).
+ *
+ * Timers cannot be cancelled. Instead the caller should attach enough
+ * information (the key and cookie) to recognize a timer that is no longer
+ * wanted when it expires.
+ *
+ */
+
+/** Opaque struct holding timer wheel state */
+typedef struct trinarkular_timer_wheel trinarkular_timer_wheel_t;
+
+/** Callback invoked for each expired timer
+ *
+ * @param key           key the timer was added with
+ * @param cookie        cookie the timer was added with
+ * @param user          user pointer passed to trinarkular_timer_wheel_expire
+ * @return 0 if the timer was handled successfully, -1 otherwise
+ */
+typedef int(trinarkular_timer_wheel_cb_t)(uint32_t key, uint32_t cookie,
+                                          void *user);
+
+/** Create a new timer wheel
+ *
+ * @param tick_len      length of a tick (in msec)
+ * @param now           current time (in msec)
+ * @return pointer to the timer wheel if successful, NULL otherwise
+ */
+trinarkular_timer_wheel_t *trinarkular_timer_wheel_create(uint64_t tick_len,
+                                                          uint64_t now);
+
+/** Destroy the given timer wheel (pending timers are discarded)
+ *
+ * @param wheel         pointer to the timer wheel to destroy
+ */
+void trinarkular_timer_wheel_destroy(trinarkular_timer_wheel_t *wheel);
+
+/** Add a timer to the given wheel
+ *
+ * @param wheel         pointer to the timer wheel
+ * @param expiry        time at which the timer expires (in msec)
+ * @param key           key to pass to the expiry callback
+ * @param cookie        cookie to pass to the expiry callback
+ * @return 0 if the timer was added successfully, -1 otherwise
+ *
+ * The timer expires at the end of the tick that contains expiry. A timer that
+ * has already expired fires on the next call to trinarkular_timer_wheel_expire.
+ */
+int trinarkular_timer_wheel_add(trinarkular_timer_wheel_t *wheel,
+                                uint64_t expiry, uint32_t key, uint32_t cookie);
+
+/** Fire all timers that have expired
+ *
+ * @param wheel         pointer to the timer wheel
+ * @param now           current time (in msec)
+ * @param cb            callback to invoke for each expired timer
+ * @param user          user pointer to pass to the callback
+ * @return the number of timers that expired if successful, -1 otherwise
+ *
+ * The callback may add new timers to the wheel. If the callback fails, the
+ * remaining timers in the same slot are discarded.
+ */
+int trinarkular_timer_wheel_expire(trinarkular_timer_wheel_t *wheel,
+                                   uint64_t now,
+                                   trinarkular_timer_wheel_cb_t *cb,
+                                   void *user);
+
+/** Discard all pending timers
+ *
+ * @param wheel         pointer to the timer wheel
+ */
+void trinarkular_timer_wheel_clear(trinarkular_timer_wheel_t *wheel);
+
+/** Get the number of pending timers
+ *
+ * @param wheel         pointer to the timer wheel
+ * @return number of timers that have not yet expired
+ */
+uint64_t trinarkular_timer_wheel_get_cnt(trinarkular_timer_wheel_t *wheel);
+
+#endif /* __TRINARKULAR_TIMER_WHEEL_H */
@@ -0,0 +1,281 @@
+/*
+ * This file is part of trinarkular
+ *
+ * Copyright (C) 2015 The Regents of the University of California.
+ * Authors: Alistair King
+ *
+ * This software is Copyright (c) 2015 The Regents of the University of
+ * California. All Rights Reserved. Permission to copy, modify, and distribute this
+ * software and its documentation for academic research and education purposes,
+ * without fee, and without a written agreement is hereby granted, provided that
+ * the above copyright notice, this paragraph and the following three paragraphs
+ * appear in all copies. Permission to make use of this software for other than
+ * academic research and education purposes may be obtained by contacting:
+ *
+ * Office of Innovation and Commercialization
+ * 9500 Gilman Drive, Mail Code 0910
+ * University of California
+ * La Jolla, CA 92093-0910
+ * (858) 534-5815
+ * invent@ucsd.edu
+ *
+ * This software program and documentation are copyrighted by The Regents of the
+ * University of California. The software program and documentation are supplied
+ * "as is", without any accompanying services from The Regents. The Regents does
+ * not warrant that the operation of the program will be uninterrupted or
+ * error-free. The end-user understands that the program was developed for research
+ * purposes and is advised not to rely exclusively on the program for any reason.
+ *
+ * IN NO EVENT SHALL THE UNIVERSITY OF CALIFORNIA BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+ * PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF
+ * THE UNIVERSITY OF CALIFORNIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE. THE UNIVERSITY OF CALIFORNIA SPECIFICALLY DISCLAIMS ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS
+ * IS" BASIS, AND THE UNIVERSITY OF CALIFORNIA HAS NO OBLIGATIONS TO PROVIDE
+ * MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ * Report any bugs, questions or comments to alistair@caida.org
+ *
+ */
+
+#include "trinarkular.h"
+#include "trinarkular_log.h"
+#include "config.h"
+#include <assert.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+/** Number of times each scan is repeated (by default) */
+#define REPEAT_DEFAULT 10
+
+static void usage(char *name)
+{
+  fprintf(stderr,
+          "Usage: %s [options] probelist\n"
+          "       -j <threads>     threads to parse the probelist with "
+          "(default: 1)\n"
+          "       -r <repeat>      number of times to repeat each scan "
+          "(default: %d)\n"
+          "\n"
+          "Loads a probelist, creates prober state for every /24, and reports\n"
+          "memory used per /24 and the speed of full-probelist scans.\n"
+          "Only the first state count scan uses the state array; the other\n"
+          "scans use the iterator and lookup functions that the hash-based\n"
+          "probelist layout also had.\n",
+          name, REPEAT_DEFAULT);
+}
+
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static long maxrss_kb(void)
+{
+  struct rusage ru;
+
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_maxrss;
+}
+
+static void report(const char *name, double secs, uint64_t cnt,
+                   uint64_t check)
+{
+  fprintf(stdout, "%-24s %8.2f ns/24 %10.1f M/24s/sec (check: %" PRIu64
+                  ")\n",
+          name, secs * 1e9 / cnt, cnt / secs / 1e6, check);
+}
+
+int main(int argc, char **argv)
+{
+  int opt, prevoptind;
+  char *probelist_file = NULL;
+  int threads = 1;
+  int repeat = REPEAT_DEFAULT;
+  trinarkular_probelist_t *pl = NULL;
+  trinarkular_slash24_t *s24;
+  trinarkular_slash24_state_t *state;
+  trinarkular_slash24_state_t *states;
+  uint32_t *ips = NULL;
+  int cnt, i, r;
+  uint64_t hosts_bytes = 0;
+  uint64_t md_bytes = 0;
+  uint64_t metrics_bytes = 0;
+  uint64_t state_cnts[3];
+  uint64_t check;
+  long rss_before, rss_after;
+  double start;
+
+  while (prevoptind = optind, (opt = getopt(argc, argv, ":j:r:v?")) >= 0) {
+    if (optind == prevoptind + 2 && optarg && *optarg == '-' &&
+        *(optarg + 1) != '\0') {
+      opt = ':';
+      --optind;
+    }
+    switch (opt) {
+    case 'j':
+      threads = strtol(optarg, NULL, 10);
+      break;
+
+    case 'r':
+      repeat = strtol(optarg, NULL, 10);
+      break;
+
+    case ':':
+      fprintf(stderr, "ERROR: Missing option argument for -%c\n", optopt);
+      usage(argv[0]);
+      goto err;
+      break;
+
+    case '?':
+    case 'v':
+      fprintf(stderr, "trinarkular version %d.%d.%d\n",
+              TRINARKULAR_MAJOR_VERSION, TRINARKULAR_MID_VERSION,
+              TRINARKULAR_MINOR_VERSION);
+      usage(argv[0]);
+      goto err;
+      break;
+
+    default:
+      usage(argv[0]);
+      goto err;
+    }
+  }
+
+  if (optind >= argc) {
+    fprintf(stderr, "ERROR: Probelist file must be specifed\n");
+    usage(argv[0]);
+    goto err;
+  }
+  probelist_file = argv[optind];
+
+  if (repeat < 1) {
+    fprintf(stderr, "ERROR: Repeat count must be at least 1\n");
+    usage(argv[0]);
+    goto err;
+  }
+
+  // load the probelist and create state as the prober would
+  rss_before = maxrss_kb();
+  start = now();
+  if ((pl = trinarkular_probelist_create_threaded(probelist_file,
+                                                  threads)) == NULL) {
+    goto err;
+  }
+  // parsing is what the probelist threads speed up, so it is timed on its own
+  // (e.g., run with -j 1, 2, 4 and 8 to check scaling)
+  fprintf(stdout, "Parsed probelist in %.3fs (%d threads)\n", now() - start,
+          threads);
+  cnt = trinarkular_probelist_get_slash24_cnt(pl);
+  if (cnt == 0) {
+    fprintf(stderr, "ERROR: Probelist is empty\n");
+    goto err;
+  }
+  if ((ips = malloc(sizeof(uint32_t) * cnt)) == NULL) {
+    goto err;
+  }
+  i = 0;
+  trinarkular_probelist_reset_slash24_iter(pl);
+  while ((s24 = trinarkular_probelist_get_next_slash24(pl)) != NULL) {
+    if ((state = trinarkular_probelist_init_slash24_state(pl, s24,
+                                                          s24->md_cnt)) ==
+        NULL) {
+      fprintf(stderr, "ERROR: Could not create /24 state\n");
+      goto err;
+    }
+    state->current_belief = TRINARKULAR_BELIEF_MAX;
+    state->current_state = 2;
+    ips[i++] = s24->network_ip;
+    hosts_bytes += s24->hosts_cnt;
+    md_bytes += sizeof(uint32_t) * s24->md_cnt;
+    metrics_bytes += sizeof(trinarkular_slash24_metrics_t) * s24->md_cnt;
+  }
+  rss_after = maxrss_kb();
+
+  fprintf(stdout, "Loaded %d /24s in %.3fs\n", cnt, now() - start);
+  fprintf(stdout, "Bytes per /24:\n");
+  fprintf(stdout, "  %-22s %8zu\n", "/24", sizeof(trinarkular_slash24_t));
+  fprintf(stdout, "  %-22s %8zu\n", "state",
+          sizeof(trinarkular_slash24_state_t));
+  fprintf(stdout, "  %-22s %8.1f\n", "hosts", (double)hosts_bytes / cnt);
+  fprintf(stdout, "  %-22s %8.1f\n", "metadata IDs", (double)md_bytes / cnt);
+  fprintf(stdout, "  %-22s %8.1f\n", "metrics",
+          (double)metrics_bytes / cnt);
+  fprintf(stdout, "  %-22s %8.1f\n", "total (max RSS growth)",
+          (rss_after - rss_before) * 1024.0 / cnt);
+
+  // end-of-round style scan: count the /24s in each state
+  start = now();
+  check = 0;
+  for (r = 0; r < repeat; r++) {
+    memset(state_cnts, 0, sizeof(state_cnts));
+    states = trinarkular_probelist_get_slash24_state_array(pl);
+    for (i = 0; i < cnt; i++) {
+      state_cnts[states[i].current_state]++;
+    }
+    check += state_cnts[2];
+  }
+  report("state count scan", now() - start, (uint64_t)cnt * repeat, check);
+
+  // the same scan through the iterator, which is the only way to reach every
+  // state in the hash-based layout (so this can be compared with a baseline
+  // measured before the state array existed)
+  start = now();
+  check = 0;
+  for (r = 0; r < repeat; r++) {
+    memset(state_cnts, 0, sizeof(state_cnts));
+    trinarkular_probelist_reset_slash24_iter(pl);
+    while ((s24 = trinarkular_probelist_get_next_slash24(pl)) != NULL) {
+      state = trinarkular_probelist_get_slash24_state(pl, s24);
+      state_cnts[state->current_state]++;
+    }
+    check += state_cnts[2];
+  }
+  report("state count scan (iter)", now() - start, (uint64_t)cnt * repeat,
+         check);
+
+  // slice iteration: what periodic probing does for each /24
+  start = now();
+  check = 0;
+  for (r = 0; r < repeat; r++) {
+    trinarkular_probelist_reset_slash24_iter(pl);
+    while ((s24 = trinarkular_probelist_get_next_slash24(pl)) != NULL) {
+      state = trinarkular_probelist_get_slash24_state(pl, s24);
+      check += trinarkular_probelist_get_next_host(s24, state) & 0xff;
+    }
+  }
+  report("slice iteration", now() - start, (uint64_t)cnt * repeat, check);
+
+  // response handling: look up a /24 (in probing order) and its state
+  start = now();
+  check = 0;
+  for (r = 0; r < repeat; r++) {
+    for (i = 0; i < cnt; i++) {
+      if ((s24 = trinarkular_probelist_get_slash24(pl, ips[i])) != NULL) {
+        state = trinarkular_probelist_get_slash24_state(pl, s24);
+        check += state->current_state;
+      }
+    }
+  }
+  report("response lookup", now() - start, (uint64_t)cnt * repeat, check);
+
+  free(ips);
+  trinarkular_probelist_destroy(pl);
+  return 0;
+
+err:
+  free(ips);
+  trinarkular_probelist_destroy(pl);
+  return -1;
+}
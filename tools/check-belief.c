@@ -0,0 +1,214 @@
+/*
+ * This file is part of trinarkular
+ *
+ * Copyright (C) 2015 The Regents of the University of California.
+ * Authors: Alistair King
+ *
+ * This software is Copyright (c) 2015 The Regents of the University of
+ * California. All Rights Reserved. Permission to copy, modify, and distribute this
+ * software and its documentation for academic research and education purposes,
+ * without fee, and without a written agreement is hereby granted, provided that
+ * the above copyright notice, this paragraph and the following three paragraphs
+ * appear in all copies. Permission to make use of this software for other than
+ * academic research and education purposes may be obtained by contacting:
+ *
+ * Office of Innovation and Commercialization
+ * 9500 Gilman Drive, Mail Code 0910
+ * University of California
+ * La Jolla, CA 92093-0910
+ * (858) 534-5815
+ * invent@ucsd.edu
+ *
+ * This software program and documentation are copyrighted by The Regents of the
+ * University of California. The software program and documentation are supplied
+ * "as is", without any accompanying services from The Regents. The Regents does
+ * not warrant that the operation of the program will be uninterrupted or
+ * error-free. The end-user understands that the program was developed for research
+ * purposes and is advised not to rely exclusively on the program for any reason.
+ *
+ * IN NO EVENT SHALL THE UNIVERSITY OF CALIFORNIA BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+ * PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF
+ * THE UNIVERSITY OF CALIFORNIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE. THE UNIVERSITY OF CALIFORNIA SPECIFICALLY DISCLAIMS ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS
+ * IS" BASIS, AND THE UNIVERSITY OF CALIFORNIA HAS NO OBLIGATIONS TO PROVIDE
+ * MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ * Report any bugs, questions or comments to alistair@caida.org
+ *
+ */
+
+#include "trinarkular.h"
+#include "config.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* Checks the fixed-point belief engine against the reference float
+ * implementation (trinarkular_belief_update_ref), as documented in
+ * trinarkular_belief.h. Chains of TRINARKULAR_BELIEF_REF_UPDATES random
+ * responses are applied to /24s with random A(E(b)) values, both with
+ * trinarkular_belief_update_batch and TRINARKULAR_BELIEF_UPDATE (which must
+ * agree exactly), and the results are compared with the float belief after
+ * every update. Exits with a non-zero status if any belief differs by more
+ * than TRINARKULAR_BELIEF_REF_TOLERANCE, or any state differs when the float
+ * belief is not within that distance of a threshold. */
+
+/** Number of chains that are checked (by default) */
+#define CHAINS_DEFAULT 1000000
+
+/** Number of chains that are updated by each call to update_batch */
+#define BATCH_LEN 4096
+
+/** States as in the prober (0: uncertain, 1: down, 2: up) */
+#define FIXED_STATE(b)                                                         \
+  (((b) > TRINARKULAR_BELIEF_UP_THRESHOLD)                                     \
+     ? 2                                                                       \
+     : ((b) < TRINARKULAR_BELIEF_DOWN_THRESHOLD) ? 1 : 0)
+#define REF_STATE(p) (((p) > 0.9) ? 2 : ((p) < 0.1) ? 1 : 0)
+
+static void usage(char *name)
+{
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "       -n <chains>      number of chains to check (default: %d)\n"
+          "       -s <seed>        random seed (default: 1)\n",
+          name, CHAINS_DEFAULT);
+}
+
+int main(int argc, char **argv)
+{
+  int opt, prevoptind;
+  uint64_t chains = CHAINS_DEFAULT;
+  long seed = 1;
+  static trinarkular_belief_t beliefs[BATCH_LEN];
+  static trinarkular_belief_t beliefs_macro[BATCH_LEN];
+  static trinarkular_belief_t neg_incrs[BATCH_LEN];
+  static trinarkular_belief_t pos_incrs[BATCH_LEN];
+  static uint8_t responses[BATCH_LEN];
+  static float aebs[BATCH_LEN];
+  static float refs[BATCH_LEN];
+  trinarkular_belief_t incrs[2];
+  uint64_t done = 0;
+  uint64_t update_cnt = 0;
+  uint64_t near_threshold_cnt = 0;
+  uint64_t fail_cnt = 0;
+  double diff, max_diff = 0;
+  uint32_t cnt, i;
+  int u;
+
+  while (prevoptind = optind, (opt = getopt(argc, argv, ":n:s:v?")) >= 0) {
+    if (optind == prevoptind + 2 && optarg && *optarg == '-' &&
+        *(optarg + 1) != '\0') {
+      opt = ':';
+      --optind;
+    }
+    switch (opt) {
+    case 'n':
+      chains = strtoull(optarg, NULL, 10);
+      break;
+
+    case 's':
+      seed = strtol(optarg, NULL, 10);
+      break;
+
+    case ':':
+      fprintf(stderr, "ERROR: Missing option argument for -%c\n", optopt);
+      usage(argv[0]);
+      return -1;
+      break;
+
+    case '?':
+    case 'v':
+      fprintf(stderr, "trinarkular version %d.%d.%d\n",
+              TRINARKULAR_MAJOR_VERSION, TRINARKULAR_MID_VERSION,
+              TRINARKULAR_MINOR_VERSION);
+      usage(argv[0]);
+      return -1;
+      break;
+
+    default:
+      usage(argv[0]);
+      return -1;
+    }
+  }
+
+  srand48(seed);
+
+  for (done = 0; done < chains; done += cnt) {
+    cnt = (chains - done < BATCH_LEN) ? chains - done : BATCH_LEN;
+
+    // each chain starts at the upper bound, as a new /24 does
+    for (i = 0; i < cnt; i++) {
+      aebs[i] = drand48();
+      trinarkular_belief_compute_incrs(aebs[i], incrs);
+      neg_incrs[i] = incrs[0];
+      pos_incrs[i] = incrs[1];
+      beliefs[i] = beliefs_macro[i] = TRINARKULAR_BELIEF_MAX;
+      refs[i] = 0.99;
+    }
+
+    for (u = 0; u < TRINARKULAR_BELIEF_REF_UPDATES; u++) {
+      for (i = 0; i < cnt; i++) {
+        responses[i] = drand48() < 0.5;
+      }
+      trinarkular_belief_update_batch(beliefs, neg_incrs, pos_incrs,
+                                      responses, cnt);
+
+      for (i = 0; i < cnt; i++) {
+        beliefs_macro[i] = TRINARKULAR_BELIEF_UPDATE(
+          beliefs_macro[i], responses[i] ? pos_incrs[i] : neg_incrs[i]);
+        refs[i] = trinarkular_belief_update_ref(refs[i], aebs[i], responses[i]);
+        update_cnt++;
+
+        if (beliefs_macro[i] != beliefs[i]) {
+          fprintf(stderr,
+                  "FAIL: update_batch gave %d, TRINARKULAR_BELIEF_UPDATE gave "
+                  "%d (A(E(b)): %f, update %d)\n",
+                  beliefs[i], beliefs_macro[i], aebs[i], u);
+          fail_cnt++;
+        }
+
+        diff = fabs(trinarkular_belief_to_prob(beliefs[i]) - refs[i]);
+        if (diff > max_diff) {
+          max_diff = diff;
+        }
+        if (diff > TRINARKULAR_BELIEF_REF_TOLERANCE) {
+          fprintf(stderr,
+                  "FAIL: B(U) is %f, reference is %f (A(E(b)): %f, update "
+                  "%d)\n",
+                  trinarkular_belief_to_prob(beliefs[i]), refs[i], aebs[i], u);
+          fail_cnt++;
+        }
+
+        if (FIXED_STATE(beliefs[i]) != REF_STATE(refs[i])) {
+          if (fabs(refs[i] - 0.9) > TRINARKULAR_BELIEF_REF_TOLERANCE &&
+              fabs(refs[i] - 0.1) > TRINARKULAR_BELIEF_REF_TOLERANCE) {
+            fprintf(stderr,
+                    "FAIL: state is %d, reference is %d (B(U): %f, "
+                    "reference: %f)\n",
+                    FIXED_STATE(beliefs[i]), REF_STATE(refs[i]),
+                    trinarkular_belief_to_prob(beliefs[i]), refs[i]);
+            fail_cnt++;
+          } else {
+            near_threshold_cnt++;
+          }
+        }
+      }
+    }
+  }
+
+  fprintf(stdout,
+          "%" PRIu64 " updates, max B(U) difference: %f (tolerance: %f), "
+          "%" PRIu64 " state differences near a threshold, %" PRIu64
+          " failures\n",
+          update_cnt, max_diff, TRINARKULAR_BELIEF_REF_TOLERANCE,
+          near_threshold_cnt, fail_cnt);
+
+  return (fail_cnt == 0) ? 0 : -1;
+}
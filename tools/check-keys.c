@@ -0,0 +1,215 @@
+/*
+ * This file is part of trinarkular
+ *
+ * Copyright (C) 2015 The Regents of the University of California.
+ * Authors: Alistair King
+ *
+ * This software is Copyright (c) 2015 The Regents of the University of
+ * California. All Rights Reserved. Permission to copy, modify, and distribute this
+ * software and its documentation for academic research and education purposes,
+ * without fee, and without a written agreement is hereby granted, provided that
+ * the above copyright notice, this paragraph and the following three paragraphs
+ * appear in all copies. Permission to make use of this software for other than
+ * academic research and education purposes may be obtained by contacting:
+ *
+ * Office of Innovation and Commercialization
+ * 9500 Gilman Drive, Mail Code 0910
+ * University of California
+ * La Jolla, CA 92093-0910
+ * (858) 534-5815
+ * invent@ucsd.edu
+ *
+ * This software program and documentation are copyrighted by The Regents of the
+ * University of California. The software program and documentation are supplied
+ * "as is", without any accompanying services from The Regents. The Regents does
+ * not warrant that the operation of the program will be uninterrupted or
+ * error-free. The end-user understands that the program was developed for research
+ * purposes and is advised not to rely exclusively on the program for any reason.
+ *
+ * IN NO EVENT SHALL THE UNIVERSITY OF CALIFORNIA BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+ * PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF
+ * THE UNIVERSITY OF CALIFORNIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE. THE UNIVERSITY OF CALIFORNIA SPECIFICALLY DISCLAIMS ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS
+ * IS" BASIS, AND THE UNIVERSITY OF CALIFORNIA HAS NO OBLIGATIONS TO PROVIDE
+ * MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ * Report any bugs, questions or comments to alistair@caida.org
+ *
+ */
+
+#include "trinarkular.h"
+#include "config.h"
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Checks that the per-/24 key writer (trinarkular_prober_write_slash24_key)
+ * produces the same keys as the original snprintf/inet_ntop formatting, for
+ * every /24 whose octets have each possible width and for random /24s. Exits
+ * with a non-zero status if any key differs. */
+
+/** Number of random /24s that are checked (by default) */
+#define SLASH24S_DEFAULT 2000000
+
+/** Per-/24 key format used before keys were built from templates */
+#define KEY_FORMAT_REF "%s.%s.probers.%s.blocks.__PFX_%s_24.%s"
+
+/** Metadata, prober name and suffixes that the keys are built with */
+#define KEY_PREFIX "active.ping-slash24"
+#define KEY_MD "asn.12345"
+#define KEY_NAME "prober-1"
+
+static const char *metrics[] = {
+  "belief",
+  "state",
+};
+
+/** Suffixes of the per-/24 keys, as the prober writes them */
+static const char *suffixes[] = {
+  "_24.belief",
+  "_24.state",
+};
+
+#define BUFFER_LEN 1024
+
+static char *graphite_safe(char *p)
+{
+  char *r = p;
+
+  while (*p != '\0') {
+    if (*p == '.' || *p == '*') {
+      *p = '-';
+    }
+    p++;
+  }
+  return r;
+}
+
+static void usage(char *name)
+{
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "       -n <slash24s>    number of random /24s to check (default: "
+          "%d)\n"
+          "       -s <seed>        random seed (default: 1)\n",
+          name, SLASH24S_DEFAULT);
+}
+
+/** Check the keys of one /24, returning the number of keys that differ */
+static int check_slash24(const char *prefix, size_t prefix_len,
+                         uint32_t network_ip)
+{
+  char buf[BUFFER_LEN];
+  char ref[BUFFER_LEN];
+  char ip_str[INET_ADDRSTRLEN];
+  struct in_addr addr;
+  size_t len;
+  int fail_cnt = 0;
+  int i;
+
+  addr.s_addr = htonl(network_ip);
+  inet_ntop(AF_INET, &addr, ip_str, INET_ADDRSTRLEN);
+  graphite_safe(ip_str);
+
+  for (i = 0; i < (int)(sizeof(metrics) / sizeof(metrics[0])); i++) {
+    snprintf(ref, BUFFER_LEN, KEY_FORMAT_REF, KEY_PREFIX, KEY_MD, KEY_NAME,
+             ip_str, metrics[i]);
+    len = trinarkular_prober_write_slash24_key(
+      buf, prefix, prefix_len, network_ip, suffixes[i], strlen(suffixes[i]));
+
+    if (strcmp(buf, ref) != 0 || len != strlen(ref)) {
+      fprintf(stderr, "FAIL: wrote '%s' (length %zu), expecting '%s'\n", buf,
+              len, ref);
+      fail_cnt++;
+    }
+  }
+
+  return fail_cnt;
+}
+
+int main(int argc, char **argv)
+{
+  int opt, prevoptind;
+  uint64_t slash24s = SLASH24S_DEFAULT;
+  long seed = 1;
+  char prefix[BUFFER_LEN];
+  size_t prefix_len;
+  uint64_t check_cnt = 0;
+  uint64_t fail_cnt = 0;
+  uint32_t octets[] = {0, 7, 10, 99, 100, 255};
+  int octets_cnt = sizeof(octets) / sizeof(octets[0]);
+  int a, b, c;
+  uint64_t i;
+
+  while (prevoptind = optind, (opt = getopt(argc, argv, ":n:s:v?")) >= 0) {
+    if (optind == prevoptind + 2 && optarg && *optarg == '-' &&
+        *(optarg + 1) != '\0') {
+      opt = ':';
+      --optind;
+    }
+    switch (opt) {
+    case 'n':
+      slash24s = strtoull(optarg, NULL, 10);
+      break;
+
+    case 's':
+      seed = strtol(optarg, NULL, 10);
+      break;
+
+    case ':':
+      fprintf(stderr, "ERROR: Missing option argument for -%c\n", optopt);
+      usage(argv[0]);
+      return -1;
+      break;
+
+    case '?':
+    case 'v':
+      fprintf(stderr, "trinarkular version %d.%d.%d\n",
+              TRINARKULAR_MAJOR_VERSION, TRINARKULAR_MID_VERSION,
+              TRINARKULAR_MINOR_VERSION);
+      usage(argv[0]);
+      return -1;
+      break;
+
+    default:
+      usage(argv[0]);
+      return -1;
+    }
+  }
+
+  srand48(seed);
+
+  // the constant part of the keys, as the prober formats it
+  prefix_len = snprintf(prefix, BUFFER_LEN, "%s.%s.probers.%s.blocks.__PFX_",
+                        KEY_PREFIX, KEY_MD, KEY_NAME);
+
+  // every combination of octet widths (and the extremes)
+  for (a = 0; a < octets_cnt; a++) {
+    for (b = 0; b < octets_cnt; b++) {
+      for (c = 0; c < octets_cnt; c++) {
+        fail_cnt += check_slash24(
+          prefix, prefix_len, (octets[a] << 24) | (octets[b] << 16) |
+                                (octets[c] << 8));
+        check_cnt++;
+      }
+    }
+  }
+
+  for (i = 0; i < slash24s; i++) {
+    fail_cnt += check_slash24(prefix, prefix_len,
+                              (uint32_t)mrand48() & TRINARKULAR_SLASH24_NETMASK);
+    check_cnt++;
+  }
+
+  fprintf(stdout, "%" PRIu64 " /24s checked, %" PRIu64 " failures\n",
+          check_cnt, fail_cnt);
+
+  return (fail_cnt == 0) ? 0 : -1;
+}
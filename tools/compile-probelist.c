@@ -0,0 +1,138 @@
+/*
+ * This file is part of trinarkular
+ *
+ * Copyright (C) 2015 The Regents of the University of California.
+ * Authors: Alistair King
+ *
+ * This software is Copyright (c) 2015 The Regents of the University of
+ * California. All Rights Reserved. Permission to copy, modify, and distribute this
+ * software and its documentation for academic research and education purposes,
+ * without fee, and without a written agreement is hereby granted, provided that
+ * the above copyright notice, this paragraph and the following three paragraphs
+ * appear in all copies. Permission to make use of this software for other than
+ * academic research and education purposes may be obtained by contacting:
+ *
+ * Office of Innovation and Commercialization
+ * 9500 Gilman Drive, Mail Code 0910
+ * University of California
+ * La Jolla, CA 92093-0910
+ * (858) 534-5815
+ * invent@ucsd.edu
+ *
+ * This software program and documentation are copyrighted by The Regents of the
+ * University of California. The software program and documentation are supplied
+ * "as is", without any accompanying services from The Regents. The Regents does
+ * not warrant that the operation of the program will be uninterrupted or
+ * error-free. The end-user understands that the program was developed for research
+ * purposes and is advised not to rely exclusively on the program for any reason.
+ *
+ * IN NO EVENT SHALL THE UNIVERSITY OF CALIFORNIA BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+ * PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF
+ * THE UNIVERSITY OF CALIFORNIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE. THE UNIVERSITY OF CALIFORNIA SPECIFICALLY DISCLAIMS ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS
+ * IS" BASIS, AND THE UNIVERSITY OF CALIFORNIA HAS NO OBLIGATIONS TO PROVIDE
+ * MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ * Report any bugs, questions or comments to alistair@caida.org
+ *
+ */
+
+#include "trinarkular.h"
+#include "trinarkular_log.h"
+#include "config.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void usage(char *name)
+{
+  fprintf(stderr,
+          "Usage: %s [options] -o outfile probelist\n"
+          "       -j <threads>     threads to parse the probelist with "
+          "(default: 1)\n"
+          "       -o <outfile>     file to write the compiled probelist to\n"
+          "\n"
+          "Converts a JSON probelist (optionally compressed) into the binary\n"
+          "format that can be memory-mapped by the prober at startup.\n",
+          name);
+}
+
+int main(int argc, char **argv)
+{
+  int opt, prevoptind;
+  char *probelist_file = NULL;
+  char *outfile = NULL;
+  int threads = 1;
+  trinarkular_probelist_t *pl = NULL;
+
+  while (prevoptind = optind, (opt = getopt(argc, argv, ":j:o:v?")) >= 0) {
+    if (optind == prevoptind + 2 && optarg && *optarg == '-' &&
+        *(optarg + 1) != '\0') {
+      opt = ':';
+      --optind;
+    }
+    switch (opt) {
+    case 'j':
+      threads = strtol(optarg, NULL, 10);
+      break;
+
+    case 'o':
+      outfile = optarg;
+      break;
+
+    case ':':
+      fprintf(stderr, "ERROR: Missing option argument for -%c\n", optopt);
+      usage(argv[0]);
+      goto err;
+      break;
+
+    case '?':
+    case 'v':
+      fprintf(stderr, "trinarkular version %d.%d.%d\n",
+              TRINARKULAR_MAJOR_VERSION, TRINARKULAR_MID_VERSION,
+              TRINARKULAR_MINOR_VERSION);
+      usage(argv[0]);
+      goto err;
+      break;
+
+    default:
+      usage(argv[0]);
+      goto err;
+    }
+  }
+
+  if (optind >= argc) {
+    fprintf(stderr, "ERROR: Probelist file must be specifed\n");
+    usage(argv[0]);
+    goto err;
+  }
+  probelist_file = argv[optind];
+
+  if (outfile == NULL) {
+    fprintf(stderr, "ERROR: Output file must be specified using -o\n");
+    usage(argv[0]);
+    goto err;
+  }
+
+  if ((pl = trinarkular_probelist_create_threaded(probelist_file,
+                                                  threads)) == NULL) {
+    goto err;
+  }
+
+  if (trinarkular_probelist_save_binary(pl, outfile) != 0) {
+    goto err;
+  }
+
+  trinarkular_probelist_destroy(pl);
+  return 0;
+
+err:
+  trinarkular_probelist_destroy(pl);
+  return -1;
+}
@@ -53,6 +53,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <timeseries.h>
 #include <unistd.h>
 
@@ -130,16 +131,38 @@ static void usage(char *name)
 
   fprintf(
     stderr, "Usage: %s [options] -n prober-name probelist\n"
+            "       -b <batch>       max responses handled per wakeup "
+            "(default: %d)\n"
+            "       -C <path>        checkpoint /24 state to <path>, and warm "
+            "start from it\n"
             "       -d <duration>    periodic probing round duration in msec "
             "(default: %d)\n"
+            "       -D <rounds>      only write changed per-/24 values, with "
+            "all values every <rounds> rounds\n"
+            "       -e <grace>       msec to wait past the probe timeout before "
+            "a probe expires (default: %d)\n"
+            "       -E <endpoint>    publish /24 state transition events on "
+            "<endpoint>\n"
             "       -i <timeout>     periodic probing probe timeout in msec "
             "(default: %d)\n"
+            "       -j <threads>     threads to parse a JSON probelist, and "
+            "generate its keys, with (default: 1)\n"
+            "       -J <prefix>      journal /24 state transitions to files "
+            "starting with <prefix>\n"
+            "       -K               only create per-/24 keys once a /24 "
+            "leaves the UP state\n"
             "       -l <rounds>      periodic probing round limit (default: "
             "unlimited)\n"
+            "       -L <latency>     driver latency in msec that triggers "
+            "backpressure (default: probe timeout)\n"
+            "       -m <prefix>      publish events under metadata starting "
+            "with <prefix> (e.g. asn.)\n"
             "       -n <prober-name> prober name (used in timeseries paths)\n"
             "       -p <driver>      probe driver to use (default: %s %s)\n"
             "                        options are:\n",
-    name, TRINARKULAR_PROBER_PERIODIC_ROUND_DURATION_DEFAULT,
+    name, TRINARKULAR_PROBER_RESP_BATCH_SIZE_DEFAULT,
+    TRINARKULAR_PROBER_PERIODIC_ROUND_DURATION_DEFAULT,
+    TRINARKULAR_PROBER_PROBE_EXPIRY_GRACE_DEFAULT,
     TRINARKULAR_PROBER_PERIODIC_PROBE_TIMEOUT_DEFAULT,
     TRINARKULAR_PROBER_DRIVER_DEFAULT, TRINARKULAR_PROBER_DRIVER_ARGS_DEFAULT);
 
@@ -151,12 +174,24 @@ static void usage(char *name)
 
   fprintf(
     stderr,
+    "       -P <batch>       pace periodic probes, queueing <batch> at a time\n"
+    "       -Q <depth>       driver queue depth that triggers backpressure "
+    "(default: 5 slices)\n"
+    "       -r <rate>        target periodic probes/sec when pacing (default: "
+    "spread evenly over each slice)\n"
+    "       -R               reload probelist incrementally (keeps state of "
+    "unchanged /24s)\n"
     "       -s <slices>      periodic probing round slices (default: %d)\n"
     "       -S               do not sleep to align with interval start\n"
     "       -t <ts-per-/24>  Timeseries backend to use for per-/24 metrics\n"
     "       -T <ts-aggr>     Timeseries backend to use for aggregated metrics\n"
-    "                        (-t and -T can be used multiple times)\n",
-    TRINARKULAR_PROBER_PERIODIC_ROUND_SLICES_DEFAULT);
+    "                        (-t and -T can be used multiple times)\n"
+    "       -w <threads>     worker threads to partition probing across "
+    "(default: 1, max: %d)\n"
+    "       -X <path>        export /24 state to a shared table at <path> "
+    "(e.g. /dev/shm/trinarkular)\n",
+    TRINARKULAR_PROBER_PERIODIC_ROUND_SLICES_DEFAULT,
+    TRINARKULAR_PROBER_WORKER_MAX_CNT);
   timeseries_usage(ts_slash24);
 }
 
@@ -224,6 +259,13 @@ int main(int argc, char **argv)
   uint32_t wait = 0;
   int wait_set = 0;
 
+  uint32_t grace = 0;
+  int grace_set = 0;
+
+  uint32_t bp_latency = 0;
+  uint32_t bp_queue_depth = 0;
+  int bp_set = 0;
+
   int round_limit = 0;
   int round_limit_set = 0;
 
@@ -234,6 +276,33 @@ int main(int argc, char **argv)
 
   int disable_sleep = 0;
 
+  int incremental_reload = 0;
+
+  int lazy_keys = 0;
+
+  char *journal_prefix = NULL;
+
+  char *checkpoint_path = NULL;
+  char *state_table_path = NULL;
+
+  char *events_endpoint = NULL;
+  char *events_topic_prefix = NULL;
+
+  int keyframe_interval = 0;
+  int keyframe_interval_set = 0;
+
+  int pl_threads = 0;
+  int pl_threads_set = 0;
+
+  int worker_threads = 0;
+  int worker_threads_set = 0;
+
+  int batch_size = 0;
+  int batch_size_set = 0;
+
+  int pacing_batch_size = 0;
+  int pacing_rate = 0;
+
   char *backends_slash24[TIMESERIES_BACKEND_ID_LAST];
   int backends_slash24_cnt = 0;
   char *backends_aggr[TIMESERIES_BACKEND_ID_LAST];
@@ -252,28 +321,73 @@ int main(int argc, char **argv)
   }
 
   while (prevoptind = optind,
-         (opt = getopt(argc, argv, ":c:d:i:l:n:p:s:t:T:Sv?")) >= 0) {
+         (opt = getopt(argc, argv, ":b:c:C:d:D:e:E:i:j:J:Kl:L:m:n:p:P:Q:r:s:t:T:w:X:RSv?")) >= 0) {
     if (optind == prevoptind + 2 && optarg && *optarg == '-' &&
         *(optarg + 1) != '\0') {
       opt = ':';
       --optind;
     }
     switch (opt) {
+    case 'b':
+      batch_size = strtol(optarg, NULL, 10);
+      batch_size_set = 1;
+      break;
+
+    case 'C':
+      checkpoint_path = optarg;
+      break;
+
     case 'd':
       duration = strtoull(optarg, NULL, 10);
       duration_set = 1;
       break;
 
+    case 'D':
+      keyframe_interval = strtol(optarg, NULL, 10);
+      keyframe_interval_set = 1;
+      break;
+
+    case 'e':
+      grace = strtoul(optarg, NULL, 10);
+      grace_set = 1;
+      break;
+
+    case 'E':
+      events_endpoint = optarg;
+      break;
+
     case 'i':
       wait = strtoul(optarg, NULL, 10);
       wait_set = 1;
       break;
 
+    case 'j':
+      pl_threads = strtol(optarg, NULL, 10);
+      pl_threads_set = 1;
+      break;
+
+    case 'J':
+      journal_prefix = optarg;
+      break;
+
+    case 'K':
+      lazy_keys = 1;
+      break;
+
+    case 'L':
+      bp_latency = strtoul(optarg, NULL, 10);
+      bp_set = 1;
+      break;
+
     case 'l':
       round_limit = strtol(optarg, NULL, 10);
       round_limit_set = 1;
       break;
 
+    case 'm':
+      events_topic_prefix = optarg;
+      break;
+
     case 'n':
       prober_name = optarg;
       break;
@@ -289,6 +403,23 @@ int main(int argc, char **argv)
       driver_names_cnt++;
       break;
 
+    case 'Q':
+      bp_queue_depth = strtoul(optarg, NULL, 10);
+      bp_set = 1;
+      break;
+
+    case 'P':
+      pacing_batch_size = strtol(optarg, NULL, 10);
+      break;
+
+    case 'r':
+      pacing_rate = strtol(optarg, NULL, 10);
+      break;
+
+    case 'R':
+      incremental_reload = 1;
+      break;
+
     case 's':
       slices = strtol(optarg, NULL, 10);
       slices_set = 1;
@@ -306,6 +437,15 @@ int main(int argc, char **argv)
       backends_aggr[backends_aggr_cnt++] = optarg;
       break;
 
+    case 'w':
+      worker_threads = strtol(optarg, NULL, 10);
+      worker_threads_set = 1;
+      break;
+
+    case 'X':
+      state_table_path = optarg;
+      break;
+
     case ':':
       fprintf(stderr, "ERROR: Missing option argument for -%c\n", optopt);
       usage(argv[0]);
@@ -366,6 +506,10 @@ int main(int argc, char **argv)
     goto err;
   }
 
+  // the probelist randomizes host order (and where probing of each /24
+  // starts), which should differ between runs and between probers
+  srand(time(NULL) ^ getpid());
+
   if ((prober = trinarkular_prober_create(prober_name, probelist_file,
                                           ts_slash24, ts_aggr)) == NULL) {
     goto err;
@@ -379,6 +523,14 @@ int main(int argc, char **argv)
     trinarkular_prober_set_periodic_probe_timeout(prober, wait);
   }
 
+  if (grace_set != 0) {
+    trinarkular_prober_set_probe_expiry_grace(prober, grace);
+  }
+
+  if (bp_set != 0) {
+    trinarkular_prober_set_backpressure(prober, bp_latency, bp_queue_depth);
+  }
+
   if (round_limit_set != 0) {
     trinarkular_prober_set_periodic_round_limit(prober, round_limit);
   }
@@ -391,6 +543,100 @@ int main(int argc, char **argv)
     trinarkular_prober_disable_sleep_align_start(prober);
   }
 
+  if (incremental_reload != 0) {
+    trinarkular_prober_enable_incremental_reload(prober);
+  }
+
+  if (lazy_keys != 0) {
+    trinarkular_prober_enable_lazy_slash24_keys(prober);
+  }
+
+  if (journal_prefix != NULL &&
+      trinarkular_prober_enable_journal(
+        prober, journal_prefix, TRINARKULAR_JOURNAL_FILE_RECORDS_DEFAULT, 0) !=
+        0) {
+    goto err;
+  }
+
+  if (checkpoint_path != NULL &&
+      trinarkular_prober_enable_checkpoint(
+        prober, checkpoint_path, TRINARKULAR_PROBER_CHECKPOINT_INTERVAL_DEFAULT,
+        TRINARKULAR_PROBER_CHECKPOINT_MAX_AGE_DEFAULT) != 0) {
+    goto err;
+  }
+
+  if (state_table_path != NULL &&
+      trinarkular_prober_enable_state_table(prober, state_table_path) != 0) {
+    goto err;
+  }
+
+  if (events_topic_prefix != NULL && events_endpoint == NULL) {
+    fprintf(stderr, "ERROR: An event topic prefix requires events to be "
+                    "enabled (-E)\n");
+    usage(argv[0]);
+    goto err;
+  }
+
+  if (events_endpoint != NULL &&
+      trinarkular_prober_enable_events(
+        prober, events_endpoint, events_topic_prefix,
+        TRINARKULAR_PROBER_EVENTS_MAX_LATENCY_DEFAULT,
+        TRINARKULAR_PROBER_EVENTS_HWM_DEFAULT) != 0) {
+    goto err;
+  }
+
+  if (keyframe_interval_set != 0) {
+    if (keyframe_interval < 1) {
+      fprintf(stderr, "ERROR: Keyframe interval must be at least 1 round\n");
+      usage(argv[0]);
+      goto err;
+    }
+    trinarkular_prober_enable_delta_emission(prober, keyframe_interval);
+  }
+
+  if (pl_threads_set != 0) {
+    if (pl_threads < 1) {
+      fprintf(stderr, "ERROR: Probelist thread count must be at least 1\n");
+      usage(argv[0]);
+      goto err;
+    }
+    trinarkular_prober_set_probelist_threads(prober, pl_threads);
+  }
+
+  if (batch_size_set != 0) {
+    if (batch_size < 1) {
+      fprintf(stderr, "ERROR: Response batch size must be at least 1\n");
+      usage(argv[0]);
+      goto err;
+    }
+    trinarkular_prober_set_resp_batch_size(prober, batch_size);
+  }
+
+  if (pacing_rate != 0 && pacing_batch_size == 0) {
+    fprintf(stderr, "ERROR: A pacing rate requires pacing to be enabled (-P)\n");
+    usage(argv[0]);
+    goto err;
+  }
+  if (pacing_batch_size != 0) {
+    if (pacing_batch_size < 1 || pacing_rate < 0) {
+      fprintf(stderr, "ERROR: Invalid pacing batch size or rate\n");
+      usage(argv[0]);
+      goto err;
+    }
+    trinarkular_prober_enable_pacing(prober, pacing_batch_size, pacing_rate);
+  }
+
+  if (worker_threads_set != 0) {
+    if (worker_threads < 1 ||
+        worker_threads > TRINARKULAR_PROBER_WORKER_MAX_CNT) {
+      fprintf(stderr, "ERROR: Worker thread count must be between 1 and %d\n",
+              TRINARKULAR_PROBER_WORKER_MAX_CNT);
+      usage(argv[0]);
+      goto err;
+    }
+    trinarkular_prober_set_worker_threads(prober, worker_threads);
+  }
+
   for (i = 0; i < driver_names_cnt; i++) {
     if (driver_names[i] != NULL) {
       /* the driver_name string will contain the name of the driver, optionally
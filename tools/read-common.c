@@ -0,0 +1,95 @@
+/*
+ * This file is part of trinarkular
+ *
+ * Copyright (C) 2015 The Regents of the University of California.
+ * Authors: Alistair King
+ *
+ * This software is Copyright (c) 2015 The Regents of the University of
+ * California. All Rights Reserved. Permission to copy, modify, and distribute this
+ * software and its documentation for academic research and education purposes,
+ * without fee, and without a written agreement is hereby granted, provided that
+ * the above copyright notice, this paragraph and the following three paragraphs
+ * appear in all copies. Permission to make use of this software for other than
+ * academic research and education purposes may be obtained by contacting:
+ *
+ * Office of Innovation and Commercialization
+ * 9500 Gilman Drive, Mail Code 0910
+ * University of California
+ * La Jolla, CA 92093-0910
+ * (858) 534-5815
+ * invent@ucsd.edu
+ *
+ * This software program and documentation are copyrighted by The Regents of the
+ * University of California. The software program and documentation are supplied
+ * "as is", without any accompanying services from The Regents. The Regents does
+ * not warrant that the operation of the program will be uninterrupted or
+ * error-free. The end-user understands that the program was developed for research
+ * purposes and is advised not to rely exclusively on the program for any reason.
+ *
+ * IN NO EVENT SHALL THE UNIVERSITY OF CALIFORNIA BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+ * PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF
+ * THE UNIVERSITY OF CALIFORNIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE. THE UNIVERSITY OF CALIFORNIA SPECIFICALLY DISCLAIMS ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS
+ * IS" BASIS, AND THE UNIVERSITY OF CALIFORNIA HAS NO OBLIGATIONS TO PROVIDE
+ * MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ * Report any bugs, questions or comments to alistair@caida.org
+ *
+ */
+
+#include "read-common.h"
+#include "trinarkular.h"
+#include <arpa/inet.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *state_names[] = {
+  "uncertain", // 0
+  "down",      // 1
+  "up",        // 2
+};
+
+static const char *probe_type_names[] = {
+  "unprobed", // 0
+  "periodic", // 1
+  "adaptive", // 2
+  "recovery", // 3
+};
+
+#define NAME(names, i)                                                         \
+  ((i) < (sizeof(names) / sizeof(names[0])) ? names[(i)] : "unknown")
+
+int read_parse_prefix(char *str, uint32_t *first_ip, uint32_t *last_ip)
+{
+  char *slash;
+  struct in_addr addr;
+  unsigned long len = 32;
+  uint32_t mask;
+
+  if ((slash = strchr(str, '/')) != NULL) {
+    *slash = '\0';
+    len = strtoul(slash + 1, NULL, 10);
+  }
+  if (inet_pton(AF_INET, str, &addr) != 1 || len > 32) {
+    return -1;
+  }
+
+  mask = (len == 0) ? 0 : (UINT32_MAX << (32 - len));
+  *first_ip = ntohl(addr.s_addr) & mask & TRINARKULAR_SLASH24_NETMASK;
+  *last_ip = (ntohl(addr.s_addr) | ~mask) & TRINARKULAR_SLASH24_NETMASK;
+  return 0;
+}
+
+const char *read_state_name(unsigned int state)
+{
+  return NAME(state_names, state);
+}
+
+const char *read_probe_type_name(unsigned int probe_type)
+{
+  return NAME(probe_type_names, probe_type);
+}
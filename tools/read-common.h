@@ -0,0 +1,81 @@
+/*
+ * This file is part of trinarkular
+ *
+ * Copyright (C) 2015 The Regents of the University of California.
+ * Authors: Alistair King
+ *
+ * This software is Copyright (c) 2015 The Regents of the University of
+ * California. All Rights Reserved. Permission to copy, modify, and distribute this
+ * software and its documentation for academic research and education purposes,
+ * without fee, and without a written agreement is hereby granted, provided that
+ * the above copyright notice, this paragraph and the following three paragraphs
+ * appear in all copies. Permission to make use of this software for other than
+ * academic research and education purposes may be obtained by contacting:
+ *
+ * Office of Innovation and Commercialization
+ * 9500 Gilman Drive, Mail Code 0910
+ * University of California
+ * La Jolla, CA 92093-0910
+ * (858) 534-5815
+ * invent@ucsd.edu
+ *
+ * This software program and documentation are copyrighted by The Regents of the
+ * University of California. The software program and documentation are supplied
+ * "as is", without any accompanying services from The Regents. The Regents does
+ * not warrant that the operation of the program will be uninterrupted or
+ * error-free. The end-user understands that the program was developed for research
+ * purposes and is advised not to rely exclusively on the program for any reason.
+ *
+ * IN NO EVENT SHALL THE UNIVERSITY OF CALIFORNIA BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+ * PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF
+ * THE UNIVERSITY OF CALIFORNIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE. THE UNIVERSITY OF CALIFORNIA SPECIFICALLY DISCLAIMS ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS
+ * IS" BASIS, AND THE UNIVERSITY OF CALIFORNIA HAS NO OBLIGATIONS TO PROVIDE
+ * MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ * Report any bugs, questions or comments to alistair@caida.org
+ *
+ */
+
+#ifndef __READ_COMMON_H
+#define __READ_COMMON_H
+
+#include <stdint.h>
+
+/** @file
+ *
+ * @brief Helpers shared by the tools that read prober output (journals and
+ * state tables)
+ *
+ * @author Alistair King
+ *
+ */
+
+/** Parse a prefix into the range of /24s that it covers
+ *
+ * @param str           prefix to parse (e.g. "192.0.2.0/23"), which is
+ *                      modified
+ * @param first_ip[out] filled with the network IP of the first /24
+ * @param last_ip[out]  filled with the network IP of the last /24
+ * @return 0 if successful, -1 if the prefix is invalid
+ */
+int read_parse_prefix(char *str, uint32_t *first_ip, uint32_t *last_ip);
+
+/** Get the name of a /24 state
+ *
+ * @param state         state (0: uncertain, 1: down, 2: up)
+ * @return the name of the state, or "unknown"
+ */
+const char *read_state_name(unsigned int state);
+
+/** Get the name of a probe type
+ *
+ * @param probe_type    probe type (as recorded in journals)
+ * @return the name of the probe type, or "unknown"
+ */
+const char *read_probe_type_name(unsigned int probe_type);
+
+#endif /* __READ_COMMON_H */
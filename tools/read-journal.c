@@ -0,0 +1,182 @@
+/*
+ * This file is part of trinarkular
+ *
+ * Copyright (C) 2015 The Regents of the University of California.
+ * Authors: Alistair King
+ *
+ * This software is Copyright (c) 2015 The Regents of the University of
+ * California. All Rights Reserved. Permission to copy, modify, and distribute this
+ * software and its documentation for academic research and education purposes,
+ * without fee, and without a written agreement is hereby granted, provided that
+ * the above copyright notice, this paragraph and the following three paragraphs
+ * appear in all copies. Permission to make use of this software for other than
+ * academic research and education purposes may be obtained by contacting:
+ *
+ * Office of Innovation and Commercialization
+ * 9500 Gilman Drive, Mail Code 0910
+ * University of California
+ * La Jolla, CA 92093-0910
+ * (858) 534-5815
+ * invent@ucsd.edu
+ *
+ * This software program and documentation are copyrighted by The Regents of the
+ * University of California. The software program and documentation are supplied
+ * "as is", without any accompanying services from The Regents. The Regents does
+ * not warrant that the operation of the program will be uninterrupted or
+ * error-free. The end-user understands that the program was developed for research
+ * purposes and is advised not to rely exclusively on the program for any reason.
+ *
+ * IN NO EVENT SHALL THE UNIVERSITY OF CALIFORNIA BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+ * PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF
+ * THE UNIVERSITY OF CALIFORNIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE. THE UNIVERSITY OF CALIFORNIA SPECIFICALLY DISCLAIMS ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS
+ * IS" BASIS, AND THE UNIVERSITY OF CALIFORNIA HAS NO OBLIGATIONS TO PROVIDE
+ * MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ * Report any bugs, questions or comments to alistair@caida.org
+ *
+ */
+
+#include "read-common.h"
+#include "trinarkular.h"
+#include "trinarkular_log.h"
+#include "config.h"
+#include <arpa/inet.h>
+#include <assert.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void usage(char *name)
+{
+  fprintf(stderr,
+          "Usage: %s [options] journal-file [journal-file...]\n"
+          "       -c               only print the number of matching records\n"
+          "       -e <time>        latest transition time (ms since the "
+          "epoch)\n"
+          "       -p <prefix>      only /24s in the given prefix (e.g. "
+          "192.0.2.0/23)\n"
+          "       -s <time>        earliest transition time (ms since the "
+          "epoch)\n"
+          "\n"
+          "Prints the /24 state transitions recorded in prober journals as:\n"
+          "  <time> <network> <old-state> <new-state> <B(U)> <probe-type>\n",
+          name);
+}
+
+static int print_rec(const trinarkular_journal_rec_t *rec, void *user)
+{
+  struct in_addr addr;
+  char buf[INET_ADDRSTRLEN];
+
+  addr.s_addr = htonl(rec->network_ip);
+  inet_ntop(AF_INET, &addr, buf, sizeof(buf));
+
+  printf("%" PRIu64 " %s/24 %s %s %0.3f %s\n", rec->time, buf,
+         read_state_name(TRINARKULAR_JOURNAL_OLD_STATE(rec)),
+         read_state_name(TRINARKULAR_JOURNAL_NEW_STATE(rec)),
+         trinarkular_belief_to_prob(rec->belief),
+         read_probe_type_name(rec->probe_type));
+  return 0;
+}
+
+static int count_rec(const trinarkular_journal_rec_t *rec, void *user)
+{
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  int opt, prevoptind;
+  int count_only = 0;
+  uint64_t match_cnt = 0;
+  int64_t ret;
+  trinarkular_journal_filter_t filter = {
+    0, UINT32_MAX, 0, UINT64_MAX,
+  };
+  trinarkular_journal_reader_t *reader = NULL;
+
+  while (prevoptind = optind, (opt = getopt(argc, argv, ":ce:p:s:v?")) >= 0) {
+    if (optind == prevoptind + 2 && optarg && *optarg == '-' &&
+        *(optarg + 1) != '\0') {
+      opt = ':';
+      --optind;
+    }
+    switch (opt) {
+    case 'c':
+      count_only = 1;
+      break;
+
+    case 'e':
+      filter.time_last = strtoull(optarg, NULL, 10);
+      break;
+
+    case 'p':
+      if (read_parse_prefix(optarg, &filter.ip_first, &filter.ip_last) !=
+          0) {
+        fprintf(stderr, "ERROR: Invalid prefix: %s\n", optarg);
+        usage(argv[0]);
+        goto err;
+      }
+      break;
+
+    case 's':
+      filter.time_first = strtoull(optarg, NULL, 10);
+      break;
+
+    case ':':
+      fprintf(stderr, "ERROR: Missing option argument for -%c\n", optopt);
+      usage(argv[0]);
+      goto err;
+      break;
+
+    case '?':
+    case 'v':
+      fprintf(stderr, "trinarkular version %d.%d.%d\n",
+              TRINARKULAR_MAJOR_VERSION, TRINARKULAR_MID_VERSION,
+              TRINARKULAR_MINOR_VERSION);
+      usage(argv[0]);
+      goto err;
+      break;
+
+    default:
+      usage(argv[0]);
+      goto err;
+    }
+  }
+
+  if (optind >= argc) {
+    fprintf(stderr, "ERROR: At least one journal file must be specified\n");
+    usage(argv[0]);
+    goto err;
+  }
+
+  for (; optind < argc; optind++) {
+    if ((reader = trinarkular_journal_open(argv[optind])) == NULL) {
+      goto err;
+    }
+    if ((ret = trinarkular_journal_scan(
+           reader, &filter, count_only ? count_rec : print_rec, NULL)) < 0) {
+      goto err;
+    }
+    match_cnt += ret;
+    trinarkular_journal_close(reader);
+    reader = NULL;
+  }
+
+  if (count_only != 0) {
+    printf("%" PRIu64 "\n", match_cnt);
+  }
+
+  return 0;
+
+err:
+  trinarkular_journal_close(reader);
+  return -1;
+}
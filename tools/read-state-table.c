@@ -0,0 +1,184 @@
+/*
+ * This file is part of trinarkular
+ *
+ * Copyright (C) 2015 The Regents of the University of California.
+ * Authors: Alistair King
+ *
+ * This software is Copyright (c) 2015 The Regents of the University of
+ * California. All Rights Reserved. Permission to copy, modify, and distribute this
+ * software and its documentation for academic research and education purposes,
+ * without fee, and without a written agreement is hereby granted, provided that
+ * the above copyright notice, this paragraph and the following three paragraphs
+ * appear in all copies. Permission to make use of this software for other than
+ * academic research and education purposes may be obtained by contacting:
+ *
+ * Office of Innovation and Commercialization
+ * 9500 Gilman Drive, Mail Code 0910
+ * University of California
+ * La Jolla, CA 92093-0910
+ * (858) 534-5815
+ * invent@ucsd.edu
+ *
+ * This software program and documentation are copyrighted by The Regents of the
+ * University of California. The software program and documentation are supplied
+ * "as is", without any accompanying services from The Regents. The Regents does
+ * not warrant that the operation of the program will be uninterrupted or
+ * error-free. The end-user understands that the program was developed for research
+ * purposes and is advised not to rely exclusively on the program for any reason.
+ *
+ * IN NO EVENT SHALL THE UNIVERSITY OF CALIFORNIA BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+ * PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN IF
+ * THE UNIVERSITY OF CALIFORNIA HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE. THE UNIVERSITY OF CALIFORNIA SPECIFICALLY DISCLAIMS ANY WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS
+ * IS" BASIS, AND THE UNIVERSITY OF CALIFORNIA HAS NO OBLIGATIONS TO PROVIDE
+ * MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ * Report any bugs, questions or comments to alistair@caida.org
+ *
+ */
+
+
+#include "read-common.h"
+#include "trinarkular.h"
+#include "trinarkular_log.h"
+#include "config.h"
+#include <arpa/inet.h>
+#include <assert.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void usage(char *name)
+{
+  fprintf(stderr,
+          "Usage: %s [options] state-table-file\n"
+          "       -c               only print the number of /24s in each "
+          "state\n"
+          "       -p <prefix>      only /24s in the given prefix (e.g. "
+          "192.0.2.0/23)\n"
+          "\n"
+          "Prints the current state of the /24s in the state table exported "
+          "by a prober\n"
+          "(with the last round that had completed) as:\n"
+          "  # round <round-id> <time>\n"
+          "  <network> <state> <B(U)>\n",
+          name);
+}
+
+int main(int argc, char **argv)
+{
+  int opt, prevoptind;
+  int count_only = 0;
+  uint32_t first_ip = 0;
+  uint32_t last_ip = TRINARKULAR_SLASH24_NETMASK;
+  uint64_t entries_cnt, i;
+  uint64_t round_id, round_time;
+  uint64_t state_cnts[3] = {0, 0, 0};
+  trinarkular_state_table_entry_t *entries = NULL;
+  trinarkular_state_table_reader_t *reader = NULL;
+  struct in_addr addr;
+  char buf[INET_ADDRSTRLEN];
+
+  while (prevoptind = optind, (opt = getopt(argc, argv, ":cp:v?")) >= 0) {
+    if (optind == prevoptind + 2 && optarg && *optarg == '-' &&
+        *(optarg + 1) != '\0') {
+      opt = ':';
+      --optind;
+    }
+    switch (opt) {
+    case 'c':
+      count_only = 1;
+      break;
+
+    case 'p':
+      if (read_parse_prefix(optarg, &first_ip, &last_ip) != 0) {
+        fprintf(stderr, "ERROR: Invalid prefix: %s\n", optarg);
+        usage(argv[0]);
+        goto err;
+      }
+      break;
+
+    case ':':
+      fprintf(stderr, "ERROR: Missing option argument for -%c\n", optopt);
+      usage(argv[0]);
+      goto err;
+      break;
+
+    case '?':
+    case 'v':
+      fprintf(stderr, "trinarkular version %d.%d.%d\n",
+              TRINARKULAR_MAJOR_VERSION, TRINARKULAR_MID_VERSION,
+              TRINARKULAR_MINOR_VERSION);
+      usage(argv[0]);
+      goto err;
+      break;
+
+    default:
+      usage(argv[0]);
+      goto err;
+    }
+  }
+
+  if (optind != argc - 1) {
+    fprintf(stderr, "ERROR: Exactly one state table file must be specified\n");
+    usage(argv[0]);
+    goto err;
+  }
+
+  if ((reader = trinarkular_state_table_open(argv[optind])) == NULL) {
+    goto err;
+  }
+
+  // copy the range out so that the prober can update the table while we print
+  entries_cnt = ((last_ip - first_ip) >> 8) + 1;
+  if ((entries = malloc(sizeof(trinarkular_state_table_entry_t) *
+                        entries_cnt)) == NULL) {
+    fprintf(stderr, "ERROR: Could not allocate %" PRIu64 " entries\n",
+            entries_cnt);
+    goto err;
+  }
+  trinarkular_state_table_copy(reader, first_ip, last_ip, entries, &round_id,
+                               &round_time);
+  trinarkular_state_table_close(reader);
+  reader = NULL;
+
+  if (count_only == 0) {
+    printf("# round %" PRIu64 " %" PRIu64 "\n", round_id, round_time);
+  }
+
+  for (i = 0; i < entries_cnt; i++) {
+    if ((entries[i].flags & TRINARKULAR_STATE_TABLE_PRESENT) == 0) {
+      continue;
+    }
+    if (count_only != 0) {
+      if (entries[i].state < 3) {
+        state_cnts[entries[i].state]++;
+      }
+      continue;
+    }
+    addr.s_addr = htonl(first_ip + (uint32_t)(i << 8));
+    inet_ntop(AF_INET, &addr, buf, sizeof(buf));
+    printf("%s/24 %s %0.3f\n", buf, read_state_name(entries[i].state),
+           trinarkular_belief_to_prob(entries[i].belief));
+  }
+
+  if (count_only != 0) {
+    for (i = 0; i < 3; i++) {
+      printf("%s %" PRIu64 "\n", read_state_name(i), state_cnts[i]);
+    }
+  }
+
+  free(entries);
+  return 0;
+
+err:
+  free(entries);
+  trinarkular_state_table_close(reader);
+  return -1;
+}